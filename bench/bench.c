@@ -0,0 +1,858 @@
+/**
+ * @file: bench.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Benchmark harness that times the public filters of ocular over standard image sizes and channel counts.
+ *
+ * Every filter runs once to warm up, which also records the peak scratch memory it takes from a fresh workspace, and is
+ * then timed until the minimum time has elapsed. The median time of the timed runs is reported as megapixels per second
+ * and nanoseconds per pixel, as a text table or as JSON or CSV for regression tracking.
+ *
+ * Usage: ocular_bench [options]
+ *   --filter <names>    comma separated substrings of the filter names to run (case insensitive)
+ *   --sizes <names>     comma separated sizes from vga, 1080p, 4k, 24mp (default: all)
+ *   --channels <list>   comma separated channel counts from 1, 3, 4 (default: all)
+ *   --min-time <sec>    minimum time to spend timing each case (default: 0.5)
+ *   --threads <count>   number of threads, 0 for one per processor (default: 0)
+ *   --format <name>     text, json or csv (default: text)
+ *   --output <file>     write the report to a file instead of stdout
+ *   --list              list the filter names and exit
+ */
+
+#if defined(_MSC_VER)
+    #define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "../lib/ocular.h"
+#include "../demo/timing.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_ITERATIONS 1000
+
+// Channel counts a filter accepts
+#define CH_1 1
+#define CH_3 2
+#define CH_4 4
+#define CH_COLOR (CH_3 | CH_4)
+#define CH_GRAY_RGB (CH_1 | CH_3)
+#define CH_ALL (CH_1 | CH_3 | CH_4)
+
+typedef struct {
+    unsigned char* input;
+    unsigned char* output;
+    unsigned char* aux; // second image, for blending
+    int width;
+    int height;
+    int stride;
+    int channels;
+} BenchImage;
+
+typedef OC_STATUS (*BenchRunner)(BenchImage* b);
+
+typedef struct {
+    const char* name;
+    int channelMask;
+    BenchRunner run;
+} BenchFilter;
+
+typedef struct {
+    const char* name;
+    int width;
+    int height;
+} BenchSize;
+
+typedef struct {
+    const char* filter;
+    const char* size;
+    int width;
+    int height;
+    int channels;
+    OC_STATUS status;
+    int iterations;
+    double seconds; // median time of one run
+    size_t peakScratch;
+} BenchResult;
+
+static const BenchSize benchSizes[] = {
+    { "vga", 640, 480 },
+    { "1080p", 1920, 1080 },
+    { "4k", 3840, 2160 },
+    { "24mp", 6000, 4000 },
+};
+
+/* Filter parameters  -----------------------------------------------*/
+
+static unsigned char benchLookupTable[512 * 512 * 3];
+static float benchColorMatrix[16] = {
+    0.9f, 0.1f, 0.0f, 0.0f,
+    0.0f, 0.9f, 0.1f, 0.0f,
+    0.1f, 0.0f, 0.9f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+};
+static const float benchMixer[16] = {
+    0.8f, 0.2f, 0.0f, 0.0f,
+    0.1f, 0.8f, 0.1f, 0.0f,
+    0.0f, 0.2f, 0.8f, 0.0f,
+    0.3f, 0.6f, 0.1f, 0.0f,
+};
+static float benchGamma[3] = { 1.2f, 1.0f, 0.8f };
+static ocularLevelParams benchLevels = { 20, 128, 235, 0, 255, true };
+static float benchConvolutionKernel[25] = {
+    1, 4, 6, 4, 1,
+    4, 16, 24, 16, 4,
+    6, 24, 36, 24, 6,
+    4, 16, 24, 16, 4,
+    1, 4, 6, 4, 1,
+};
+static CloudParams benchClouds = { 30.0f, 6, 20, 40, 120, 250, 250, 250, 100.0f, 1, OC_NOISE_PERLIN };
+static OcFFTFilterParams benchFFTParams = { OC_FFT_LOWPASS, 0.2f, 0.0f, NULL, 0, 1.0f };
+static OcCurve* benchCurves[4] = { NULL };
+static OcPipeline* benchPipeline = NULL;
+
+// Plans and row buffers of the FFT plan entries, made again when the width changes so planning stays out of the timed runs
+static struct {
+    int length;
+    OcFFTPlan* plan;
+    OcFFTPlan* realPlan;
+    OcComplex* signal;
+    OcComplex* spectrum;
+    float* samples;
+} benchFFT = { 0 };
+
+// Bit images of the binary entries: the input thresholded once per size, and the result
+static struct {
+    int width;
+    int height;
+    OcImage* bits;
+    OcImage* result;
+} benchBits = { 0 };
+
+static void freeBitImages(void) {
+    if (benchBits.bits)
+        ocularFreeImage(&benchBits.bits);
+    if (benchBits.result)
+        ocularFreeImage(&benchBits.result);
+    memset(&benchBits, 0, sizeof(benchBits));
+}
+
+static bool prepareBitImages(const unsigned char* input, int width, int height, int stride) {
+    if (benchBits.width == width && benchBits.height == height)
+        return true;
+    freeBitImages();
+    if (ocularCreateImage(width, height, OC_DEPTH_1U, 1, &benchBits.bits) != OC_STATUS_OK ||
+        ocularCreateImage(width, height, OC_DEPTH_1U, 1, &benchBits.result) != OC_STATUS_OK ||
+        ocularThresholdToBits(input, width, height, stride, 128, benchBits.bits) != OC_STATUS_OK)
+        return false;
+    benchBits.width = width;
+    benchBits.height = height;
+    return true;
+}
+
+static void freeFFTPlans(void) {
+    ocularFreeFFTPlan(&benchFFT.plan);
+    ocularFreeFFTPlan(&benchFFT.realPlan);
+    free(benchFFT.signal);
+    free(benchFFT.spectrum);
+    free(benchFFT.samples);
+    memset(&benchFFT, 0, sizeof(benchFFT));
+}
+
+static bool prepareFFTPlans(int length) {
+    if (benchFFT.length == length)
+        return true;
+    freeFFTPlans();
+    if (ocularCreateFFTPlan(length, &benchFFT.plan) != OC_STATUS_OK || ocularCreateRealFFTPlan(length, &benchFFT.realPlan) != OC_STATUS_OK)
+        return false;
+    benchFFT.signal = (OcComplex*)malloc(length * sizeof(OcComplex));
+    benchFFT.spectrum = (OcComplex*)malloc(length * sizeof(OcComplex));
+    benchFFT.samples = (float*)malloc(length * sizeof(float));
+    if (benchFFT.signal == NULL || benchFFT.spectrum == NULL || benchFFT.samples == NULL)
+        return false;
+    benchFFT.length = length;
+    return true;
+}
+
+static bool setupParameters(void) {
+    // identity color lookup: 8x8 tiles of 64x64, blue selects the tile
+    for (int y = 0; y < 512; y++) {
+        for (int x = 0; x < 512; x++) {
+            unsigned char* p = benchLookupTable + (y * 512 + x) * 3;
+            p[0] = (unsigned char)((x % 64) * 255 / 63);
+            p[1] = (unsigned char)((y % 64) * 255 / 63);
+            p[2] = (unsigned char)(((y / 64) * 8 + x / 64) * 255 / 63);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        benchCurves[i] = createCurve();
+        if (benchCurves[i] == NULL)
+            return false;
+        curveAddPoint(benchCurves[i], 64, (uint8_t)(56 + 8 * i));
+        curveAddPoint(benchCurves[i], 192, (uint8_t)(200 - 4 * i));
+        curveBuild(benchCurves[i]);
+    }
+
+    if (ocularCreatePipeline(&benchPipeline) != OC_STATUS_OK)
+        return false;
+    ocularPipelineAddLevels(benchPipeline, &benchLevels, &benchLevels, &benchLevels);
+    ocularPipelineAddGamma(benchPipeline, benchGamma);
+    ocularPipelineAddUnsharpMask(benchPipeline, 1.5f, 1.0f, 0.0f);
+    return true;
+}
+
+static void cleanupParameters(void) {
+    for (int i = 0; i < 4; i++) {
+        if (benchCurves[i])
+            destroyCurve(benchCurves[i]);
+    }
+    if (benchPipeline)
+        ocularFreePipeline(&benchPipeline);
+    freeFFTPlans();
+    freeBitImages();
+}
+
+/* End Filter parameters  -------------------------------------------*/
+
+/* Filters needing more than one call  ------------------------------*/
+
+static OC_STATUS benchAverageColor(BenchImage* b) {
+    unsigned char r, g, bl, a;
+    return ocularAverageColor(b->input, b->width, b->height, b->stride, &r, &g, &bl, &a);
+}
+
+static OC_STATUS benchLuminosity(BenchImage* b) {
+    unsigned char luminance;
+    return ocularLuminosity(b->input, b->width, b->height, b->stride, &luminance);
+}
+
+static OC_STATUS benchAutoWhiteBalance(BenchImage* b) {
+    bool hasColorCast;
+    return ocularAutoWhiteBalance(b->input, b->output, b->width, b->height, b->stride, 15, 0.01f, 0.9f, &hasColorCast);
+}
+
+static OC_STATUS benchSplitToning(BenchImage* b) {
+    OcColor highlight = { 255, 200, 120 };
+    OcColor shadow = { 40, 80, 160 };
+    return ocularSplitToningFilter(b->input, b->output, b->width, b->height, b->stride, highlight, shadow, 0.0f, 50.0f);
+}
+
+static OC_STATUS benchLayerBlend(BenchImage* b) {
+    // blends into the output, which holds a copy of the input from the previous run; 4 channel images count as premultiplied
+    return ocularLayerBlend(b->output, b->width, b->height, b->stride, b->aux, b->width, b->height, b->stride, OC_BLEND_OVERLAY, 70);
+}
+
+static OC_STATUS benchRotate(BenchImage* b) {
+    int newWidth, newHeight;
+    return ocularRotateImage(b->input, b->width, b->height, b->stride, b->output, &newWidth, &newHeight, 15.0f, true, false,
+                             OC_INTERPOLATE_BILINEAR, 255, 255, 255);
+}
+
+static OC_STATUS benchDeskew(BenchImage* b) {
+    bool skewed = false;
+    return ocularDocumentDeskew(b->input, b->output, b->width, b->height, b->stride, &skewed);
+}
+
+static OC_STATUS benchHoughLines(BenchImage* b) {
+    // one entry per cell of the coarse vote table bounds the number of lines
+    int diagonal = (int)sqrt((double)b->width * b->width + (double)b->height * b->height);
+    struct LineParameter* lines = (struct LineParameter*)malloc(46 * (diagonal / 2 + 1) * sizeof(struct LineParameter));
+    if (lines == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    int lineNumber = 0;
+    OC_STATUS status = ocularHoughLineDetection(b->input, &lineNumber, lines, b->height, b->width, max(b->width, b->height) / 2);
+    free(lines);
+    return status;
+}
+
+static OC_STATUS benchThumbnails(BenchImage* b) {
+    // quarter, eighth and sixteenth size thumbnails, packed one after another into the output
+    OcThumbnail thumbnails[3];
+    unsigned char* data = b->output;
+    for (int i = 0; i < 3; i++) {
+        thumbnails[i].Data = data;
+        thumbnails[i].Width = b->width >> (i + 2);
+        thumbnails[i].Height = b->height >> (i + 2);
+        thumbnails[i].Stride = thumbnails[i].Width * b->channels;
+        data += (size_t)thumbnails[i].Stride * thumbnails[i].Height;
+    }
+    return ocularResamplingThumbnails(b->input, b->width, b->height, b->stride, thumbnails, 3, OC_INTERPOLATE_BILINEAR);
+}
+
+static OC_STATUS benchThresholdToBits(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularThresholdToBits(b->input, b->width, b->height, b->stride, 128, benchBits.result);
+}
+
+static OC_STATUS benchAutoThresholdToBits(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularAutoThresholdToBits(b->input, b->width, b->height, b->stride, OC_AUTO_THRESHOLD_OTSU, benchBits.result);
+}
+
+static OC_STATUS benchBinaryErode(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularBinaryErode(benchBits.bits, benchBits.result, 3);
+}
+
+static OC_STATUS benchBinaryDilate(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularBinaryDilate(benchBits.bits, benchBits.result, 3);
+}
+
+static OC_STATUS benchBinaryOpen(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularBinaryOpen(benchBits.bits, benchBits.result, 3);
+}
+
+static OC_STATUS benchBinaryClose(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularBinaryClose(benchBits.bits, benchBits.result, 3);
+}
+
+static OC_STATUS benchBinarySkeletonize(BenchImage* b) {
+    if (!prepareBitImages(b->input, b->width, b->height, b->stride))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return ocularBinarySkeletonize(benchBits.bits, benchBits.result);
+}
+
+static OC_STATUS benchPipelineStream(BenchImage* b) {
+    // pushes strips of 64 rows, as a decoder feeding the stream would, and pulls whatever each strip completes
+    OcPipelineStream* stream = NULL;
+    OC_STATUS status = ocularCreatePipelineStream(benchPipeline, b->width, b->height, b->channels, &stream);
+    if (status != OC_STATUS_OK)
+        return status;
+    int pushed = 0, pulled = 0;
+    while (status == OC_STATUS_OK && pulled < b->height) {
+        int accepted = 0, rows = 0;
+        if (pushed < b->height) {
+            status = ocularPipelineStreamPush(stream, b->input + (size_t)pushed * b->stride, min(64, b->height - pushed), b->stride, &accepted);
+            pushed += accepted;
+        }
+        if (status == OC_STATUS_OK) {
+            status = ocularPipelineStreamPull(stream, b->output + (size_t)pulled * b->stride, b->height - pulled, b->stride, &rows);
+            pulled += rows;
+        }
+        if (status == OC_STATUS_OK && accepted == 0 && rows == 0)
+            status = OC_STATUS_ERR_UNKNOWN; // the stream stalled
+    }
+    ocularFreePipelineStream(&stream);
+    return status;
+}
+
+static OC_STATUS benchFFTExecute(BenchImage* b) {
+    // a forward and an inverse transform of every row of every channel
+    if (!prepareFFTPlans(b->width))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    for (int y = 0; y < b->height; y++) {
+        const unsigned char* in = b->input + (size_t)y * b->stride;
+        unsigned char* out = b->output + (size_t)y * b->stride;
+        for (int c = 0; c < b->channels; c++) {
+            for (int x = 0; x < b->width; x++) {
+                benchFFT.signal[x].real = in[x * b->channels + c];
+                benchFFT.signal[x].imag = 0;
+            }
+            OC_STATUS status = ocularFFTExecute(benchFFT.plan, benchFFT.signal, benchFFT.spectrum, false);
+            if (status == OC_STATUS_OK)
+                status = ocularFFTExecute(benchFFT.plan, benchFFT.spectrum, benchFFT.signal, true);
+            if (status != OC_STATUS_OK)
+                return status;
+            for (int x = 0; x < b->width; x++)
+                out[x * b->channels + c] = ClampToByte((int)(benchFFT.signal[x].real + 0.5f));
+        }
+    }
+    return OC_STATUS_OK;
+}
+
+static OC_STATUS benchFFTExecuteReal(BenchImage* b) {
+    // as benchFFTExecute(), through the half spectrum of the real transform
+    if (!prepareFFTPlans(b->width))
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    for (int y = 0; y < b->height; y++) {
+        const unsigned char* in = b->input + (size_t)y * b->stride;
+        unsigned char* out = b->output + (size_t)y * b->stride;
+        for (int c = 0; c < b->channels; c++) {
+            for (int x = 0; x < b->width; x++)
+                benchFFT.samples[x] = in[x * b->channels + c];
+            OC_STATUS status = ocularFFTExecuteReal(benchFFT.realPlan, benchFFT.samples, benchFFT.spectrum);
+            if (status == OC_STATUS_OK)
+                status = ocularFFTExecuteRealInverse(benchFFT.realPlan, benchFFT.spectrum, benchFFT.samples);
+            if (status != OC_STATUS_OK)
+                return status;
+            for (int x = 0; x < b->width; x++)
+                out[x * b->channels + c] = ClampToByte((int)(benchFFT.samples[x] + 0.5f));
+        }
+    }
+    return OC_STATUS_OK;
+}
+
+/* End Filters needing more than one call  --------------------------*/
+
+// Every benchmarked filter: name, accepted channel counts and the call. In, Out, Aux, W, H, S and C are the image being run.
+// Deprecated wrappers (contrast, brightness, opacity) and the file based functions are left out.
+#define BENCH_FILTERS(X)                                                                                                              \
+    X(ocularGrayscaleFilter, CH_COLOR, ocularGrayscaleFilter(In, Out, W, H, S))                                                       \
+    X(ocularRGBFilter, CH_COLOR, ocularRGBFilter(In, Out, W, H, S, 1.1f, 0.9f, 1.05f))                                                \
+    X(ocularHSLFilter, CH_COLOR, ocularHSLFilter(In, Out, W, H, S, 0.1f, 0.6f, 0.5f))                                                 \
+    X(ocularAverageLuminanceThresholdFilter, CH_ALL, ocularAverageLuminanceThresholdFilter(In, Out, W, H, S, 1.0f))                   \
+    X(ocularAverageColor, CH_ALL, benchAverageColor(b))                                                                               \
+    X(ocularLuminosity, CH_ALL, benchLuminosity(b))                                                                                   \
+    X(ocularColorMatrixFilter, CH_COLOR, ocularColorMatrixFilter(In, Out, W, H, S, benchColorMatrix, 1.0f))                           \
+    X(ocularChannelMixerFilter, CH_COLOR, ocularChannelMixerFilter(In, Out, W, H, S, benchMixer, false, false))                       \
+    X(ocularSepiaFilter, CH_COLOR, ocularSepiaFilter(In, Out, W, H, S, 80))                                                           \
+    X(ocularChromaKeyFilter, CH_COLOR, ocularChromaKeyFilter(In, Out, W, H, S, 0, 255, 0, 0.4f, 0.1f))                                \
+    X(ocularLookupFilter, CH_COLOR, ocularLookupFilter(In, Out, benchLookupTable, W, H, S, 100))                                      \
+    X(ocularSaturationFilter, CH_COLOR, ocularSaturationFilter(In, Out, W, H, S, 0.7f))                                               \
+    X(ocularGammaFilter, CH_GRAY_RGB, ocularGammaFilter(In, Out, W, H, S, benchGamma))                                                \
+    X(ocularBrightnessAndContrastFilter, CH_ALL, ocularBrightnessAndContrastFilter(In, Out, W, H, S, 0.1f, 0.2f))                     \
+    X(ocularExposureFilter, CH_ALL, ocularExposureFilter(In, Out, W, H, S, 0.5f))                                                     \
+    X(ocularFalseColorFilter, CH_COLOR, ocularFalseColorFilter(In, Out, W, H, S, 0, 0, 128, 255, 200, 0, 100))                        \
+    X(ocularHazeFilter, CH_COLOR, ocularHazeFilter(In, Out, W, H, S, 0.2f, 0.1f, 100))                                                \
+    X(ocularLevelsFilter, CH_ALL, ocularLevelsFilter(In, Out, W, H, S, &benchLevels, &benchLevels, &benchLevels))                     \
+    X(ocularHueFilter, CH_COLOR, ocularHueFilter(In, Out, W, H, S, 45.0f))                                                            \
+    X(ocularHighlightShadowTintFilter, CH_COLOR,                                                                                      \
+      ocularHighlightShadowTintFilter(In, Out, W, H, S, 0.2f, 0.3f, 0.8f, 1.0f, 0.8f, 0.4f, 0.5f, 0.5f))                              \
+    X(ocularHighlightShadowFilter, CH_COLOR, ocularHighlightShadowFilter(In, Out, W, H, S, 0.3f, 0.2f, -0.2f))                        \
+    X(ocularMonochromeFilter, CH_COLOR, ocularMonochromeFilter(In, Out, W, H, S, 150, 110, 60, 80))                                   \
+    X(ocularColorInvertFilter, CH_COLOR, ocularColorInvertFilter(In, Out, W, H, S))                                                   \
+    X(ocularSolidColorGenerator, CH_COLOR, ocularSolidColorGenerator(Out, W, H, S, 10, 20, 30, 255))                                  \
+    X(ocularLuminanceThresholdFilter, CH_ALL, ocularLuminanceThresholdFilter(In, Out, W, H, S, 128))                                  \
+    X(ocularAutoContrast, CH_ALL, ocularAutoContrast(In, Out, W, H, C))                                                               \
+    X(ocularAutoGammaCorrection, CH_ALL, ocularAutoGammaCorrection(In, Out, W, H, S))                                                 \
+    X(ocularAutoWhiteBalance, CH_COLOR, benchAutoWhiteBalance(b))                                                                     \
+    X(ocularWhiteBalanceFilter, CH_COLOR, ocularWhiteBalanceFilter(In, Out, W, H, S, 6000.0f, 20.0f))                                 \
+    X(ocularVibranceFilter, CH_COLOR, ocularVibranceFilter(In, Out, W, H, S, 0.5f))                                                   \
+    X(ocularSkinToneFilter, CH_COLOR, ocularSkinToneFilter(In, Out, W, H, S, 0.2f, 0.05f, 40.0f, 0.25f, 0.4f, 1))                     \
+    X(ocularSplitToningFilter, CH_COLOR, benchSplitToning(b))                                                                         \
+    X(ocularAutoLevel, CH_ALL, ocularAutoLevel(In, Out, W, H, S, 0.01f))                                                              \
+    X(ocularEqualizeFilter, CH_3, ocularEqualizeFilter(In, Out, W, H, S))                                                             \
+    X(ocularHistogramStretch, CH_ALL, ocularHistogramStretch(In, Out, W, H, C))                                                       \
+    X(ocularAutoThreshold, CH_1, ocularAutoThreshold(In, Out, W, H, S, OC_AUTO_THRESHOLD_OTSU))                                       \
+    X(ocularAdaptiveThreshold, CH_1, ocularAdaptiveThreshold(In, Out, W, H, S, OC_AUTO_THRESHOLD_SAUVOLA, 15, 0.34f))                 \
+    X(ocularBacklightRepair, CH_3, ocularBacklightRepair(In, Out, W, H, S))                                                           \
+    X(ocularLayerBlend, CH_COLOR, benchLayerBlend(b))                                                                                 \
+    X(ocularColorBalance, CH_COLOR, ocularColorBalance(In, Out, W, H, S, 20, -10, 5, MIDTONES, true))                                 \
+    X(ocularColorTemperature, CH_COLOR, ocularColorTemperature(In, Out, W, H, S, 4500.0f, 50.0f))                                     \
+    X(ocularMultiscaleRetinex, CH_COLOR, ocularMultiscaleRetinex(In, Out, W, H, C, RETINEX_UNIFORM, 100, 3, 1.2f))                    \
+    X(ocularDarkChannelPriorHazeRemoval, CH_COLOR,                                                                                    \
+      ocularDarkChannelPriorHazeRemoval(In, Out, W, H, S, 7, 30, 0.9f, 0.95f, 0.001f, 0.1f, 1))                                       \
+    X(ocularBEEPSFilter, CH_ALL, ocularBEEPSFilter(In, Out, W, H, S, 255.0f, 0.1f, 1))                                                \
+    X(ocularBilateralFilter, CH_ALL, ocularBilateralFilter(In, Out, W, H, S, 0.08f, 0.12f))                                           \
+    X(ocularUnsharpMaskFilter, CH_ALL, ocularUnsharpMaskFilter(In, Out, W, H, S, 2.0f, 1.0f, 0.0f))                                   \
+    X(ocularSharpenFilter, CH_ALL, ocularSharpenFilter(In, Out, W, H, S, 0.5f))                                                       \
+    X(ocularSkinSmoothingFilter, CH_COLOR, ocularSkinSmoothingFilter(In, Out, W, H, S, 5, true))                                      \
+    X(ocularConvolution2DFilter, CH_ALL,                                                                                              \
+      ocularConvolution2DFilter(In, Out, W, H, S, C, benchConvolutionKernel, 5, 1, 0, OC_EDGE_CLAMP))                                 \
+    X(ocularResamplingFilter, CH_ALL, ocularResamplingFilter(In, W, H, S, Out, W / 2, H / 2, W / 2 * C, OC_INTERPOLATE_BILINEAR))     \
+    X(ocularResamplingThumbnails, CH_ALL, benchThumbnails(b))                                                                         \
+    X(ocularRotateImage, CH_ALL, benchRotate(b))                                                                                      \
+    X(ocularCropImage, CH_ALL, ocularCropImage(In, W, H, S, Out, W / 4, H / 4, W / 2, H / 2, W / 2 * C))                              \
+    X(ocularFlipImage, CH_ALL, ocularFlipImage(In, Out, W, H, C, OC_DIRECTION_HORIZONTAL))                                            \
+    X(ocularDespeckle, CH_ALL, ocularDespeckle(In, Out, W, H, S, 15, 10))                                                             \
+    X(ocularDocumentDeskew, CH_COLOR, benchDeskew(b))                                                                                 \
+    X(ocularPalettetizeFromImage, CH_COLOR,                                                                                           \
+      ocularPalettetizeFromImage(In, Out, W, H, C, OC_QUANTIZE_MEDIAN_CUT, 16, OC_DITHER_FLOYD_STEINBERG, 75))                        \
+    X(ocularPosterizeFilter, CH_ALL, ocularPosterizeFilter(In, Out, W, H, C, 4))                                                      \
+    X(ocularHoughLineDetection, CH_1, benchHoughLines(b))                                                                             \
+    X(ocularBoxBlurFilter, CH_ALL, ocularBoxBlurFilter(In, Out, W, H, S, 5))                                                          \
+    X(ocularGaussianBlurFilter, CH_ALL, ocularGaussianBlurFilter(In, Out, W, H, S, 3.0f))                                             \
+    X(ocularExponentialBlur, CH_ALL, ocularExponentialBlur(In, Out, W, H, C, 5.0f))                                                   \
+    X(ocularMotionBlurFilter, CH_ALL, ocularMotionBlurFilter(In, Out, W, H, S, 60, 30, true))                                         \
+    X(ocularRadialBlur, CH_ALL, ocularRadialBlur(In, Out, W, H, S, W / 2, H / 2, 20))                                                 \
+    X(ocularZoomBlur, CH_ALL, ocularZoomBlur(In, Out, W, H, S, 20, 0.3f, W / 2, H / 2))                                               \
+    X(ocularAverageBlur, CH_3, ocularAverageBlur(In, Out, W, H, S, 5))                                                                \
+    X(ocularMedianBlur, CH_ALL, ocularMedianBlur(In, Out, W, H, S, 5))                                                                \
+    X(ocularSurfaceBlurFilter, CH_GRAY_RGB, ocularSurfaceBlurFilter(In, Out, W, H, S, 5, 30))                                         \
+    X(ocularPrewittEdgeDetect, CH_1, ocularPrewittEdgeDetect(In, Out, W, H, C))                                                       \
+    X(ocularRobertsEdgeDetect, CH_1, ocularRobertsEdgeDetect(In, Out, W, H, C))                                                       \
+    X(ocularLaplacianEdgeDetect, CH_1, ocularLaplacianEdgeDetect(In, Out, W, H, C, 1.0f))                                             \
+    X(ocularCannyEdgeDetect, CH_1, ocularCannyEdgeDetect(In, Out, W, H, C, CannyGaus3x3, 30, 90))                                     \
+    X(ocularSobelEdgeDetect, CH_1, ocularSobelEdgeDetect(In, Out, W, H, C))                                                           \
+    X(ocularGradientEdgeDetect, CH_1, ocularGradientEdgeDetect(In, Out, W, H, C))                                                     \
+    X(ocularErodeFilter, CH_ALL, ocularErodeFilter(In, Out, W, H, S, 3))                                                              \
+    X(ocularDilateFilter, CH_ALL, ocularDilateFilter(In, Out, W, H, S, 3))                                                            \
+    X(ocularErodeShapeFilter, CH_ALL, ocularErodeShapeFilter(In, Out, W, H, S, 3, OC_MORPH_OCTAGON))                                  \
+    X(ocularDilateShapeFilter, CH_ALL, ocularDilateShapeFilter(In, Out, W, H, S, 3, OC_MORPH_OCTAGON))                                \
+    X(ocularMinFilter, CH_ALL, ocularMinFilter(In, Out, W, H, S, 3))                                                                  \
+    X(ocularMaxFilter, CH_ALL, ocularMaxFilter(In, Out, W, H, S, 3))                                                                  \
+    X(ocularHighPassFilter, CH_ALL, ocularHighPassFilter(In, Out, W, H, S, 5))                                                        \
+    X(ocularSkeletonizeFilter, CH_ALL, ocularSkeletonizeFilter(In, Out, W, H, S, 128))                                                \
+    X(ocularThresholdToBits, CH_1, benchThresholdToBits(b))                                                                           \
+    X(ocularAutoThresholdToBits, CH_1, benchAutoThresholdToBits(b))                                                                   \
+    X(ocularBinaryErode, CH_1, benchBinaryErode(b))                                                                                   \
+    X(ocularBinaryDilate, CH_1, benchBinaryDilate(b))                                                                                 \
+    X(ocularBinaryOpen, CH_1, benchBinaryOpen(b))                                                                                     \
+    X(ocularBinaryClose, CH_1, benchBinaryClose(b))                                                                                   \
+    X(ocularBinarySkeletonize, CH_1, benchBinarySkeletonize(b))                                                                       \
+    X(ocularGuidedFilter, CH_GRAY_RGB, ocularGuidedFilter(In, In, Out, W, H, S, 8, 0.01f, 1))                                         \
+    X(ocularPinchDistortionFilter, CH_ALL, ocularPinchDistortionFilter(In, Out, W, H, S, 50.0f))                                      \
+    X(ocularTwirlDistortionFilter, CH_ALL, ocularTwirlDistortionFilter(In, Out, W, H, S, 90.0f))                                      \
+    X(ocularRippleDistortionFilter, CH_ALL, ocularRippleDistortionFilter(In, Out, W, H, S, 30.0f, 10.0f, 0.5f, 0.5f, 80.0f, 0.0f))    \
+    X(ocularSpherizeDistortionFilter, CH_ALL, ocularSpherizeDistortionFilter(In, Out, W, H, S, 50, OC_SPHERIZE_NORMAL))               \
+    X(ocularPolarCoordinatesFilter, CH_ALL, ocularPolarCoordinatesFilter(In, Out, W, H, S, OC_RECT_TO_POLAR))                         \
+    X(ocularWaveDistortionFilter, CH_ALL,                                                                                             \
+      ocularWaveDistortionFilter(In, Out, W, H, S, 5, 10, 120, 5, 35, 100, 100, OC_WAVE_SINE, 1))                                     \
+    X(ocularKaleidoscopeFilter, CH_ALL, ocularKaleidoscopeFilter(In, Out, W, H, S, 6, 30.0f, 0.0f, 0.5f, 0.5f, 100.0f))               \
+    X(ocularRenderClouds, CH_COLOR, ocularRenderClouds(In, Out, W, H, C, &benchClouds))                                               \
+    X(ocularOilPaintFilter, CH_3, ocularOilPaintFilter(In, Out, W, H, S, 4, 20))                                                      \
+    X(ocularFrostedGlassEffect, CH_ALL, ocularFrostedGlassEffect(In, Out, W, H, S, 2, 10))                                            \
+    X(ocularFilmGrainEffect, CH_ALL, ocularFilmGrainEffect(In, Out, W, H, C, 20.0f, 5.0f))                                            \
+    X(ocularReliefFilter, CH_ALL, ocularReliefFilter(In, Out, W, H, S, 45.0f, 127))                                                   \
+    X(ocularKuwaharaFilter, CH_GRAY_RGB, ocularKuwaharaFilter(In, Out, W, H, S, 4))                                                   \
+    X(ocularPortraitGlowFilter, CH_COLOR, ocularPortraitGlowFilter(In, Out, W, H, S, OC_GLOW_STYLE_CLASSIC, 10, 120, 50))             \
+    X(ocularGlassTilesFilter, CH_GRAY_RGB, ocularGlassTilesFilter(In, Out, W, H, S, 0.0f, 40, 5.0f, 2, OC_EDGE_CLAMP))                \
+    X(ocularMarbleFilter, CH_GRAY_RGB, ocularMarbleFilter(In, Out, W, H, S, 20.0f, 0.5f, 2, OC_EDGE_CLAMP, 1))                        \
+    X(ocularMosaicFilter, CH_GRAY_RGB, ocularMosaicFilter(In, Out, W, H, S, 16))                                                      \
+    X(ocularPointillizeFilter, CH_COLOR, ocularPointillizeFilter(In, Out, W, H, S, 10, 255, 255, 255))                                \
+    X(ocularColorHalftoneFilter, CH_COLOR, ocularColorHalftoneFilter(In, Out, W, H, S, 6, 100.0f, 108.0f, 162.0f, 90.0f))             \
+    X(ocularFragmentFilter, CH_ALL, ocularFragmentFilter(In, Out, W, H, S))                                                           \
+    X(ocularCrystallizeFilter, CH_ALL, ocularCrystallizeFilter(In, Out, W, H, S, 16))                                                 \
+    X(ocularCurvesFilter, CH_COLOR,                                                                                                   \
+      ocularCurvesFilter(In, Out, W, H, S, benchCurves[0], benchCurves[1], benchCurves[2], benchCurves[3]))                           \
+    X(ocularFFTFilter, CH_ALL, ocularFFTFilter(In, Out, W, H, S, &benchFFTParams))                                                    \
+    X(ocularFFTVisualize, CH_ALL, ocularFFTVisualize(In, Out, W, H, S, true))                                                         \
+    X(ocularFFTExecute, CH_ALL, benchFFTExecute(b))                                                                                   \
+    X(ocularFFTExecuteReal, CH_ALL, benchFFTExecuteReal(b))                                                                           \
+    X(ocularPipelineRun, CH_ALL, ocularPipelineRun(benchPipeline, In, W, H, S, Out, S))                                               \
+    X(ocularPipelineStream, CH_ALL, benchPipelineStream(b))
+
+#define BENCH_RUNNER(Name, Mask, Call)                                                                                                \
+    static OC_STATUS bench_##Name(BenchImage* b) {                                                                                    \
+        unsigned char* In = b->input;                                                                                                 \
+        unsigned char* Out = b->output;                                                                                               \
+        unsigned char* Aux = b->aux;                                                                                                  \
+        int W = b->width, H = b->height, S = b->stride, C = b->channels;                                                              \
+        (void)In, (void)Out, (void)Aux, (void)W, (void)H, (void)S, (void)C;                                                           \
+        return Call;                                                                                                                  \
+    }
+BENCH_FILTERS(BENCH_RUNNER)
+
+#define BENCH_ENTRY(Name, Mask, Call) { #Name, Mask, bench_##Name },
+static const BenchFilter benchFilters[] = { BENCH_FILTERS(BENCH_ENTRY) };
+
+#define BENCH_FILTER_COUNT ((int)(sizeof(benchFilters) / sizeof(benchFilters[0])))
+
+/* Test images  -----------------------------------------------------*/
+
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Smooth gradients with noise, sharp edged blocks and dark text-like strokes, so data dependent filters see typical content
+static void fillImage(unsigned char* image, int width, int height, int channels, unsigned int seed) {
+    unsigned int state = seed;
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = image + (size_t)y * width * channels;
+        for (int x = 0; x < width; x++) {
+            int noise = (int)(nextRandom(&state) % 17) - 8;
+            int block = ((x / 97 + y / 61) & 1) ? 40 : 0;
+            bool stroke = (y % 40 < 3) && (x % 160 < 120);
+            int base[3] = { x * 255 / width, y * 255 / height, (x + y) * 255 / (width + height) };
+            for (int c = 0; c < channels && c < 3; c++) {
+                row[x * channels + c] = stroke ? 20 : ClampToByte(base[c] / 2 + 64 + block + noise);
+            }
+            if (channels == 4) {
+                row[x * channels + 3] = 255;
+            }
+        }
+    }
+}
+
+/* End Test images  -------------------------------------------------*/
+
+static bool containsIgnoreCase(const char* text, const char* pattern, size_t length) {
+    size_t n = strlen(text);
+    for (size_t i = 0; i + length <= n; i++) {
+        size_t k = 0;
+        while (k < length && tolower((unsigned char)text[i + k]) == tolower((unsigned char)pattern[k]))
+            k++;
+        if (k == length)
+            return true;
+    }
+    return false;
+}
+
+// True if Name matches one of the comma separated entries of List; a NULL list matches everything
+static bool matchesList(const char* name, const char* list, bool substring) {
+    if (list == NULL)
+        return true;
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length > 0) {
+            if (substring ? containsIgnoreCase(name, p, length) : (strlen(name) == length && containsIgnoreCase(name, p, length)))
+                return true;
+        }
+        p += length + (end ? 1 : 0);
+    }
+    return false;
+}
+
+static int compareDouble(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static const char* statusName(OC_STATUS status) {
+    switch (status) {
+        case OC_STATUS_OK: return "OK";
+        case OC_STATUS_ERR_NOTSUPPORTED: return "NOTSUPPORTED";
+        case OC_STATUS_ERR_OUTOFMEMORY: return "OUTOFMEMORY";
+        case OC_STATUS_ERR_INVALIDPARAMETER: return "INVALIDPARAMETER";
+        case OC_STATUS_ERR_NULLREFERENCE: return "NULLREFERENCE";
+        default: return "ERROR";
+    }
+}
+
+static void runCase(const BenchFilter* filter, BenchImage* image, double minTime, BenchResult* result) {
+    static double times[BENCH_MAX_ITERATIONS];
+
+    result->iterations = 0;
+    result->seconds = 0;
+    result->peakScratch = 0;
+
+    // the output starts as a copy of the input, for filters that work in place
+    memcpy(image->output, image->input, (size_t)image->stride * image->height);
+
+    // the warm-up run takes its scratch memory from a fresh workspace to measure the peak
+    OcWorkspace* workspace = NULL;
+    if (ocularCreateWorkspace(0, &workspace) == OC_STATUS_OK) {
+        ocularAttachWorkspace(workspace);
+    }
+    result->status = filter->run(image);
+    if (workspace != NULL) {
+        ocularGetWorkspaceUsage(workspace, NULL, &result->peakScratch, NULL);
+    }
+    if (result->status != OC_STATUS_OK) {
+        ocularAttachWorkspace(NULL);
+        ocularFreeWorkspace(&workspace);
+        return;
+    }
+
+    double total = 0;
+    while (result->iterations < BENCH_MAX_ITERATIONS && (total < minTime || result->iterations == 0)) {
+        uint64_t start = nanotimer();
+        filter->run(image);
+        times[result->iterations] = (nanotimer() - start) / 1e9;
+        total += times[result->iterations];
+        result->iterations++;
+    }
+    qsort(times, result->iterations, sizeof(double), compareDouble);
+    result->seconds = times[result->iterations / 2];
+
+    ocularAttachWorkspace(NULL);
+    ocularFreeWorkspace(&workspace);
+}
+
+/* Reports  ---------------------------------------------------------*/
+
+static double megapixelsPerSecond(const BenchResult* r) {
+    return (r->seconds > 0) ? (double)r->width * r->height / r->seconds / 1e6 : 0;
+}
+
+static double nanosecondsPerPixel(const BenchResult* r) {
+    return r->seconds * 1e9 / ((double)r->width * r->height);
+}
+
+static void printTextHeader(FILE* out) {
+    fprintf(out, "ocular %s, %d threads, simd level %d\n\n", ocular_version, ocularGetThreadCount(), (int)ocularGetSimdLevel());
+    fprintf(out, "%-38s %-6s %9s %2s %6s %11s %10s %9s %12s\n", "filter", "size", "pixels", "ch", "iters", "ms/iter", "MP/s",
+            "ns/pixel", "scratch KB");
+}
+
+static void printText(FILE* out, const BenchResult* r) {
+    char pixels[32];
+    snprintf(pixels, sizeof(pixels), "%dx%d", r->width, r->height);
+    if (r->status != OC_STATUS_OK) {
+        fprintf(out, "%-38s %-6s %9s %2d %s\n", r->filter, r->size, pixels, r->channels, statusName(r->status));
+        return;
+    }
+    fprintf(out, "%-38s %-6s %9s %2d %6d %11.3f %10.1f %9.2f %12.1f\n", r->filter, r->size, pixels, r->channels, r->iterations,
+            r->seconds * 1e3, megapixelsPerSecond(r), nanosecondsPerPixel(r), r->peakScratch / 1024.0);
+}
+
+static void printCSVHeader(FILE* out) {
+    fprintf(out, "filter,size,width,height,channels,status,iterations,seconds,megapixels_per_second,ns_per_pixel,peak_scratch_bytes\n");
+}
+
+static void printCSV(FILE* out, const BenchResult* r) {
+    fprintf(out, "%s,%s,%d,%d,%d,%s,%d,%.9f,%.3f,%.4f,%zu\n", r->filter, r->size, r->width, r->height, r->channels,
+            statusName(r->status), r->iterations, r->seconds, megapixelsPerSecond(r), nanosecondsPerPixel(r), r->peakScratch);
+}
+
+static void printJSONHeader(FILE* out) {
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"threads\": %d,\n  \"simd\": %d,\n  \"results\": [", ocular_version,
+            ocularGetThreadCount(), (int)ocularGetSimdLevel());
+}
+
+static void printJSON(FILE* out, const BenchResult* r, bool first) {
+    fprintf(out,
+            "%s\n    { \"filter\": \"%s\", \"size\": \"%s\", \"width\": %d, \"height\": %d, \"channels\": %d, \"status\": \"%s\", "
+            "\"iterations\": %d, \"seconds\": %.9f, \"megapixels_per_second\": %.3f, \"ns_per_pixel\": %.4f, "
+            "\"peak_scratch_bytes\": %zu }",
+            first ? "" : ",", r->filter, r->size, r->width, r->height, r->channels, statusName(r->status), r->iterations, r->seconds,
+            megapixelsPerSecond(r), nanosecondsPerPixel(r), r->peakScratch);
+}
+
+/* End Reports  -----------------------------------------------------*/
+
+static void usage(void) {
+    fprintf(stderr, "Usage: ocular_bench [--filter names] [--sizes vga,1080p,4k,24mp] [--channels 1,3,4] [--min-time sec]\n"
+                    "                    [--threads count] [--format text|json|csv] [--output file] [--list]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* filterList = NULL;
+    const char* sizeList = NULL;
+    const char* channelList = NULL;
+    const char* format = "text";
+    const char* outputPath = NULL;
+    double minTime = 0.5;
+    int threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--list") == 0) {
+            for (int f = 0; f < BENCH_FILTER_COUNT; f++)
+                printf("%s\n", benchFilters[f].name);
+            return 0;
+        }
+        if (value == NULL) {
+            usage();
+            return 1;
+        }
+        if (strcmp(arg, "--filter") == 0) {
+            filterList = value;
+        } else if (strcmp(arg, "--sizes") == 0) {
+            sizeList = value;
+        } else if (strcmp(arg, "--channels") == 0) {
+            channelList = value;
+        } else if (strcmp(arg, "--min-time") == 0) {
+            minTime = atof(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--format") == 0) {
+            format = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            outputPath = value;
+        } else {
+            usage();
+            return 1;
+        }
+        i++;
+    }
+
+    if (strcmp(format, "text") != 0 && strcmp(format, "json") != 0 && strcmp(format, "csv") != 0) {
+        usage();
+        return 1;
+    }
+    FILE* out = stdout;
+    if (outputPath != NULL) {
+        out = fopen(outputPath, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Cannot open %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    ocularSetThreadCount(threads);
+    if (!setupParameters()) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (strcmp(format, "json") == 0) {
+        printJSONHeader(out);
+    } else if (strcmp(format, "csv") == 0) {
+        printCSVHeader(out);
+    } else {
+        printTextHeader(out);
+    }
+
+    bool first = true;
+    const int channelCounts[] = { 1, 3, 4 };
+    for (size_t s = 0; s < sizeof(benchSizes) / sizeof(benchSizes[0]); s++) {
+        const BenchSize* size = &benchSizes[s];
+        if (!matchesList(size->name, sizeList, false))
+            continue;
+
+        for (int c = 0; c < 3; c++) {
+            int channels = channelCounts[c];
+            char channelName[2] = { (char)('0' + channels), 0 };
+            if (!matchesList(channelName, channelList, false))
+                continue;
+
+            BenchImage image;
+            image.width = size->width;
+            image.height = size->height;
+            image.channels = channels;
+            image.stride = size->width * channels;
+            image.input = (unsigned char*)malloc((size_t)image.stride * image.height);
+            image.output = (unsigned char*)malloc((size_t)image.stride * image.height);
+            image.aux = (unsigned char*)malloc((size_t)image.stride * image.height);
+            if (image.input == NULL || image.output == NULL || image.aux == NULL) {
+                fprintf(stderr, "Out of memory for %s\n", size->name);
+                free(image.input);
+                free(image.output);
+                free(image.aux);
+                continue;
+            }
+            fillImage(image.input, image.width, image.height, channels, 0x9E3779B9u);
+            fillImage(image.aux, image.width, image.height, channels, 0x85EBCA6Bu);
+
+            for (int f = 0; f < BENCH_FILTER_COUNT; f++) {
+                const BenchFilter* filter = &benchFilters[f];
+                if (!(filter->channelMask & (1 << c)) || !matchesList(filter->name, filterList, true))
+                    continue;
+
+                BenchResult result;
+                result.filter = filter->name;
+                result.size = size->name;
+                result.width = size->width;
+                result.height = size->height;
+                result.channels = channels;
+                runCase(filter, &image, minTime, &result);
+
+                if (strcmp(format, "json") == 0) {
+                    printJSON(out, &result, first);
+                } else if (strcmp(format, "csv") == 0) {
+                    printCSV(out, &result);
+                } else {
+                    printText(out, &result);
+                }
+                first = false;
+                fflush(out);
+            }
+
+            free(image.input);
+            free(image.output);
+            free(image.aux);
+        }
+    }
+
+    if (strcmp(format, "json") == 0) {
+        fprintf(out, "\n  ]\n}\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    cleanupParameters();
+    return 0;
+}
@@ -222,7 +222,8 @@ int applyFilterFromConfig(const char* configFile, unsigned char *input, unsigned
     parseConfigFile(configFile, &config);
 
     if (strcmp(config.function, "ocularMotionBlurFilter") == 0) {
-        ocularMotionBlurFilter(input, output, width, height, stride, (int)config.params[0].value.float_val, (int)config.params[1].value.float_val);
+        ocularMotionBlurFilter(input, output, width, height, stride, (int)config.params[0].value.float_val, (int)config.params[1].value.float_val,
+                               config.params[2].value.float_val != 0.0f);
     } else if (strcmp(config.function, "ocularZoomBlurFilter") == 0) {
         ocularZoomBlur(input, output, width, height, stride, (int)config.params[0].value.float_val, config.params[1].value.float_val, width / 2, height / 2);
     } else if (strcmp(config.function, "ocularSurfaceBlurFilter") == 0) {
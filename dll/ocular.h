@@ -22,24 +22,9 @@ extern "C" {
 #include "../lib/palette.h"
 #include "../lib/dither.h"
 #include "../lib/curves.h"
+#include "../lib/fft.h"
 #include "dlib_export.h"
 
-// Parameters for Levels filter
-typedef struct {
-    // color level minimum
-    int levelMinimum;
-    // color scale median
-    int levelMiddle;
-    // maximum value of color scale
-    int levelMaximum;
-    // minimum output value
-    int minOutput;
-    // maximum output value
-    int maxOutput;
-    // whether to apply
-    bool Enable;
-} ocularLevelParams;
-
 typedef enum {
     OC_EDGE_WRAP = 0,   // repeat edge pixel
     OC_EDGE_MIRROR = 1, // mirror edge pixel
@@ -53,6 +38,32 @@ typedef enum {
     CannyGaus5x5
 } CannyNoiseFilter;
 
+typedef enum {
+    OC_SIMD_NONE = 0,   // portable C
+    OC_SIMD_SSSE3 = 1,  // SSE2 + pshufb deinterleave
+    OC_SIMD_AVX2 = 2,   // 256-bit integer kernels
+    OC_SIMD_AVX512 = 3, // AVX-512 BW + VBMI
+} OcSimdLevel;
+
+typedef enum {
+    OC_MORPH_SQUARE = 0,  // (2 * Radius + 1) square
+    OC_MORPH_DIAMOND = 1, // pixels within a city block distance of Radius
+    OC_MORPH_OCTAGON = 2, // square and diamond combined; the closest of the three to a disk
+} OcStructuringElement;
+
+typedef struct OcPipeline OcPipeline;
+typedef struct OcPipelineStream OcPipelineStream;
+
+typedef struct OcWorkspace OcWorkspace;
+
+typedef enum {
+    OC_SCRATCH_MEDIAN_BLUR = 0,
+    OC_SCRATCH_ERODE_DILATE = 1,
+    OC_SCRATCH_BILATERAL = 2,
+    OC_SCRATCH_MULTISCALE_RETINEX = 3,
+    OC_SCRATCH_CONVOLUTION_2D = 4,
+} OcScratchFilter;
+
 
 //--------------------------Color adjustments--------------------------
 
@@ -154,6 +165,12 @@ DLIB_EXPORT OC_STATUS ocularHistogramStretch(uint8_t* input, uint8_t* output, in
 
 DLIB_EXPORT OC_STATUS ocularAutoThreshold(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride);
 
+DLIB_EXPORT OC_STATUS ocularAutoThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, OcAutoThresholdMethod method,
+                                                OcImage* Output);
+
+DLIB_EXPORT OC_STATUS ocularAdaptiveThreshold(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
+                                              OcAutoThresholdMethod method, int Radius, float K);
+
 DLIB_EXPORT OC_STATUS ocularBacklightRepair(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride);
 
 DLIB_EXPORT OC_STATUS ocularLayerBlend(unsigned char* baseInput, int bWidth, int bHeight, int bStride, unsigned char* mixInput, int mWidth,
@@ -170,7 +187,7 @@ DLIB_EXPORT OC_STATUS ocularMultiscaleRetinex(unsigned char* input, unsigned cha
                                                 
 DLIB_EXPORT OC_STATUS ocularDarkChannelPriorHazeRemoval(unsigned char* Input, unsigned char* Output, 
                                                         int Width, int Height, int Stride,
-                                                        int radius, int guideRadius, float maxAtm, float omega, float epsilon, float t0);
+                                                        int radius, int guideRadius, float maxAtm, float omega, float epsilon, float t0, int subsample);
 
 DLIB_EXPORT OC_STATUS ocularCurvesFilter(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
                                             const OcCurve* curveR, const OcCurve* curveG, const OcCurve* curveB, const OcCurve* curveL);
@@ -179,10 +196,11 @@ DLIB_EXPORT OC_STATUS ocularCurvesFilter(const unsigned char* Input, unsigned ch
 
 //--------------------------Image processing--------------------------
 
-DLIB_EXPORT OC_STATUS ocularConvolution2DFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels,
-                                            float* kernel, unsigned char filterW, unsigned char cfactor, unsigned char bias);
+DLIB_EXPORT OC_STATUS ocularConvolution2DFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Channels,
+                                            float* kernel, unsigned char filterW, unsigned char cfactor, unsigned char bias, OcEdgeMode edgeMode);
 
-DLIB_EXPORT OC_STATUS ocularMotionBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Distance, int Angle);
+DLIB_EXPORT OC_STATUS ocularMotionBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Distance, int Angle,
+                                             bool Subpixel);
 
 DLIB_EXPORT OC_STATUS ocularRadialBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int centerX,
                                         int centerY, int intensity);
@@ -201,6 +219,12 @@ DLIB_EXPORT OC_STATUS ocularErodeFilter(unsigned char* Input, unsigned char* Out
 
 DLIB_EXPORT OC_STATUS ocularDilateFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius);
 
+DLIB_EXPORT OC_STATUS ocularErodeShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                             OcStructuringElement Element);
+
+DLIB_EXPORT OC_STATUS ocularDilateShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                              OcStructuringElement Element);
+
 DLIB_EXPORT OC_STATUS ocularMinFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius);   
 
 DLIB_EXPORT OC_STATUS ocularMaxFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius);
@@ -209,6 +233,24 @@ DLIB_EXPORT OC_STATUS ocularHighPassFilter(unsigned char* Input, unsigned char*
 
 DLIB_EXPORT OC_STATUS ocularSkeletonizeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Threshold);
 
+DLIB_EXPORT OC_STATUS ocularThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, int Threshold, OcImage* Output);
+
+DLIB_EXPORT OC_STATUS ocularBitsToBytes(const OcImage* Input, unsigned char* Output, int Stride);
+
+DLIB_EXPORT OC_STATUS ocularBinaryInvert(const OcImage* Input, OcImage* Output);
+
+DLIB_EXPORT OC_STATUS ocularBinaryErode(const OcImage* Input, OcImage* Output, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularBinaryDilate(const OcImage* Input, OcImage* Output, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularBinaryOpen(const OcImage* Input, OcImage* Output, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularBinaryClose(const OcImage* Input, OcImage* Output, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularBinarySkeletonize(const OcImage* Input, OcImage* Output);
+
+DLIB_EXPORT OC_STATUS ocularBinarySkewAngle(const OcImage* Input, float maxAngle, float Step, float* Angle);
+
 DLIB_EXPORT OC_STATUS ocularBilateralFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
                                         float sigmaSpatial, float sigmaRange);
 
@@ -225,7 +267,7 @@ DLIB_EXPORT OC_STATUS ocularBEEPSFilter(const unsigned char* Input, unsigned cha
                                     float PhotometricStandardDeviation, float SpatialDecay, int RangeFilter);
 
 DLIB_EXPORT OC_STATUS ocularGuidedFilter(unsigned char* Input, unsigned char* Guide, unsigned char* Output, int Width, int Height, 
-                                            int Stride, int Radius, float Epsilon);
+                                            int Stride, int Radius, float Epsilon, int Subsample);
 
 DLIB_EXPORT OC_STATUS ocularSkinSmoothingFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
                                             int smoothingLevel, bool applySkinFilter);
@@ -235,6 +277,9 @@ DLIB_EXPORT OC_STATUS ocularSharpenFilter(unsigned char* Input, unsigned char* O
 DLIB_EXPORT OC_STATUS ocularResamplingFilter(unsigned char* Input, int Width, int Height, int Stride, unsigned char* Output,
                                         int newWidth, int newHeight, int dstStride, OcInterpolationMode InterpolationMode);
 
+DLIB_EXPORT OC_STATUS ocularResamplingThumbnails(const unsigned char* Input, int Width, int Height, int Stride, OcThumbnail* Thumbnails,
+                                             int Count, OcInterpolationMode InterpolationMode);
+
 DLIB_EXPORT OC_STATUS ocularRotateImage(unsigned char* Input, int Width, int Height, int Stride, unsigned char* Output, 
                             int* newWidth, int* newHeight, float angle, bool preserveSize, bool useTransparency,
                             OcInterpolationMode InterpolationMode, unsigned char fillColorR, unsigned char fillColorG, 
@@ -293,6 +338,24 @@ DLIB_EXPORT OC_STATUS ocularFFTFilter(unsigned char* Input, unsigned char* Outpu
 
 DLIB_EXPORT OC_STATUS ocularFFTVisualize(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, bool logScale);
 
+DLIB_EXPORT OC_STATUS ocularCreateFFTPlan(int n, OcFFTPlan** Plan);
+
+DLIB_EXPORT OC_STATUS ocularCreateRealFFTPlan(int n, OcFFTPlan** Plan);
+
+DLIB_EXPORT OC_STATUS ocularFreeFFTPlan(OcFFTPlan** Plan);
+
+DLIB_EXPORT OC_STATUS ocularFFTExecute(const OcFFTPlan* Plan, const OcComplex* Input, OcComplex* Output, bool inverse);
+
+DLIB_EXPORT OC_STATUS ocularFFTExecuteReal(const OcFFTPlan* Plan, const float* Input, OcComplex* Output);
+
+DLIB_EXPORT OC_STATUS ocularFFTExecuteRealInverse(const OcFFTPlan* Plan, const OcComplex* Input, float* Output);
+
+DLIB_EXPORT int ocularFFTGoodSize(int n);
+
+DLIB_EXPORT OC_STATUS ocularFFTReal2D(const float* Input, OcComplex* Output, int Width, int Height);
+
+DLIB_EXPORT OC_STATUS ocularFFTFilterReal2D(float* Data, int Width, int Height, const OcComplex* Spectrum);
+
 DLIB_EXPORT int ocularHoughLineDetection(unsigned char* Input, int Width, int Height, int lineIntensity, int Threshold, float resTheta,
                                             int numLine, float* Radius, float* Theta);
 
@@ -397,8 +460,81 @@ DLIB_EXPORT void ocularFreeImage(OcImage** image);
 
 DLIB_EXPORT void ocularCloneImage(OcImage* Input, OcImage** Output);    
 
+DLIB_EXPORT OC_STATUS ocularCreateImageView(const OcImage* Parent, int X, int Y, int Width, int Height, OcImage** View);
+
+DLIB_EXPORT OC_STATUS ocularWrapImage(unsigned char* Data, int Width, int Height, int Stride, int Depth, int Channels, OcImage** image);
+
+DLIB_EXPORT OC_STATUS ocularMapImage(const char* FileName, bool Writable, OcImage** image);
+
+DLIB_EXPORT OC_STATUS ocularCreateMappedImage(const char* FileName, int Width, int Height, int Channels, OcImage** image);
+
 DLIB_EXPORT void ocularTransposeImage(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride);
 
+DLIB_EXPORT OC_STATUS ocularSetThreadCount(int Count);
+
+DLIB_EXPORT int ocularGetThreadCount(void);
+
+DLIB_EXPORT OcSimdLevel ocularGetSimdLevel(void);
+
+DLIB_EXPORT OC_STATUS ocularSetSimdLevel(OcSimdLevel Level);
+
+DLIB_EXPORT OC_STATUS ocularCreatePipeline(OcPipeline** Pipeline);
+
+DLIB_EXPORT OC_STATUS ocularFreePipeline(OcPipeline** Pipeline);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddLookup(OcPipeline* Pipeline, const unsigned char* TableR, const unsigned char* TableG,
+                                              const unsigned char* TableB);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddLevels(OcPipeline* Pipeline, const ocularLevelParams* redLevelParams,
+                                              const ocularLevelParams* greenLevelParams, const ocularLevelParams* blueLevelParams);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddCurves(OcPipeline* Pipeline, const OcCurve* curveR, const OcCurve* curveG, const OcCurve* curveB);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddGamma(OcPipeline* Pipeline, const float gamma[3]);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddBrightnessAndContrast(OcPipeline* Pipeline, float brightness, float contrast);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddSaturation(OcPipeline* Pipeline, float saturation);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddUnsharpMask(OcPipeline* Pipeline, float GaussianSigma, float intensity, float threshold);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddGaussianBlur(OcPipeline* Pipeline, float GaussianSigma);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddBoxBlur(OcPipeline* Pipeline, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddErode(OcPipeline* Pipeline, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddDilate(OcPipeline* Pipeline, int Radius);
+
+DLIB_EXPORT OC_STATUS ocularPipelineAddResample(OcPipeline* Pipeline, int newWidth, int newHeight, OcInterpolationMode InterpolationMode);
+
+DLIB_EXPORT OC_STATUS ocularPipelineGetOutputSize(const OcPipeline* Pipeline, int Width, int Height, int* newWidth, int* newHeight);
+
+DLIB_EXPORT OC_STATUS ocularPipelineRun(const OcPipeline* Pipeline, const unsigned char* Input, int Width, int Height, int Stride,
+                                        unsigned char* Output, int dstStride);
+
+DLIB_EXPORT OC_STATUS ocularCreatePipelineStream(const OcPipeline* Pipeline, int Width, int Height, int Channels, OcPipelineStream** Stream);
+
+DLIB_EXPORT OC_STATUS ocularFreePipelineStream(OcPipelineStream** Stream);
+
+DLIB_EXPORT OC_STATUS ocularPipelineStreamGetWindow(const OcPipelineStream* Stream, int* InputRows);
+
+DLIB_EXPORT OC_STATUS ocularPipelineStreamPush(OcPipelineStream* Stream, const unsigned char* Input, int Rows, int Stride, int* Accepted);
+
+DLIB_EXPORT OC_STATUS ocularPipelineStreamPull(OcPipelineStream* Stream, unsigned char* Output, int MaxRows, int dstStride, int* Rows);
+
+DLIB_EXPORT OC_STATUS ocularCreateWorkspace(size_t Capacity, OcWorkspace** Workspace);
+
+DLIB_EXPORT OC_STATUS ocularFreeWorkspace(OcWorkspace** Workspace);
+
+DLIB_EXPORT OC_STATUS ocularAttachWorkspace(OcWorkspace* Workspace);
+
+DLIB_EXPORT OcWorkspace* ocularGetAttachedWorkspace(void);
+
+DLIB_EXPORT OC_STATUS ocularGetWorkspaceUsage(const OcWorkspace* Workspace, size_t* Capacity, size_t* Peak, size_t* HeapAllocations);
+
+DLIB_EXPORT OC_STATUS ocularGetScratchSize(OcScratchFilter Filter, int Width, int Height, int Stride, int Radius, size_t* Size);
+
 //---------------------------General functions--------------------------
     
 
@@ -418,64 +418,45 @@ void CopyAlphaChannel(unsigned char* Src, unsigned char* Dest, int Width, int He
 }
 
 
-void GetPixelWithEdgeBehavior(unsigned char* Input, int Width, int Height, int Stride, int x, int y, OcEdgeMode edgeMode,
-                              unsigned char* pixel, int channels) {
-
-    int newX = x;
-    int newY = y;
+int GetEdgeCoordinate(int Coordinate, int Size, OcEdgeMode edgeMode) {
 
-    if (x >= 0 && x < Width && y >= 0 && y < Height) {
-        // Within bounds
-        int pos = y * Stride + x * channels;
-        for (int c = 0; c < channels; c++) {
-            pixel[c] = Input[pos + c];
-        }
-        return;
+    if (Coordinate >= 0 && Coordinate < Size) {
+        return Coordinate;
     }
 
     switch (edgeMode) {
-    case OC_EDGE_CLAMP:
-        newX = (x < 0) ? 0 : (x >= Width) ? Width - 1 : x;
-        newY = (y < 0) ? 0 : (y >= Height) ? Height - 1 : y;
-        break;
-
     case OC_EDGE_MIRROR:
-        if (x < 0)
-            newX = -x - 1;
-        else if (x >= Width)
-            newX = 2 * Width - x - 1;
-        else
-            newX = x;
-
-        if (y < 0)
-            newY = -y - 1;
-        else if (y >= Height)
-            newY = 2 * Height - y - 1;
-        else
-            newY = y;
-
+        Coordinate = (Coordinate < 0) ? -Coordinate - 1 : 2 * Size - Coordinate - 1;
         // Clamp after reflection
-        newX = (newX < 0) ? 0 : (newX >= Width) ? Width - 1 : newX;
-        newY = (newY < 0) ? 0 : (newY >= Height) ? Height - 1 : newY;
-        break;
+        return (Coordinate < 0) ? 0 : (Coordinate >= Size) ? Size - 1 : Coordinate;
 
     case OC_EDGE_WRAP:
-        newX = ((x % Width) + Width) % Width;
-        newY = ((y % Height) + Height) % Height;
-        break;
+        return ((Coordinate % Size) + Size) % Size;
 
     case OC_EDGE_ERASE:
+        // No source pixel, the caller substitutes black/transparent
+        return -1;
+
+    case OC_EDGE_CLAMP:
+    case OC_EDGE_IGNORE:
+    default:
+        // Return the nearest pixel inside the image
+        return (Coordinate < 0) ? 0 : Size - 1;
+    }
+}
+
+void GetPixelWithEdgeBehavior(unsigned char* Input, int Width, int Height, int Stride, int x, int y, OcEdgeMode edgeMode,
+                              unsigned char* pixel, int channels) {
+
+    int newX = GetEdgeCoordinate(x, Width, edgeMode);
+    int newY = GetEdgeCoordinate(y, Height, edgeMode);
+
+    if (newX < 0 || newY < 0) {
         // Return black/transparent
         for (int c = 0; c < channels; c++) {
             pixel[c] = 0;
         }
         return;
-
-    case OC_EDGE_IGNORE:
-        // Return original pixel value at the out-of-bounds location
-        newX = (x < 0) ? 0 : (x >= Width) ? Width - 1 : x;
-        newY = (y < 0) ? 0 : (y >= Height) ? Height - 1 : y;
-        break;
     }
 
     int pos = newY * Stride + newX * channels;
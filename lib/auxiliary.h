@@ -33,6 +33,9 @@ void CopyAlphaChannel(unsigned char* Src, unsigned char* Dest, int Width, int He
 void GetPixelBilinear(const unsigned char* Input, int Width, int Height, int Stride, float x, float y,
                       OcEdgeMode edgeMode, unsigned char* pixel, int channels);
 
+// Maps a possibly out of range coordinate back into [0, Size) following the edge mode; -1 for OC_EDGE_ERASE
+int GetEdgeCoordinate(int Coordinate, int Size, OcEdgeMode edgeMode);
+
 void GetPixelWithEdgeBehavior(unsigned char* Input, int Width, int Height, int Stride, int x, int y, 
                             OcEdgeMode edgeMode, unsigned char* pixel, int channels);
 
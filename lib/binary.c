@@ -0,0 +1,591 @@
+/**
+ * @file: binary.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Bit-packed binary images: binarization, word-parallel morphology, thinning and projection profiles.
+ */
+
+#include "binary.h"
+#include "parallel.h"
+#include "simd.h"
+#include "util.h"
+#include "workspace.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Rows per task; a row of a document page is only a hundred words or so
+#define BINARY_GRAIN 16
+
+static inline uint64_t* bitRow(const OcImage* Image, int Y) {
+    return (uint64_t*)(Image->Data + (size_t)Y * Image->Stride);
+}
+
+static inline int rowWords(int Width) {
+    return (Width + 63) / 64;
+}
+
+// The bits of the last word of a row that hold pixels
+static inline uint64_t lastWordMask(int Width) {
+    return (Width & 63) ? ((uint64_t)1 << (Width & 63)) - 1 : ~(uint64_t)0;
+}
+
+// Copies a row, clearing the bits past its width
+static void loadRow(uint64_t* Dst, const uint64_t* Src, int Width) {
+    int Words = rowWords(Width);
+    memcpy(Dst, Src, (size_t)(Words - 1) * sizeof(uint64_t));
+    Dst[Words - 1] = Src[Words - 1] & lastWordMask(Width);
+}
+
+// Writes a row, keeping the bits past its width
+static void storeRow(uint64_t* Dst, const uint64_t* Src, int Width) {
+    int Words = rowWords(Width);
+    uint64_t Mask = lastWordMask(Width);
+    memmove(Dst, Src, (size_t)(Words - 1) * sizeof(uint64_t));
+    Dst[Words - 1] = (Dst[Words - 1] & ~Mask) | (Src[Words - 1] & Mask);
+}
+
+static OC_STATUS checkBitImage(const OcImage* Image) {
+    if (Image == NULL || Image->Data == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Image->Depth != OC_DEPTH_1U)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    return OC_STATUS_OK;
+}
+
+static OC_STATUS checkBitImages(const OcImage* Input, const OcImage* Output) {
+    OC_STATUS status = checkBitImage(Input);
+    if (status == OC_STATUS_OK)
+        status = checkBitImage(Output);
+    if (status == OC_STATUS_OK && (Input->Width != Output->Width || Input->Height != Output->Height))
+        status = OC_STATUS_ERR_PARAMISMATCH;
+    return status;
+}
+
+//--------------------------Conversion--------------------------
+
+typedef struct {
+    const unsigned char* Input;
+    int Stride;
+    int Threshold;
+    const OcImage* Bits;
+    unsigned char* Output;
+} PackParams;
+
+static void thresholdRows(void* Context, int Begin, int End, int Thread) {
+    const PackParams* p = (const PackParams*)Context;
+    (void)Thread;
+    for (int Y = Begin; Y < End; Y++) {
+        simdThresholdBitsRow(p->Input + (size_t)Y * p->Stride, bitRow(p->Bits, Y), p->Bits->Width, p->Threshold);
+    }
+}
+
+OC_STATUS ocularThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, int Threshold, OcImage* Output) {
+    if (Input == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    OC_STATUS status = checkBitImage(Output);
+    if (status != OC_STATUS_OK)
+        return status;
+    if (Width <= 0 || Height <= 0 || Stride <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (Stride / Width != 1)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    if (Output->Width != Width || Output->Height != Height)
+        return OC_STATUS_ERR_PARAMISMATCH;
+
+    PackParams params = { Input, Stride, ClampToByte(Threshold), Output, NULL };
+    ocularParallelFor(Height, BINARY_GRAIN, thresholdRows, &params);
+    return OC_STATUS_OK;
+}
+
+static void unpackRows(void* Context, int Begin, int End, int Thread) {
+    const PackParams* p = (const PackParams*)Context;
+    (void)Thread;
+    int Width = p->Bits->Width;
+    for (int Y = Begin; Y < End; Y++) {
+        const uint64_t* pInput = bitRow(p->Bits, Y);
+        unsigned char* pOutput = p->Output + (size_t)Y * p->Stride;
+        for (int X = 0; X < Width; X++) {
+            pOutput[X] = (unsigned char)(0 - ((pInput[X >> 6] >> (X & 63)) & 1));
+        }
+    }
+}
+
+OC_STATUS ocularBitsToBytes(const OcImage* Input, unsigned char* Output, int Stride) {
+    if (Output == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    OC_STATUS status = checkBitImage(Input);
+    if (status != OC_STATUS_OK)
+        return status;
+    if (Stride < Input->Width)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    PackParams params = { NULL, Stride, 0, Input, Output };
+    ocularParallelFor(Input->Height, BINARY_GRAIN, unpackRows, &params);
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularBinaryInvert(const OcImage* Input, OcImage* Output) {
+    OC_STATUS status = checkBitImages(Input, Output);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    int Words = rowWords(Input->Width);
+    uint64_t Mask = lastWordMask(Input->Width);
+    for (int Y = 0; Y < Input->Height; Y++) {
+        const uint64_t* pInput = bitRow(Input, Y);
+        uint64_t* pOutput = bitRow(Output, Y);
+        for (int k = 0; k < Words - 1; k++) {
+            pOutput[k] = ~pInput[k];
+        }
+        pOutput[Words - 1] = (pOutput[Words - 1] & ~Mask) | (~pInput[Words - 1] & Mask);
+    }
+    return OC_STATUS_OK;
+}
+
+//--------------------------Morphology--------------------------
+
+// ORs into every word k the bits Shift positions above it, so bit x gains bit x + Shift. Ascending order reads only words
+// not yet updated, so the row can be updated in place. Row has Words + Shift / 64 + 1 readable words.
+static void orShiftedDown(uint64_t* Row, int Words, int Shift) {
+    int q = Shift >> 6, r = Shift & 63;
+    if (r == 0) {
+        for (int k = 0; k < Words; k++) {
+            Row[k] |= Row[k + q];
+        }
+    } else {
+        for (int k = 0; k < Words; k++) {
+            Row[k] |= (Row[k + q] >> r) | (Row[k + q + 1] << (64 - r));
+        }
+    }
+}
+
+typedef struct {
+    const OcImage* Input;
+    OcImage* Output;
+    bool Erode;
+    int Radius;
+    int Span;     // 2 * Radius + 1
+    int Power;    // largest power of two not above Span
+    int Words;    // words of a plane row
+    uint64_t* Plane; // Height + 2 * Radius rows of Words words; the first and last Radius rows stay zero
+    uint64_t* Next;
+    int Shift;    // rows combined by the current vertical pass
+    uint64_t* Lines; // per-thread padded rows of lineWords words
+    int lineWords;
+} BinaryRankParams;
+
+// Horizontal pass into the plane. Erosion is dilation of the background, so eroded rows are complemented on the way in and
+// out; padding the complement with zeros ignores the pixels outside the image.
+static void rankRows(void* Context, int Begin, int End, int Thread) {
+    const BinaryRankParams* p = (const BinaryRankParams*)Context;
+    int Width = p->Input->Width;
+    int Words = p->Words;
+    uint64_t Mask = lastWordMask(Width);
+    uint64_t* Line = p->Lines + (size_t)Thread * p->lineWords;
+    // Bits of the padded line that can become output: x + Radius for x below Width, plus the window read beyond them
+    int padWords = rowWords(Width + 2 * p->Radius);
+    int q = p->Radius >> 6, r = p->Radius & 63;
+
+    for (int Y = Begin; Y < End; Y++) {
+        const uint64_t* pInput = bitRow(p->Input, Y);
+        memset(Line, 0, (size_t)p->lineWords * sizeof(uint64_t));
+        // Line bit x + Radius is image bit x
+        for (int k = 0; k < Words; k++) {
+            uint64_t w = p->Erode ? ~pInput[k] : pInput[k];
+            if (k == Words - 1)
+                w &= Mask;
+            Line[k + q] |= w << r;
+            if (r != 0)
+                Line[k + q + 1] |= w >> (64 - r);
+        }
+        // Doubling windows: after the pass with shift s, bit x holds the OR of bits [x, x + 2s)
+        for (int s = 1; 2 * s <= p->Span; s *= 2) {
+            orShiftedDown(Line, padWords, s);
+        }
+        if (p->Span > p->Power)
+            orShiftedDown(Line, padWords, p->Span - p->Power);
+        // Bit x now covers image pixels [x - Radius, x + Radius]
+        memcpy(p->Plane + (size_t)(Y + p->Radius) * Words, Line, (size_t)Words * sizeof(uint64_t));
+    }
+}
+
+static void rankColumns(void* Context, int Begin, int End, int Thread) {
+    const BinaryRankParams* p = (const BinaryRankParams*)Context;
+    (void)Thread;
+    int Rows = p->Input->Height + 2 * p->Radius;
+    int Words = p->Words;
+    for (int Y = Begin; Y < End; Y++) {
+        const uint64_t* Row = p->Plane + (size_t)Y * Words;
+        uint64_t* pNext = p->Next + (size_t)Y * Words;
+        if (Y + p->Shift < Rows) {
+            const uint64_t* Below = Row + (size_t)p->Shift * Words;
+            for (int k = 0; k < Words; k++) {
+                pNext[k] = Row[k] | Below[k];
+            }
+        } else {
+            memcpy(pNext, Row, (size_t)Words * sizeof(uint64_t));
+        }
+    }
+}
+
+// Plane row Y now holds the OR of rows [Y, Y + Power); the window of output row Y is rows [Y, Y + Span)
+static void rankOutput(void* Context, int Begin, int End, int Thread) {
+    const BinaryRankParams* p = (const BinaryRankParams*)Context;
+    int Words = p->Words;
+    uint64_t* Line = p->Lines + (size_t)Thread * p->lineWords;
+    for (int Y = Begin; Y < End; Y++) {
+        const uint64_t* Top = p->Plane + (size_t)Y * Words;
+        const uint64_t* Bottom = Top + (size_t)(p->Span - p->Power) * Words;
+        for (int k = 0; k < Words; k++) {
+            uint64_t w = Top[k] | Bottom[k];
+            Line[k] = p->Erode ? ~w : w;
+        }
+        storeRow(bitRow(p->Output, Y), Line, p->Input->Width);
+    }
+}
+
+static OC_STATUS binaryRank(const OcImage* Input, OcImage* Output, int Radius, bool Erode) {
+    OC_STATUS status = checkBitImages(Input, Output);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    // Ensure filter specific parameters are within valid ranges
+    Radius = max(Radius, 1);
+
+    BinaryRankParams params;
+    params.Input = Input;
+    params.Output = Output;
+    params.Erode = Erode;
+    params.Radius = Radius;
+    params.Span = 2 * Radius + 1;
+    params.Power = 1;
+    while (2 * params.Power <= params.Span)
+        params.Power *= 2;
+    params.Words = rowWords(Input->Width);
+    // The doubling passes read up to Span bits past the padded row
+    params.lineWords = rowWords(Input->Width + 2 * Radius) + params.Span / 64 + 2;
+
+    int Rows = Input->Height + 2 * Radius;
+    size_t planeSize = (size_t)Rows * params.Words * sizeof(uint64_t);
+    params.Plane = (uint64_t*)ScratchAlloc(planeSize, false);
+    params.Next = (uint64_t*)ScratchAlloc(planeSize, false);
+    params.Lines = (uint64_t*)ScratchAlloc((size_t)params.lineWords * ocularGetThreadCount() * sizeof(uint64_t), false);
+    if (params.Plane == NULL || params.Next == NULL || params.Lines == NULL) {
+        ScratchFree(params.Plane);
+        ScratchFree(params.Next);
+        ScratchFree(params.Lines);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    size_t marginSize = (size_t)Radius * params.Words * sizeof(uint64_t);
+    memset(params.Plane, 0, marginSize);
+    memset(params.Plane + (size_t)(Input->Height + Radius) * params.Words, 0, marginSize);
+
+    ocularParallelFor(Input->Height, BINARY_GRAIN, rankRows, &params);
+    for (int s = 1; 2 * s <= params.Span; s *= 2) {
+        params.Shift = s;
+        ocularParallelFor(Rows, BINARY_GRAIN, rankColumns, &params);
+        uint64_t* Swap = params.Plane;
+        params.Plane = params.Next;
+        params.Next = Swap;
+    }
+    ocularParallelFor(Input->Height, BINARY_GRAIN, rankOutput, &params);
+
+    ScratchFree(params.Plane);
+    ScratchFree(params.Next);
+    ScratchFree(params.Lines);
+    return OC_STATUS_OK;
+}
+
+size_t binaryRankScratchSize(int Width, int Height, int Radius) {
+    int Span = 2 * Radius + 1;
+    size_t lineWords = rowWords(Width + 2 * Radius) + Span / 64 + 2;
+    size_t planeSize = (size_t)(Height + 2 * Radius) * rowWords(Width) * sizeof(uint64_t);
+    return 2 * ScratchBlockSize(planeSize) + ScratchBlockSize(lineWords * ocularGetThreadCount() * sizeof(uint64_t));
+}
+
+OC_STATUS ocularBinaryErode(const OcImage* Input, OcImage* Output, int Radius) {
+    return binaryRank(Input, Output, Radius, true);
+}
+
+OC_STATUS ocularBinaryDilate(const OcImage* Input, OcImage* Output, int Radius) {
+    return binaryRank(Input, Output, Radius, false);
+}
+
+OC_STATUS ocularBinaryOpen(const OcImage* Input, OcImage* Output, int Radius) {
+    OC_STATUS status = binaryRank(Input, Output, Radius, true);
+    if (status == OC_STATUS_OK)
+        status = binaryRank(Output, Output, Radius, false);
+    return status;
+}
+
+OC_STATUS ocularBinaryClose(const OcImage* Input, OcImage* Output, int Radius) {
+    OC_STATUS status = binaryRank(Input, Output, Radius, false);
+    if (status == OC_STATUS_OK)
+        status = binaryRank(Output, Output, Radius, true);
+    return status;
+}
+
+//--------------------------Thinning--------------------------
+
+typedef struct {
+    const uint64_t* Source;
+    uint64_t* Target;
+    const uint64_t* Interior; // columns [1, Width - 1) of a row
+    int Words;
+    int Height;
+    bool Second;
+    int* Changed;             // per thread
+} ThinParams;
+
+// The left and right neighbours of the pixels of word k, moved onto their bits
+static inline uint64_t westOf(const uint64_t* Row, int k) {
+    return (Row[k] << 1) | (k > 0 ? Row[k - 1] >> 63 : 0);
+}
+
+static inline uint64_t eastOf(const uint64_t* Row, int k, int Words) {
+    return (Row[k] >> 1) | (k + 1 < Words ? Row[k + 1] << 63 : 0);
+}
+
+// One subiteration of ocularSkeletonizeFilter for 64 pixels at a time. The neighbour counts are kept bit-sliced: every
+// pixel has its own bit in each of a few counter words.
+static void thinRows(void* Context, int Begin, int End, int Thread) {
+    const ThinParams* p = (const ThinParams*)Context;
+    int Words = p->Words;
+    uint64_t changed = 0;
+    for (int Y = Begin; Y < End; Y++) {
+        const uint64_t* Cur = p->Source + (size_t)Y * Words;
+        uint64_t* pTarget = p->Target + (size_t)Y * Words;
+        if (Y == 0 || Y == p->Height - 1) {
+            memcpy(pTarget, Cur, (size_t)Words * sizeof(uint64_t));
+            continue;
+        }
+        const uint64_t* Up = Cur - Words;
+        const uint64_t* Down = Cur + Words;
+        for (int k = 0; k < Words; k++) {
+            uint64_t c = Cur[k];
+            if ((c & p->Interior[k]) == 0) {
+                pTarget[k] = c;
+                continue;
+            }
+            uint64_t top = Up[k], topRight = eastOf(Up, k, Words), right = eastOf(Cur, k, Words);
+            uint64_t bottomRight = eastOf(Down, k, Words), bottom = Down[k], bottomLeft = westOf(Down, k);
+            uint64_t left = westOf(Cur, k), topLeft = westOf(Up, k);
+
+            // 2 to 7 foreground neighbours
+            const uint64_t ring[8] = { top, topRight, right, bottomRight, bottom, bottomLeft, left, topLeft };
+            uint64_t one = 0, two = 0, all = ~(uint64_t)0;
+            for (int i = 0; i < 8; i++) {
+                two |= one & ring[i];
+                one |= ring[i];
+                all &= ring[i];
+            }
+            uint64_t neighbors = two & ~all;
+
+            // 0 -> 1 transitions around the ring, counted up to 4 in bits c0, c1 and the sticky c2
+            uint64_t c0 = 0, c1 = 0, c2 = 0;
+            for (int i = 0; i < 8; i++) {
+                uint64_t t = ~ring[i] & ring[(i + 1) & 7];
+                uint64_t carry = c0 & t;
+                c0 ^= t;
+                c2 |= c1 & carry;
+                c1 ^= carry;
+            }
+            uint64_t oneTransition = c0 & ~c1 & ~c2;
+            uint64_t twoTransitions = ~c0 & c1 & ~c2;
+
+            uint64_t remove;
+            if (!p->Second) {
+                remove = (oneTransition & ~(top & right & bottom) & ~(right & bottom & left)) |
+                         (twoTransitions & (((top & right) & ~(bottom | bottomLeft | left)) | ((right & bottom) & ~(top | left | topLeft))));
+            } else {
+                remove = (oneTransition & ~(top & right & left) & ~(top & bottom & left)) |
+                         (twoTransitions & (((top & left) & ~(right | bottomRight | bottom)) | ((bottom & left) & ~(top | topRight | right))));
+            }
+            remove &= c & neighbors & p->Interior[k];
+            pTarget[k] = c & ~remove;
+            changed |= remove;
+        }
+    }
+    if (changed != 0)
+        p->Changed[Thread] = 1;
+}
+
+OC_STATUS ocularBinarySkeletonize(const OcImage* Input, OcImage* Output) {
+    OC_STATUS status = checkBitImages(Input, Output);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    int Width = Input->Width, Height = Input->Height;
+    int Words = rowWords(Width);
+    int threadCount = ocularGetThreadCount();
+    size_t planeSize = (size_t)Height * Words * sizeof(uint64_t);
+    uint64_t* Source = (uint64_t*)ScratchAlloc(planeSize, false);
+    uint64_t* Target = (uint64_t*)ScratchAlloc(planeSize, false);
+    uint64_t* Interior = (uint64_t*)ScratchAlloc((size_t)Words * sizeof(uint64_t), true);
+    int* Changed = (int*)ScratchAlloc(threadCount * sizeof(int), false);
+    if (Source == NULL || Target == NULL || Interior == NULL || Changed == NULL) {
+        ScratchFree(Source);
+        ScratchFree(Target);
+        ScratchFree(Interior);
+        ScratchFree(Changed);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+
+    for (int Y = 0; Y < Height; Y++) {
+        loadRow(Source + (size_t)Y * Words, bitRow(Input, Y), Width);
+    }
+    // The border pixels are never removed
+    for (int X = 1; X < Width - 1; X++) {
+        Interior[X >> 6] |= (uint64_t)1 << (X & 63);
+    }
+
+    ThinParams params = { Source, Target, Interior, Words, Height, false, Changed };
+    for (;;) {
+        memset(Changed, 0, threadCount * sizeof(int));
+        for (int pass = 0; pass < 2; pass++) {
+            params.Second = pass == 1;
+            ocularParallelFor(Height, BINARY_GRAIN, thinRows, &params);
+            const uint64_t* Swap = params.Source;
+            params.Source = params.Target;
+            params.Target = (uint64_t*)Swap;
+        }
+        int changed = 0;
+        for (int i = 0; i < threadCount; i++) {
+            changed |= Changed[i];
+        }
+        if (!changed)
+            break;
+    }
+
+    for (int Y = 0; Y < Height; Y++) {
+        storeRow(bitRow(Output, Y), params.Source + (size_t)Y * Words, Width);
+    }
+
+    ScratchFree(Source);
+    ScratchFree(Target);
+    ScratchFree(Interior);
+    ScratchFree(Changed);
+    return OC_STATUS_OK;
+}
+
+size_t binarySkeletonizeScratchSize(int Width, int Height) {
+    int Words = rowWords(Width);
+    return 2 * ScratchBlockSize((size_t)Height * Words * sizeof(uint64_t)) + ScratchBlockSize((size_t)Words * sizeof(uint64_t)) +
+           ScratchBlockSize(ocularGetThreadCount() * sizeof(int));
+}
+
+//--------------------------Projection profiles--------------------------
+
+typedef struct {
+    const OcImage* Input;
+    float minAngle;
+    float Step;
+    int maxShift;      // largest shear in rows at either end of a row
+    int numBins;
+    int* Bins;         // per thread
+    int* Offsets;      // per thread, one per byte of a row
+    double* Scores;
+} SkewParams;
+
+// Counts the set bits of each byte of a word in that byte
+static inline uint64_t bytePopcounts(uint64_t w) {
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    return (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+}
+
+// Sheared row profile for each candidate angle: the bits of byte b of row Y fall in bin Y - tan(angle) * x, x being the
+// center of the byte. The sum of squared bins is largest when the text lines fall on few bins.
+static void skewScores(void* Context, int Begin, int End, int Thread) {
+    const SkewParams* p = (const SkewParams*)Context;
+    const OcImage* Input = p->Input;
+    int Words = rowWords(Input->Width);
+    int numBytes = Words * 8;
+    uint64_t Mask = lastWordMask(Input->Width);
+    int* Bins = p->Bins + (size_t)Thread * p->numBins;
+    int* Offsets = p->Offsets + (size_t)Thread * numBytes;
+
+    for (int i = Begin; i < End; i++) {
+        double slope = tan((p->minAngle + i * p->Step) * M_PI / 180.0);
+        for (int b = 0; b < numBytes; b++) {
+            Offsets[b] = p->maxShift - (int)lround(slope * (b * 8 + 4));
+        }
+        memset(Bins, 0, (size_t)p->numBins * sizeof(int));
+        for (int Y = 0; Y < Input->Height; Y++) {
+            const uint64_t* Row = bitRow(Input, Y);
+            int* RowBins = Bins + Y;
+            for (int k = 0; k < Words; k++) {
+                uint64_t w = k == Words - 1 ? Row[k] & Mask : Row[k];
+                if (w == 0)
+                    continue;
+                uint64_t counts = bytePopcounts(w);
+                const int* ByteOffsets = Offsets + k * 8;
+                for (int b = 0; b < 8; b++, counts >>= 8) {
+                    RowBins[ByteOffsets[b]] += (int)(counts & 0xFF);
+                }
+            }
+        }
+        double score = 0.0;
+        for (int b = 0; b < p->numBins; b++) {
+            score += (double)Bins[b] * Bins[b];
+        }
+        p->Scores[i] = score;
+    }
+}
+
+OC_STATUS ocularBinarySkewAngle(const OcImage* Input, float maxAngle, float Step, float* Angle) {
+    if (Angle == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    OC_STATUS status = checkBitImage(Input);
+    if (status != OC_STATUS_OK)
+        return status;
+    if (!(maxAngle > 0.0f && maxAngle <= 45.0f) || !(Step > 0.0f))
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    int halfCount = max((int)lround(maxAngle / Step), 1);
+    int numAngles = 2 * halfCount + 1;
+    int Words = rowWords(Input->Width);
+    int threadCount = ocularGetThreadCount();
+
+    SkewParams params;
+    params.Input = Input;
+    params.minAngle = -halfCount * Step;
+    params.Step = Step;
+    params.maxShift = (int)ceil(tan(halfCount * Step * M_PI / 180.0) * Words * 64) + 1;
+    params.numBins = Input->Height + 2 * params.maxShift + 1;
+    params.Bins = (int*)ScratchAlloc((size_t)params.numBins * threadCount * sizeof(int), false);
+    params.Offsets = (int*)ScratchAlloc((size_t)Words * 8 * threadCount * sizeof(int), false);
+    params.Scores = (double*)ScratchAlloc(numAngles * sizeof(double), false);
+    if (params.Bins == NULL || params.Offsets == NULL || params.Scores == NULL) {
+        ScratchFree(params.Bins);
+        ScratchFree(params.Offsets);
+        ScratchFree(params.Scores);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+
+    ocularParallelFor(numAngles, 1, skewScores, &params);
+
+    int best = halfCount;
+    for (int i = 0; i < numAngles; i++) {
+        if (params.Scores[i] > params.Scores[best])
+            best = i;
+    }
+    // Vertex of the parabola through the best score and its neighbours
+    float offset = 0.0f;
+    if (best > 0 && best < numAngles - 1) {
+        double left = params.Scores[best - 1], center = params.Scores[best], right = params.Scores[best + 1];
+        double curvature = left - 2.0 * center + right;
+        if (curvature < 0.0)
+            offset = (float)(0.5 * (left - right) / curvature);
+    }
+    *Angle = params.minAngle + (best + offset) * Step;
+
+    ScratchFree(params.Bins);
+    ScratchFree(params.Offsets);
+    ScratchFree(params.Scores);
+    return OC_STATUS_OK;
+}
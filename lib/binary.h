@@ -0,0 +1,121 @@
+/**
+ * @file: binary.h
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Bit-packed binary images for document pipelines.
+ *
+ * OC_DEPTH_1U images store one bit per pixel, 64 pixels to a 64-bit word with the leftmost pixel in the lowest bit, an
+ * eighth of the memory of a 0/255 mask. Set bits are the foreground: erosion shrinks it, dilation grows it, thinning reduces
+ * it to a skeleton and projections count it. The filters work on whole words, 64 pixels per operation. Bits past the width
+ * of a row are neither read nor written, so views into wider images are left intact.
+ */
+
+#ifndef OCULAR_BINARY_H
+#define OCULAR_BINARY_H
+
+#include "core.h"
+
+/**
+ * @brief Binarizes a grayscale image into a bit image: pixels brighter than the threshold become set bits.
+ * Use ocularBinaryInvert() afterwards to make dark ink the foreground.
+ * @ingroup group_ip_ocr
+ * @param Input The image input data buffer, 1 channel.
+ * @param Width The width of the image in pixels.
+ * @param Height The height of the image in pixels.
+ * @param Stride The number of bytes in one row of pixels.
+ * @param Threshold Pixels greater than Threshold are set. Range [0,255].
+ * @param Output An OC_DEPTH_1U image of the same size.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, int Threshold, OcImage* Output);
+
+/**
+ * @brief Expands a bit image into a 0/255 mask, set bits becoming 255.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output The image output data buffer, 1 channel of Input->Width x Input->Height pixels.
+ * @param Stride The number of bytes in one row of Output.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBitsToBytes(const OcImage* Input, unsigned char* Output, int Stride);
+
+/**
+ * @brief Swaps the foreground and background of a bit image.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinaryInvert(const OcImage* Input, OcImage* Output);
+
+/**
+ * @brief Erodes the foreground of a bit image with a (2 * Radius + 1) square. Pixels outside the image are ignored, so the
+ * result matches ocularErodeFilter() on the 0/255 mask. Both passes double the window with shifted ORs, so the cost grows
+ * with the logarithm of the radius.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @param Radius A radius in pixels, >= 1
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinaryErode(const OcImage* Input, OcImage* Output, int Radius);
+
+/**
+ * @brief Dilates the foreground of a bit image with a (2 * Radius + 1) square, matching ocularDilateFilter() on the 0/255
+ * mask.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @param Radius A radius in pixels, >= 1
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinaryDilate(const OcImage* Input, OcImage* Output, int Radius);
+
+/**
+ * @brief Opens a bit image: erodes, then dilates. Removes specks and strokes thinner than the square.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @param Radius A radius in pixels, >= 1
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinaryOpen(const OcImage* Input, OcImage* Output, int Radius);
+
+/**
+ * @brief Closes a bit image: dilates, then erodes. Fills gaps and holes smaller than the square, e.g. to join broken
+ * strokes.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @param Radius A radius in pixels, >= 1
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinaryClose(const OcImage* Input, OcImage* Output, int Radius);
+
+/**
+ * @brief Thins the foreground of a bit image to a one pixel wide skeleton with the rules of ocularSkeletonizeFilter(),
+ * evaluated for 64 pixels at a time with bitwise logic. Given the same foreground, the skeletons are identical.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image.
+ * @param Output An OC_DEPTH_1U image of the same size. May be Input.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinarySkeletonize(const OcImage* Input, OcImage* Output);
+
+/**
+ * @brief Estimates the skew of text lines from projection profiles. For every candidate angle the rows are sheared and the
+ * set bits counted per row, a byte at a time with a word-parallel population count; the angle at which the lines collapse
+ * into the sharpest profile wins and is refined between the steps.
+ * @ingroup group_ip_ocr
+ * @param Input An OC_DEPTH_1U image whose foreground is the ink.
+ * @param maxAngle The largest skew looked for, in degrees. Range (0,45].
+ * @param Step The spacing of the candidate angles in degrees, e.g. 0.1.
+ * @param[out] Angle The skew in degrees, positive when the lines descend to the right.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularBinarySkewAngle(const OcImage* Input, float maxAngle, float Step, float* Angle);
+
+#endif // OCULAR_BINARY_H
@@ -0,0 +1,323 @@
+/**
+ * @file: blend.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Layer blending row kernels, one specialized loop per blend mode.
+ *
+ * The mode is resolved once per row rather than once per pixel. Separable modes that need only integer arithmetic run on
+ * vector lanes (see simdBlendRow()), the separable modes that divide or take roots read a 256 x 256 table of every base and
+ * mix pair, and the remaining modes, which look at whole pixels, call the functions of blend.h with the mode fixed.
+ */
+
+#include "blend.h"
+#include "parallel.h"
+#include "simd.h"
+
+// Rows per parallel task
+#define BLEND_GRAIN 16
+
+// Bytes of a row looked up in a table before they are mixed with the base
+#define BLEND_CHUNK 512
+
+// Number of modes with a table, see tableIndex()
+#define BLEND_TABLES 5
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define OcAtomicLoad(p) _InterlockedOr((volatile long*)(p), 0)
+    #define OcAtomicStore(p, v) _InterlockedExchange((volatile long*)(p), (v))
+    #define OcAtomicCompareExchange(p, from, to) _InterlockedCompareExchange((volatile long*)(p), (to), (from))
+#else
+    #define OcAtomicLoad(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define OcAtomicStore(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+    #define OcAtomicCompareExchange(p, from, to) __sync_val_compare_and_swap((p), (from), (to))
+#endif
+
+enum { TABLE_UNBUILT, TABLE_BUILDING, TABLE_BUILT };
+
+// Tables indexed by mix * 256 + base, each built by the first thread that needs it and published through its state
+static unsigned char blendTables[BLEND_TABLES][256 * 256];
+static long blendTableState[BLEND_TABLES];
+
+// 255 / alpha in Q16 for taking premultiplied alpha out of a color
+static unsigned int unpremultiplyScale[256];
+static long unpremultiplyState;
+
+// True if the caller has to build the table behind State and then publish it with OcAtomicStore(State, TABLE_BUILT).
+// Threads that find it being built wait for it, which is brief: a table is 64K lookups.
+static bool claimTable(long* State) {
+    if (OcAtomicLoad(State) == TABLE_BUILT)
+        return false;
+    if (OcAtomicCompareExchange(State, TABLE_UNBUILT, TABLE_BUILDING) == TABLE_UNBUILT)
+        return true;
+    while (OcAtomicLoad(State) != TABLE_BUILT) {
+    }
+    return false;
+}
+
+static int tableIndex(OcBlendMode blendMode) {
+    switch (blendMode) {
+    case OC_BLEND_COLORBURN: return 0;
+    case OC_BLEND_COLORDODGE: return 1;
+    case OC_BLEND_SOFTLIGHT: return 2;
+    case OC_BLEND_VIVIDLIGHT: return 3;
+    case OC_BLEND_DIVIDE: return 4;
+    default: return -1;
+    }
+}
+
+// The table of a mode, or NULL for modes without one
+static const unsigned char* blendTable(OcBlendMode blendMode) {
+    int index = tableIndex(blendMode);
+    if (index < 0)
+        return NULL;
+
+    unsigned char* Table = blendTables[index];
+    if (claimTable(&blendTableState[index])) {
+        for (int mix = 0; mix < 256; mix++) {
+            for (int base = 0; base < 256; base++) {
+                int res = 0, unusedG = 0, unusedB = 0;
+                layerBlend(base, 0, 0, mix, 0, 0, &res, &unusedG, &unusedB, blendMode, 100);
+                Table[mix * 256 + base] = (unsigned char)res;
+            }
+        }
+        OcAtomicStore(&blendTableState[index], TABLE_BUILT);
+    }
+    return Table;
+}
+
+static const unsigned int* unpremultiplyTable(void) {
+    if (claimTable(&unpremultiplyState)) {
+        unpremultiplyScale[0] = 0;
+        for (int a = 1; a < 256; a++) {
+            unpremultiplyScale[a] = ((255u << 16) + a / 2) / a;
+        }
+        OcAtomicStore(&unpremultiplyState, TABLE_BUILT);
+    }
+    return unpremultiplyScale;
+}
+
+bool isArithmeticBlend(OcBlendMode blendMode) {
+    switch (blendMode) {
+    case OC_BLEND_NORMAL:
+    case OC_BLEND_DARKEN:
+    case OC_BLEND_MULTIPLY:
+    case OC_BLEND_LINEARBURN:
+    case OC_BLEND_LIGHTEN:
+    case OC_BLEND_SCREEN:
+    case OC_BLEND_LINEARDODGE:
+    case OC_BLEND_OVERLAY:
+    case OC_BLEND_HARDLIGHT:
+    case OC_BLEND_LINEARLIGHT:
+    case OC_BLEND_PINLIGHT:
+    case OC_BLEND_HARDMIX:
+    case OC_BLEND_DIFFERENCE:
+    case OC_BLEND_EXCLUSION:
+    case OC_BLEND_SUBTRACT: return true;
+    default: return false;
+    }
+}
+
+// A fixed pseudo-random pick of Alpha percent of the pixels, so dissolving is repeatable and needs no shared state
+static inline bool dissolvePixel(int X, int Y, int alpha) {
+    unsigned int h = (unsigned int)X * 0x9E3779B1u ^ (unsigned int)Y * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return (int)(h % 100) < alpha;
+}
+
+// The table lookups are gathered a chunk at a time, so mixing in the base runs on vector lanes
+static void tableRow(unsigned char* Base, const unsigned char* Mix, int Count, const unsigned char* Table, int alpha) {
+    unsigned char Blended[BLEND_CHUNK];
+    for (int i = 0; i < Count; i += BLEND_CHUNK) {
+        int n = min(BLEND_CHUNK, Count - i);
+        for (int j = 0; j < n; j++) {
+            Blended[j] = Table[Mix[i + j] * 256 + Base[i + j]];
+        }
+        simdBlendRow(Base + i, Blended, n, OC_BLEND_NORMAL, alpha);
+    }
+}
+
+static void dissolveRow(unsigned char* Base, const unsigned char* Mix, int Width, int alpha, int Y) {
+    // The picks are random, so they select with a mask instead of branching
+    for (int X = 0; X < Width; X++, Base += 3, Mix += 3) {
+        unsigned char pick = (unsigned char)-(int)dissolvePixel(X, Y, alpha);
+        Base[0] = (unsigned char)((Mix[0] & pick) | (Base[0] & ~pick));
+        Base[1] = (unsigned char)((Mix[1] & pick) | (Base[1] & ~pick));
+        Base[2] = (unsigned char)((Mix[2] & pick) | (Base[2] & ~pick));
+    }
+}
+
+static inline void pixelRowOf(unsigned char* Base, const unsigned char* Mix, int Width, int alpha, OcBlendMode blendMode) {
+    for (int X = 0; X < Width; X++, Base += 3, Mix += 3) {
+        int resR = 0, resG = 0, resB = 0;
+        layerBlend(Base[0], Base[1], Base[2], Mix[0], Mix[1], Mix[2], &resR, &resG, &resB, blendMode, alpha);
+        Base[0] = (unsigned char)resR;
+        Base[1] = (unsigned char)resG;
+        Base[2] = (unsigned char)resB;
+    }
+}
+
+// The blended color of two unpremultiplied pixels at full opacity. The table modes differ only in their table and all
+// come in as OC_BLEND_COLORBURN.
+static inline void blendPixelOf(const int* base, const int* mix, int* res, const unsigned char* Table, OcBlendMode blendMode) {
+    switch (blendMode) {
+    case OC_BLEND_DARK:
+    case OC_BLEND_LIGHTERCOLOR:
+    case OC_BLEND_HUE:
+    case OC_BLEND_SATURATION:
+    case OC_BLEND_COLOR:
+    case OC_BLEND_LUMINOSITY:
+        layerBlend(base[0], base[1], base[2], mix[0], mix[1], mix[2], &res[0], &res[1], &res[2], blendMode, 100);
+        break;
+    case OC_BLEND_COLORBURN:
+        for (int c = 0; c < 3; c++) {
+            res[c] = Table[mix[c] * 256 + base[c]];
+        }
+        break;
+    default:
+        for (int c = 0; c < 3; c++) {
+            res[c] = blendChannel((unsigned short)base[c], (unsigned short)mix[c], blendMode);
+        }
+        break;
+    }
+}
+
+// Rounds x / 255 for x in [0, 65535]
+static inline int div255(int x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+// Composites premultiplied mix pixels over premultiplied base pixels. Where both are opaque the blended color shows, where
+// only one is that pixel shows:
+//     color = mix * (1 - baseAlpha) + base * (1 - mixAlpha) + mixAlpha * baseAlpha * blend(base, mix)
+// with the mix scaled by the opacity in [0, 255]. Dissolve composites a normal blend at full opacity over the picked pixels.
+static inline void premultipliedRowOf(unsigned char* Base, const unsigned char* Mix, int Width, int opacity, int alpha, int Y,
+                                      const unsigned char* Table, const unsigned int* Scale, OcBlendMode blendMode) {
+    for (int X = 0; X < Width; X++, Base += 4, Mix += 4) {
+        int pixelOpacity = opacity;
+        if (blendMode == OC_BLEND_DISSOLVE) {
+            if (!dissolvePixel(X, Y, alpha))
+                continue;
+            pixelOpacity = 255;
+        }
+        int mixAlpha = div255(Mix[3] * pixelOpacity);
+        if (mixAlpha == 0)
+            continue;
+        int baseAlpha = Base[3];
+
+        // Colors above their alpha would overflow the sums below
+        int baseColor[3], mixColor[3], base[3], mix[3], res[3];
+        for (int c = 0; c < 3; c++) {
+            baseColor[c] = min(Base[c], baseAlpha);
+            mixColor[c] = min(Mix[c], Mix[3]);
+            base[c] = (int)((baseColor[c] * Scale[baseAlpha] + 32768) >> 16);
+            mix[c] = (int)((mixColor[c] * Scale[Mix[3]] + 32768) >> 16);
+        }
+        blendPixelOf(base, mix, res, Table, blendMode == OC_BLEND_DISSOLVE ? OC_BLEND_NORMAL : blendMode);
+
+        int both = div255(mixAlpha * baseAlpha);
+        int outAlpha = mixAlpha + baseAlpha - both;
+        for (int c = 0; c < 3; c++) {
+            int value = div255(div255(mixColor[c] * pixelOpacity) * (255 - baseAlpha) + baseColor[c] * (255 - mixAlpha)) + div255(both * res[c]);
+            Base[c] = (unsigned char)min(value, outAlpha);
+        }
+        Base[3] = (unsigned char)outAlpha;
+    }
+}
+
+#define PREMULTIPLIED_CASE(Mode) \
+    case Mode: premultipliedRowOf(Base, Mix, Width, opacity, alpha, Y, Table, Scale, Mode); break;
+
+static void premultipliedRow(unsigned char* Base, const unsigned char* Mix, int Width, OcBlendMode blendMode, int alpha, int Y) {
+    const unsigned char* Table = blendTable(blendMode);
+    const unsigned int* Scale = unpremultiplyTable();
+    int opacity = (alpha * 255 + 50) / 100;
+    if (Table != NULL) {
+        premultipliedRowOf(Base, Mix, Width, opacity, alpha, Y, Table, Scale, OC_BLEND_COLORBURN);
+        return;
+    }
+    switch (blendMode) {
+    PREMULTIPLIED_CASE(OC_BLEND_DISSOLVE)
+    PREMULTIPLIED_CASE(OC_BLEND_DARKEN)
+    PREMULTIPLIED_CASE(OC_BLEND_MULTIPLY)
+    PREMULTIPLIED_CASE(OC_BLEND_LINEARBURN)
+    PREMULTIPLIED_CASE(OC_BLEND_DARK)
+    PREMULTIPLIED_CASE(OC_BLEND_LIGHTEN)
+    PREMULTIPLIED_CASE(OC_BLEND_SCREEN)
+    PREMULTIPLIED_CASE(OC_BLEND_LINEARDODGE)
+    PREMULTIPLIED_CASE(OC_BLEND_LIGHTERCOLOR)
+    PREMULTIPLIED_CASE(OC_BLEND_OVERLAY)
+    PREMULTIPLIED_CASE(OC_BLEND_HARDLIGHT)
+    PREMULTIPLIED_CASE(OC_BLEND_LINEARLIGHT)
+    PREMULTIPLIED_CASE(OC_BLEND_PINLIGHT)
+    PREMULTIPLIED_CASE(OC_BLEND_HARDMIX)
+    PREMULTIPLIED_CASE(OC_BLEND_DIFFERENCE)
+    PREMULTIPLIED_CASE(OC_BLEND_EXCLUSION)
+    PREMULTIPLIED_CASE(OC_BLEND_SUBTRACT)
+    PREMULTIPLIED_CASE(OC_BLEND_HUE)
+    PREMULTIPLIED_CASE(OC_BLEND_SATURATION)
+    PREMULTIPLIED_CASE(OC_BLEND_COLOR)
+    PREMULTIPLIED_CASE(OC_BLEND_LUMINOSITY)
+    default: premultipliedRowOf(Base, Mix, Width, opacity, alpha, Y, Table, Scale, OC_BLEND_NORMAL); break;
+    }
+}
+
+void layerBlendRow(unsigned char* Base, const unsigned char* Mix, int Width, int Channels, OcBlendMode blendMode, int alpha, int Y) {
+    if (Channels == 4) {
+        premultipliedRow(Base, Mix, Width, blendMode, alpha, Y);
+        return;
+    }
+    if (isArithmeticBlend(blendMode)) {
+        simdBlendRow(Base, Mix, Width * 3, blendMode, alpha);
+        return;
+    }
+    const unsigned char* Table = blendTable(blendMode);
+    if (Table != NULL) {
+        tableRow(Base, Mix, Width * 3, Table, alpha);
+        return;
+    }
+    switch (blendMode) {
+    case OC_BLEND_DISSOLVE: dissolveRow(Base, Mix, Width, alpha, Y); break;
+    case OC_BLEND_DARK: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_DARK); break;
+    case OC_BLEND_LIGHTERCOLOR: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_LIGHTERCOLOR); break;
+    case OC_BLEND_HUE: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_HUE); break;
+    case OC_BLEND_SATURATION: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_SATURATION); break;
+    case OC_BLEND_COLOR: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_COLOR); break;
+    case OC_BLEND_LUMINOSITY: pixelRowOf(Base, Mix, Width, alpha, OC_BLEND_LUMINOSITY); break;
+    default: break;
+    }
+}
+
+typedef struct {
+    unsigned char* Base;
+    int bStride;
+    const unsigned char* Mix;
+    int mStride;
+    int Width;
+    int Channels;
+    OcBlendMode blendMode;
+    int alpha;
+} LayerBlendParams;
+
+static void layerBlendRows(void* Context, int Begin, int End, int Thread) {
+    const LayerBlendParams* p = (const LayerBlendParams*)Context;
+    (void)Thread;
+    for (int Y = Begin; Y < End; Y++) {
+        layerBlendRow(p->Base + (size_t)Y * p->bStride, p->Mix + (size_t)Y * p->mStride, p->Width, p->Channels, p->blendMode, p->alpha, Y);
+    }
+}
+
+void layerBlendImage(unsigned char* Base, int bStride, const unsigned char* Mix, int mStride, int Width, int Height, int Channels,
+                     OcBlendMode blendMode, int alpha) {
+    // Build the tables before the rows share them
+    blendTable(blendMode);
+    unpremultiplyTable();
+
+    LayerBlendParams params = { Base, bStride, Mix, mStride, Width, Channels, blendMode, alpha };
+    ocularParallelFor(Height, BLEND_GRAIN, layerBlendRows, &params);
+}
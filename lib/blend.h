@@ -64,7 +64,7 @@ static inline double AverageRandom(double a, double b) {
 // dissolution mode
 static inline void BlendDissolve(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
     int threshold = (int)(AverageRandom(0, 1.0) * 100.0);
-    if (threshold > alpha) {
+    if (threshold < alpha) {
         *resR = mixR;
         *resG = mixG;
         *resB = mixB;
@@ -272,36 +272,9 @@ static inline void BlendLinearLight(int baseR, int baseG, int baseB, int mixR, i
 
 // pinlight mode
 static inline void BlendPinLight(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
-    int res = 0;
-    int a = mixR + mixR - 255;
-    int b = mixR + mixR;
-    if (baseR < a)
-        res = b - 255;
-    if (baseR >= a && baseR < b)
-        res = baseR;
-    if (baseR > b)
-        res = b;
-    *resR = clamp(res, 0, 255);
-
-    a = mixG + mixG - 255;
-    b = mixG + mixG;
-    if (baseG < a)
-        res = b - 255;
-    if (baseG >= a && baseG < b)
-        res = baseG;
-    if (baseG > b)
-        res = b;
-    *resG = clamp(res, 0, 255);
-
-    a = mixB + mixB - 255;
-    b = mixB + mixB;
-    if (baseB < a)
-        res = b - 255;
-    if (baseB >= a && baseB < b)
-        res = baseB;
-    if (baseB > b)
-        res = b;
-    *resB = clamp(res, 0, 255);
+    *resR = clamp(clamp(baseR, mixR + mixR - 255, mixR + mixR), 0, 255);
+    *resG = clamp(clamp(baseG, mixG + mixG - 255, mixG + mixG), 0, 255);
+    *resB = clamp(clamp(baseB, mixB + mixB - 255, mixB + mixB), 0, 255);
     *resR = clamp((*resR * alpha + baseR * (100 - alpha)) / 100, 0, 255);
     *resG = clamp((*resG * alpha + baseG * (100 - alpha)) / 100, 0, 255);
     *resB = clamp((*resB * alpha + baseB * (100 - alpha)) / 100, 0, 255);
@@ -359,12 +332,12 @@ static inline void BlendDivide(int baseR, int baseG, int baseB, int mixR, int mi
 
 // hue mode
 static inline void BlendHue(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
-    float baseH = 0, baseS = 0, baseV = 0;
-    float mixH = 0, mixS = 0, mixV = 0;
-    rgb2hsv(baseR, baseG, baseB, (unsigned char*)&baseH, (unsigned char*)&baseS, (unsigned char*)&baseV);
-    rgb2hsv(mixR, mixG, mixB, (unsigned char*)&mixH, (unsigned char*)&mixS, (unsigned char*)&mixV);
+    unsigned char baseH = 0, baseS = 0, baseV = 0;
+    unsigned char mixH = 0, mixS = 0, mixV = 0;
+    rgb2hsv(baseR, baseG, baseB, &baseH, &baseS, &baseV);
+    rgb2hsv(mixR, mixG, mixB, &mixH, &mixS, &mixV);
     unsigned char R = 0, G = 0, B = 0;
-    hsv2rgb((unsigned char)mixH, (unsigned char)baseS, (unsigned char)baseV, &R, &G, &B);
+    hsv2rgb(mixH, baseS, baseV, &R, &G, &B);
     *resR = (R * alpha + baseR * (100 - alpha)) / 100;
     *resG = (G * alpha + baseG * (100 - alpha)) / 100;
     *resB = (B * alpha + baseB * (100 - alpha)) / 100;
@@ -372,12 +345,12 @@ static inline void BlendHue(int baseR, int baseG, int baseB, int mixR, int mixG,
 
 // saturation mode
 static inline void BlendSaturation(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
-    float baseH = 0, baseS = 0, baseV = 0;
-    float mixH = 0, mixS = 0, mixV = 0;
-    rgb2hsv(baseR, baseG, baseB, (unsigned char*)&baseH, (unsigned char*)&baseS, (unsigned char*)&baseV);
-    rgb2hsv(mixR, mixG, mixB, (unsigned char*)&mixH, (unsigned char*)&mixS, (unsigned char*)&mixV);
+    unsigned char baseH = 0, baseS = 0, baseV = 0;
+    unsigned char mixH = 0, mixS = 0, mixV = 0;
+    rgb2hsv(baseR, baseG, baseB, &baseH, &baseS, &baseV);
+    rgb2hsv(mixR, mixG, mixB, &mixH, &mixS, &mixV);
     unsigned char R = 0, G = 0, B = 0;
-    hsv2rgb((unsigned char)baseH, (unsigned char)mixS, (unsigned char)baseV, &R, &G, &B);
+    hsv2rgb(baseH, mixS, baseV, &R, &G, &B);
     *resR = (R * alpha + baseR * (100 - alpha)) / 100;
     *resG = (G * alpha + baseG * (100 - alpha)) / 100;
     *resB = (B * alpha + baseB * (100 - alpha)) / 100;
@@ -386,12 +359,12 @@ static inline void BlendSaturation(int baseR, int baseG, int baseB, int mixR, in
 
 // luminosity mode
 static inline void BlendLuminosity(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
-    float baseH = 0, baseS = 0, baseV = 0;
-    float mixH = 0, mixS = 0, mixV = 0;
-    rgb2hsv(baseR, baseG, baseB, (unsigned char*)&baseH, (unsigned char*)&baseS, (unsigned char*)&baseV);
-    rgb2hsv(mixR, mixG, mixB, (unsigned char*)&mixH, (unsigned char*)&mixS, (unsigned char*)&mixV);
+    unsigned char baseH = 0, baseS = 0, baseV = 0;
+    unsigned char mixH = 0, mixS = 0, mixV = 0;
+    rgb2hsv(baseR, baseG, baseB, &baseH, &baseS, &baseV);
+    rgb2hsv(mixR, mixG, mixB, &mixH, &mixS, &mixV);
     unsigned char R = 0, G = 0, B = 0;
-    hsv2rgb((unsigned char)baseH, (unsigned char)baseS, (unsigned char)mixV, &R, &G, &B);
+    hsv2rgb(baseH, baseS, mixV, &R, &G, &B);
     *resR = (R * alpha + baseR * (100 - alpha)) / 100;
     *resG = (G * alpha + baseG * (100 - alpha)) / 100;
     *resB = (B * alpha + baseB * (100 - alpha)) / 100;
@@ -399,12 +372,12 @@ static inline void BlendLuminosity(int baseR, int baseG, int baseB, int mixR, in
 
 // color mode
 static inline void BlendColor(int baseR, int baseG, int baseB, int mixR, int mixG, int mixB, int* resR, int* resG, int* resB, int alpha) {
-    float baseH = 0, baseS = 0, baseV = 0;
-    float mixH = 0, mixS = 0, mixV = 0;
-    rgb2hsv(baseR, baseG, baseB, (unsigned char*)&baseH, (unsigned char*)&baseS, (unsigned char*)&baseV);
-    rgb2hsv(mixR, mixG, mixB, (unsigned char*)&mixH, (unsigned char*)&mixS, (unsigned char*)&mixV);
+    unsigned char baseH = 0, baseS = 0, baseV = 0;
+    unsigned char mixH = 0, mixS = 0, mixV = 0;
+    rgb2hsv(baseR, baseG, baseB, &baseH, &baseS, &baseV);
+    rgb2hsv(mixR, mixG, mixB, &mixH, &mixS, &mixV);
     unsigned char R = 0, G = 0, B = 0;
-    hsv2rgb((unsigned char)mixH, (unsigned char)mixS, (unsigned char)baseV, &R, &G, &B);
+    hsv2rgb(mixH, mixS, baseV, &R, &G, &B);
     *resR = (R * alpha + baseR * (100 - alpha)) / 100;
     *resG = (G * alpha + baseG * (100 - alpha)) / 100;
     *resB = (B * alpha + baseB * (100 - alpha)) / 100;
@@ -444,4 +417,46 @@ static inline void layerBlend(int baseR, int baseG, int baseB, int mixR, int mix
     }
 };
 
+// One channel of the separable modes that need only integer arithmetic, before the opacity is applied. Every intermediate
+// fits in 16 bits, so the row kernels can run it on 16-bit vector lanes; the results are those of the functions above.
+static inline unsigned short blendChannel(unsigned short base, unsigned short mix, OcBlendMode blendMode) {
+    switch (blendMode) {
+    case OC_BLEND_DARKEN: return base > mix ? mix : base;
+    case OC_BLEND_MULTIPLY: return (unsigned short)(base * mix) / 255;
+    case OC_BLEND_LINEARBURN: return base + mix > 255 ? base + mix - 255 : 0;
+    case OC_BLEND_LIGHTEN: return base > mix ? base : mix;
+    case OC_BLEND_SCREEN: return 255 - (unsigned short)((255 - mix) * (255 - base)) / 255;
+    case OC_BLEND_LINEARDODGE: return base + mix < 255 ? base + mix : 255;
+    case OC_BLEND_OVERLAY:
+        return base <= 128 ? (unsigned short)(mix * base) >> 7 : 255 - ((unsigned short)((255 - mix) * (255 - base)) >> 7);
+    case OC_BLEND_HARDLIGHT:
+        return mix <= 128 ? (unsigned short)(mix * base) >> 7 : 255 - ((unsigned short)((255 - mix) * (255 - base)) >> 7);
+    case OC_BLEND_LINEARLIGHT: {
+        unsigned short sum = mix + mix + base;
+        return sum <= 255 ? 0 : sum >= 510 ? 255 : sum - 255;
+    }
+    case OC_BLEND_PINLIGHT: return base > mix + mix ? mix + mix : base + 255 < mix + mix ? mix + mix - 255 : base;
+    case OC_BLEND_HARDMIX: return base + mix < 255 ? 0 : 255;
+    case OC_BLEND_DIFFERENCE: return base > mix ? base - mix : mix - base;
+    case OC_BLEND_EXCLUSION: {
+        unsigned short sum = mix + base - ((unsigned short)(mix * base) >> 7);
+        return sum < 255 ? sum : 255;
+    }
+    case OC_BLEND_SUBTRACT: return base > mix ? base - mix : 0;
+    default: return mix;
+    }
+}
+
+// Internal use: true for the modes blendChannel() implements
+bool isArithmeticBlend(OcBlendMode blendMode);
+
+// Internal use: blends one row of Width pixels of Mix into Base with the given opacity in [0, 100]. Three channel rows are
+// blended like layerBlend(); four channel rows hold premultiplied alpha, and the blended mix is composited over the base.
+// Y seeds the dissolve pattern.
+void layerBlendRow(unsigned char* Base, const unsigned char* Mix, int Width, int Channels, OcBlendMode blendMode, int alpha, int Y);
+
+// Internal use: blends a Width x Height image of Mix into Base in parallel, see layerBlendRow()
+void layerBlendImage(unsigned char* Base, int bStride, const unsigned char* Mix, int mStride, int Width, int Height, int Channels,
+                     OcBlendMode blendMode, int alpha);
+
 #endif /* OCUALR_BLEND_H */
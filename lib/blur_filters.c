@@ -1,7 +1,12 @@
 #include "blur_filters.h"
+#include "parallel.h"
+#include "workspace.h"
+#include <limits.h>
+#include <stdint.h>
 
 
-static inline void boxfilterRow(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, int Radius) {
+// Horizontal box pass over rows [Begin, End)
+static inline void boxfilterRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels, int Radius, int Begin, int End) {
     int iRadius = Radius + 1;
     int iScale = (int)((256.0f * 256.0f) / (2 * Radius + 1));
     int iWidthStep = Width * Channels;
@@ -10,7 +15,7 @@ static inline void boxfilterRow(const unsigned char* Input, unsigned char* Outpu
     int iRadChannelsPlus = (iRadChannels + Channels);
     switch (Channels) {
     case 1: {
-        for (int y = 0; y < Height; y++) {
+        for (int y = Begin; y < End; y++) {
             //  Process left edge
             int iY = y * iWidthStep;
             int sum = Input[iY] * Radius;
@@ -55,7 +60,7 @@ static inline void boxfilterRow(const unsigned char* Input, unsigned char* Outpu
         break;
     }
     case 3: {
-        for (int y = 0; y < Height; y++) {
+        for (int y = Begin; y < End; y++) {
             //  Process left edge
 
             int iY = y * iWidthStep;
@@ -128,7 +133,7 @@ static inline void boxfilterRow(const unsigned char* Input, unsigned char* Outpu
         break;
     }
     case 4: {
-        for (int y = 0; y < Height; y++) {
+        for (int y = Begin; y < End; y++) {
             //  Process left edge
             int iY = y * iWidthStep;
             int sumR = Input[iY] * Radius;
@@ -206,7 +211,9 @@ static inline void boxfilterRow(const unsigned char* Input, unsigned char* Outpu
     }
 }
 
-static inline void boxfilterCol(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, int Radius) {
+// Vertical box pass over columns [Begin, End)
+static inline void boxfilterCol(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, int Radius, int Begin,
+                                int End) {
     int iScale = (int)((256.0f * 256.0f) / (2 * Radius + 1));
     int iWidthStep = Width * Channels;
     int iWidthStepDec = (Height - 1) * iWidthStep;
@@ -216,7 +223,7 @@ static inline void boxfilterCol(const unsigned char* Input, unsigned char* Outpu
     int iRadius = Radius + 1;
     switch (Channels) {
     case 1: {
-        for (int x = 0; x < Width; x++) {
+        for (int x = Begin; x < End; x++) {
             //  Process left edge
             int iX = x * Channels;
             int sum = Input[iX] * Radius;
@@ -265,7 +272,7 @@ static inline void boxfilterCol(const unsigned char* Input, unsigned char* Outpu
         break;
     }
     case 3: {
-        for (int x = 0; x < Width; x++) {
+        for (int x = Begin; x < End; x++) {
             //  Process left edge
             int iX = x * Channels;
             int sumR = Input[iX] * Radius;
@@ -336,7 +343,7 @@ static inline void boxfilterCol(const unsigned char* Input, unsigned char* Outpu
         break;
     }
     case 4: {
-        for (int x = 0; x < Width; x++) {
+        for (int x = Begin; x < End; x++) {
             //  Process left edge
             int iX = x * Channels;
             int sumR = Input[iX] * Radius;
@@ -409,6 +416,28 @@ static inline void boxfilterCol(const unsigned char* Input, unsigned char* Outpu
     }
 }
 
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Temp;
+    unsigned char* Output;
+    int Width;
+    int Height;
+    int Channels;
+    int Radius;
+} BoxBlurParams;
+
+static void boxBlurRows(void* Context, int Begin, int End, int Thread) {
+    const BoxBlurParams* p = (const BoxBlurParams*)Context;
+    (void)Thread;
+    boxfilterRow(p->Input, p->Temp, p->Width, p->Channels, p->Radius, Begin, End);
+}
+
+static void boxBlurCols(void* Context, int Begin, int End, int Thread) {
+    const BoxBlurParams* p = (const BoxBlurParams*)Context;
+    (void)Thread;
+    boxfilterCol(p->Temp, p->Output, p->Width, p->Height, p->Channels, p->Radius, Begin, End);
+}
+
 OC_STATUS ocularBoxBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
 
     if (Input == NULL || Output == NULL)
@@ -423,238 +452,171 @@ OC_STATUS ocularBoxBlurFilter(unsigned char* Input, unsigned char* Output, int W
     // Ensure Radius is within valid range
     Radius = clamp(Radius, 1, 127);
 
-    unsigned char* temp = (unsigned char*)malloc(Width * Height * Channels);
+    unsigned char* temp = (unsigned char*)ScratchAlloc(Width * Height * Channels, false);
     if (temp == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    boxfilterRow(Input, temp, Width, Height, Channels, Radius);
-    boxfilterCol(temp, Output, Width, Height, Channels, Radius);
-    free(temp);
+    BoxBlurParams params = { Input, temp, Output, Width, Height, Channels, Radius };
+    ocularParallelFor(Height, 8, boxBlurRows, &params);
+    ocularParallelFor(Width, 16, boxBlurCols, &params);
+    ScratchFree(temp);
 
     return OC_STATUS_OK;
 }
 
-static void gaussianHorizontal(unsigned char* bufferPerLine, const unsigned char* lpRowInitial, unsigned char* lpColumn, int width,
-                               int height, int Channels, int Nwidth, float a0a1, float a2a3, float b1b2, float cprev, float cnext) {
-    int HeightStep = Channels * height;
-    int WidthSubOne = width - 1;
-    if (Channels == 3) {
-        float prevOut[3];
-        prevOut[0] = (lpRowInitial[0] * cprev);
-        prevOut[1] = (lpRowInitial[1] * cprev);
-        prevOut[2] = (lpRowInitial[2] * cprev);
-        for (int x = 0; x < width; ++x) {
-            prevOut[0] = ((lpRowInitial[0] * (a0a1)) - (prevOut[0] * (b1b2)));
-            prevOut[1] = ((lpRowInitial[1] * (a0a1)) - (prevOut[1] * (b1b2)));
-            prevOut[2] = ((lpRowInitial[2] * (a0a1)) - (prevOut[2] * (b1b2)));
-            bufferPerLine[0] = (unsigned char)prevOut[0];
-            bufferPerLine[1] = (unsigned char)prevOut[1];
-            bufferPerLine[2] = (unsigned char)prevOut[2];
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
-        }
-        lpRowInitial -= Channels;
-        lpColumn += HeightStep * WidthSubOne;
-        bufferPerLine -= Channels;
-        prevOut[0] = (lpRowInitial[0] * cnext);
-        prevOut[1] = (lpRowInitial[1] * cnext);
-        prevOut[2] = (lpRowInitial[2] * cnext);
-
-        for (int x = WidthSubOne; x >= 0; --x) {
-            prevOut[0] = ((lpRowInitial[0] * (a2a3)) - (prevOut[0] * (b1b2)));
-            prevOut[1] = ((lpRowInitial[1] * (a2a3)) - (prevOut[1] * (b1b2)));
-            prevOut[2] = ((lpRowInitial[2] * (a2a3)) - (prevOut[2] * (b1b2)));
-            bufferPerLine[0] += (unsigned char)prevOut[0];
-            bufferPerLine[1] += (unsigned char)prevOut[1];
-            bufferPerLine[2] += (unsigned char)prevOut[2];
-            lpColumn[0] = bufferPerLine[0];
-            lpColumn[1] = bufferPerLine[1];
-            lpColumn[2] = bufferPerLine[2];
-            lpRowInitial -= Channels;
-            lpColumn -= HeightStep;
-            bufferPerLine -= Channels;
-        }
-    } else if (Channels == 4) {
-        float prevOut[4];
-
-        prevOut[0] = (lpRowInitial[0] * cprev);
-        prevOut[1] = (lpRowInitial[1] * cprev);
-        prevOut[2] = (lpRowInitial[2] * cprev);
-        prevOut[3] = (lpRowInitial[3] * cprev);
-        for (int x = 0; x < width; ++x) {
-            prevOut[0] = ((lpRowInitial[0] * (a0a1)) - (prevOut[0] * (b1b2)));
-            prevOut[1] = ((lpRowInitial[1] * (a0a1)) - (prevOut[1] * (b1b2)));
-            prevOut[2] = ((lpRowInitial[2] * (a0a1)) - (prevOut[2] * (b1b2)));
-            prevOut[3] = ((lpRowInitial[3] * (a0a1)) - (prevOut[3] * (b1b2)));
-
-            bufferPerLine[0] = (unsigned char)prevOut[0];
-            bufferPerLine[1] = (unsigned char)prevOut[1];
-            bufferPerLine[2] = (unsigned char)prevOut[2];
-            bufferPerLine[3] = (unsigned char)prevOut[3];
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
-        }
-        lpRowInitial -= Channels;
-        lpColumn += HeightStep * WidthSubOne;
-        bufferPerLine -= Channels;
-
-        prevOut[0] = (lpRowInitial[0] * cnext);
-        prevOut[1] = (lpRowInitial[1] * cnext);
-        prevOut[2] = (lpRowInitial[2] * cnext);
-        prevOut[3] = (lpRowInitial[3] * cnext);
-
-        for (int x = WidthSubOne; x >= 0; --x) {
-            prevOut[0] = ((lpRowInitial[0] * a2a3) - (prevOut[0] * b1b2));
-            prevOut[1] = ((lpRowInitial[1] * a2a3) - (prevOut[1] * b1b2));
-            prevOut[2] = ((lpRowInitial[2] * a2a3) - (prevOut[2] * b1b2));
-            prevOut[3] = ((lpRowInitial[3] * a2a3) - (prevOut[3] * b1b2));
-            bufferPerLine[0] += (unsigned char)prevOut[0];
-            bufferPerLine[1] += (unsigned char)prevOut[1];
-            bufferPerLine[2] += (unsigned char)prevOut[2];
-            bufferPerLine[3] += (unsigned char)prevOut[3];
-            lpColumn[0] = bufferPerLine[0];
-            lpColumn[1] = bufferPerLine[1];
-            lpColumn[2] = bufferPerLine[2];
-            lpColumn[3] = bufferPerLine[3];
-            lpRowInitial -= Channels;
-            lpColumn -= HeightStep;
-            bufferPerLine -= Channels;
-        }
-    } else if (Channels == 1) {
-        float prevOut = (lpRowInitial[0] * cprev);
-
-        for (int x = 0; x < width; ++x) {
-            prevOut = ((lpRowInitial[0] * (a0a1)) - (prevOut * (b1b2)));
-            bufferPerLine[0] = (unsigned char)prevOut;
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
-        }
-        lpRowInitial -= Channels;
-        lpColumn += HeightStep * WidthSubOne;
-        bufferPerLine -= Channels;
-
-        prevOut = (lpRowInitial[0] * cnext);
-
-        for (int x = WidthSubOne; x >= 0; --x) {
-            prevOut = ((lpRowInitial[0] * a2a3) - (prevOut * b1b2));
-            bufferPerLine[0] += (unsigned char)prevOut;
-            lpColumn[0] = bufferPerLine[0];
-            lpRowInitial -= Channels;
-            lpColumn -= HeightStep;
-            bufferPerLine -= Channels;
-        }
-    }
+size_t boxBlurScratchSize(int Width, int Height, int Channels) {
+    return ScratchBlockSize((size_t)Width * Height * Channels);
 }
 
-static void gaussianVertical(unsigned char* bufferPerLine, const unsigned char* lpRowInitial, unsigned char* lpColInitial, int height,
-                             int width, int Channels, float a0a1, float a2a3, float b1b2, float cprev, float cnext) {
+#define GAUSSIAN_ROWS 4   // rows interleaved by the horizontal pass so the recursion runs across them
+#define GAUSSIAN_LANES 32 // floats of a row filtered together by the vertical pass
+
+typedef struct {
+    const unsigned char* Input;
+    float* Temp;           // horizontally filtered rows, Width * Channels floats each
+    unsigned char* Output; // NULL when the result stays in Temp
+    int Width;
+    int Height;
+    int Stride;
+    int Channels;
+    float* Lines; // per thread samples and results of the recursion
+    size_t LineFloats;
+    float a0a1, a2a3, b1b2, cprev, cnext;
+} GaussianBlurParams;
+
+// Forward and backward recursion along Count samples, Step floats apart, of Lanes independent signals stored next to each
+// other. The sum of both goes to Out, Lanes floats per sample
+static inline void gaussianLanes(const GaussianBlurParams* p, const float* In, size_t Step, float* Out, int Count, int Lanes) {
+    float a0a1 = p->a0a1, a2a3 = p->a2a3, b1b2 = p->b1b2;
+    float prev[GAUSSIAN_LANES];
+    for (int k = 0; k < Lanes; k++)
+        prev[k] = In[k] * p->cprev;
+    for (int i = 0; i < Count; i++) {
+        const float* in = In + i * Step;
+        float* out = Out + (size_t)i * Lanes;
+        for (int k = 0; k < Lanes; k++)
+            prev[k] = in[k] * a0a1 - prev[k] * b1b2;
+        memcpy(out, prev, Lanes * sizeof(float));
+    }
+    const float* last = In + (Count - 1) * Step;
+    for (int k = 0; k < Lanes; k++)
+        prev[k] = last[k] * p->cnext;
+    for (int i = Count - 1; i >= 0; i--) {
+        const float* in = In + i * Step;
+        float* out = Out + (size_t)i * Lanes;
+        for (int k = 0; k < Lanes; k++)
+            prev[k] = in[k] * a2a3 - prev[k] * b1b2;
+        for (int k = 0; k < Lanes; k++)
+            out[k] += prev[k];
+    }
+}
 
-    int WidthStep = Channels * width;
-    int HeightSubOne = height - 1;
-    if (Channels == 3) {
-        float prevOut[3];
-        prevOut[0] = (lpRowInitial[0] * cprev);
-        prevOut[1] = (lpRowInitial[1] * cprev);
-        prevOut[2] = (lpRowInitial[2] * cprev);
+// Filters Rows rows from Y0 together. Inlined with constant channel and row counts for the common cases
+static inline void gaussianRowBlock(const GaussianBlurParams* p, float* Samples, float* Results, int Y0, int Rows, int Channels) {
+    int width = p->Width;
+    int lanes = Rows * Channels;
+
+    // Interleave the rows so that each pixel position holds all their channels
+    for (int r = 0; r < Rows; r++) {
+        const unsigned char* in = p->Input + (size_t)(Y0 + r) * p->Stride;
+        float* lane = Samples + r * Channels;
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < Channels; c++)
+                lane[x * lanes + c] = in[x * Channels + c];
+    }
+    gaussianLanes(p, Samples, lanes, Results, width, lanes);
+    for (int r = 0; r < Rows; r++) {
+        float* out = p->Temp + (size_t)(Y0 + r) * width * Channels;
+        const float* lane = Results + r * Channels;
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < Channels; c++)
+                out[x * Channels + c] = lane[x * lanes + c];
+    }
+}
 
-        for (int y = 0; y < height; y++) {
-            prevOut[0] = ((lpRowInitial[0] * a0a1) - (prevOut[0] * b1b2));
-            prevOut[1] = ((lpRowInitial[1] * a0a1) - (prevOut[1] * b1b2));
-            prevOut[2] = ((lpRowInitial[2] * a0a1) - (prevOut[2] * b1b2));
-            bufferPerLine[0] = (unsigned char)prevOut[0];
-            bufferPerLine[1] = (unsigned char)prevOut[1];
-            bufferPerLine[2] = (unsigned char)prevOut[2];
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
+static void gaussianBlurRows(void* Context, int Begin, int End, int Thread) {
+    const GaussianBlurParams* p = (const GaussianBlurParams*)Context;
+    float* samples = p->Lines + Thread * p->LineFloats;
+    float* results = samples + p->LineFloats / 2;
+
+    for (int block = Begin; block < End; block++) {
+        int y0 = block * GAUSSIAN_ROWS;
+        int rows = min(GAUSSIAN_ROWS, p->Height - y0);
+        if (rows < GAUSSIAN_ROWS) {
+            gaussianRowBlock(p, samples, results, y0, rows, p->Channels);
+            continue;
         }
-        lpRowInitial -= Channels;
-        bufferPerLine -= Channels;
-        lpColInitial += WidthStep * HeightSubOne;
-        prevOut[0] = (lpRowInitial[0] * cnext);
-        prevOut[1] = (lpRowInitial[1] * cnext);
-        prevOut[2] = (lpRowInitial[2] * cnext);
-        for (int y = HeightSubOne; y >= 0; y--) {
-            prevOut[0] = ((lpRowInitial[0] * a2a3) - (prevOut[0] * b1b2));
-            prevOut[1] = ((lpRowInitial[1] * a2a3) - (prevOut[1] * b1b2));
-            prevOut[2] = ((lpRowInitial[2] * a2a3) - (prevOut[2] * b1b2));
-            bufferPerLine[0] += (unsigned char)prevOut[0];
-            bufferPerLine[1] += (unsigned char)prevOut[1];
-            bufferPerLine[2] += (unsigned char)prevOut[2];
-            lpColInitial[0] = bufferPerLine[0];
-            lpColInitial[1] = bufferPerLine[1];
-            lpColInitial[2] = bufferPerLine[2];
-            lpRowInitial -= Channels;
-            lpColInitial -= WidthStep;
-            bufferPerLine -= Channels;
+        switch (p->Channels) {
+        case 1:
+            gaussianRowBlock(p, samples, results, y0, GAUSSIAN_ROWS, 1);
+            break;
+        case 3:
+            gaussianRowBlock(p, samples, results, y0, GAUSSIAN_ROWS, 3);
+            break;
+        case 4:
+            gaussianRowBlock(p, samples, results, y0, GAUSSIAN_ROWS, 4);
+            break;
+        default:
+            gaussianRowBlock(p, samples, results, y0, GAUSSIAN_ROWS, p->Channels);
+            break;
         }
-    } else if (Channels == 4) {
-        float prevOut[4];
+    }
+}
 
-        prevOut[0] = (lpRowInitial[0] * cprev);
-        prevOut[1] = (lpRowInitial[1] * cprev);
-        prevOut[2] = (lpRowInitial[2] * cprev);
-        prevOut[3] = (lpRowInitial[3] * cprev);
+// Filters columns of Temp in chunks of GAUSSIAN_LANES floats, in place unless an 8-bit Output is given
+static void gaussianBlurCols(void* Context, int Begin, int End, int Thread) {
+    const GaussianBlurParams* p = (const GaussianBlurParams*)Context;
+    int height = p->Height;
+    int rowFloats = p->Width * p->Channels;
+    float* results = p->Lines + Thread * p->LineFloats;
+
+    for (int chunk = Begin; chunk < End; chunk++) {
+        int offset = chunk * GAUSSIAN_LANES;
+        int lanes = min(GAUSSIAN_LANES, rowFloats - offset);
+        // A constant lane count lets the compiler vectorize the recursion
+        if (lanes == GAUSSIAN_LANES)
+            gaussianLanes(p, p->Temp + offset, rowFloats, results, height, GAUSSIAN_LANES);
+        else
+            gaussianLanes(p, p->Temp + offset, rowFloats, results, height, lanes);
 
         for (int y = 0; y < height; y++) {
-            prevOut[0] = ((lpRowInitial[0] * a0a1) - (prevOut[0] * b1b2));
-            prevOut[1] = ((lpRowInitial[1] * a0a1) - (prevOut[1] * b1b2));
-            prevOut[2] = ((lpRowInitial[2] * a0a1) - (prevOut[2] * b1b2));
-            prevOut[3] = ((lpRowInitial[3] * a0a1) - (prevOut[3] * b1b2));
-            bufferPerLine[0] = (unsigned char)prevOut[0];
-            bufferPerLine[1] = (unsigned char)prevOut[1];
-            bufferPerLine[2] = (unsigned char)prevOut[2];
-            bufferPerLine[3] = (unsigned char)prevOut[3];
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
-        }
-        lpRowInitial -= Channels;
-        bufferPerLine -= Channels;
-        lpColInitial += WidthStep * HeightSubOne;
-        prevOut[0] = (lpRowInitial[0] * cnext);
-        prevOut[1] = (lpRowInitial[1] * cnext);
-        prevOut[2] = (lpRowInitial[2] * cnext);
-        prevOut[3] = (lpRowInitial[3] * cnext);
-        for (int y = HeightSubOne; y >= 0; y--) {
-            prevOut[0] = ((lpRowInitial[0] * a2a3) - (prevOut[0] * b1b2));
-            prevOut[1] = ((lpRowInitial[1] * a2a3) - (prevOut[1] * b1b2));
-            prevOut[2] = ((lpRowInitial[2] * a2a3) - (prevOut[2] * b1b2));
-            prevOut[3] = ((lpRowInitial[3] * a2a3) - (prevOut[3] * b1b2));
-            bufferPerLine[0] += (unsigned char)prevOut[0];
-            bufferPerLine[1] += (unsigned char)prevOut[1];
-            bufferPerLine[2] += (unsigned char)prevOut[2];
-            bufferPerLine[3] += (unsigned char)prevOut[3];
-            lpColInitial[0] = bufferPerLine[0];
-            lpColInitial[1] = bufferPerLine[1];
-            lpColInitial[2] = bufferPerLine[2];
-            lpColInitial[3] = bufferPerLine[3];
-            lpRowInitial -= Channels;
-            lpColInitial -= WidthStep;
-            bufferPerLine -= Channels;
-        }
-    } else if (Channels == 1) {
-        float prevOut = 0;
-        prevOut = (lpRowInitial[0] * cprev);
-        for (int y = 0; y < height; y++) {
-            prevOut = ((lpRowInitial[0] * a0a1) - (prevOut * b1b2));
-            bufferPerLine[0] = (unsigned char)prevOut;
-            bufferPerLine += Channels;
-            lpRowInitial += Channels;
-        }
-        lpRowInitial -= Channels;
-        bufferPerLine -= Channels;
-        lpColInitial += WidthStep * HeightSubOne;
-        prevOut = (lpRowInitial[0] * cnext);
-        for (int y = HeightSubOne; y >= 0; y--) {
-            prevOut = ((lpRowInitial[0] * a2a3) - (prevOut * b1b2));
-            bufferPerLine[0] += (unsigned char)prevOut;
-            lpColInitial[0] = bufferPerLine[0];
-            lpRowInitial -= Channels;
-            lpColInitial -= WidthStep;
-            bufferPerLine -= Channels;
+            const float* in = results + (size_t)y * lanes;
+            if (p->Output != NULL) {
+                unsigned char* out = p->Output + (size_t)y * p->Stride + offset;
+                for (int k = 0; k < lanes; k++)
+                    out[k] = ClampToByte(in[k] + 0.5f);
+            } else {
+                memcpy(p->Temp + (size_t)y * rowFloats + offset, in, lanes * sizeof(float));
+            }
         }
     }
 }
 
+// Runs both passes, leaving the result in Temp when Output is NULL
+static OC_STATUS gaussianBlur(const unsigned char* Input, float* Temp, unsigned char* Output, int Width, int Height, int Stride, int Channels,
+                              float GaussianSigma) {
+    float a0, a1, a2, a3, b1, b2, cprev, cnext;
+    CalGaussianCoeff(GaussianSigma, &a0, &a1, &a2, &a3, &b1, &b2, &cprev, &cnext);
+
+    size_t lineFloats = 2 * (size_t)max(Width * GAUSSIAN_ROWS * Channels, Height * GAUSSIAN_LANES);
+    float* lines = (float*)ScratchAlloc(ocularGetThreadCount() * lineFloats * sizeof(float), false);
+    if (lines == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+
+    GaussianBlurParams params = { Input, Temp, Output, Width, Height, Stride, Channels, lines, lineFloats,
+                                  a0 + a1, a2 + a3, b1 + b2, cprev, cnext };
+    ocularParallelFor((Height + GAUSSIAN_ROWS - 1) / GAUSSIAN_ROWS, 2, gaussianBlurRows, &params);
+    ocularParallelFor((Width * Channels + GAUSSIAN_LANES - 1) / GAUSSIAN_LANES, 4, gaussianBlurCols, &params);
+
+    ScratchFree(lines);
+    return OC_STATUS_OK;
+}
+
+OC_STATUS gaussianBlurFloat(const unsigned char* Input, float* Output, int Width, int Height, int Stride, float GaussianSigma) {
+    return gaussianBlur(Input, Output, NULL, Width, Height, Stride, Stride / Width, max(GaussianSigma, 0.0f));
+}
+
 OC_STATUS ocularGaussianBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, float GaussianSigma) {
 
     if (Input == NULL || Output == NULL)
@@ -669,42 +631,21 @@ OC_STATUS ocularGaussianBlurFilter(unsigned char* Input, unsigned char* Output,
     // Ensure filter specific parameters are within valid ranges
     GaussianSigma = max(GaussianSigma, 0.0f);
 
-    float a0, a1, a2, a3, b1, b2, cprev, cnext;
-
-    CalGaussianCoeff(GaussianSigma, &a0, &a1, &a2, &a3, &b1, &b2, &cprev, &cnext);
-
-    float a0a1 = (a0 + a1);
-    float a2a3 = (a2 + a3);
-    float b1b2 = (b1 + b2);
-
-    int bufferSizePerThread = (Width > Height ? Width : Height) * Channels;
-    unsigned char* bufferPerLine = (unsigned char*)malloc((size_t)bufferSizePerThread);
-    unsigned char* tempData = (unsigned char*)malloc((size_t)Height * Stride);
-    if (bufferPerLine == NULL || tempData == NULL) {
-        if (tempData) {
-            free(tempData);
-        }
-        if (bufferPerLine) {
-            free(bufferPerLine);
-        }
+    // The intermediate stays in float so the passes do not round between them
+    float* temp = (float*)ScratchAlloc((size_t)Width * Height * Channels * sizeof(float), false);
+    if (temp == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    for (int y = 0; y < Height; ++y) {
-        unsigned char* lpRowInitial = Input + Stride * y;
-        unsigned char* lpColInitial = tempData + y * Channels;
-        gaussianHorizontal(bufferPerLine, lpRowInitial, lpColInitial, Width, Height, Channels, Width, a0a1, a2a3, b1b2, cprev, cnext);
-    }
-    int HeightStep = Height * Channels;
-    for (int x = 0; x < Width; ++x) {
-        unsigned char* lpColInitial = Output + x * Channels;
-        unsigned char* lpRowInitial = tempData + HeightStep * x;
-        gaussianVertical(bufferPerLine, lpRowInitial, lpColInitial, Height, Width, Channels, a0a1, a2a3, b1b2, cprev, cnext);
-    }
+    OC_STATUS status = gaussianBlur(Input, temp, Output, Width, Height, Stride, Channels, GaussianSigma);
+    ScratchFree(temp);
 
-    free(bufferPerLine);
-    free(tempData);
+    return status;
+}
 
-    return OC_STATUS_OK;
+size_t gaussianBlurScratchSize(int Width, int Height, int Channels) {
+    size_t lineFloats = 2 * (size_t)max(Width * GAUSSIAN_ROWS * Channels, Height * GAUSSIAN_LANES);
+    return ScratchBlockSize((size_t)Width * Height * Channels * sizeof(float)) +
+           ScratchBlockSize(ocularGetThreadCount() * lineFloats * sizeof(float));
 }
 
 OC_STATUS ocularExponentialBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, float Radius) {
@@ -717,15 +658,15 @@ OC_STATUS ocularExponentialBlur(unsigned char* Input, unsigned char* Output, int
     Radius = max(Radius, 1);
 
     // Create temporary buffer
-    unsigned char* temp = (unsigned char*)malloc(Width * Height * Channels);
+    unsigned char* temp = (unsigned char*)ScratchAlloc(Width * Height * Channels, false);
     if (!temp)
         return OC_STATUS_ERR_OUTOFMEMORY;
 
     // Pre-calculate weights for the kernel
     int kernel_size = (int)ceil(Radius) * 2 + 1;
-    float* weights = (float*)malloc(kernel_size * sizeof(float));
+    float* weights = (float*)ScratchAlloc(kernel_size * sizeof(float), false);
     if (!weights) {
-        free(temp);
+        ScratchFree(temp);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -794,12 +735,16 @@ OC_STATUS ocularExponentialBlur(unsigned char* Input, unsigned char* Output, int
         }
     }
 
-    free(weights);
-    free(temp);
+    ScratchFree(weights);
+    ScratchFree(temp);
 
     return OC_STATUS_OK;
 }
 
+size_t exponentialBlurScratchSize(int Width, int Height, int Channels, int Radius) {
+    return ScratchBlockSize((size_t)Width * Height * Channels) + ScratchBlockSize((2 * (size_t)Radius + 1) * sizeof(float));
+}
+
 OC_STATUS ocularSurfaceBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius, int Threshold) {
 
     if (Input == NULL || Output == NULL)
@@ -816,44 +761,44 @@ OC_STATUS ocularSurfaceBlurFilter(unsigned char* Input, unsigned char* Output, i
     Threshold = clamp(Threshold, 2, 255);
 
     if (Channel == 1) {
-        unsigned short* ColHist = (unsigned short*)AllocMemory(256 * (Width + Radius + Radius) * sizeof(unsigned short), false);
+        unsigned short* ColHist = (unsigned short*)ScratchAlloc(256 * (Width + Radius + Radius) * sizeof(unsigned short), false);
         if (ColHist == NULL)
             return OC_STATUS_ERR_OUTOFMEMORY;
-        unsigned short* Hist = (unsigned short*)AllocMemory(256 * sizeof(unsigned short), false);
+        unsigned short* Hist = (unsigned short*)ScratchAlloc(256 * sizeof(unsigned short), false);
         if (Hist == NULL) {
-            FreeMemory(ColHist);
+            ScratchFree(ColHist);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
-        unsigned short* Intensity = (unsigned short*)AllocMemory(511 * sizeof(unsigned short), false); // Avoid abs when a negative value is used
+        unsigned short* Intensity = (unsigned short*)ScratchAlloc(511 * sizeof(unsigned short), false); // Avoid abs when a negative value is used
         if (Intensity == NULL) {
-            FreeMemory(ColHist);
-            FreeMemory(Hist);
+            ScratchFree(ColHist);
+            ScratchFree(Hist);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        unsigned short* Level = (unsigned short*)AllocMemory(256 * sizeof(unsigned short), false);
+        unsigned short* Level = (unsigned short*)ScratchAlloc(256 * sizeof(unsigned short), false);
         if (Level == NULL) {
-            FreeMemory(ColHist);
-            FreeMemory(Hist);
-            FreeMemory(Intensity);
+            ScratchFree(ColHist);
+            ScratchFree(Hist);
+            ScratchFree(Intensity);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
-        int* RowOffset = (int*)malloc((Width + Radius + Radius) * sizeof(int));
+        int* RowOffset = (int*)ScratchAlloc((Width + Radius + Radius) * sizeof(int), false);
         if (RowOffset == NULL) {
-            FreeMemory(ColHist);
-            FreeMemory(Hist);
-            FreeMemory(Intensity);
-            FreeMemory(Level);
+            ScratchFree(ColHist);
+            ScratchFree(Hist);
+            ScratchFree(Intensity);
+            ScratchFree(Level);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        int* ColOffset = (int*)malloc((Height + Radius + Radius) * sizeof(int));
+        int* ColOffset = (int*)ScratchAlloc((Height + Radius + Radius) * sizeof(int), false);
         if (ColOffset == NULL) {
-            FreeMemory(ColHist);
-            FreeMemory(Hist);
-            FreeMemory(Intensity);
-            FreeMemory(Level);
-            free(RowOffset);
+            ScratchFree(ColHist);
+            ScratchFree(Hist);
+            ScratchFree(Intensity);
+            ScratchFree(Level);
+            ScratchFree(RowOffset);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
@@ -913,28 +858,28 @@ OC_STATUS ocularSurfaceBlurFilter(unsigned char* Input, unsigned char* Output, i
                 LinePD[X] = HistogramCalc(Hist, LinePS[X], Intensity);
             }
         }
-        FreeMemory(ColHist);
-        FreeMemory(Hist);
-        FreeMemory(Intensity);
-        FreeMemory(Level);
-        free(RowOffset);
-        free(ColOffset);
+        ScratchFree(ColHist);
+        ScratchFree(Hist);
+        ScratchFree(Intensity);
+        ScratchFree(Level);
+        ScratchFree(RowOffset);
+        ScratchFree(ColOffset);
         return OC_STATUS_OK;
     } else {
-        unsigned char* SrcB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+        unsigned char* SrcB = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        unsigned char* SrcG = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        unsigned char* SrcR = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        unsigned char* DstB = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        unsigned char* DstG = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        unsigned char* DstR = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
 
         if (SrcB == NULL || SrcG == NULL || SrcR == NULL || DstB == NULL || DstG == NULL || DstR == NULL) {
-            free(SrcB);
-            free(SrcG);
-            free(SrcR);
-            free(DstB);
-            free(DstG);
-            free(DstR);
+            ScratchFree(SrcB);
+            ScratchFree(SrcG);
+            ScratchFree(SrcR);
+            ScratchFree(DstB);
+            ScratchFree(DstG);
+            ScratchFree(DstR);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
@@ -945,45 +890,420 @@ OC_STATUS ocularSurfaceBlurFilter(unsigned char* Input, unsigned char* Output, i
         OC_STATUS statusR = ocularSurfaceBlurFilter(SrcR, DstR, Width, Height, Width, Radius, Threshold);
         
         if (statusB != OC_STATUS_OK) {
-            free(SrcB);
-            free(SrcG);
-            free(SrcR);
-            free(DstB);
-            free(DstG);
-            free(DstR);
+            ScratchFree(SrcB);
+            ScratchFree(SrcG);
+            ScratchFree(SrcR);
+            ScratchFree(DstB);
+            ScratchFree(DstG);
+            ScratchFree(DstR);
             return statusB;
         }
         if (statusG != OC_STATUS_OK) {
-            free(SrcB);
-            free(SrcG);
-            free(SrcR);
-            free(DstB);
-            free(DstG);
-            free(DstR);
+            ScratchFree(SrcB);
+            ScratchFree(SrcG);
+            ScratchFree(SrcR);
+            ScratchFree(DstB);
+            ScratchFree(DstG);
+            ScratchFree(DstR);
             return statusG;
         }
         if (statusR != OC_STATUS_OK) {
-            free(SrcB);
-            free(SrcG);
-            free(SrcR);
-            free(DstB);
-            free(DstG);
-            free(DstR);
+            ScratchFree(SrcB);
+            ScratchFree(SrcG);
+            ScratchFree(SrcR);
+            ScratchFree(DstB);
+            ScratchFree(DstG);
+            ScratchFree(DstR);
             return statusR;
         }
         
         CombineRGB(DstB, DstG, DstR, Output, Width, Height, Stride);
 
-        free(SrcB);
-        free(SrcG);
-        free(SrcR);
-        free(DstB);
-        free(DstG);
-        free(DstR);
+        ScratchFree(SrcB);
+        ScratchFree(SrcG);
+        ScratchFree(SrcR);
+        ScratchFree(DstB);
+        ScratchFree(DstG);
+        ScratchFree(DstR);
         return OC_STATUS_OK;
     }
 }
 
+size_t surfaceBlurScratchSize(int Width, int Height, int Channels, int Radius) {
+    Radius = clamp(Radius, 1, 127);
+    size_t gray = ScratchBlockSize(256 * (size_t)(Width + 2 * Radius) * sizeof(unsigned short)) + 2 * ScratchBlockSize(256 * sizeof(unsigned short)) +
+                  ScratchBlockSize(511 * sizeof(unsigned short)) + ScratchBlockSize((size_t)(Width + 2 * Radius) * sizeof(int)) +
+                  ScratchBlockSize((size_t)(Height + 2 * Radius) * sizeof(int));
+    // Color images are blurred as three planes
+    if (Channels == 3)
+        return 6 * ScratchBlockSize((size_t)Width * Height) + gray;
+    return gray;
+}
+
+// Radial and zoom blurs run on a polar grid around the center: sample (Ray, Radius) holds the image at angle
+// 2 * pi * Ray / Rays and distance Radius, so both blurs become running sums along one axis of the grid. Rays are at
+// most a pixel apart at the farthest corner, and each output pixel is interpolated between its four nearest samples.
+// Ray Rays repeats ray 0 to close the circle. The whole grid grows with the square of that distance, so it is built and
+// mapped back onto the image in parts of at most POLAR_PART_SIZE bytes: sectors of rays for the zoom blur, which runs
+// along the rays, and bands of radii for the radial blur, which runs around the rings.
+#define POLAR_PART_SIZE (8 << 20)
+
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    int Width;
+    int Height;
+    int Stride;
+    int Channels;
+    int CenterX;
+    int CenterY;
+    int Rays;
+    int Radii;              // samples per ray, from the center out past the farthest corner
+    float RayScale;         // rays per radian
+    int PolarChannels;      // channels held by the grid, the ones that are blurred
+    size_t RayStep;         // bytes between neighbouring rays in Polar
+    size_t RadiusStep;      // bytes between neighbouring radii in Polar
+    unsigned char* Polar;   // the current part of the grid, from FirstRay and FirstRadius on
+    int FirstRay;
+    int FirstRadius;
+    bool ByRadius;          // parts are bands of radii rather than sectors of rays
+    int PartBegin;          // pixels interpolated from rays, or radii, in [PartBegin, PartEnd) are mapped back from the part
+    int PartEnd;
+    int Left;               // bounding box of those pixels
+    int Top;
+    int Right;
+    int Bottom;
+    const float* Cosines;   // direction of every ray
+    const float* Sines;
+    int Window;             // radial blur: rays averaged by the running sum
+    float Amount;           // zoom blur: the streak of the sample at distance D runs out to D * (1 + Amount)
+    int Reach;              // zoom blur: samples taken along each ray to cover the streaks of the last radius
+    unsigned char* Buffers; // per thread lines
+    size_t BufferSize;
+} PolarBlurParams;
+
+// Bilinear sample of the image at (X, Y), clamped to its edges
+static inline void polarSample(const PolarBlurParams* p, float X, float Y, float* Value) {
+    X = clamp(X, 0.0f, (float)(p->Width - 1));
+    Y = clamp(Y, 0.0f, (float)(p->Height - 1));
+    int x0 = (int)X, y0 = (int)Y;
+    float fx = X - x0, fy = Y - y0;
+    const unsigned char* row0 = p->Input + (size_t)y0 * p->Stride + x0 * p->Channels;
+    const unsigned char* row1 = (y0 + 1 < p->Height) ? row0 + p->Stride : row0;
+    int next = (x0 + 1 < p->Width) ? p->Channels : 0;
+    for (int c = 0; c < p->PolarChannels; c++) {
+        float top = row0[c] + (row0[c + next] - row0[c]) * fx;
+        float bottom = row1[c] + (row1[c + next] - row1[c]) * fx;
+        Value[c] = top + (bottom - top) * fy;
+    }
+}
+
+// Sizes the grid to reach the farthest corner from the center
+static void polarBlurGrid(PolarBlurParams* p) {
+    float farX = (float)max(p->CenterX, p->Width - 1 - p->CenterX);
+    float farY = (float)max(p->CenterY, p->Height - 1 - p->CenterY);
+    float farthest = sqrtf(farX * farX + farY * farY);
+    p->Radii = (int)ceilf(farthest) + 2;
+    p->Rays = max((int)ceilf(2.0f * M_PI * farthest), 8);
+    p->RayScale = (float)(p->Rays / (2.0 * M_PI));
+}
+
+static OC_STATUS polarBlurSetup(PolarBlurParams* p, float** Directions) {
+    polarBlurGrid(p);
+
+    float* directions = (float*)ScratchAlloc(2 * ((size_t)p->Rays + 1) * sizeof(float), false);
+    if (directions == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    for (int j = 0; j < p->Rays; j++) {
+        double angle = 2.0 * M_PI * j / p->Rays;
+        directions[j] = (float)cos(angle);
+        directions[p->Rays + 1 + j] = (float)sin(angle);
+    }
+    directions[p->Rays] = directions[0];
+    directions[2 * p->Rays + 1] = directions[p->Rays + 1];
+    p->Cosines = directions;
+    p->Sines = directions + p->Rays + 1;
+    *Directions = directions;
+    return OC_STATUS_OK;
+}
+
+// Ray of the pixel at (Dx, Dy) from the center, in [0, Rays]
+static inline float polarRay(float Dx, float Dy, float RayScale, int Rays) {
+    float ray = atan2f(Dy, Dx) * RayScale;
+    return (ray < 0.0f) ? ray + Rays : ray;
+}
+
+// The ray, or the radius, that pixel X of the row at Dy from the center is interpolated from
+static inline int polarPartOf(const PolarBlurParams* p, int X, float Dy) {
+    float dx = (float)(X - p->CenterX);
+    if (p->ByRadius)
+        return (int)sqrtf(dx * dx + Dy * Dy);
+    return min((int)polarRay(dx, Dy, p->RayScale, p->Rays), p->Rays - 1);
+}
+
+// First X in [Begin, End) whose ray or radius has reached Limit when Rising, or dropped below it otherwise, else End.
+// On either side of the center column both only rise or only fall along a row.
+static int polarSearch(const PolarBlurParams* p, int Begin, int End, float Dy, int Limit, bool Rising) {
+    while (Begin < End) {
+        int x = Begin + (End - Begin) / 2;
+        int part = polarPartOf(p, x, Dy);
+        if (Rising ? part >= Limit : part < Limit)
+            End = x;
+        else
+            Begin = x + 1;
+    }
+    return Begin;
+}
+
+// Maps the blurred part of the grid back onto pixels [First, Last) of row Y. Pixels read only their own alpha.
+static void polarUnwrapSpan(const PolarBlurParams* p, int Y, int First, int Last) {
+    int channels = p->Channels, polarChannels = p->PolarChannels, rays = p->Rays;
+    float rayScale = p->RayScale;
+    const unsigned char* in = p->Input + (size_t)Y * p->Stride + First * channels;
+    unsigned char* out = p->Output + (size_t)Y * p->Stride + First * channels;
+    const unsigned char* polar = p->Polar - p->FirstRay * p->RayStep - p->FirstRadius * p->RadiusStep;
+    size_t rayStep = p->RayStep, radiusStep = p->RadiusStep;
+    float dy = (float)(Y - p->CenterY);
+    for (int x = First; x < Last; x++, in += channels, out += channels) {
+        float dx = (float)(x - p->CenterX);
+        float radius = sqrtf(dx * dx + dy * dy);
+        float ray = polarRay(dx, dy, rayScale, rays);
+        int j0 = min((int)ray, rays - 1), k0 = (int)radius;
+        float fj = ray - j0, fk = radius - k0;
+        const unsigned char* s0 = polar + j0 * rayStep + k0 * radiusStep;
+        const unsigned char* s1 = s0 + rayStep;
+        for (int c = 0; c < polarChannels; c++) {
+            float v0 = s0[c] + (s0[c + radiusStep] - s0[c]) * fk;
+            float v1 = s1[c] + (s1[c + radiusStep] - s1[c]) * fk;
+            out[c] = (unsigned char)(v0 + (v1 - v0) * fj + 0.5f);
+        }
+        for (int c = polarChannels; c < channels; c++)
+            out[c] = in[c];
+    }
+}
+
+// Finds, on each side of the center column, the pixels of the current part along the rows of its bounding box
+static void polarUnwrapRows(void* Context, int Begin, int End, int Thread) {
+    const PolarBlurParams* p = (const PolarBlurParams*)Context;
+    (void)Thread;
+    int sides[3] = { p->Left, clamp(p->CenterX, p->Left, p->Right), p->Right };
+    for (int y = p->Top + Begin; y < p->Top + End; y++) {
+        float dy = (float)(y - p->CenterY);
+        for (int s = 0; s < 2; s++) {
+            int left = sides[s], right = sides[s + 1];
+            if (left >= right)
+                continue;
+            bool rising = polarPartOf(p, right - 1, dy) >= polarPartOf(p, left, dy);
+            int first = polarSearch(p, left, right, dy, rising ? p->PartBegin : p->PartEnd, rising);
+            int last = polarSearch(p, first, right, dy, rising ? p->PartEnd : p->PartBegin, rising);
+            polarUnwrapSpan(p, y, first, last);
+        }
+    }
+}
+
+// Bounding box of the pixels the sector of rays [First, Last] reaches, a pixel wider for rounding, clipped to the image.
+// Returns false when the sector misses the image.
+static bool polarSectorBounds(PolarBlurParams* p, int First, int Last) {
+    // Both edges of the sector, then the axes it spans
+    static const float axes[3][2] = { { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 0.0f, -1.0f } };
+    float left = 0.0f, top = 0.0f, right = 0.0f, bottom = 0.0f;
+    for (int i = 0; i < 5; i++) {
+        float cosine, sine;
+        if (i < 2) {
+            int j = (i == 0) ? First : Last;
+            cosine = p->Cosines[j];
+            sine = p->Sines[j];
+        } else {
+            double axis = (i - 1) * p->Rays / 4.0;
+            if (axis < First || axis > Last)
+                continue;
+            cosine = axes[i - 2][0];
+            sine = axes[i - 2][1];
+        }
+        left = min(left, cosine);
+        right = max(right, cosine);
+        top = min(top, sine);
+        bottom = max(bottom, sine);
+    }
+    float reach = (float)p->Radii;
+    p->Left = clamp(p->CenterX + (int)floorf(left * reach) - 1, 0, p->Width);
+    p->Right = clamp(p->CenterX + (int)ceilf(right * reach) + 2, 0, p->Width);
+    p->Top = clamp(p->CenterY + (int)floorf(top * reach) - 1, 0, p->Height);
+    p->Bottom = clamp(p->CenterY + (int)ceilf(bottom * reach) + 2, 0, p->Height);
+    return p->Left < p->Right && p->Top < p->Bottom;
+}
+
+// Bounding box of the pixels closer to the center than radius Last, a pixel wider for rounding, clipped to the image
+static void polarBandBounds(PolarBlurParams* p, int Last) {
+    p->Left = max(p->CenterX - Last - 1, 0);
+    p->Right = min(p->CenterX + Last + 2, p->Width);
+    p->Top = max(p->CenterY - Last - 1, 0);
+    p->Bottom = min(p->CenterY + Last + 2, p->Height);
+}
+
+// Zoom blur along every ray of the current part. The streak of the sample at distance D weighs the ray by
+// 1 - (r - D) / (Amount * D) for r in [D, D * (1 + Amount)], so with the ray treated as constant over each pixel, two
+// prefix sums (of the samples and of the samples times their distance) give it exactly.
+static void zoomBlurRays(void* Context, int Begin, int End, int Thread) {
+    const PolarBlurParams* p = (const PolarBlurParams*)Context;
+    int channels = p->PolarChannels, radii = p->Radii, reach = p->Reach;
+    double amount = p->Amount;
+    int64_t* sum0 = (int64_t*)(p->Buffers + Thread * p->BufferSize);
+    int64_t* sum1 = sum0 + (size_t)(reach + 1) * channels;
+    int* line = (int*)(sum1 + (size_t)(reach + 1) * channels);
+    float value[4];
+
+    for (int i = Begin; i < End; i++) {
+        // Samples in 8.8 fixed point and their exact prefix sums. Past the image the streaks carry on along its
+        // clamped edge.
+        float cosine = p->Cosines[p->FirstRay + i], sine = p->Sines[p->FirstRay + i];
+        int64_t s0[4] = { 0, 0, 0, 0 }, s1[4] = { 0, 0, 0, 0 };
+        for (int c = 0; c < channels; c++)
+            sum0[c] = sum1[c] = 0;
+        for (int k = 0; k < reach; k++) {
+            polarSample(p, p->CenterX + k * cosine, p->CenterY + k * sine, value);
+            for (int c = 0; c < channels; c++) {
+                int v = (int)(value[c] * 256.0f + 0.5f);
+                line[k * channels + c] = v;
+                s0[c] += v;
+                s1[c] += (int64_t)v * k;
+                sum0[(k + 1) * channels + c] = s0[c];
+                sum1[(k + 1) * channels + c] = s1[c];
+            }
+        }
+
+        unsigned char* out = p->Polar + i * p->RayStep;
+        for (int c = 0; c < channels; c++)
+            out[c] = (unsigned char)((line[c] + 128) >> 8);
+        for (int k = 1; k < radii; k++) {
+            // Sample i covers [i - 0.5, i + 0.5)
+            double d = k, e = k * (1.0 + amount);
+            int i = min((int)(e + 0.5), reach - 1);
+            double start = k - 0.5, end = i - 0.5;
+            float e0 = (float)(e - end), e1 = (float)((e * e - end * end) * 0.5);
+            float d0 = (float)(d - start), d1 = (float)((d * d - start * start) * 0.5);
+            double length = amount * d;
+            float ramp = (float)((1.0 + 1.0 / amount) * 2.0 / (length * 256.0)), slope = (float)(2.0 / (length * length * 256.0));
+            for (int c = 0; c < channels; c++) {
+                float vd = (float)line[k * channels + c], ve = (float)line[i * channels + c];
+                // integrals of the ray and of the ray times r over [D, E], weighed and divided by the weights' integral
+                float f0 = (float)(sum0[i * channels + c] - sum0[k * channels + c]) + e0 * ve - d0 * vd;
+                float f1 = (float)(sum1[i * channels + c] - sum1[k * channels + c]) + e1 * ve - d1 * vd;
+                float mean = ramp * f0 - slope * f1;
+                out[k * p->RadiusStep + c] = ClampToByte(mean + 0.5f);
+            }
+        }
+    }
+}
+
+// Rotational blur around every ring of the current part: each sample averages the Window rays that follow it
+static void radialBlurRadii(void* Context, int Begin, int End, int Thread) {
+    const PolarBlurParams* p = (const PolarBlurParams*)Context;
+    int channels = p->PolarChannels, rays = p->Rays, window = p->Window;
+    int* line = (int*)(p->Buffers + Thread * p->BufferSize);
+    float scale = 1.0f / (256.0f * window);
+    float value[4];
+
+    for (int i = Begin; i < End; i++) {
+        int k = p->FirstRadius + i;
+        for (int j = 0; j < rays; j++) {
+            polarSample(p, p->CenterX + k * p->Cosines[j], p->CenterY + k * p->Sines[j], value);
+            for (int c = 0; c < channels; c++)
+                line[j * channels + c] = (int)(value[c] * 256.0f + 0.5f);
+        }
+        int64_t sums[4] = { 0, 0, 0, 0 };
+        for (int j = 0; j < window; j++) {
+            for (int c = 0; c < channels; c++)
+                sums[c] += line[j * channels + c];
+        }
+        unsigned char* out = p->Polar + i * p->RadiusStep;
+        for (int j = 0; j < rays; j++) {
+            int entering = (j + window < rays) ? j + window : j + window - rays;
+            for (int c = 0; c < channels; c++) {
+                out[j * channels + c] = (unsigned char)(sums[c] * scale + 0.5f);
+                sums[c] += line[entering * channels + c] - line[j * channels + c];
+            }
+        }
+        for (int c = 0; c < channels; c++)
+            out[rays * channels + c] = out[c];
+    }
+}
+
+// Builds, blurs and maps back the grid one part at a time. Parts read pixels that earlier parts may have mapped back
+// already, so with more than one part a blur in place reads a copy of the input.
+// Rays, or radii, that polarBlurRun() goes through and how many of them one part holds
+static int polarBlurParts(const PolarBlurParams* p, int* perPart) {
+    // Each part holds one ray, or radius, past the ones its pixels are interpolated from
+    int count = p->ByRadius ? p->Radii - 1 : p->Rays;
+    size_t step = p->ByRadius ? p->RadiusStep : p->RayStep;
+    *perPart = (int)min((size_t)count, max(POLAR_PART_SIZE / step, (size_t)2) - 1);
+    return count;
+}
+
+// Peak scratch of polarBlurSetup() and polarBlurRun() for an in place blur
+static size_t polarBlurScratchSize(const PolarBlurParams* p) {
+    int perPart = 0;
+    int count = polarBlurParts(p, &perPart);
+    size_t step = p->ByRadius ? p->RadiusStep : p->RayStep;
+    size_t size = ScratchBlockSize(2 * ((size_t)p->Rays + 1) * sizeof(float)) + ScratchBlockSize((perPart + 1) * step) +
+                  ScratchBlockSize(ocularGetThreadCount() * p->BufferSize);
+    if (perPart < count)
+        size += ScratchBlockSize((size_t)p->Height * p->Stride);
+    return size;
+}
+
+static OC_STATUS polarBlurRun(PolarBlurParams* p, OcParallelBody Blur, int Grain) {
+    int perPart = 0;
+    int count = polarBlurParts(p, &perPart);
+    size_t step = p->ByRadius ? p->RadiusStep : p->RayStep;
+
+    bool copy = (perPart < count && p->Input == p->Output);
+    unsigned char* source = copy ? (unsigned char*)ScratchAlloc((size_t)p->Height * p->Stride, false) : NULL;
+    p->Polar = (unsigned char*)ScratchAlloc((perPart + 1) * step, false);
+    p->Buffers = (unsigned char*)ScratchAlloc(ocularGetThreadCount() * p->BufferSize, false);
+    if ((copy && source == NULL) || p->Polar == NULL || p->Buffers == NULL) {
+        ScratchFree(p->Buffers);
+        ScratchFree(p->Polar);
+        ScratchFree(source);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    if (source != NULL) {
+        memcpy(source, p->Input, (size_t)p->Height * p->Stride);
+        p->Input = source;
+    }
+
+    for (int begin = 0; begin < count; begin += perPart) {
+        int end = min(begin + perPart, count);
+        p->PartBegin = begin;
+        p->PartEnd = end;
+        if (p->ByRadius) {
+            p->FirstRadius = begin;
+            polarBandBounds(p, end);
+        } else {
+            p->FirstRay = begin;
+            if (!polarSectorBounds(p, begin, end))
+                continue;
+        }
+        ocularParallelFor(end - begin + 1, Grain, Blur, p);
+        ocularParallelFor(p->Bottom - p->Top, 16, polarUnwrapRows, p);
+    }
+
+    ScratchFree(p->Buffers);
+    ScratchFree(p->Polar);
+    ScratchFree(source);
+    return OC_STATUS_OK;
+}
+
+// Steps and line buffers of the zoom blur grid, once polarBlurGrid() has sized it
+static void zoomBlurLayout(PolarBlurParams* p) {
+    p->Reach = (int)ceilf(p->Radii * (1.0f + p->Amount)) + 1;
+    p->RadiusStep = p->PolarChannels;
+    p->RayStep = (size_t)p->Radii * p->PolarChannels;
+    p->BufferSize = ((size_t)(p->Reach + 1) * p->PolarChannels * 2 * sizeof(int64_t) + (size_t)p->Reach * p->PolarChannels * sizeof(int) + 63) &
+                    ~(size_t)63;
+}
+
 OC_STATUS ocularZoomBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int sampleRadius, float blurAmount,
                          int centerX, int centerY) {
 
@@ -994,61 +1314,53 @@ OC_STATUS ocularZoomBlur(unsigned char* Input, unsigned char* Output, int Width,
         return OC_STATUS_ERR_INVALIDPARAMETER;
     }
 
-    // Ensure filter specific parameters are within valid ranges
-    sampleRadius = clamp(sampleRadius, 10, 200);
+    int Channels = Stride / Width;
+    if (Channels < 1 || Channels > 4) {
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    }
+
+    // Ensure filter specific parameters are within valid ranges. The streaks are integrated exactly, so sampleRadius
+    // no longer changes the result.
+    (void)sampleRadius;
     blurAmount = clamp(blurAmount, 0.1f, 1.0f);
     centerX = clamp(centerX, 0, Width - 1);
     centerY = clamp(centerY, 0, Height - 1);
 
-    int Channels = Stride / Width;
-    float maxDistance = sqrtf(Width * Width + Height * Height) / 2.0f;
-
-    for (int y = 0; y < Height; y++) {
-        for (int x = 0; x < Width; x++) {
-            float dx = (float)(x - centerX);
-            float dy = (float)(y - centerY);
-            float distance = sqrtf(dx * dx + dy * dy);
-            float strength = distance / maxDistance;
-
-            float r = 0, g = 0, b = 0;
-            float totalWeight = 0;
-
-            int actualSamples = (int)(strength * sampleRadius);
-            for (int sample = 0; sample <= actualSamples; sample++) {
-                float t = (float)sample / (float)actualSamples;
-                float weight = 1.0f - t;
-                float sampleX = x + dx * t * blurAmount;
-                float sampleY = y + dy * t * blurAmount;
-
-                // Clamp sample coordinates to image boundaries
-                int ix = (int)fmaxf(0, fminf(sampleX, Width - 1));
-                int iy = (int)fmaxf(0, fminf(sampleY, Height - 1));
-                int index = (iy * Stride) + (ix * Channels);
-
-                r += Input[index] * weight;
-                g += Input[index + 1] * weight;
-                b += Input[index + 2] * weight;
-                totalWeight += weight;
-            }
-
-            int outIndex = (y * Stride) + (x * Channels);
-            if (totalWeight > 0) {
-                Output[outIndex] = (unsigned char)(r / totalWeight);
-                Output[outIndex + 1] = (unsigned char)(g / totalWeight);
-                Output[outIndex + 2] = (unsigned char)(b / totalWeight);
-            } else {
-                Output[outIndex] = Input[outIndex];
-                Output[outIndex + 1] = Input[outIndex + 1];
-                Output[outIndex + 2] = Input[outIndex + 2];
-            }
-
-            if (Channels == 4) {
-                Output[outIndex + 3] = Input[outIndex + 3];
-            }
-        }
+    PolarBlurParams params = { 0 };
+    params.Input = Input;
+    params.Output = Output;
+    params.Width = Width;
+    params.Height = Height;
+    params.Stride = Stride;
+    params.Channels = Channels;
+    params.CenterX = centerX;
+    params.CenterY = centerY;
+    params.PolarChannels = (Channels == 2 || Channels == 4) ? Channels - 1 : Channels; // alpha is kept
+    params.Amount = blurAmount;
+
+    float* directions = NULL;
+    OC_STATUS status = polarBlurSetup(&params, &directions);
+    if (status != OC_STATUS_OK) {
+        return status;
     }
+    zoomBlurLayout(&params);
 
-    return OC_STATUS_OK;
+    status = polarBlurRun(&params, zoomBlurRays, 16);
+    ScratchFree(directions);
+    return status;
+}
+
+size_t zoomBlurScratchSize(int Width, int Height, int Stride, int Channels) {
+    // The grid is largest with the center in a corner and the longest streaks
+    PolarBlurParams params = { 0 };
+    params.Width = Width;
+    params.Height = Height;
+    params.Stride = Stride;
+    params.PolarChannels = (Channels == 2 || Channels == 4) ? Channels - 1 : Channels;
+    params.Amount = 1.0f;
+    polarBlurGrid(&params);
+    zoomBlurLayout(&params);
+    return polarBlurScratchSize(&params);
 }
 
 OC_STATUS ocularAverageBlur(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
@@ -1068,14 +1380,14 @@ OC_STATUS ocularAverageBlur(const unsigned char* Input, unsigned char* Output, i
     Radius = max(Radius, 1);
 
     // Allocate integral image buffers for each channel
-    int* integralR = (int*)malloc((Width + 1) * (Height + 1) * sizeof(int));
-    int* integralG = (int*)malloc((Width + 1) * (Height + 1) * sizeof(int));
-    int* integralB = (int*)malloc((Width + 1) * (Height + 1) * sizeof(int));
+    int* integralR = (int*)ScratchAlloc((Width + 1) * (Height + 1) * sizeof(int), false);
+    int* integralG = (int*)ScratchAlloc((Width + 1) * (Height + 1) * sizeof(int), false);
+    int* integralB = (int*)ScratchAlloc((Width + 1) * (Height + 1) * sizeof(int), false);
 
     if (!integralR || !integralG || !integralB) {
-        free(integralR);
-        free(integralG);
-        free(integralB);
+        ScratchFree(integralR);
+        ScratchFree(integralG);
+        ScratchFree(integralB);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -1132,123 +1444,402 @@ OC_STATUS ocularAverageBlur(const unsigned char* Input, unsigned char* Output, i
     }
 
     // Clean up
-    free(integralR);
-    free(integralG);
-    free(integralB);
+    ScratchFree(integralR);
+    ScratchFree(integralG);
+    ScratchFree(integralB);
 
     return OC_STATUS_OK;
 }
 
-OC_STATUS ocularMedianBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+size_t averageBlurScratchSize(int Width, int Height) {
+    return 3 * ScratchBlockSize((size_t)(Width + 1) * (Height + 1) * sizeof(int));
+}
 
-    if (Input == NULL || Output == NULL) {
-        return OC_STATUS_ERR_NULLREFERENCE;
-    }
-    if (Width <= 0 || Height <= 0 || Stride <= 0) {
-        return OC_STATUS_ERR_INVALIDPARAMETER;
+// Median blur after Perreault and Hebert: every column keeps a histogram of the 2 * Radius + 1 rows around the current row, and
+// the window histogram is the sum of the column histograms under it, so moving one pixel costs one column added and one removed
+// whatever the radius. Histograms have 16 coarse bins of 16 values; the window only keeps the coarse counts current and brings a
+// fine segment up to date when the median falls in it. Columns are split into strips that run on the worker pool.
+
+#define MEDIAN_MAX_RADIUS 100
+#define MEDIAN_MAX_STRIP 256
+#define MEDIAN_MIN_STRIP 64
+// Up to this radius sliding a single window histogram along each row beats the column histograms
+#define MEDIAN_SLIDING_RADIUS 7
+
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    unsigned char* Buffers; // per thread histograms
+    size_t BufferSize;
+    int Width;
+    int Height;
+    int Stride;
+    int Channels;
+    int Radius;
+    int StripWidth;
+} MedianParams;
+
+// Counts never exceed (2 * MEDIAN_MAX_RADIUS + 1)^2, so they fit 16 bits
+typedef unsigned short MedianCount;
+
+static size_t medianStripSize(int StripWidth, int Channels, int Radius) {
+    if (Radius <= MEDIAN_SLIDING_RADIUS)
+        return 256 * sizeof(int);
+    size_t columns = (size_t)StripWidth + 2 * Radius;
+    return (columns + 1) * Channels * (256 + 16) * sizeof(MedianCount) + Channels * 16 * sizeof(int);
+}
+
+static int medianStripWidth(int Width) {
+    int threads = ocularGetThreadCount();
+    return min(clamp((Width + threads - 1) / threads, MEDIAN_MIN_STRIP, MEDIAN_MAX_STRIP), Width);
+}
+
+size_t medianBlurScratchSize(int Width, int Height, int Channels, int Radius) {
+    (void)Height;
+    if (Channels < 1 || Channels > 4)
+        return 0;
+    Radius = clamp(Radius, 1, MEDIAN_MAX_RADIUS);
+    return ScratchBlockSize(ocularGetThreadCount() * medianStripSize(medianStripWidth(Width), Channels, Radius));
+}
+
+// Adds (Delta 1) or removes (Delta -1) row Y of the strip columns [First, Last) from the column histograms
+static void medianUpdateColumns(const MedianParams* p, MedianCount* columnFine, MedianCount* columnCoarse, int Y, int First, int Last,
+                                int Delta) {
+    int channels = p->Channels;
+    const unsigned char* in = p->Input + (size_t)Y * p->Stride + First * channels;
+    for (int i = 0; i < (Last - First) * channels; i++) {
+        int value = in[i];
+        columnFine[i * 256 + value] += Delta;
+        columnCoarse[i * 16 + (value >> 4)] += Delta;
     }
+}
 
-    int Channel = Stride / Width;
-    if ((Channel != 1) && (Channel != 3)) {
-        return OC_STATUS_ERR_NOTSUPPORTED;
+// Small radius path: Huang's algorithm. The median moves little between neighbouring pixels, so it is walked from its
+// previous position instead of searched for, tracking how many window values lie below it
+static void medianRows(void* Context, int Begin, int End, int Thread) {
+    const MedianParams* p = (const MedianParams*)Context;
+    const unsigned char* input = p->Input;
+    int width = p->Width, height = p->Height, stride = p->Stride, channels = p->Channels, radius = p->Radius;
+    int* histogram = (int*)(p->Buffers + Thread * p->BufferSize);
+
+    for (int y = Begin; y < End; y++) {
+        int top = max(y - radius, 0);
+        int rows = min(y + radius, height - 1) - top + 1;
+        const unsigned char* window = input + (size_t)top * stride;
+        unsigned char* out = p->Output + (size_t)y * stride;
+
+        for (int c = 0; c < channels; c++) {
+            int* counts = histogram;
+            memset(counts, 0, 256 * sizeof(int));
+            for (int j = 0; j < rows; j++)
+                for (int cx = 0; cx <= radius && cx < width; cx++)
+                    counts[window[(size_t)j * stride + cx * channels + c]]++;
+
+            int median = 0, below = 0;
+            for (int x = 0; x < width; x++) {
+                if (x > 0) {
+                    if (x + radius < width) {
+                        const unsigned char* column = window + (x + radius) * channels + c;
+                        for (int j = 0; j < rows; j++, column += stride) {
+                            int value = *column;
+                            counts[value]++;
+                            below += (value < median);
+                        }
+                    }
+                    if (x - radius - 1 >= 0) {
+                        const unsigned char* column = window + (x - radius - 1) * channels + c;
+                        for (int j = 0; j < rows; j++, column += stride) {
+                            int value = *column;
+                            counts[value]--;
+                            below -= (value < median);
+                        }
+                    }
+                }
+                // The median is the smallest value with more than rank values at or below it
+                int rank = rows * (min(x + radius, width - 1) - max(x - radius, 0) + 1) / 2;
+                while (below > rank)
+                    below -= counts[--median];
+                while (below + counts[median] <= rank)
+                    below += counts[median++];
+                out[x * channels + c] = (unsigned char)median;
+            }
+        }
     }
+}
 
-    // Ensure filter specific parameters are within valid ranges
-    Radius = max(Radius, 1);
+static void medianStrips(void* Context, int Begin, int End, int Thread) {
+    const MedianParams* p = (const MedianParams*)Context;
+    int width = p->Width, height = p->Height, channels = p->Channels, radius = p->Radius;
 
-    const int Level = 256;
+    for (int strip = Begin; strip < End; strip++) {
+        int x0 = strip * p->StripWidth;
+        int x1 = min(x0 + p->StripWidth, width);
+        // columns whose histograms the strip needs, indexed from First
+        int first = max(x0 - radius, 0);
+        int last = min(x1 + radius, width);
+        int columns = last - first;
 
-    if (Channel == 1) {
+        MedianCount* columnFine = (MedianCount*)(p->Buffers + Thread * p->BufferSize);
+        MedianCount* columnCoarse = columnFine + (size_t)columns * channels * 256;
+        MedianCount* windowFine = columnCoarse + (size_t)columns * channels * 16;
+        MedianCount* windowCoarse = windowFine + channels * 256;
+        int* segmentX = (int*)(windowCoarse + channels * 16); // column each fine segment of the window was last brought to
 
-        int* histogram = (int*)malloc(Level * sizeof(int));
-        if (histogram == NULL) {
-            return OC_STATUS_ERR_OUTOFMEMORY;
-        }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* LinePS = Input + Y * Stride;
-            unsigned char* LinePD = Output + Y * Stride;
-            memset(histogram, 0, Level * sizeof(int)); // all assigned values are 0
-            int CutPoint = -1;
-            int Balance = 0;
-
-            for (int J = max(Y - Radius, 0); J <= min(Y + Radius, Height - 1); J++) {
-                for (int I = max(0 - Radius, 0); I <= min(0 + Radius, Width - 1); I++) {
-                    int Value = Input[J * Stride + I];
-                    // Calculate the two-dimensional histogram of the first point in each row.
-                    // The horizontal direction of the histogram is the Feature coordinate and
-                    // the vertical direction is the Value coordinate.
-                    histogram[Value]++;
-                    Balance--;
-                }
+        memset(columnFine, 0, (size_t)columns * channels * (256 + 16) * sizeof(MedianCount));
+        for (int y = 0; y <= radius && y < height; y++)
+            medianUpdateColumns(p, columnFine, columnCoarse, y, first, last, 1);
+
+        for (int y = 0; y < height; y++) {
+            if (y > 0) {
+                if (y - radius - 1 >= 0)
+                    medianUpdateColumns(p, columnFine, columnCoarse, y - radius - 1, first, last, -1);
+                if (y + radius < height)
+                    medianUpdateColumns(p, columnFine, columnCoarse, y + radius, first, last, 1);
+            }
+            int rows = min(y + radius, height - 1) - max(y - radius, 0) + 1;
+            unsigned char* out = p->Output + (size_t)y * p->Stride;
+
+            memset(windowCoarse, 0, channels * 16 * sizeof(MedianCount));
+            for (int i = 0; i < channels * 16; i++)
+                segmentX[i] = INT_MIN;
+            for (int cx = max(x0 - radius, 0); cx <= min(x0 + radius, width - 1); cx++) {
+                const MedianCount* coarse = columnCoarse + (size_t)(cx - first) * channels * 16;
+                for (int i = 0; i < channels * 16; i++)
+                    windowCoarse[i] += coarse[i];
             }
-            for (int X = 0; X < Width; X++) {
 
-                if (Balance < 0) // the balance of the first point must be less than 0
-                {
-                    for (; Balance < 0 && CutPoint != Level - 1; CutPoint++) {
-                        Balance += 2 * histogram[CutPoint + 1];
+            for (int x = x0; x < x1; x++) {
+                if (x > x0) {
+                    if (x + radius < width) {
+                        const MedianCount* coarse = columnCoarse + (size_t)(x + radius - first) * channels * 16;
+                        for (int i = 0; i < channels * 16; i++)
+                            windowCoarse[i] += coarse[i];
                     }
-                } else if (Balance > 0) // If the balance value is greater than 0, move the middle value to the left
-                {
-                    for (; Balance > 0 && CutPoint != 0; CutPoint--) {
-                        Balance -= 2 * histogram[CutPoint];
+                    if (x - radius - 1 >= 0) {
+                        const MedianCount* coarse = columnCoarse + (size_t)(x - radius - 1 - first) * channels * 16;
+                        for (int i = 0; i < channels * 16; i++)
+                            windowCoarse[i] -= coarse[i];
                     }
                 }
-                LinePD[X] = CutPoint;
-                if ((X - Radius) >= 0) {
-                    for (int J = max(Y - Radius, 0); J <= min(Y + Radius, Height - 1); J++) // the column of data to be moved out
-                    {
-                        int Value = Input[J * Stride + X - Radius];
-                        histogram[Value]--;
-                        if (Value <= CutPoint) // If the value moved out is less than the current median value
-                            Balance--;
-                        else
-                            Balance++;
-                    }
-                }
-                if ((X + Radius + 1) <= Width - 1) {
-                    for (int J = max(Y - Radius, 0); J <= min(Y + Radius, Height - 1); J++) {
-                        int Value = Input[J * Stride + X + Radius + 1];
-                        histogram[Value]++;
-                        if (Value <= CutPoint) // If the value moved out is less than the current median value
-                            Balance++;
-                        else
-                            Balance--;
+                int count = rows * (min(x + radius, width - 1) - max(x - radius, 0) + 1);
+                int rank = count / 2;
+
+                for (int c = 0; c < channels; c++) {
+                    const MedianCount* coarse = windowCoarse + c * 16;
+                    int below = 0;
+                    int bin = 0;
+                    while (below + coarse[bin] <= rank)
+                        below += coarse[bin++];
+
+                    // Bring the fine segment of the bin to this column
+                    MedianCount* fine = windowFine + c * 256 + bin * 16;
+                    int* lastX = segmentX + c * 16 + bin;
+                    if (*lastX == INT_MIN || x - *lastX > 2 * radius + 1) {
+                        memset(fine, 0, 16 * sizeof(MedianCount));
+                        for (int cx = max(x - radius, 0); cx <= min(x + radius, width - 1); cx++) {
+                            const MedianCount* column = columnFine + ((size_t)(cx - first) * channels + c) * 256 + bin * 16;
+                            for (int i = 0; i < 16; i++)
+                                fine[i] += column[i];
+                        }
+                    } else {
+                        for (int px = *lastX + 1; px <= x; px++) {
+                            if (px + radius < width) {
+                                const MedianCount* column = columnFine + ((size_t)(px + radius - first) * channels + c) * 256 + bin * 16;
+                                for (int i = 0; i < 16; i++)
+                                    fine[i] += column[i];
+                            }
+                            if (px - radius - 1 >= 0) {
+                                const MedianCount* column = columnFine + ((size_t)(px - radius - 1 - first) * channels + c) * 256 + bin * 16;
+                                for (int i = 0; i < 16; i++)
+                                    fine[i] -= column[i];
+                            }
+                        }
                     }
+                    *lastX = x;
+
+                    int value = 0;
+                    while (below + fine[value] <= rank)
+                        below += fine[value++];
+                    out[x * channels + c] = (unsigned char)(bin * 16 + value);
                 }
             }
         }
-        free(histogram);
-    } else {
-        unsigned char* SrcR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+    }
+}
 
-        unsigned char* DstR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+OC_STATUS ocularMedianBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
 
-        SplitRGB(Input, SrcB, SrcG, SrcR, Width, Height, Stride);
+    if (Input == NULL || Output == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Width <= 0 || Height <= 0 || Stride <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
 
-        // TODO: Investigate using parallel processing here
-        ocularMedianBlur(SrcR, DstR, Width, Height, Width, Radius);
-        ocularMedianBlur(SrcG, DstG, Width, Height, Width, Radius);
-        ocularMedianBlur(SrcB, DstB, Width, Height, Width, Radius);
+    int Channels = Stride / Width;
+    if (Channels < 1 || Channels > 4) {
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    }
 
-        CombineRGB(DstB, DstG, DstR, Output, Width, Height, Stride);
+    // Ensure filter specific parameters are within valid ranges
+    Radius = clamp(Radius, 1, MEDIAN_MAX_RADIUS);
 
-        free(SrcR);
-        free(SrcG);
-        free(SrcB);
-        free(DstR);
-        free(DstG);
-        free(DstB);
+    int stripWidth = medianStripWidth(Width);
+    size_t bufferSize = medianStripSize(stripWidth, Channels, Radius);
+    unsigned char* buffers = (unsigned char*)ScratchAlloc(ocularGetThreadCount() * bufferSize, false);
+    if (buffers == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
+    MedianParams params = { Input, Output, buffers, bufferSize, Width, Height, Stride, Channels, Radius, stripWidth };
+    if (Radius <= MEDIAN_SLIDING_RADIUS)
+        ocularParallelFor(Height, 8, medianRows, &params);
+    else
+        ocularParallelFor((Width + stripWidth - 1) / stripWidth, 1, medianStrips, &params);
+
+    ScratchFree(buffers);
     return OC_STATUS_OK;
 }
 
-OC_STATUS ocularMotionBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Distance, int Angle) {
+// The blur runs along sheared rows: row V holds, for each position M along the major axis of the blur direction, the pixel
+// V + Offset[M] across it (plus Weight[M] / 256 of the next one when sampling sub-pixel). A running sum along each row
+// then gives every pixel its streak in constant time whatever the distance.
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    int Channels;
+    int MajorLength; // pixels along the major axis
+    int MinorLength; // pixels across it
+    int MajorStep;   // bytes between neighbours along the major axis
+    int MinorStep;   // bytes between neighbours across it
+    int Samples;     // streak length in pixels along the major axis
+    int Direction;   // 1 when the streak runs towards increasing M, -1 otherwise
+    int FirstRow;
+    const int* Offset;
+    const unsigned short* Weight; // NULL for nearest sampling
+    unsigned char* Buffers;       // per thread rows
+    size_t BufferSize;
+} MotionBlurParams;
+
+// Gathers sheared row V into Samples (8.8 fixed point) and returns the range [First, Last] of M it covers, empty if
+// First > Last
+static void motionBlurGather(const MotionBlurParams* p, int V, unsigned short* Samples, int* First, int* Last) {
+    int channels = p->Channels;
+    int first = p->MajorLength, last = -1;
+    for (int m = 0; m < p->MajorLength; m++) {
+        int minor = V + p->Offset[m];
+        int weight = (p->Weight != NULL) ? p->Weight[m] : 0;
+        if (minor < 0 || minor + (weight > 0) >= p->MinorLength)
+            continue;
+        first = min(first, m);
+        last = m;
+        const unsigned char* pixel = p->Input + (size_t)m * p->MajorStep + (size_t)minor * p->MinorStep;
+        unsigned short* sample = Samples + m * channels;
+        if (weight == 0) {
+            for (int c = 0; c < channels; c++)
+                sample[c] = (unsigned short)(pixel[c] << 8);
+        } else {
+            const unsigned char* next = pixel + p->MinorStep;
+            for (int c = 0; c < channels; c++)
+                sample[c] = (unsigned short)(pixel[c] * (256 - weight) + next[c] * weight);
+        }
+    }
+    *First = first;
+    *Last = last;
+}
+
+// Mean of the streak of every position in [First, Last], the streak being cut where the row leaves the image
+static void motionBlurMeans(const MotionBlurParams* p, const unsigned short* Samples, float* Means, int First, int Last) {
+    int channels = p->Channels, samples = p->Samples;
+    int64_t sums[4] = { 0, 0, 0, 0 };
+    int step = -p->Direction;
+    int m = (p->Direction > 0) ? Last : First;
+    for (int i = First; i <= Last; i++, m += step) {
+        // entering sample is m, leaving one is Samples positions further along the streak
+        int leaving = m + p->Direction * samples;
+        bool leaves = (leaving >= First && leaving <= Last);
+        int count = (p->Direction > 0) ? min(m + samples - 1, Last) - m + 1 : m - max(m - samples + 1, First) + 1;
+        float scale = 1.0f / (256.0f * count);
+        for (int c = 0; c < channels; c++) {
+            sums[c] += Samples[m * channels + c];
+            if (leaves)
+                sums[c] -= Samples[leaving * channels + c];
+            Means[m * channels + c] = (float)sums[c] * scale;
+        }
+    }
+}
+
+static void motionBlurRows(void* Context, int Begin, int End, int Thread) {
+    const MotionBlurParams* p = (const MotionBlurParams*)Context;
+    int channels = p->Channels;
+    float* means = (float*)(p->Buffers + Thread * p->BufferSize);
+    unsigned short* samples = (unsigned short*)(means + (size_t)p->MajorLength * channels);
+
+    for (int row = Begin; row < End; row++) {
+        int v = p->FirstRow + row;
+        int first, last;
+        motionBlurGather(p, v, samples, &first, &last);
+        if (first > last)
+            continue;
+        motionBlurMeans(p, samples, means, first, last);
+        for (int m = first; m <= last; m++) {
+            unsigned char* out = p->Output + (size_t)m * p->MajorStep + (size_t)(v + p->Offset[m]) * p->MinorStep;
+            for (int c = 0; c < channels; c++)
+                out[c] = ClampToByte(means[m * channels + c] + 0.5f);
+        }
+    }
+}
+
+// Sub-pixel sampling: pixel (M, P) lies between sheared rows V and V + 1, and is interpolated from both
+static void motionBlurRowPairs(void* Context, int Begin, int End, int Thread) {
+    const MotionBlurParams* p = (const MotionBlurParams*)Context;
+    int channels = p->Channels;
+    size_t rowFloats = (size_t)p->MajorLength * channels;
+    float* means[2] = { (float*)(p->Buffers + Thread * p->BufferSize), (float*)(p->Buffers + Thread * p->BufferSize) + rowFloats };
+    unsigned short* samples = (unsigned short*)(means[1] + rowFloats);
+    int first[2], last[2];
+
+    int v = p->FirstRow + Begin;
+    motionBlurGather(p, v, samples, &first[0], &last[0]);
+    if (first[0] <= last[0])
+        motionBlurMeans(p, samples, means[0], first[0], last[0]);
+
+    for (int row = Begin; row < End; row++, v++) {
+        motionBlurGather(p, v + 1, samples, &first[1], &last[1]);
+        if (first[1] <= last[1])
+            motionBlurMeans(p, samples, means[1], first[1], last[1]);
+
+        for (int m = 0; m < p->MajorLength; m++) {
+            int weight = p->Weight[m];
+            int minor = v + p->Offset[m] + (weight > 0);
+            if (minor < 0 || minor >= p->MinorLength)
+                continue;
+            // Row V is sampled at minor - weight / 256 and row V + 1 at minor + 1 - weight / 256
+            bool upper = (m >= first[0] && m <= last[0]);
+            bool lower = (weight > 0 && m >= first[1] && m <= last[1]);
+            float upperWeight = (weight == 0) ? 1.0f : weight / 256.0f;
+            if (!lower)
+                upperWeight = 1.0f;
+            else if (!upper)
+                upperWeight = 0.0f;
+            unsigned char* out = p->Output + (size_t)m * p->MajorStep + (size_t)minor * p->MinorStep;
+            for (int c = 0; c < channels; c++) {
+                float a = upper ? means[0][m * channels + c] : 0.0f;
+                float b = lower ? means[1][m * channels + c] : 0.0f;
+                out[c] = ClampToByte(a * upperWeight + b * (1.0f - upperWeight) + 0.5f);
+            }
+        }
+
+        float* swapMeans = means[0];
+        means[0] = means[1];
+        means[1] = swapMeans;
+        first[0] = first[1];
+        last[0] = last[1];
+    }
+}
+
+OC_STATUS ocularMotionBlurFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Distance, int Angle,
+                                 bool Subpixel) {
 
     if (Input == NULL || Output == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
@@ -1257,92 +1848,105 @@ OC_STATUS ocularMotionBlurFilter(unsigned char* Input, unsigned char* Output, in
         return OC_STATUS_ERR_INVALIDPARAMETER;
     }
 
+    int Channels = Stride / Width;
+    if (Channels < 1 || Channels > 4) {
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    }
+
     // Ensure filter specific parameters are within valid ranges
-    Distance = max(Distance, 1); // Changed from min to max since we want at least 1 pixel distance
+    Distance = max(Distance, 1);
     Angle = clamp(Angle, -180, 180);
 
-    int channels = Stride / Width;
-
-    // Pre-calculate angle and direction
-    float radian = ((float)(Angle % 360) + 180.0f) / 180.0f * M_PI;
-    int dx = (int)((float)Distance * fastCos(radian) + 0.5f);
-    int dy = (int)((float)Distance * fastSin(radian) + 0.5f);
-
-    // Pre-calculate sign to avoid branching in loop
-    int sign = (dx == 0) ? 0 : (dx < 0 ? -1 : 1);
-    int absDistance = abs(dx);
-
-    // Process image in chunks for better cache utilization
-    const int CHUNK_SIZE = 32;
-    for (int blockY = 0; blockY < Height; blockY += CHUNK_SIZE) {
-        for (int blockX = 0; blockX < Width; blockX += CHUNK_SIZE) {
-            int endY = min(blockY + CHUNK_SIZE, Height);
-            int endX = min(blockX + CHUNK_SIZE, Width);
-
-            // Pre-allocate arrays for accumulation
-            int sums[4] = { 0 }; // Support up to 4 channels
-            float invCount;
-
-            for (int y = blockY; y < endY; y++) {
-                unsigned char* pInput = Input + (y * Stride);
-                unsigned char* pOutput = Output + (y * Stride);
-
-                for (int x = blockX; x < endX; x++) {
-                    // Reset sums for new pixel
-                    memset(sums, 0, sizeof(sums));
-                    int count = 0;
-
-                    // Vectorizable inner loop
-                    for (int p = 0; p < absDistance; p++) {
-                        int yOffset = y + p * sign;
-                        int xOffset = x + p * sign;
-
-                        if (yOffset >= 0 && yOffset < Height && xOffset >= 0 && xOffset < Width) {
-                            unsigned char* pOffset = Input + (yOffset * Stride + xOffset * channels);
-                            count++;
-
-                            // Unrolled channel accumulation
-                            switch (channels) {
-                            case 4:
-                                sums[3] += pOffset[3];
-                                // fallthrough
-                            case 3:
-                                sums[2] += pOffset[2];
-                                sums[1] += pOffset[1];
-                                sums[0] += pOffset[0];
-                                break;
-                            case 1: sums[0] += pOffset[0]; break;
-                            }
-                        }
-                    }
+    // The streak runs from each pixel away from the angle
+    double radian = ((double)Angle + 180.0) / 180.0 * M_PI;
+    double dx = cos(radian), dy = sin(radian);
+    bool horizontal = fabs(dx) >= fabs(dy);
+    double major = horizontal ? dx : dy;
+    double slope = (horizontal ? dy : dx) / major;
+
+    MotionBlurParams params;
+    params.Input = Input;
+    params.Output = Output;
+    params.Channels = Channels;
+    params.MajorLength = horizontal ? Width : Height;
+    params.MinorLength = horizontal ? Height : Width;
+    params.MajorStep = horizontal ? Channels : Stride;
+    params.MinorStep = horizontal ? Stride : Channels;
+    params.Samples = max((int)(Distance * fabs(major) + 0.5), 1);
+    params.Direction = (major > 0) ? 1 : -1;
+    // A single pixel across leaves no neighbour to interpolate with
+    if (params.MinorLength == 1)
+        Subpixel = false;
+
+    int* offset = (int*)ScratchAlloc(params.MajorLength * sizeof(int), false);
+    unsigned short* weight = Subpixel ? (unsigned short*)ScratchAlloc(params.MajorLength * sizeof(unsigned short), false) : NULL;
+    // Sub-pixel rows read pixels other than the ones they write, so they need the input intact
+    unsigned char* source = (Subpixel && Input == Output) ? (unsigned char*)ScratchAlloc((size_t)Height * Stride, false) : NULL;
+    int rowsPerThread = Subpixel ? 2 : 1;
+    size_t bufferSize = ((size_t)params.MajorLength * Channels * (rowsPerThread * sizeof(float) + sizeof(unsigned short)) + 63) & ~(size_t)63;
+    unsigned char* buffers = (unsigned char*)ScratchAlloc(ocularGetThreadCount() * bufferSize, false);
+    if (offset == NULL || (Subpixel && weight == NULL) || (Subpixel && Input == Output && source == NULL) || buffers == NULL) {
+        ScratchFree(buffers);
+        ScratchFree(source);
+        ScratchFree(weight);
+        ScratchFree(offset);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    if (source != NULL) {
+        memcpy(source, Input, (size_t)Height * Stride);
+        params.Input = source;
+    }
 
-                    // Write output
-                    if (count == 0) {
-                        // Direct copy if no valid samples
-                        memcpy(pOutput + x * channels, pInput + x * channels, channels);
-                    } else {
-                        // Pre-calculate inverse count for multiplication instead of division
-                        invCount = 1.0f / count;
-                        switch (channels) {
-                        case 4:
-                            pOutput[x * channels + 3] = ClampToByte(sums[3] * invCount + 0.5f);
-                            // fallthrough
-                        case 3:
-                            pOutput[x * channels + 2] = ClampToByte(sums[2] * invCount + 0.5f);
-                            pOutput[x * channels + 1] = ClampToByte(sums[1] * invCount + 0.5f);
-                            pOutput[x * channels + 0] = ClampToByte(sums[0] * invCount + 0.5f);
-                            break;
-                        case 1: pOutput[x * channels] = ClampToByte(sums[0] * invCount + 0.5f); break;
-                        }
-                    }
-                }
+    int lowest = 0, highest = 0;
+    for (int m = 0; m < params.MajorLength; m++) {
+        double position = m * slope;
+        if (Subpixel) {
+            offset[m] = (int)floor(position);
+            weight[m] = (unsigned short)((position - offset[m]) * 256.0 + 0.5);
+            if (weight[m] == 256) {
+                offset[m]++;
+                weight[m] = 0;
             }
+        } else {
+            offset[m] = (int)floor(position + 0.5);
         }
+        lowest = min(lowest, offset[m]);
+        highest = max(highest, offset[m]);
     }
+    params.Offset = offset;
+    params.Weight = weight;
+    params.Buffers = buffers;
+    params.BufferSize = bufferSize;
+
+    // Every pixel lies on one sheared row, or between a row and the next one when sampling sub-pixel
+    params.FirstRow = -highest - (Subpixel ? 1 : 0);
+    int rows = params.MinorLength - lowest - params.FirstRow;
+    ocularParallelFor(rows, 8, Subpixel ? motionBlurRowPairs : motionBlurRows, &params);
+
+    ScratchFree(buffers);
+    ScratchFree(source);
+    ScratchFree(weight);
+    ScratchFree(offset);
 
     return OC_STATUS_OK;
 }
 
+size_t motionBlurScratchSize(int Width, int Height, int Stride, int Channels) {
+    // Sub-pixel streaks in place along the longer side take the most
+    size_t majorLength = max(Width, Height);
+    size_t bufferSize = (majorLength * Channels * (2 * sizeof(float) + sizeof(unsigned short)) + 63) & ~(size_t)63;
+    return ScratchBlockSize(majorLength * sizeof(int)) + ScratchBlockSize(majorLength * sizeof(unsigned short)) +
+           ScratchBlockSize((size_t)Height * Stride) + ScratchBlockSize(ocularGetThreadCount() * bufferSize);
+}
+
+// Steps and line buffers of the radial blur grid, once polarBlurGrid() has sized it
+static void radialBlurLayout(PolarBlurParams* p) {
+    p->RayStep = p->PolarChannels;
+    p->RadiusStep = ((size_t)p->Rays + 1) * p->PolarChannels;
+    p->ByRadius = true;
+    p->BufferSize = ((size_t)p->Rays * p->PolarChannels * sizeof(int) + 63) & ~(size_t)63;
+}
+
 OC_STATUS ocularRadialBlur(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int centerX, int centerY, int intensity) {
 
     if (Input == NULL || Output == NULL) {
@@ -1353,7 +1957,7 @@ OC_STATUS ocularRadialBlur(unsigned char* Input, unsigned char* Output, int Widt
     }
 
     int channels = Stride / Width;
-    if (channels != 1 && channels != 3) {
+    if (channels < 1 || channels > 4) {
         return OC_STATUS_ERR_NOTSUPPORTED;
     }
 
@@ -1362,104 +1966,41 @@ OC_STATUS ocularRadialBlur(unsigned char* Input, unsigned char* Output, int Widt
     centerY = clamp(centerY, 0, Height - 1);
     intensity = clamp(intensity, 1, 100);
 
-    // Pre-calculate angle increment and inverse intensity
-    const float angleIncrement = 0.005f;
-    const float invIntensity = 1.0f / intensity;
-
-    // Process image in chunks for better cache utilization
-    const int CHUNK_SIZE = 32;
-
-    if (channels == 1) {
-        for (int blockY = 0; blockY < Height; blockY += CHUNK_SIZE) {
-            for (int blockX = 0; blockX < Width; blockX += CHUNK_SIZE) {
-                int endY = min(blockY + CHUNK_SIZE, Height);
-                int endX = min(blockX + CHUNK_SIZE, Width);
-
-                for (int y = blockY; y < endY; y++) {
-                    unsigned char* pOut = Output + y * Stride;
-
-                    for (int x = blockX; x < endX; x++) {
-                        float dx = (float)(x - centerX);
-                        float dy = (float)(y - centerY);
-                        float distance = sqrtf(dx * dx + dy * dy);
-                        float angle = atan2f(dy, dx);
-
-                        float sum = 0.0f;
-
-                        // Unroll the intensity loop for better performance
-                        for (int n = 0; n < intensity; n += 4) {
-                            // Process 4 samples at once
-                            for (int k = 0; k < 4 && (n + k) < intensity; k++) {
-                                float curAngle = angle + (n + k) * angleIncrement;
-                                float cosAngle = fastCos(curAngle);
-                                float sinAngle = fastSin(curAngle);
-
-                                int newX = (int)(distance * cosAngle + centerX);
-                                int newY = (int)(distance * sinAngle + centerY);
-
-                                // Clamp coordinates
-                                newX = min(Width - 1, max(0, newX));
-                                newY = min(Height - 1, max(0, newY));
-
-                                sum += Input[newY * Stride + newX];
-                            }
-                        }
-
-                        pOut[x] = ClampToByte(sum * invIntensity);
-                    }
-                }
-            }
-        }
+    PolarBlurParams params = { 0 };
+    params.Input = Input;
+    params.Output = Output;
+    params.Width = Width;
+    params.Height = Height;
+    params.Stride = Stride;
+    params.Channels = channels;
+    params.CenterX = centerX;
+    params.CenterY = centerY;
+    params.PolarChannels = channels;
+
+    float* directions = NULL;
+    OC_STATUS status = polarBlurSetup(&params, &directions);
+    if (status != OC_STATUS_OK) {
+        return status;
     }
-    if (channels == 3) {
-        for (int blockY = 0; blockY < Height; blockY += CHUNK_SIZE) {
-            for (int blockX = 0; blockX < Width; blockX += CHUNK_SIZE) {
-                int endY = min(blockY + CHUNK_SIZE, Height);
-                int endX = min(blockX + CHUNK_SIZE, Width);
-
-                float sums[3];
-
-                for (int y = blockY; y < endY; y++) {
-                    unsigned char* pOut = Output + y * Stride;
-
-                    for (int x = blockX; x < endX; x++) {
-                        float dx = (float)(x - centerX);
-                        float dy = (float)(y - centerY);
-                        float distance = sqrtf(dx * dx + dy * dy);
-                        float angle = atan2f(dy, dx);
-
-                        sums[0] = sums[1] = sums[2] = 0.0f;
-
-                        // Unroll the intensity loop
-                        for (int n = 0; n < intensity; n += 4) {
-                            // Process 4 samples at once
-                            for (int k = 0; k < 4 && (n + k) < intensity; k++) {
-                                float curAngle = angle + (n + k) * angleIncrement;
-                                float cosAngle = fastCos(curAngle);
-                                float sinAngle = fastSin(curAngle);
-
-                                int newX = (int)(distance * cosAngle + centerX);
-                                int newY = (int)(distance * sinAngle + centerY);
-
-                                // Clamp coordinates
-                                newX = min(Width - 1, max(0, newX));
-                                newY = min(Height - 1, max(0, newY));
-
-                                const unsigned char* pIn = Input + (newY * Stride + newX * 3);
-                                sums[0] += pIn[0];
-                                sums[1] += pIn[1];
-                                sums[2] += pIn[2];
-                            }
-                        }
+    // Each pixel averages the arc of intensity steps of 0.005 radians that follows it
+    const float angleIncrement = 0.005f;
+    params.Window = (int)((intensity - 1) * angleIncrement * params.Rays / (2.0f * M_PI) + 0.5f) + 1;
+    params.Window = min(params.Window, params.Rays);
+    radialBlurLayout(&params);
 
-                        pOut[x * 3] = ClampToByte(sums[0] * invIntensity);
-                        pOut[x * 3 + 1] = ClampToByte(sums[1] * invIntensity);
-                        pOut[x * 3 + 2] = ClampToByte(sums[2] * invIntensity);
-                    }
-                }
-            }
-        }
-    }
+    status = polarBlurRun(&params, radialBlurRadii, 4);
+    ScratchFree(directions);
+    return status;
+}
 
-    return OC_STATUS_OK;
+size_t radialBlurScratchSize(int Width, int Height, int Stride, int Channels) {
+    // The grid is largest with the center in a corner
+    PolarBlurParams params = { 0 };
+    params.Width = Width;
+    params.Height = Height;
+    params.Stride = Stride;
+    params.PolarChannels = Channels;
+    polarBlurGrid(&params);
+    radialBlurLayout(&params);
+    return polarBlurScratchSize(&params);
 }
\ No newline at end of file
@@ -1,14 +1,18 @@
 #include "core.h"
+#include "image_io.h"
 #include "util.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #ifdef _MSC_VER
 #include <malloc.h>
+#else
+#include <mm_malloc.h>
 #endif
 
-void* AllocMemory(unsigned int Size, bool ZeroMemory) {
-    
+void* AllocMemory(size_t Size, bool ZeroMemory) {
+
     void* ptr = _mm_malloc(Size, 32);
     if (ptr != NULL)
         if (ZeroMemory == true)
@@ -36,30 +40,61 @@ int OC_ELEMENT_SIZE(int Depth) {
     return Size;
 }
 
+size_t OC_LINE_SIZE(int Width, int Channels, int Depth) {
+    if (Depth == OC_DEPTH_1U)
+        return ((size_t)Width + 63) / 64 * 8;
+    return (size_t)Width * Channels * OC_ELEMENT_SIZE(Depth);
+}
+
+// Packed bit images are addressed a word at a time, so they hold a single channel and their rows start on words
+static bool isValidLayout(int Depth, int Channels) {
+    if (Depth == OC_DEPTH_1U)
+        return Channels == 1;
+    return OC_ELEMENT_SIZE(Depth) != 0;
+}
+
 OC_STATUS ocularCreateImage(int Width, int Height, int Depth, int Channels, OcImage** image) {
 
     if (Width < 1 || Height < 1)
         return OC_STATUS_ERR_INVALIDPARAMETER;
     if (Channels != 1 && Channels != 2 && Channels != 3 && Channels != 4)
         return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (!isValidLayout(Depth, Channels))
+        return OC_STATUS_ERR_INVALIDPARAMETER;
     *image = (OcImage*)AllocMemory(sizeof(OcImage), false);
     (*image)->Width = Width;
     (*image)->Height = Height;
     (*image)->Depth = Depth;
     (*image)->Channels = Channels;
-    (*image)->Stride = WIDTHBYTES(Width * Channels * OC_ELEMENT_SIZE(Depth));
-    (*image)->Data = (unsigned char*)AllocMemory((*image)->Height * (*image)->Stride, true);
+    if (Depth == OC_DEPTH_1U)
+        (*image)->Stride = (int)OC_LINE_SIZE(Width, Channels, Depth);
+    else
+        (*image)->Stride = WIDTHBYTES(Width * Channels * OC_ELEMENT_SIZE(Depth));
+    (*image)->Data = (unsigned char*)AllocMemory((size_t)(*image)->Height * (*image)->Stride, true);
     if ((*image)->Data == NULL) {
         FreeMemory(*image);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    (*image)->Reserved = 0;
+    (*image)->Storage = OC_IMAGE_OWNED;
+    (*image)->Mapping = NULL;
+    (*image)->MappingSize = 0;
     return OC_STATUS_OK;
 }
 
 OC_STATUS ocularFreeImage(OcImage** image) {
     if ((*image) == NULL)
         return OC_STATUS_ERR_NULLREFERENCE;
+    if ((*image)->Storage == OC_IMAGE_VIEW) {
+        FreeMemory((*image));
+        *image = NULL;
+        return OC_STATUS_OK;
+    }
+    if ((*image)->Storage == OC_IMAGE_MAPPED) {
+        unmapImageFile((*image)->Mapping, (*image)->MappingSize);
+        FreeMemory((*image));
+        *image = NULL;
+        return OC_STATUS_OK;
+    }
     if ((*image)->Data == NULL) {
         FreeMemory((*image));
         return OC_STATUS_ERR_OUTOFMEMORY;
@@ -77,11 +112,60 @@ OC_STATUS ocularCloneImage(OcImage* Input, OcImage** Output) {
     if (Input->Data == NULL)
         return OC_STATUS_ERR_NULLREFERENCE;
     OC_STATUS ret = ocularCreateImage(Input->Width, Input->Height, Input->Depth, Input->Channels, Output);
-    if (ret == OC_STATUS_OK)
-        memcpy((*Output)->Data, Input->Data, (*Output)->Height * (*Output)->Stride);
+    if (ret != OC_STATUS_OK)
+        return ret;
+    // Views and mapped images have their own stride, so copy row by row unless the layouts match
+    if (Input->Stride == (*Output)->Stride) {
+        memcpy((*Output)->Data, Input->Data, (size_t)(*Output)->Height * (*Output)->Stride);
+    } else {
+        size_t LineSize = OC_LINE_SIZE(Input->Width, Input->Channels, Input->Depth);
+        for (int Y = 0; Y < Input->Height; Y++)
+            memcpy((*Output)->Data + (size_t)Y * (*Output)->Stride, Input->Data + (size_t)Y * Input->Stride, LineSize);
+    }
     return ret;
 }
 
+OC_STATUS ocularCreateImageView(const OcImage* Parent, int X, int Y, int Width, int Height, OcImage** View) {
+    if (Parent == NULL || View == NULL || Parent->Data == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width < 1 || Height < 1)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (X < 0 || Y < 0 || X > Parent->Width - Width || Y > Parent->Height - Height)
+        return OC_STATUS_ERR_INDEXOUTOFRANGE;
+    if (Parent->Depth == OC_DEPTH_1U && X % 64 != 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    unsigned char* Data = Parent->Data + (size_t)Y * Parent->Stride + OC_LINE_SIZE(X, Parent->Channels, Parent->Depth);
+    return ocularWrapImage(Data, Width, Height, Parent->Stride, Parent->Depth, Parent->Channels, View);
+}
+
+OC_STATUS ocularWrapImage(unsigned char* Data, int Width, int Height, int Stride, int Depth, int Channels, OcImage** image) {
+    if (Data == NULL || image == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width < 1 || Height < 1)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (Channels != 1 && Channels != 2 && Channels != 3 && Channels != 4)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (!isValidLayout(Depth, Channels) || Stride < 0 || (size_t)Stride < OC_LINE_SIZE(Width, Channels, Depth))
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (Depth == OC_DEPTH_1U && (Stride % 8 != 0 || (uintptr_t)Data % 8 != 0))
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    *image = (OcImage*)AllocMemory(sizeof(OcImage), false);
+    if (*image == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    (*image)->Width = Width;
+    (*image)->Height = Height;
+    (*image)->Depth = Depth;
+    (*image)->Channels = Channels;
+    (*image)->Stride = Stride;
+    (*image)->Data = Data;
+    (*image)->Storage = OC_IMAGE_VIEW;
+    (*image)->Mapping = NULL;
+    (*image)->MappingSize = 0;
+    return OC_STATUS_OK;
+}
+
 OC_STATUS ocularTransposeImage(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride) {
     int Channels = Stride / Width;
 
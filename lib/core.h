@@ -12,6 +12,7 @@
 #define OCULAR_CORE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct {
     unsigned char R;
@@ -30,6 +31,49 @@ typedef enum {
     OC_EDGE_IGNORE = 4,  // ignore edge pixel
 } OcEdgeMode;
 
+/** @enum OcInterpolationMode
+ * @brief Interpolation method to use for resampling filter
+ */
+typedef enum {
+    OC_INTERPOLATE_NEAREST,
+    OC_INTERPOLATE_BILINEAR, // triangle filter
+    OC_INTERPOLATE_BICUBIC,  // Catmull-Rom cubic
+    OC_INTERPOLATE_LANZCOS,  // Lanczos-3
+    OC_INTERPOLATE_MITCHELL, // Mitchell-Netravali cubic (B = C = 1/3), softer than Catmull-Rom with less ringing
+} OcInterpolationMode;
+
+/**
+ * @struct Parameters for Levels filter
+ * @var levelMinimum color level minimum
+ * @var levelMiddle color scale median
+ * @var levelMaximum maximum value of color scale
+ * @var minOutput minimum output value
+ * @var maxOutput maximum output value
+ * @var Enable Flag used to determine if to apply
+ */
+typedef struct {
+    int levelMinimum;
+    int levelMiddle;
+    int levelMaximum;
+    int minOutput;
+    int maxOutput;
+    bool Enable;
+} ocularLevelParams;
+
+/**
+ * @struct OcThumbnail One output of ocularResamplingThumbnails
+ * @var Data buffer receiving the resampled image
+ * @var Width The width of the thumbnail in pixels
+ * @var Height The height of the thumbnail in pixels
+ * @var Stride The number of bytes in one row of the thumbnail
+ */
+typedef struct {
+    unsigned char* Data;
+    int Width;
+    int Height;
+    int Stride;
+} OcThumbnail;
+
 /**
  * @todo Implement these within the filters
  * @brief Return status codes for filter exported functions
@@ -59,8 +103,19 @@ typedef enum {
     OC_DEPTH_32S = 3, //    int
     OC_DEPTH_32F = 4, //	float
     OC_DEPTH_64F = 5, //	double
+    OC_DEPTH_1U = 6,  //	1 bit, 64 pixels packed per 64-bit word with the leftmost in the lowest bit (see binary.h)
 } OC_BITDEPTH;
 
+/**
+ * @enum OcImageStorage
+ * @brief Where the pixels of an OcImage live, which decides what ocularFreeImage() releases.
+ */
+typedef enum {
+    OC_IMAGE_OWNED = 0,  // allocated with the image and freed with it
+    OC_IMAGE_VIEW = 1,   // borrowed from a parent image or the caller, never freed by the image
+    OC_IMAGE_MAPPED = 2, // a memory-mapped file, unmapped when the image is freed
+} OcImageStorage;
+
 /**
  * @struct OcImage Image data structure
  * @var Width The width of the image
@@ -69,7 +124,9 @@ typedef enum {
  * @var Channels Number of color channels
  * @var Depth The image bit depth data type
  * @var Data image buffer data
- * @var Reserved Reserved use (not yet used)
+ * @var Storage Ownership of Data, one of OcImageStorage
+ * @var Mapping Start of the file mapping for OC_IMAGE_MAPPED images, otherwise NULL
+ * @var MappingSize Size in bytes of the file mapping
  */
 typedef struct {
     int Width;
@@ -78,22 +135,28 @@ typedef struct {
     int Channels;
     int Depth;
     unsigned char* Data;
-    int Reserved;
+    int Storage;
+    void* Mapping;
+    size_t MappingSize;
 } OcImage;
 
 
-void* AllocMemory(unsigned int Size, bool ZeroMemory);
+void* AllocMemory(size_t Size, bool ZeroMemory);
 void FreeMemory(void* ptr);
 
-// Obtain the number of bytes actually occupied by an element based on the type of the OcImage element.
+// Obtain the number of bytes actually occupied by an element based on the type of the OcImage element. 0 for OC_DEPTH_1U,
+// whose elements are smaller than a byte, and for unknown depths.
 int OC_ELEMENT_SIZE(int Depth);
 
+// Obtain the number of bytes the pixels of a row occupy, without padding. Rows of OC_DEPTH_1U images take whole words.
+size_t OC_LINE_SIZE(int Width, int Channels, int Depth);
+
 /**
  * @brief Allocates a new image data structure in memory.
  * @ingroup group_ip_utility
  * @param Width The width of the image.
  * @param Height The height of the image.
- * @param Depth The color depth of the image.
+ * @param Depth The color depth of the image. OC_DEPTH_1U images take 1 channel.
  * @param Channel The number of color channels of the image.
  * @param[out] image The returned image data structure.
  * @return 0 if success, otherwise fail.
@@ -102,6 +165,7 @@ OC_STATUS ocularCreateImage(int Width, int Height, int Depth, int Channel, OcIma
 
 /**
  * @brief Releases a created image data structure from memory.
+ * Views release only the structure, mapped images are unmapped and their file is kept.
  * @ingroup group_ip_utility
  * @param image The image data structure that needs to be released.
  * @return 0 if success, otherwise fail.
@@ -109,7 +173,8 @@ OC_STATUS ocularCreateImage(int Width, int Height, int Depth, int Channel, OcIma
 OC_STATUS ocularFreeImage(OcImage** image);
 
 /**
- * @brief Clone an existing image.
+ * @brief Clone an existing image. The copy always owns its pixels, so cloning a view or a mapped image makes a compact
+ * copy of just its rectangle.
  * @ingroup group_ip_utility
  * @param Input The image data structure to copy.
  * @param[out] Output The returned image data structure. This should be empty and not previously allocated.
@@ -117,6 +182,38 @@ OC_STATUS ocularFreeImage(OcImage** image);
  */
 OC_STATUS ocularCloneImage(OcImage* Input, OcImage** Output);
 
+/**
+ * @brief Creates a view of a rectangle of an image without copying any pixels.
+ * The view shares the pixels and the stride of its parent, so writes through either are seen by both, and the parent
+ * must outlive the view. Views of OC_DEPTH_1U images start on a word, so X must be a multiple of 64. Filters that take
+ * a buffer and derive the channel count from Stride / Width need a compact image; clone the view first, or pass its
+ * Data and Stride to functions taking the channel count separately.
+ * @ingroup group_ip_utility
+ * @param Parent The image to look into. May itself be a view or a mapped image.
+ * @param X The left column of the rectangle.
+ * @param Y The top row of the rectangle.
+ * @param Width The width of the rectangle in pixels.
+ * @param Height The height of the rectangle in pixels.
+ * @param[out] View The returned image data structure, released with ocularFreeImage().
+ * @return OC_STATUS_OK if successful, OC_STATUS_ERR_INDEXOUTOFRANGE if the rectangle does not fit in the parent.
+ */
+OC_STATUS ocularCreateImageView(const OcImage* Parent, int X, int Y, int Width, int Height, OcImage** View);
+
+/**
+ * @brief Wraps caller memory in an image data structure without copying it. The memory is not released by ocularFreeImage().
+ * @ingroup group_ip_utility
+ * @param Data The first pixel of the image.
+ * @param Width The width of the image in pixels.
+ * @param Height The height of the image in pixels.
+ * @param Stride The number of bytes from one row to the next, at least Width * Channels * element size. OC_DEPTH_1U
+ *               images take 1 channel, and Data and Stride must be multiples of 8 bytes.
+ * @param Depth The color depth of the image.
+ * @param Channels The number of color channels of the image.
+ * @param[out] image The returned image data structure.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularWrapImage(unsigned char* Data, int Width, int Height, int Stride, int Depth, int Channels, OcImage** image);
+
 /**
  * @brief Transpose an image by swapping the height and width data.
  * @ingroup group_ip_general
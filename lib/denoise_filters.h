@@ -28,10 +28,13 @@
  * @param Radius Filter radius. Range [1 - 64]
  * @param Epsilon Prevents division by zero and controls the degree of smoothing near edges. Range [0.001 - 0.4]
  *                Smaller values preserve edges better, larger values increase smoothing.
+ * @param Subsample 1 filters at full resolution. Larger values select the fast guided filter, which computes the filter
+ *                  coefficients on an image Subsample times smaller and interpolates them, for a speedup of about
+ *                  Subsample squared. Range [1 - Radius]
  * @return OC_STATUS_OK if successful, otherwise an error code
  */
 OC_STATUS ocularGuidedFilter(unsigned char* Input, unsigned char* Guide, unsigned char* Output, int Width, int Height, 
-                            int Stride, int Radius, float Epsilon);
+                            int Stride, int Radius, float Epsilon, int Subsample);
 
  #endif /* DENOISE_FILTERS_H */
 
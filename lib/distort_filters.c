@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <time.h>
 #include "util.h"
+#include "parallel.h"
+#include "workspace.h"
 
 
 const double ONE_DIV_PI = 1.0 / M_PI;
@@ -67,6 +69,125 @@ static inline float bilinearSample(uint8_t* image, int width, int height,
     return top * (1.0f - fy) + bottom * fy;
 }
 
+// Maps a destination pixel to the source position it samples from.
+// Returns false when the pixel lies outside the effect and is copied unchanged.
+typedef bool (*WarpMapping)(const void* Params, int x, int y, float* sampleX, float* sampleY);
+
+typedef struct {
+    uint8_t* Source;
+    unsigned char* Output;
+    int Width;
+    int Height;
+    int Channels;
+    WarpMapping Mapping;
+    const void* Params;
+} WarpJob;
+
+static void warpRows(void* Context, int Begin, int End, int Thread) {
+    const WarpJob* job = (const WarpJob*)Context;
+    (void)Thread;
+    int width = job->Width;
+    int channels = job->Channels;
+    for (int y = Begin; y < End; y++) {
+        for (int x = 0; x < width; x++) {
+            int dstIdx = (y * width + x) * channels;
+            float srcX, srcY;
+            if (!job->Mapping(job->Params, x, y, &srcX, &srcY)) {
+                for (int c = 0; c < channels; c++) {
+                    job->Output[dstIdx + c] = job->Source[dstIdx + c];
+                }
+                continue;
+            }
+            for (int c = 0; c < channels; c++) {
+                float value = bilinearSample(job->Source, width, job->Height, channels, c, srcX, srcY);
+                job->Output[dstIdx + c] = (unsigned char)clamp(value, 0.0f, 255.0f);
+            }
+        }
+    }
+}
+
+// Runs a coordinate mapping over every pixel of the image, splitting rows across the worker pool.
+// Source must not alias Output.
+static void warpImage(uint8_t* source, unsigned char* output, int width, int height, int channels, WarpMapping mapping,
+                      const void* params) {
+    WarpJob job = { source, output, width, height, channels, mapping, params };
+    ocularParallelFor(height, 4, warpRows, &job);
+}
+
+// Filters that warp in place take a copy of the input
+size_t distortionScratchSize(int Height, int Stride) {
+    return ScratchBlockSize((size_t)Height * Stride);
+}
+
+typedef struct {
+    float centerX;
+    float centerY;
+    float maxRadius;
+    float amount;
+    float strength;
+} PinchParams;
+
+static bool pinchMapping(const void* Params, int x, int y, float* sampleX, float* sampleY) {
+    const PinchParams* p = (const PinchParams*)Params;
+    float centerX = p->centerX;
+    float centerY = p->centerY;
+    float maxRadius = p->maxRadius;
+    float amount = p->amount;
+    float strength = p->strength;
+    
+    // Calculate distance from center
+    float dx = x - centerX;
+    float dy = y - centerY;
+    float distance = sqrtf(dx * dx + dy * dy);
+    
+    // Pixels outside the radius remain untouched
+    if (distance > maxRadius) {
+        return false;
+    }
+    
+    // Source coordinates (where to sample from)
+    float srcX, srcY;
+    
+    if (distance < 0.0001f) {
+        // At the center, no distortion needed
+        srcX = x;
+        srcY = y;
+    } else {
+        // Normalize distance (0 at center, 1 at edge of radius)
+        float normalizedDist = distance / maxRadius;
+        
+        // Apply distortion formula
+        float distortionFactor;
+        
+        if (amount > 0) {
+            // Pinch: use inverse power function to properly stretch edges toward center
+            // normalized^(1/(1+strength)) where strength ∈ [0, 1]
+            // amount = 100 → strength = 1.0 → exponent = 0.5 (square root)
+            // amount = 50  → strength = 0.5 → exponent = 0.667
+            // This creates smooth stretching without tight center compression
+            distortionFactor = powf(normalizedDist, 1.0f / (1.0f + strength));
+        } else {
+            // Bulge: use power function with additive strength
+            // normalized^(1-strength) where strength ∈ [-1, 0]
+            // amount = -100 → strength = -1.0 → exponent = 2.0 (square)
+            // amount = -50  → strength = -0.5 → exponent = 1.5
+            distortionFactor = powf(normalizedDist, 1.0f - strength);
+        }
+        
+        // Calculate new radius (where to sample from)
+        float newRadius = maxRadius * distortionFactor;
+        
+        // Calculate source coordinates
+        float angle = atan2f(dy, dx);
+        srcX = centerX + newRadius * cosf(angle);
+        srcY = centerY + newRadius * sinf(angle);
+    }
+
+    *sampleX = srcX;
+    *sampleY = srcY;
+    return true;
+}
+
 OC_STATUS ocularPinchDistortionFilter(unsigned char* input, unsigned char* output, int width, int height, int stride, float amount) {
     // Validate inputs
     if (input == NULL || output == NULL) {
@@ -108,88 +229,83 @@ OC_STATUS ocularPinchDistortionFilter(unsigned char* input, unsigned char* outpu
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
     // Apply distortion
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int dstIdx = (y * width + x) * channels;
-            
-            // Calculate distance from center
-            float dx = x - centerX;
-            float dy = y - centerY;
-            float distance = sqrtf(dx * dx + dy * dy);
-            
-            // Pixels outside the radius remain untouched
-            if (distance > maxRadius) {
-                for (int c = 0; c < channels; c++) {
-                    output[dstIdx + c] = source[dstIdx + c];
-                }
-                continue;
-            }
-            
-            // Source coordinates (where to sample from)
-            float srcX, srcY;
-            
-            if (distance < 0.0001f) {
-                // At the center, no distortion needed
-                srcX = x;
-                srcY = y;
-            } else {
-                // Normalize distance (0 at center, 1 at edge of radius)
-                float normalizedDist = distance / maxRadius;
-                
-                // Apply distortion formula
-                float distortionFactor;
-                
-                if (amount > 0) {
-                    // Pinch: use inverse power function to properly stretch edges toward center
-                    // normalized^(1/(1+strength)) where strength ∈ [0, 1]
-                    // amount = 100 → strength = 1.0 → exponent = 0.5 (square root)
-                    // amount = 50  → strength = 0.5 → exponent = 0.667
-                    // This creates smooth stretching without tight center compression
-                    distortionFactor = powf(normalizedDist, 1.0f / (1.0f + strength));
-                } else {
-                    // Bulge: use power function with additive strength
-                    // normalized^(1-strength) where strength ∈ [-1, 0]
-                    // amount = -100 → strength = -1.0 → exponent = 2.0 (square)
-                    // amount = -50  → strength = -0.5 → exponent = 1.5
-                    distortionFactor = powf(normalizedDist, 1.0f - strength);
-                }
-                
-                // Calculate new radius (where to sample from)
-                float newRadius = maxRadius * distortionFactor;
-                
-                // Calculate source coordinates
-                float angle = atan2f(dy, dx);
-                srcX = centerX + newRadius * cosf(angle);
-                srcY = centerY + newRadius * sinf(angle);
-            }
-            
-            // Sample from source image using bilinear interpolation
-            // Clamp remapped coordinates to valid bounds,
-            // then bilinearly interpolate. This keeps the outer border intact with no holes.
-            for (int c = 0; c < channels; c++) {
-                float value = bilinearSample(source, width, height, channels, c, srcX, srcY);
-                output[dstIdx + c] = (unsigned char)clamp(value, 0.0f, 255.0f);
-            }
-        }
-    }
+    PinchParams params = { centerX, centerY, maxRadius, amount, strength };
+    warpImage(source, output, width, height, channels, pinchMapping, &params);
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     return OC_STATUS_OK;
 }
 
+typedef struct {
+    float centerX;
+    float centerY;
+    float maxRadius;
+    float angleRad;
+} TwirlParams;
+
+static bool twirlMapping(const void* Params, int x, int y, float* sampleX, float* sampleY) {
+    const TwirlParams* p = (const TwirlParams*)Params;
+    float centerX = p->centerX;
+    float centerY = p->centerY;
+    float maxRadius = p->maxRadius;
+    float angleRad = p->angleRad;
+    
+    // Calculate distance from center
+    float dx = x - centerX;
+    float dy = y - centerY;
+    float distance = sqrtf(dx * dx + dy * dy);
+    
+    // Pixels outside the radius remain untouched
+    if (distance > maxRadius) {
+        return false;
+    }
+    
+    // Source coordinates (where to sample from)
+    float srcX, srcY;
+    
+    if (distance < 0.0001f) {
+        // At the center, no rotation needed (or would be undefined)
+        srcX = x;
+        srcY = y;
+    } else {
+        // Normalize distance (0 at center, 1 at edge)
+        float normalizedDist = distance / maxRadius;
+        
+        // Calculate rotation amount that decreases from center to edge
+        // Using quadratic falloff for smoother result
+        float falloff = 1.0f - normalizedDist;
+        falloff = falloff * falloff;  // Square for smoother falloff
+        float rotationAmount = angleRad * falloff;
+        
+        // Get current angle from center
+        float currentAngle = atan2f(dy, dx);
+        
+        // Apply rotation
+        float newAngle = currentAngle - rotationAmount;
+        
+        // Calculate source coordinates using rotated angle
+        srcX = centerX + distance * cosf(newAngle);
+        srcY = centerY + distance * sinf(newAngle);
+    }
+
+    *sampleX = srcX;
+    *sampleY = srcY;
+    return true;
+}
+
 OC_STATUS ocularTwirlDistortionFilter(unsigned char* input, unsigned char* output,
                                       int width, int height, int stride,
                                       float angle) {
@@ -227,76 +343,99 @@ OC_STATUS ocularTwirlDistortionFilter(unsigned char* input, unsigned char* outpu
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
     // Apply twirl distortion
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int dstIdx = (y * width + x) * channels;
-            
-            // Calculate distance from center
-            float dx = x - centerX;
-            float dy = y - centerY;
-            float distance = sqrtf(dx * dx + dy * dy);
-            
-            // Pixels outside the radius remain untouched
-            if (distance > maxRadius) {
-                for (int c = 0; c < channels; c++) {
-                    output[dstIdx + c] = source[dstIdx + c];
-                }
-                continue;
-            }
-            
-            // Source coordinates (where to sample from)
-            float srcX, srcY;
-            
-            if (distance < 0.0001f) {
-                // At the center, no rotation needed (or would be undefined)
-                srcX = x;
-                srcY = y;
-            } else {
-                // Normalize distance (0 at center, 1 at edge)
-                float normalizedDist = distance / maxRadius;
-                
-                // Calculate rotation amount that decreases from center to edge
-                // Using quadratic falloff for smoother result
-                float falloff = 1.0f - normalizedDist;
-                falloff = falloff * falloff;  // Square for smoother falloff
-                float rotationAmount = angleRad * falloff;
-                
-                // Get current angle from center
-                float currentAngle = atan2f(dy, dx);
-                
-                // Apply rotation
-                float newAngle = currentAngle - rotationAmount;
-                
-                // Calculate source coordinates using rotated angle
-                srcX = centerX + distance * cosf(newAngle);
-                srcY = centerY + distance * sinf(newAngle);
-            }
-            
-            // Sample from source image using bilinear interpolation
-            for (int c = 0; c < channels; c++) {
-                float value = bilinearSample(source, width, height, channels, c, srcX, srcY);
-                output[dstIdx + c] = (unsigned char)clamp(value, 0.0f, 255.0f);
-            }
-        }
-    }
+    TwirlParams params = { centerX, centerY, maxRadius, angleRad };
+    warpImage(source, output, width, height, channels, twirlMapping, &params);
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     return OC_STATUS_OK;
 }
 
+typedef struct {
+    float centerPixelX;
+    float centerPixelY;
+    float effectRadius;
+    float wavelength;
+    float amplitude;
+    float phaseRadians;
+} RippleParams;
+
+static bool rippleMapping(const void* Params, int x, int y, float* sampleX, float* sampleY) {
+    const RippleParams* p = (const RippleParams*)Params;
+    float centerPixelX = p->centerPixelX;
+    float centerPixelY = p->centerPixelY;
+    float effectRadius = p->effectRadius;
+    float wavelength = p->wavelength;
+    float amplitude = p->amplitude;
+    float phaseRadians = p->phaseRadians;
+    
+    // Calculate distance from center
+    float dx = x - centerPixelX;
+    float dy = y - centerPixelY;
+    float distance = sqrtf(dx * dx + dy * dy);
+    
+    // Calculate smooth falloff factor
+    float falloffFactor = 1.0f;
+    if (distance > effectRadius * 0.9f) {
+        // Start fading out at 90% of effect radius
+        float fadeStart = effectRadius * 0.9f;
+        float fadeEnd = effectRadius;
+        if (distance < fadeEnd) {
+            float fadeProgress = (distance - fadeStart) / (fadeEnd - fadeStart);
+            // Smooth falloff using smoothstep function
+            falloffFactor = 1.0f - (fadeProgress * fadeProgress * (3.0f - 2.0f * fadeProgress));
+        } else {
+            // Beyond effect radius, no effect
+            falloffFactor = 0.0f;
+        }
+    }
+    
+    // If falloff factor is zero, just copy original pixel
+    if (falloffFactor <= 0.0f) {
+        return false;
+    }
+    
+    // Source coordinates (where to sample from)
+    float srcX, srcY;
+    
+    if (distance < 0.0001f) {
+        // At the center, no distortion needed
+        srcX = x;
+        srcY = y;
+    } else {
+        // Calculate ripple displacement using sine wave
+        // The wave propagates radially outward from the center
+        float wavePhase = (distance / wavelength) * 2.0f * M_PI + phaseRadians;
+        float displacement = sinf(wavePhase) * amplitude * falloffFactor;
+        
+        // Apply displacement in radial direction (toward/away from center)
+        // Normalize the direction vector
+        float nx = dx / distance;  // Normal x (radial direction)
+        float ny = dy / distance;  // Normal y (radial direction)
+        
+        // Apply radial displacement
+        // Positive displacement moves away from center, negative moves toward center
+        srcX = x + nx * displacement;
+        srcY = y + ny * displacement;
+    }
+
+    *sampleX = srcX;
+    *sampleY = srcY;
+    return true;
+}
+
 OC_STATUS ocularRippleDistortionFilter(unsigned char* input, unsigned char* output,
                                        int width, int height, int stride,
                                        float wavelength, float amplitude,
@@ -358,86 +497,188 @@ OC_STATUS ocularRippleDistortionFilter(unsigned char* input, unsigned char* outp
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
     // Apply ripple distortion
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int dstIdx = (y * width + x) * channels;
+    RippleParams params = { centerPixelX, centerPixelY, effectRadius, wavelength, amplitude, phaseRadians };
+    warpImage(source, output, width, height, channels, rippleMapping, &params);
+    
+    // Free temporary buffer if allocated
+    if (tempBuffer != NULL) {
+        ScratchFree(tempBuffer);
+    }
+    
+    return OC_STATUS_OK;
+}
+
+typedef struct {
+    float centerX;
+    float centerY;
+    float normRadiusX;
+    float normRadiusY;
+    float strength;
+    OcSpherizeMode mode;
+} SpherizeParams;
+
+static bool spherizeMapping(const void* Params, int x, int y, float* sampleX, float* sampleY) {
+    const SpherizeParams* p = (const SpherizeParams*)Params;
+    float centerX = p->centerX;
+    float centerY = p->centerY;
+    float normRadiusX = p->normRadiusX;
+    float normRadiusY = p->normRadiusY;
+    float strength = p->strength;
+    OcSpherizeMode mode = p->mode;
+    
+    // Calculate normalized coordinates [-1, 1] range
+    float normX = (x - centerX) / normRadiusX;
+    float normY = (y - centerY) / normRadiusY;
+    
+    // Source coordinates (where to sample from)
+    float srcX, srcY;
+    
+    // Apply spherize transformation based on mode
+    switch (mode) {
+        case OC_SPHERIZE_NORMAL: {
+            // Full spherical distortion (both axes)
+            float r2 = normX * normX + normY * normY;
             
-            // Calculate distance from center
-            float dx = x - centerPixelX;
-            float dy = y - centerPixelY;
-            float distance = sqrtf(dx * dx + dy * dy);
+            if (r2 > 1.0f) {
+                // Outside the unit circle - copy unchanged
+                return false;
+            }
             
-            // Calculate smooth falloff factor
-            float falloffFactor = 1.0f;
-            if (distance > effectRadius * 0.9f) {
-                // Start fading out at 90% of effect radius
-                float fadeStart = effectRadius * 0.9f;
-                float fadeEnd = effectRadius;
-                if (distance < fadeEnd) {
-                    float fadeProgress = (distance - fadeStart) / (fadeEnd - fadeStart);
-                    // Smooth falloff using smoothstep function
-                    falloffFactor = 1.0f - (fadeProgress * fadeProgress * (3.0f - 2.0f * fadeProgress));
+            if (r2 < 0.0001f) {
+                // At center, no distortion
+                srcX = x;
+                srcY = y;
+            } else {
+                // Apply spherical projection using proper sphere mapping
+                float r = sqrtf(r2);  // Current radius [0, 1]
+                
+                // Calculate source radius using spherical projection formula
+                float srcRadius;
+                if (strength > 0) {
+                    // Convex (bulge out) - map to sphere surface
+                    // Use arcsine projection: compresses edges toward center
+                    float angle = asinf(r);  // r is already [0,1]
+                    srcRadius = angle / (M_PI / 2.0f);
+                    // Blend with original based on strength
+                    srcRadius = r * (1.0f - strength) + srcRadius * strength;
                 } else {
-                    // Beyond effect radius, no effect
-                    falloffFactor = 0.0f;
+                    // Concave (pinch in) - inverse projection
+                    // Use sine projection: expands edges outward
+                    float angle = r * M_PI / 2.0f;  // Map [0,1] to [0, π/2]
+                    srcRadius = sinf(angle);
+                    // Blend with original based on strength
+                    srcRadius = r * (1.0f - fabsf(strength)) + srcRadius * fabsf(strength);
                 }
+                
+                // Calculate scale factor (how much to scale the radius)
+                float scale = srcRadius / r;
+                
+                // Apply scale to normalized coordinates
+                normX *= scale;
+                normY *= scale;
+                
+                // Convert back to pixel coordinates using separate radii
+                srcX = normX * normRadiusX + centerX;
+                srcY = normY * normRadiusY + centerY;
             }
+            break;
+        }
             
-            // If falloff factor is zero, just copy original pixel
-            if (falloffFactor <= 0.0f) {
-                for (int c = 0; c < channels; c++) {
-                    output[dstIdx + c] = source[dstIdx + c];
-                }
-                continue;
-            }
+        case OC_SPHERIZE_HORIZONTAL: {
+            // Horizontal cylindrical distortion
+            float absX = fabsf(normX);
             
-            // Source coordinates (where to sample from)
-            float srcX, srcY;
+            if (absX > 1.0f) {
+                // Outside valid range - copy unchanged
+                return false;
+            }
             
-            if (distance < 0.0001f) {
-                // At the center, no distortion needed
+            if (absX < 0.0001f) {
                 srcX = x;
                 srcY = y;
             } else {
-                // Calculate ripple displacement using sine wave
-                // The wave propagates radially outward from the center
-                float wavePhase = (distance / wavelength) * 2.0f * M_PI + phaseRadians;
-                float displacement = sinf(wavePhase) * amplitude * falloffFactor;
+                // Apply cylindrical projection along X axis
+                float srcAbsX;
+                if (strength > 0) {
+                    // Convex (bulge out)
+                    float angle = asinf(absX);
+                    srcAbsX = angle / (M_PI / 2.0f);
+                    srcAbsX = absX * (1.0f - strength) + srcAbsX * strength;
+                } else {
+                    // Concave (pinch in)
+                    float angle = absX * M_PI / 2.0f;
+                    srcAbsX = sinf(angle);
+                    srcAbsX = absX * (1.0f - fabsf(strength)) + srcAbsX * fabsf(strength);
+                }
                 
-                // Apply displacement in radial direction (toward/away from center)
-                // Normalize the direction vector
-                float nx = dx / distance;  // Normal x (radial direction)
-                float ny = dy / distance;  // Normal y (radial direction)
+                // Calculate scale and preserve sign
+                float scale = srcAbsX / absX;
+                normX *= scale;
                 
-                // Apply radial displacement
-                // Positive displacement moves away from center, negative moves toward center
-                srcX = x + nx * displacement;
-                srcY = y + ny * displacement;
+                // Convert back to pixel coordinates
+                srcX = normX * normRadiusX + centerX;
+                srcY = y;  // Y coordinate unchanged
             }
+            break;
+        }
             
-            // Sample from source image using bilinear interpolation
-            for (int c = 0; c < channels; c++) {
-                float value = bilinearSample(source, width, height, channels, c, srcX, srcY);
-                output[dstIdx + c] = (unsigned char)clamp(value, 0.0f, 255.0f);
+        case OC_SPHERIZE_VERTICAL: {
+            // Vertical cylindrical distortion
+            float absY = fabsf(normY);
+            
+            if (absY > 1.0f) {
+                // Outside valid range - copy unchanged
+                return false;
             }
+            
+            if (absY < 0.0001f) {
+                srcX = x;
+                srcY = y;
+            } else {
+                // Apply cylindrical projection along Y axis
+                float srcAbsY;
+                if (strength > 0) {
+                    // Convex (bulge out)
+                    float angle = asinf(absY);
+                    srcAbsY = angle / (M_PI / 2.0f);
+                    srcAbsY = absY * (1.0f - strength) + srcAbsY * strength;
+                } else {
+                    // Concave (pinch in)
+                    float angle = absY * M_PI / 2.0f;
+                    srcAbsY = sinf(angle);
+                    srcAbsY = absY * (1.0f - fabsf(strength)) + srcAbsY * fabsf(strength);
+                }
+                
+                // Calculate scale and preserve sign
+                float scale = srcAbsY / absY;
+                normY *= scale;
+                
+                // Convert back to pixel coordinates
+                srcX = x;  // X coordinate unchanged
+                srcY = normY * normRadiusY + centerY;
+            }
+            break;
         }
+            
+        default:
+            // No distortion
+            srcX = x;
+            srcY = y;
+            break;
     }
-    
-    // Free temporary buffer if allocated
-    if (tempBuffer != NULL) {
-        free(tempBuffer);
-    }
-    
-    return OC_STATUS_OK;
+
+    *sampleX = srcX;
+    *sampleY = srcY;
+    return true;
 }
 
 OC_STATUS ocularSpherizeDistortionFilter(unsigned char* input, unsigned char* output,
@@ -474,11 +715,11 @@ OC_STATUS ocularSpherizeDistortionFilter(unsigned char* input, unsigned char* ou
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
@@ -507,171 +748,12 @@ OC_STATUS ocularSpherizeDistortionFilter(unsigned char* input, unsigned char* ou
     }
     
     // Apply spherize distortion
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int dstIdx = (y * width + x) * channels;
-            
-            // Calculate normalized coordinates [-1, 1] range
-            float normX = (x - centerX) / normRadiusX;
-            float normY = (y - centerY) / normRadiusY;
-            
-            // Source coordinates (where to sample from)
-            float srcX, srcY;
-            
-            // Apply spherize transformation based on mode
-            switch (mode) {
-                case OC_SPHERIZE_NORMAL: {
-                    // Full spherical distortion (both axes)
-                    float r2 = normX * normX + normY * normY;
-                    
-                    if (r2 > 1.0f) {
-                        // Outside the unit circle - copy unchanged
-                        for (int c = 0; c < channels; c++) {
-                            output[dstIdx + c] = source[dstIdx + c];
-                        }
-                        continue;
-                    }
-                    
-                    if (r2 < 0.0001f) {
-                        // At center, no distortion
-                        srcX = x;
-                        srcY = y;
-                    } else {
-                        // Apply spherical projection using proper sphere mapping
-                        float r = sqrtf(r2);  // Current radius [0, 1]
-                        
-                        // Calculate source radius using spherical projection formula
-                        float srcRadius;
-                        if (strength > 0) {
-                            // Convex (bulge out) - map to sphere surface
-                            // Use arcsine projection: compresses edges toward center
-                            float angle = asinf(r);  // r is already [0,1]
-                            srcRadius = angle / (M_PI / 2.0f);
-                            // Blend with original based on strength
-                            srcRadius = r * (1.0f - strength) + srcRadius * strength;
-                        } else {
-                            // Concave (pinch in) - inverse projection
-                            // Use sine projection: expands edges outward
-                            float angle = r * M_PI / 2.0f;  // Map [0,1] to [0, π/2]
-                            srcRadius = sinf(angle);
-                            // Blend with original based on strength
-                            srcRadius = r * (1.0f - fabsf(strength)) + srcRadius * fabsf(strength);
-                        }
-                        
-                        // Calculate scale factor (how much to scale the radius)
-                        float scale = srcRadius / r;
-                        
-                        // Apply scale to normalized coordinates
-                        normX *= scale;
-                        normY *= scale;
-                        
-                        // Convert back to pixel coordinates using separate radii
-                        srcX = normX * normRadiusX + centerX;
-                        srcY = normY * normRadiusY + centerY;
-                    }
-                    break;
-                }
-                    
-                case OC_SPHERIZE_HORIZONTAL: {
-                    // Horizontal cylindrical distortion
-                    float absX = fabsf(normX);
-                    
-                    if (absX > 1.0f) {
-                        // Outside valid range - copy unchanged
-                        for (int c = 0; c < channels; c++) {
-                            output[dstIdx + c] = source[dstIdx + c];
-                        }
-                        continue;
-                    }
-                    
-                    if (absX < 0.0001f) {
-                        srcX = x;
-                        srcY = y;
-                    } else {
-                        // Apply cylindrical projection along X axis
-                        float srcAbsX;
-                        if (strength > 0) {
-                            // Convex (bulge out)
-                            float angle = asinf(absX);
-                            srcAbsX = angle / (M_PI / 2.0f);
-                            srcAbsX = absX * (1.0f - strength) + srcAbsX * strength;
-                        } else {
-                            // Concave (pinch in)
-                            float angle = absX * M_PI / 2.0f;
-                            srcAbsX = sinf(angle);
-                            srcAbsX = absX * (1.0f - fabsf(strength)) + srcAbsX * fabsf(strength);
-                        }
-                        
-                        // Calculate scale and preserve sign
-                        float scale = srcAbsX / absX;
-                        normX *= scale;
-                        
-                        // Convert back to pixel coordinates
-                        srcX = normX * normRadiusX + centerX;
-                        srcY = y;  // Y coordinate unchanged
-                    }
-                    break;
-                }
-                    
-                case OC_SPHERIZE_VERTICAL: {
-                    // Vertical cylindrical distortion
-                    float absY = fabsf(normY);
-                    
-                    if (absY > 1.0f) {
-                        // Outside valid range - copy unchanged
-                        for (int c = 0; c < channels; c++) {
-                            output[dstIdx + c] = source[dstIdx + c];
-                        }
-                        continue;
-                    }
-                    
-                    if (absY < 0.0001f) {
-                        srcX = x;
-                        srcY = y;
-                    } else {
-                        // Apply cylindrical projection along Y axis
-                        float srcAbsY;
-                        if (strength > 0) {
-                            // Convex (bulge out)
-                            float angle = asinf(absY);
-                            srcAbsY = angle / (M_PI / 2.0f);
-                            srcAbsY = absY * (1.0f - strength) + srcAbsY * strength;
-                        } else {
-                            // Concave (pinch in)
-                            float angle = absY * M_PI / 2.0f;
-                            srcAbsY = sinf(angle);
-                            srcAbsY = absY * (1.0f - fabsf(strength)) + srcAbsY * fabsf(strength);
-                        }
-                        
-                        // Calculate scale and preserve sign
-                        float scale = srcAbsY / absY;
-                        normY *= scale;
-                        
-                        // Convert back to pixel coordinates
-                        srcX = x;  // X coordinate unchanged
-                        srcY = normY * normRadiusY + centerY;
-                    }
-                    break;
-                }
-                    
-                default:
-                    // No distortion
-                    srcX = x;
-                    srcY = y;
-                    break;
-            }
-            
-            // Sample from source image using bilinear interpolation
-            for (int c = 0; c < channels; c++) {
-                float value = bilinearSample(source, width, height, channels, c, srcX, srcY);
-                output[dstIdx + c] = (unsigned char)clamp(value, 0.0f, 255.0f);
-            }
-        }
-    }
+    SpherizeParams params = { centerX, centerY, normRadiusX, normRadiusY, strength, mode };
+    warpImage(source, output, width, height, channels, spherizeMapping, &params);
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     return OC_STATUS_OK;
@@ -704,11 +786,11 @@ OC_STATUS ocularPolarCoordinatesFilter(unsigned char* input, unsigned char* outp
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
@@ -794,7 +876,7 @@ OC_STATUS ocularPolarCoordinatesFilter(unsigned char* input, unsigned char* outp
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     return OC_STATUS_OK;
@@ -904,7 +986,7 @@ OC_STATUS ocularWaveDistortionFilter(unsigned char* input, unsigned char* output
     wave_srand(seed);
     
     // Allocate wave generators
-    WaveGenerator* generators = (WaveGenerator*)malloc(sizeof(WaveGenerator) * numGenerators);
+    WaveGenerator* generators = (WaveGenerator*)ScratchAlloc(sizeof(WaveGenerator) * numGenerators, false);
     if (generators == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
@@ -941,12 +1023,12 @@ OC_STATUS ocularWaveDistortionFilter(unsigned char* input, unsigned char* output
     uint8_t* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (uint8_t*)malloc(height * stride);
+        tempBuffer = (uint8_t*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
-            free(generators);
+            ScratchFree(generators);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
@@ -993,15 +1075,20 @@ OC_STATUS ocularWaveDistortionFilter(unsigned char* input, unsigned char* output
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     // Free generators
-    free(generators);
+    ScratchFree(generators);
     
     return OC_STATUS_OK;
 }
 
+size_t waveDistortionScratchSize(int Height, int Stride) {
+    // Up to 100 generators
+    return ScratchBlockSize(100 * sizeof(WaveGenerator)) + distortionScratchSize(Height, Stride);
+}
+
 OC_STATUS ocularKaleidoscopeFilter(unsigned char* input, unsigned char* output,
                                    int width, int height, int stride,
                                    int mirrors, float angle, float angle2,
@@ -1042,11 +1129,11 @@ OC_STATUS ocularKaleidoscopeFilter(unsigned char* input, unsigned char* output,
     unsigned char* tempBuffer = NULL;
     
     if (input == output) {
-        tempBuffer = (unsigned char*)malloc(height * stride);
+        tempBuffer = (unsigned char*)ScratchAlloc((size_t)height * stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, input, height * stride);
+        memcpy(tempBuffer, input, (size_t)height * stride);
         source = tempBuffer;
     }
     
@@ -1103,7 +1190,7 @@ OC_STATUS ocularKaleidoscopeFilter(unsigned char* input, unsigned char* output,
     
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
     
     return OC_STATUS_OK;
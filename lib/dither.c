@@ -1,6 +1,9 @@
 #include "dither.h"
 #include "color.h"
 #include "util.h"
+#include "parallel.h"
+#include "workspace.h"
+#include <limits.h>
 
 // Define dithering matrices
 static const DitherMatrix BURKES_MATRIX = {
@@ -154,192 +157,270 @@ static const OrderedDitherMatrix BAYER_8X8_MATRIX = {
 
 /* Palette mapping  -------------------------------------------------*/
 
-// Calculate Euclidean distance between two colors
-static inline float colorDistance(OcColor* c1, OcColor* c2) {
-    float dr = c1->R - c2->R;
-    float dg = c1->G - c2->G;
-    float db = c1->B - c2->B;
-    return dr * dr + dg * dg + db * db;
-}
-
-// Compare colors for qsort based on current axis
-static inline int compareColors(const void* a, const void* b, int axis) {
-    OcColor* c1 = (OcColor*)a;
-    OcColor* c2 = (OcColor*)b;
-
-    switch (axis) {
-    case 0: return c1->R - c2->R;
-    case 1: return c1->G - c2->G;
-    case 2: return c1->B - c2->B;
+// The color cube is split into LOOKUP_CELLS^3 cells of (256 / LOOKUP_CELLS)^3 colors each
+#define LOOKUP_BITS 5
+#define LOOKUP_CELLS (1 << LOOKUP_BITS)
+#define LOOKUP_SHIFT (8 - LOOKUP_BITS)
+// Cells per axis in the coarse blocks the candidate search starts from
+#define LOOKUP_BLOCK_CELLS 4
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define OcAtomicExchangePointer(p, v) _InterlockedExchangePointer((void* volatile*)(p), (v))
+#else
+    #define OcAtomicExchangePointer(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
+// Inverse colormap: for every cell either the one palette color nearest to all of it, or the short list of colors that can be
+// nearest to some point in it, which is searched exactly per pixel.
+typedef struct {
+    int numColors;
+    unsigned char* colors;       // RGB triplets
+    int cells[LOOKUP_CELLS * LOOKUP_CELLS * LOOKUP_CELLS]; // >= 0: nearest color, < 0: -(offset + 1) into candidates
+    unsigned short* candidates;  // lists of a count followed by that many color indices, in palette order
+    int candidateSize;
+    int candidateCapacity;
+} PaletteLookup;
+
+// Most recently used lookup, shared by all threads. A thread takes it out while using it, so no lock is needed.
+static PaletteLookup* cachedLookup = NULL;
+
+static void freePaletteLookup(PaletteLookup* lookup) {
+    if (lookup) {
+        free(lookup->colors);
+        free(lookup->candidates);
+        free(lookup);
     }
-    return 0;
 }
 
-// Sort colors along a given axis
-static void qsortColors(OcColor* colors, int numColors, int axis) {
-    if (numColors <= 1)
-        return;
-
-    // Simple partition implementation
-    OcColor pivot = colors[numColors / 2];
-    int i = 0;
-    int j = numColors - 1;
-
-    while (i <= j) {
-        while (compareColors(&colors[i], &pivot, axis) < 0)
-            i++;
-        while (compareColors(&colors[j], &pivot, axis) > 0)
-            j--;
-
-        if (i <= j) {
-            OcColor temp = colors[i];
-            colors[i] = colors[j];
-            colors[j] = temp;
-            i++;
-            j--;
+// Collects, in order, the colors of In that are nearest to at least one point of the box [Lo, Hi]: a color qualifies unless
+// its distance to the box exceeds the largest distance from the box to some other color.
+static int boxCandidates(const unsigned char* colors, const unsigned short* In, int count, const int Lo[3], const int Hi[3],
+                         unsigned short* Out) {
+    int limit = INT_MAX;
+    for (int i = 0; i < count; i++) {
+        const unsigned char* c = colors + In[i] * 3;
+        int far = 0;
+        for (int k = 0; k < 3; k++) {
+            int d = max(c[k] - Lo[k], Hi[k] - c[k]);
+            far += d * d;
         }
+        limit = min(limit, far);
     }
 
-    if (j > 0)
-        qsortColors(colors, j + 1, axis);
-    if (i < numColors)
-        qsortColors(colors + i, numColors - i, axis);
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const unsigned char* c = colors + In[i] * 3;
+        int near = 0;
+        for (int k = 0; k < 3; k++) {
+            int d = (c[k] < Lo[k]) ? Lo[k] - c[k] : (c[k] > Hi[k]) ? c[k] - Hi[k] : 0;
+            near += d * d;
+        }
+        if (near <= limit)
+            Out[n++] = In[i];
+    }
+    return n;
 }
 
-// Build k-d tree from array of colors
-static KDNode* buildKDTree(OcColor* colors, int numColors) {
-    if (numColors == 0)
+static PaletteLookup* createPaletteLookup(const OcPalette* palette) {
+    PaletteLookup* lookup = (PaletteLookup*)calloc(1, sizeof(PaletteLookup));
+    unsigned short* all = (unsigned short*)malloc(palette->num_colors * sizeof(unsigned short));
+    unsigned short* blockList = (unsigned short*)malloc(palette->num_colors * sizeof(unsigned short));
+    unsigned short* cellList = (unsigned short*)malloc(palette->num_colors * sizeof(unsigned short));
+    if (lookup == NULL || all == NULL || blockList == NULL || cellList == NULL) {
+        free(lookup);
+        free(all);
+        free(blockList);
+        free(cellList);
         return NULL;
-
-    KDNode* node = (KDNode*)malloc(sizeof(KDNode));
-    node->depth = 0;
-
-    // Sort colors based on current axis (R->G->B)
-    int axis = node->depth % 3;
-    qsortColors(colors, numColors, axis);
-
-    // Find median
-    int medianIdx = numColors / 2;
-    node->color = &colors[medianIdx];
-
-    // Recursively build left and right subtrees
-    node->left = buildKDTree(colors, medianIdx);
-    if (node->left)
-        node->left->depth = node->depth + 1;
-
-    node->right = buildKDTree(colors + medianIdx + 1, numColors - medianIdx - 1);
-    if (node->right)
-        node->right->depth = node->depth + 1;
-
-    return node;
-}
-
-// Recursively search for nearest neighbor in k-d tree
-static void searchNearest(KDNode* node, OcColor* target, OcColor** best, float* bestDist) {
-    if (!node)
-        return;
-
-    float dist = colorDistance(target, node->color);
-    if (dist < *bestDist) {
-        *bestDist = dist;
-        *best = node->color;
     }
 
-    int axis = node->depth % 3;
-    int diff;
-    switch (axis) {
-    case 0: diff = target->R - node->color->R; break;
-    case 1: diff = target->G - node->color->G; break;
-    case 2: diff = target->B - node->color->B; break;
+    lookup->numColors = palette->num_colors;
+    lookup->colors = (unsigned char*)malloc(palette->num_colors * 3);
+    lookup->candidateCapacity = 4096;
+    lookup->candidates = (unsigned short*)malloc(lookup->candidateCapacity * sizeof(unsigned short));
+    bool ok = lookup->colors != NULL && lookup->candidates != NULL;
+    for (int i = 0; ok && i < palette->num_colors; i++) {
+        lookup->colors[i * 3] = ClampToByte(palette->colors[i].r);
+        lookup->colors[i * 3 + 1] = ClampToByte(palette->colors[i].g);
+        lookup->colors[i * 3 + 2] = ClampToByte(palette->colors[i].b);
+        all[i] = (unsigned short)i;
     }
 
-    KDNode* first = diff < 0 ? node->left : node->right;
-    KDNode* second = diff < 0 ? node->right : node->left;
+    // Candidates of a cell are a subset of those of any box containing it, so each coarse block's list seeds its cells
+    const int blockSize = LOOKUP_BLOCK_CELLS << LOOKUP_SHIFT;
+    const int cellSize = 1 << LOOKUP_SHIFT;
+    for (int block = 0; ok && block < 256 / blockSize * (256 / blockSize) * (256 / blockSize); block++) {
+        int blockCoord[3] = { block / (256 / blockSize) / (256 / blockSize), block / (256 / blockSize) % (256 / blockSize),
+                              block % (256 / blockSize) };
+        int Lo[3], Hi[3];
+        for (int k = 0; k < 3; k++) {
+            Lo[k] = blockCoord[k] * blockSize;
+            Hi[k] = Lo[k] + blockSize - 1;
+        }
+        int blockCount = boxCandidates(lookup->colors, all, palette->num_colors, Lo, Hi, blockList);
+
+        for (int cell = 0; ok && cell < LOOKUP_BLOCK_CELLS * LOOKUP_BLOCK_CELLS * LOOKUP_BLOCK_CELLS; cell++) {
+            int cellCoord[3] = { blockCoord[0] * LOOKUP_BLOCK_CELLS + cell / (LOOKUP_BLOCK_CELLS * LOOKUP_BLOCK_CELLS),
+                                 blockCoord[1] * LOOKUP_BLOCK_CELLS + cell / LOOKUP_BLOCK_CELLS % LOOKUP_BLOCK_CELLS,
+                                 blockCoord[2] * LOOKUP_BLOCK_CELLS + cell % LOOKUP_BLOCK_CELLS };
+            for (int k = 0; k < 3; k++) {
+                Lo[k] = cellCoord[k] * cellSize;
+                Hi[k] = Lo[k] + cellSize - 1;
+            }
+            int count = boxCandidates(lookup->colors, blockList, blockCount, Lo, Hi, cellList);
+            int index = (cellCoord[0] << (2 * LOOKUP_BITS)) | (cellCoord[1] << LOOKUP_BITS) | cellCoord[2];
+            if (count == 1) {
+                lookup->cells[index] = cellList[0];
+                continue;
+            }
 
-    searchNearest(first, target, best, bestDist);
+            if (lookup->candidateSize + count + 1 > lookup->candidateCapacity) {
+                lookup->candidateCapacity = 2 * (lookup->candidateSize + count + 1);
+                unsigned short* grown = (unsigned short*)realloc(lookup->candidates, lookup->candidateCapacity * sizeof(unsigned short));
+                if (grown == NULL) {
+                    ok = false;
+                    break;
+                }
+                lookup->candidates = grown;
+            }
+            lookup->cells[index] = -(lookup->candidateSize + 1);
+            lookup->candidates[lookup->candidateSize++] = (unsigned short)count;
+            memcpy(lookup->candidates + lookup->candidateSize, cellList, count * sizeof(unsigned short));
+            lookup->candidateSize += count;
+        }
+    }
 
-    if (diff * diff < *bestDist) {
-        searchNearest(second, target, best, bestDist);
+    free(all);
+    free(blockList);
+    free(cellList);
+    if (!ok) {
+        freePaletteLookup(lookup);
+        return NULL;
     }
+    return lookup;
 }
 
-// Find nearest neighbor in k-d tree
-static OcColor* findNearestNeighbor(KDNode* root, OcColor* target) {
-    if (!root)
+// Takes the cached lookup if it was built for this palette, otherwise builds one. Return it with releasePaletteLookup().
+static PaletteLookup* acquirePaletteLookup(const OcPalette* palette) {
+    if (palette->num_colors <= 0 || palette->num_colors > 65535) {
         return NULL;
+    }
 
-    OcColor* best = root->color;
-    float bestDist = colorDistance(target, best);
-
-    searchNearest(root, target, &best, &bestDist);
-    return best;
+    PaletteLookup* lookup = (PaletteLookup*)OcAtomicExchangePointer(&cachedLookup, NULL);
+    if (lookup != NULL && lookup->numColors == palette->num_colors) {
+        bool same = true;
+        for (int i = 0; same && i < palette->num_colors; i++) {
+            same = lookup->colors[i * 3] == ClampToByte(palette->colors[i].r) && lookup->colors[i * 3 + 1] == ClampToByte(palette->colors[i].g) &&
+                   lookup->colors[i * 3 + 2] == ClampToByte(palette->colors[i].b);
+        }
+        if (same)
+            return lookup;
+    }
+    freePaletteLookup(lookup);
+    return createPaletteLookup(palette);
 }
 
-// Free k-d tree memory
-static void freeKDTree(KDNode* node) {
-    if (!node)
-        return;
-    freeKDTree(node->left);
-    freeKDTree(node->right);
-    free(node);
+static void releasePaletteLookup(PaletteLookup* lookup) {
+    freePaletteLookup((PaletteLookup*)OcAtomicExchangePointer(&cachedLookup, lookup));
 }
 
-bool applyColorRemapKDTree(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette) {
-
-    bool success = false;
-
-    // convert palette to array of OcColor
-    OcColor* colors = (OcColor*)malloc(palette->num_colors * sizeof(OcColor));
-    for (int i = 0; i < palette->num_colors; i++) {
-        colors[i].R = palette->colors[i].r;
-        colors[i].G = palette->colors[i].g;
-        colors[i].B = palette->colors[i].b;
+// Index of the palette color nearest to (R, G, B); the lowest index wins ties
+static inline int findNearestColor(const PaletteLookup* lookup, int R, int G, int B) {
+    int cell = lookup->cells[((R >> LOOKUP_SHIFT) << (2 * LOOKUP_BITS)) | ((G >> LOOKUP_SHIFT) << LOOKUP_BITS) | (B >> LOOKUP_SHIFT)];
+    if (cell >= 0)
+        return cell;
+
+    const unsigned short* list = lookup->candidates + (-cell - 1);
+    int best = list[1];
+    int bestDist = INT_MAX;
+    for (int i = 1; i <= list[0]; i++) {
+        const unsigned char* c = lookup->colors + list[i] * 3;
+        int dr = R - c[0];
+        int dg = G - c[1];
+        int db = B - c[2];
+        int dist = dr * dr + dg * dg + db * db;
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = list[i];
+        }
     }
+    return best;
+}
 
-    KDNode* root = buildKDTree(colors, palette->num_colors);
-
-    // Process each pixel
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int idx = (y * width + x) * channels;
-
-            // Create color point from input pixel
-            OcColor inputColor = { input[idx], input[idx + 1], input[idx + 2] };
-
-            // Find nearest color in palette using k-d tree
-            OcColor* nearestColor = findNearestNeighbor(root, &inputColor);
+typedef struct {
+    const unsigned char* input;
+    unsigned char* output;
+    int width;
+    int channels;
+    const PaletteLookup* lookup;
+    const OrderedDitherMatrix* matrix; // NULL for a plain remap
+    float amount;
+} RemapParams;
+
+static void remapRows(void* Context, int Begin, int End, int Thread) {
+    const RemapParams* p = (const RemapParams*)Context;
+    (void)Thread;
+    for (int y = Begin; y < End; y++) {
+        const float* thresholdRow = p->matrix ? p->matrix->threshold + (y % p->matrix->size) * p->matrix->size : NULL;
+        for (int x = 0; x < p->width; x++) {
+            size_t idx = ((size_t)y * p->width + x) * p->channels;
+            int R = p->input[idx];
+            int G = p->input[idx + 1];
+            int B = p->input[idx + 2];
+
+            if (thresholdRow) {
+                // Apply threshold to each channel
+                float threshold = thresholdRow[x % p->matrix->size] * p->amount;
+                R = (unsigned char)clamp(R + threshold, 0.0f, 255.0f);
+                G = (unsigned char)clamp(G + threshold, 0.0f, 255.0f);
+                B = (unsigned char)clamp(B + threshold, 0.0f, 255.0f);
+            }
 
-            // Apply nearest color to output
-            output[idx] = nearestColor->R;
-            output[idx + 1] = nearestColor->G;
-            output[idx + 2] = nearestColor->B;
+            const unsigned char* nearestColor = p->lookup->colors + findNearestColor(p->lookup, R, G, B) * 3;
+            p->output[idx] = nearestColor[0];
+            p->output[idx + 1] = nearestColor[1];
+            p->output[idx + 2] = nearestColor[2];
 
             // Preserve alpha if present
-            if (channels == 4) {
-                output[idx + 3] = input[idx + 3];
+            if (p->channels == 4) {
+                p->output[idx + 3] = p->input[idx + 3];
             }
         }
     }
+}
+
+bool applyColorRemap(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette) {
 
-    success = true;
+    PaletteLookup* lookup = acquirePaletteLookup(palette);
+    if (lookup == NULL) {
+        return false;
+    }
 
-    // Clean up k-d tree
-    freeKDTree(root);
-    free(colors);
+    RemapParams params = { input, output, width, channels, lookup, NULL, 0.0f };
+    ocularParallelFor(height, 16, remapRows, &params);
 
-    return success;
+    releasePaletteLookup(lookup);
+    return true;
 }
 
 /* End Palette mapping  --------------------------------------------*/
 
 bool applyErrorDiffusionDither(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette,
-                               KDNode* tree, const DitherMatrix* matrix, float amount) {
+                               const DitherMatrix* matrix, float amount) {
 
-    bool success = false;
+    PaletteLookup* lookup = acquirePaletteLookup(palette);
     // Allocate error buffers
-    float* errorR = (float*)calloc(width * height, sizeof(float));
-    float* errorG = (float*)calloc(width * height, sizeof(float));
-    float* errorB = (float*)calloc(width * height, sizeof(float));
+    float* errorR = (float*)ScratchAlloc((size_t)width * height * sizeof(float), true);
+    float* errorG = (float*)ScratchAlloc((size_t)width * height * sizeof(float), true);
+    float* errorB = (float*)ScratchAlloc((size_t)width * height * sizeof(float), true);
+    if (lookup == NULL || errorR == NULL || errorG == NULL || errorB == NULL) {
+        ScratchFree(errorR);
+        ScratchFree(errorG);
+        ScratchFree(errorB);
+        releasePaletteLookup(lookup);
+        return false;
+    }
 
     amount = amount / 100.0f; // Convert to 0-1 range
 
@@ -354,12 +435,12 @@ bool applyErrorDiffusionDither(unsigned char* input, unsigned char* output, int
                                    (unsigned char)fmin(255, fmax(0, input[idx + 2] + errorB[bufIdx] * amount)) };
 
             // Find nearest palette color
-            OcColor* nearestColor = findNearestNeighbor(tree, &inputColor);
+            const unsigned char* nearestColor = lookup->colors + findNearestColor(lookup, inputColor.R, inputColor.G, inputColor.B) * 3;
 
             // Calculate error
-            float errR = inputColor.R - nearestColor->R;
-            float errG = inputColor.G - nearestColor->G;
-            float errB = inputColor.B - nearestColor->B;
+            float errR = inputColor.R - nearestColor[0];
+            float errG = inputColor.G - nearestColor[1];
+            float errB = inputColor.B - nearestColor[2];
 
             // Distribute error according to matrix
             for (int my = 0; my < matrix->height; my++) {
@@ -384,94 +465,42 @@ bool applyErrorDiffusionDither(unsigned char* input, unsigned char* output, int
             }
 
             // Write output pixel
-            output[idx] = nearestColor->R;
-            output[idx + 1] = nearestColor->G;
-            output[idx + 2] = nearestColor->B;
+            output[idx] = nearestColor[0];
+            output[idx + 1] = nearestColor[1];
+            output[idx + 2] = nearestColor[2];
             if (channels == 4) {
                 output[idx + 3] = input[idx + 3];
             }
         }
     }
 
-    success = true;
-
-    free(errorR);
-    free(errorG);
-    free(errorB);
+    ScratchFree(errorR);
+    ScratchFree(errorG);
+    ScratchFree(errorB);
+    releasePaletteLookup(lookup);
 
-    return success;
+    return true;
 }
 
 bool applyOrderedDither(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette,
                         const OrderedDitherMatrix* matrix, float amount) {
 
-    bool success = false;
-
-    // Convert palette to array of OcColor for KD-tree
-    OcColor* colors = (OcColor*)malloc(palette->num_colors * sizeof(OcColor));
-    for (int i = 0; i < palette->num_colors; i++) {
-        colors[i].R = palette->colors[i].r;
-        colors[i].G = palette->colors[i].g;
-        colors[i].B = palette->colors[i].b;
+    PaletteLookup* lookup = acquirePaletteLookup(palette);
+    if (lookup == NULL) {
+        return false;
     }
 
-    // Build KD-tree for faster nearest neighbor search
-    KDNode* tree = buildKDTree(colors, palette->num_colors);
-
     // Scale amount to 0-1 range
-    amount = amount / 100.0f;
+    RemapParams params = { input, output, width, channels, lookup, matrix, amount / 100.0f };
+    ocularParallelFor(height, 16, remapRows, &params);
 
-    // Process each pixel
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int idx = (y * width + x) * channels;
-
-            // Get threshold from matrix (repeating pattern)
-            float threshold = matrix->threshold[(y % matrix->size) * matrix->size + (x % matrix->size)];
-            threshold = threshold * amount;
-
-            // Apply threshold to each channel
-            OcColor inputColor = { (unsigned char)fmin(255, fmax(0, input[idx] + threshold)),
-                                   (unsigned char)fmin(255, fmax(0, input[idx + 1] + threshold)),
-                                   (unsigned char)fmin(255, fmax(0, input[idx + 2] + threshold)) };
-
-            // Find nearest palette color
-            OcColor* nearestColor = findNearestNeighbor(tree, &inputColor);
-
-            // Write output pixel
-            output[idx] = nearestColor->R;
-            output[idx + 1] = nearestColor->G;
-            output[idx + 2] = nearestColor->B;
-            if (channels == 4) {
-                output[idx + 3] = input[idx + 3];
-            }
-        }
-    }
-
-    success = true;
-
-    // Cleanup
-    freeKDTree(tree);
-    free(colors);
-
-    return success;
+    releasePaletteLookup(lookup);
+    return true;
 }
 
 
 bool applyDithering(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette,
                     OcDitherMethod method, float amount) {
-    // Convert palette to array of OcColor
-    OcColor* colors = (OcColor*)malloc(palette->num_colors * sizeof(OcColor));
-    for (int i = 0; i < palette->num_colors; i++) {
-        colors[i].R = palette->colors[i].r;
-        colors[i].G = palette->colors[i].g;
-        colors[i].B = palette->colors[i].b;
-    }
-
-    bool success = false;
-
-    // Build KD-tree for faster nearest neighbor search
-    KDNode* tree = buildKDTree(colors, palette->num_colors);
 
     // Select dithering matrix based on method
     const DitherMatrix* matrix = NULL;
@@ -490,27 +519,11 @@ bool applyDithering(unsigned char* input, unsigned char* output, int width, int
         case OC_DITHER_BAYER_8X8: orderedMatrix = &BAYER_8X8_MATRIX; break;
         case OC_DITHER_NONE:
         default: 
-            if (applyColorRemapKDTree(input, output, width, height, channels, palette)) {
-                success = true;
-            }
-            goto cleanup;
+            return applyColorRemap(input, output, width, height, channels, palette);
     }
 
     if (matrix) {
-        if (applyErrorDiffusionDither(input, output, width, height, channels, palette, tree, matrix, amount)) {
-            success = true;
-        }
-    } else if (orderedMatrix) {
-        if (applyOrderedDither(input, output, width, height, channels, palette, orderedMatrix, amount)) {
-            success = true;
-        }
+        return applyErrorDiffusionDither(input, output, width, height, channels, palette, matrix, amount);
     }
-
-cleanup:
-    freeKDTree(tree);
-    free(colors);
-
-    return success;
+    return applyOrderedDither(input, output, width, height, channels, palette, orderedMatrix, amount);
 }
-
-
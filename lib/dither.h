@@ -36,22 +36,16 @@ typedef struct {
 
 /* Palette mapping  -------------------------------------------------*/
 
-// for k-d tree nodes
-typedef struct KDNode {
-    OcColor* color;
-    struct KDNode* left;
-    struct KDNode* right;
-    int depth;
-} KDNode;
-
-// Apply color remap using k-d tree for nearest neighbor search
-bool applyColorRemapKDTree(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette);
+// Maps every pixel to its nearest palette color. The nearest colors come from an inverse colormap built once per palette:
+// a 32^3 cell cube where each cell holds the one possible color or the few colors to compare exactly. The most recent
+// one is cached, so repeated calls with the same palette skip the build.
+bool applyColorRemap(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette);
 
 /* End Palette mapping  ---------------------------------------------*/
 
 
 bool applyErrorDiffusionDither(unsigned char* input, unsigned char* output, int width, int height, int channels,
-                               OcPalette* palette, KDNode* tree, const DitherMatrix* matrix, float amount);
+                               OcPalette* palette, const DitherMatrix* matrix, float amount);
 
 bool applyOrderedDither(unsigned char* input, unsigned char* output, int width, int height, int channels, OcPalette* palette,
                         const OrderedDitherMatrix* matrix, float amount);
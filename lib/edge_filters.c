@@ -1,5 +1,9 @@
 #include "edge_filters.h"
+#include "parallel.h"
+#include "simd.h"
+#include "workspace.h"
 #include <math.h>
+#include <string.h>
 
 OC_STATUS ocularPrewittEdgeDetect(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels) {
 
@@ -89,7 +93,7 @@ OC_STATUS ocularLaplacianEdgeDetect(unsigned char* Input, unsigned char* Output,
     int kernelSize = 2 * kernelRadius + 1;
 
     // Allocate kernel
-    float* kernel = (float*)malloc(kernelSize * kernelSize * sizeof(float));
+    float* kernel = (float*)ScratchAlloc(kernelSize * kernelSize * sizeof(float), false);
     if (!kernel) 
         return OC_STATUS_ERR_OUTOFMEMORY;
 
@@ -119,9 +123,9 @@ OC_STATUS ocularLaplacianEdgeDetect(unsigned char* Input, unsigned char* Output,
 
     // Apply LoG filter and find output range for proper scaling
     float minOutput = 0.0f, maxOutput = 0.0f;
-    float* tempOutput = (float*)malloc(Width * Height * sizeof(float));
+    float* tempOutput = (float*)ScratchAlloc(Width * Height * sizeof(float), false);
     if (!tempOutput) {
-        free(kernel);
+        ScratchFree(kernel);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -165,218 +169,262 @@ OC_STATUS ocularLaplacianEdgeDetect(unsigned char* Input, unsigned char* Output,
         }
     }
 
-    free(tempOutput);
+    ScratchFree(tempOutput);
 
     // Clean up
-    free(kernel);
+    ScratchFree(kernel);
     return OC_STATUS_OK;
 }
 
-OC_STATUS ocularCannyEdgeDetect(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels,
-                                CannyNoiseFilter kernel_size, int weak_threshold, int strong_threshold) {
+size_t laplacianScratchSize(int Width, int Height, int Radius) {
+    size_t kernelSize = 2 * (size_t)Radius + 1;
+    return ScratchBlockSize(kernelSize * kernelSize * sizeof(float)) + ScratchBlockSize((size_t)Width * Height * sizeof(float));
+}
 
-    if (Input == NULL || Output == NULL) {
-        return OC_STATUS_ERR_NULLREFERENCE;
-    }
-    if (Width <= 0 || Height <= 0) {
-        return OC_STATUS_ERR_INVALIDPARAMETER;
-    }
-    if (Channels != 1) {
-        return OC_STATUS_ERR_NOTSUPPORTED;
+// Rows per band. Each band recomputes three rows of blur and two of gradient around it, and its edge groups are joined
+// to those of the band above once every band is done
+#define CANNY_BAND_ROWS 64
+
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output; // holds 0, 1 (weak) or 2 (strong) per pixel until hysteresis
+    int Width;
+    int Height;
+    int Border; // rows and columns copied unblurred: 1 for the 3x3 kernel, 2 for the 5x5 kernel
+    int LowSq;
+    int StrongSq;
+    int* Parent; // per edge pixel, the index of its parent, or -1 / -2 for the root of a weak / strong group
+    unsigned char* Buffers;
+    size_t BufferSize;
+} CannyParams;
+
+// Neighbors along the gradient, as rows of the three row window and column offsets, indexed by simdSobelRow's octant code.
+// A pixel is kept when it is larger than the first one and no smaller than the second
+typedef struct {
+    signed char RowA, DxA, RowB, DxB;
+} CannyNeighbor;
+
+static const CannyNeighbor CannyNeighbors[8] = {
+    { 1, -1, 1, 1 },  // horizontal gradient: left, right
+    { 0, 1, 2, -1 },  // "/" diagonal: above right, below left
+    { 1, -1, 1, 1 },  // not produced
+    { 0, 0, 2, 0 },   // vertical gradient: above, below
+    { 1, -1, 1, 1 },  // horizontal gradient
+    { 0, -1, 2, 1 },  // "\" diagonal: above left, below right
+    { 1, -1, 1, 1 },  // not produced
+    { 0, 0, 2, 0 },   // vertical gradient
+};
+
+// Gaussian smoothing of one row. Sums holds 3 * Width shorts of column sums
+static void cannyBlurRow(const CannyParams* p, int Y, short* Sums, unsigned char* Dst) {
+    int Width = p->Width, B = p->Border;
+    const unsigned char* In = p->Input + (size_t)Y * Width;
+    if (Y < B || Y >= p->Height - B || Width <= 2 * B) {
+        memcpy(Dst, In, Width);
+        return;
     }
 
-    // Ensure filter specific parameters are within valid ranges
-    if (kernel_size != CannyGaus3x3 && kernel_size != CannyGaus5x5) {
-        kernel_size = CannyGaus3x3;
+    if (B == 1) {
+        // Gaus3x3 is [1 2 1] applied down the columns, then across the rows
+        for (int X = 0; X < Width; X++)
+            Sums[X] = (short)(In[X - Width] + 2 * In[X] + In[X + Width]);
+        for (int X = 1; X < Width - 1; X++)
+            Dst[X] = (unsigned char)((Sums[X - 1] + 2 * Sums[X] + Sums[X + 1]) >> 4);
+    } else {
+        // Gaus5x5 is not separable, but it is symmetric: fold the rows around the center into one weighted sum per column
+        // for each distance from the center column
+        short *Far = Sums, *Near = Sums + Width, *Center = Sums + 2 * Width;
+        for (int X = 0; X < Width; X++) {
+            int a = In[X - 2 * Width] + In[X + 2 * Width], b = In[X - Width] + In[X + Width], c = In[X];
+            Far[X] = (short)(2 * a + 4 * b + 5 * c);
+            Near[X] = (short)(4 * a + 9 * b + 12 * c);
+            Center[X] = (short)(5 * a + 12 * b + 15 * c);
+        }
+        for (int X = 2; X < Width - 2; X++)
+            Dst[X] = (unsigned char)((Far[X - 2] + Far[X + 2] + Near[X - 1] + Near[X + 1] + Center[X]) / Gaus5x5Div);
     }
-    weak_threshold = clamp(weak_threshold, 0, 255);
-    strong_threshold = clamp(strong_threshold, 0, 255);
-
-    // Sobel, as for why this can be used instead of Gaussian derivative, see
-    // https://medium.com/@haidarlina4/sobel-vs-canny-edge-detection-techniques-step-by-step-implementation-11ae6103a56a
-    const int8_t Gx[] = { -1, 0, 1, -2, 0, 2, -1, 0, 1 };
-
-    // Upward minus downward, to achieve the difference in the y direction, dy
-    const int8_t Gy[] = { 1, 2, 1, 0, 0, 0, -1, -2, -1 };
-
-    int offset_xy = 1; // for kernel = 3
-    int8_t* kernel = (int8_t*)Gaus3x3;
-    int kernel_div = Gaus3x3Div;
+    memcpy(Dst, In, B);
+    memcpy(Dst + Width - B, In + Width - B, B);
+}
 
-    if (kernel_size == CannyGaus5x5) {
-        offset_xy = 2;
-        kernel = (int8_t*)Gaus5x5;
-        kernel_div = Gaus5x5Div;
+static int cannyFind(int* Parent, int Index) {
+    while (Parent[Index] >= 0) {
+        // Path halving; parents always have a lower index than their children
+        if (Parent[Parent[Index]] >= 0)
+            Parent[Index] = Parent[Parent[Index]];
+        Index = Parent[Index];
     }
+    return Index;
+}
 
-    float* G_ = (float*)calloc(Width * Height, sizeof(double));
-    float* M_ = (float*)calloc(Width * Height, sizeof(double));
-    unsigned char* s_ = (unsigned char*)calloc(Width * Height, sizeof(unsigned char));
+static void cannyUnion(int* Parent, int A, int B) {
+    A = cannyFind(Parent, A);
+    B = cannyFind(Parent, B);
+    if (A == B)
+        return;
+    if (A > B) {
+        int Temp = A;
+        A = B;
+        B = Temp;
+    }
+    // The group is strong if either part is
+    Parent[A] = min(Parent[A], Parent[B]);
+    Parent[B] = A;
+}
 
-    // gaussian filter
-    for (int x = 0; x < Width; x++) {
-        for (int y = 0; y < Height; y++) {
-            int pos = x + (y * Width);
-            if (x < offset_xy || x >= (Width - offset_xy) || y < offset_xy || y >= (Height - offset_xy)) {
-                // The first and last rows, the first and last columns, get the source value
-                Output[pos] = Input[pos];
-                continue;
-            }
-            int convolve = 0;
-            int k = 0;
-            // Calculate convolution using relevant methods
-            for (int kx = -offset_xy; kx <= offset_xy; kx++) {
-                for (int ky = -offset_xy; ky <= offset_xy; ky++) {
-                    convolve += (Input[pos + (kx + (ky * Width))] * kernel[k]);
-                    k++;
+// Smoothing, gradient, non-maximum suppression and double threshold of a band of rows, rolling three row windows down the
+// band. Edge pixels are then grouped with their 8-connected neighbors in the band
+static void cannyBands(void* Context, int Begin, int End, int Thread) {
+    const CannyParams* p = (const CannyParams*)Context;
+    int Width = p->Width, Height = p->Height;
+    int* Magnitude = (int*)(p->Buffers + Thread * p->BufferSize);
+    short* Sums = (short*)(Magnitude + 3 * Width);
+    unsigned char* Blurred = (unsigned char*)(Sums + 3 * Width);
+    unsigned char* Octant = Blurred + 3 * Width;
+
+    for (int Band = Begin; Band < End; Band++) {
+        int Top = Band * CANNY_BAND_ROWS, Bottom = min(Top + CANNY_BAND_ROWS, Height);
+        int NextBlur = max(Top - 2, 0), NextGradient = max(Top - 1, 0);
+
+        for (int Y = Top; Y < Bottom; Y++) {
+            unsigned char* LinePD = p->Output + (size_t)Y * Width;
+
+            for (; NextGradient <= min(Y + 1, Height - 1); NextGradient++) {
+                for (; NextBlur <= min(NextGradient + 1, Height - 1); NextBlur++)
+                    cannyBlurRow(p, NextBlur, Sums, Blurred + (NextBlur % 3) * Width);
+
+                int* Row = Magnitude + (NextGradient % 3) * Width;
+                if (NextGradient == 0 || NextGradient == Height - 1 || Width < 3) {
+                    memset(Row, 0, Width * sizeof(int));
+                } else {
+                    Row[0] = Row[Width - 1] = 0;
+                    simdSobelRow(Blurred + ((NextGradient - 1) % 3) * Width, Blurred + (NextGradient % 3) * Width,
+                                 Blurred + ((NextGradient + 1) % 3) * Width, Row, Octant + (NextGradient % 3) * Width, Width);
                 }
             }
 
-            Output[pos] = (unsigned char)((double)convolve / (double)kernel_div);
-        }
-    }
-
-    // apply sobel kernels
-    offset_xy = 1; // 3x3
-    for (int x = offset_xy; x < Width - offset_xy; x++) {
-        for (int y = offset_xy; y < Height - offset_xy; y++) {
-            // The first and last rows, the first and last columns are skipped and not processed.
-            double convolve_X = 0.0;
-            double convolve_Y = 0.0;
-            int k = 0;
-            int src_pos = x + (y * Width);
-
-            for (int ky = -offset_xy; ky <= offset_xy; ky++) {
-                for (int kx = -offset_xy; kx <= offset_xy; kx++) {
-                    convolve_X += Output[src_pos + (kx + (ky * Width))] * Gx[k];
-                    convolve_Y += Output[src_pos + (kx + (ky * Width))] * Gy[k];
+            memset(LinePD, 0, Width);
+            if (Y == 0 || Y == Height - 1)
+                continue;
 
-                    k++;
-                }
+            const int* Rows[3] = { Magnitude + ((Y - 1) % 3) * Width, Magnitude + (Y % 3) * Width, Magnitude + ((Y + 1) % 3) * Width };
+            const unsigned char* Code = Octant + (Y % 3) * Width;
+            for (int X = 1; X < Width - 1; X++) {
+                int Value = Rows[1][X];
+                if (Value <= p->LowSq)
+                    continue;
+                const CannyNeighbor* Along = &CannyNeighbors[Code[X]];
+                if (Rows[Along->RowA][X + Along->DxA] < Value && Rows[Along->RowB][X + Along->DxB] <= Value)
+                    LinePD[X] = Value > p->StrongSq ? 2 : 1;
             }
 
-            // gradient hypot & direction
-            int segment = 0;
-
-            if (convolve_X == 0.0 || convolve_Y == 0.0) {
-                G_[src_pos] = 0;
-            } else {
-                // calculate the intensity
-                G_[src_pos] = ((sqrt((convolve_X * convolve_X) + (convolve_Y * convolve_Y))));
-                // direction
-                double theta = atan2(convolve_Y, convolve_X); // radians. atan2 range: -PI,+PI,
-                                                              // theta : 0 - 2PI
-                // convert to degrees
-                theta = theta * (360.0 / (2.0 * M_PI)); // degrees
-
-                if ((theta <= 22.5 && theta >= -22.5) || (theta <= -157.5) || (theta >= 157.5)) {
-                    // close the horizontal line
-                    segment = 1; // "-"
-                } else if ((theta > 22.5 && theta <= 67.5) || (theta > -157.5 && theta <= -112.5)) {
-                    // close to the 45 degree diagonal
-                    segment = 2; // "/"
-                } else if ((theta > 67.5 && theta <= 112.5) || (theta >= -112.5 && theta < -67.5)) {
-                    // close vertical line
-                    segment = 3; // "|"
-                } else if ((theta >= -67.5 && theta < -22.5) || (theta > 112.5 && theta < 157.5)) {
-                    // another diagonal line close to 135 degrees
-                    segment = 4; // "\"
-                } else {
-                    // std::cout << "error " << theta << std::endl;
+            // The row above belongs to this band unless this is its first row
+            const unsigned char* Above = Y > Top ? LinePD - Width : NULL;
+            int* Parent = p->Parent + (size_t)Y * Width;
+            for (int X = 1; X < Width - 1; X++) {
+                if (LinePD[X] == 0)
+                    continue;
+                int Index = (int)((size_t)Y * Width + X);
+                Parent[X] = LinePD[X] == 2 ? -2 : -1;
+                // The pixel above touches every other earlier neighbor, so it is the only one needed when set
+                if (Above != NULL && Above[X] != 0) {
+                    cannyUnion(p->Parent, Index, Index - Width);
+                    continue;
                 }
+                if (LinePD[X - 1] != 0)
+                    cannyUnion(p->Parent, Index, Index - 1);
+                if (Above != NULL && Above[X - 1] != 0)
+                    cannyUnion(p->Parent, Index, Index - Width - 1);
+                if (Above != NULL && Above[X + 1] != 0)
+                    cannyUnion(p->Parent, Index, Index - Width + 1);
             }
-
-            s_[src_pos] = (unsigned char)segment;
         }
     }
+}
 
-    // The 9-square grid range is set to 0 if it is not the largest in the direction.
-    // local maxima: non maxima suppression
-    memcpy(M_, G_, Width * Height * sizeof(double));
+// Keeps the pixels whose group holds a strong pixel. Parents are only read, so bands can run concurrently
+static void cannyHysteresis(void* Context, int Begin, int End, int Thread) {
+    (void)Thread;
+    const CannyParams* p = (const CannyParams*)Context;
+    int Width = p->Width;
+    int Top = Begin * CANNY_BAND_ROWS, Bottom = min(End * CANNY_BAND_ROWS, p->Height);
+    for (int Y = Top; Y < Bottom; Y++) {
+        unsigned char* LinePD = p->Output + (size_t)Y * Width;
+        for (int X = 1; X < Width - 1; X++) {
+            if (LinePD[X] == 0)
+                continue;
+            int Index = (int)((size_t)Y * Width + X);
+            while (p->Parent[Index] >= 0)
+                Index = p->Parent[Index];
+            LinePD[X] = p->Parent[Index] == -2 ? 255 : 0;
+        }
+    }
+}
 
-    for (int x = 1; x < Width - 1; x++) {
-        for (int y = 1; y < Height - 1; y++) {
-            // The first and last rows, the first and last columns are skipped and not processed.
-            int pos = x + (y * Width);
+OC_STATUS ocularCannyEdgeDetect(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels,
+                                CannyNoiseFilter kernel_size, int weak_threshold, int strong_threshold) {
 
-            switch (s_[pos]) {
-            case 1:
-                // close to the horizontal line
-                if (G_[pos - 1] >= G_[pos] || G_[pos + 1] > G_[pos]) {
-                    // If there is one on the left and right that is larger than itself, set it to 0
-                    M_[pos] = 0;
-                }
-                break;
-            case 2:
-                // close to the 45 degree diagonal
-                if (G_[pos - (Width - 1)] >= G_[pos] || G_[pos + (Width - 1)] > G_[pos]) {
-                    M_[pos] = 0;
-                }
-                break;
-            case 3:
-                // close to vertical line
-                if (G_[pos - (Width)] >= G_[pos] || G_[pos + (Width)] > G_[pos]) {
-                    // If there is one above or below that is larger than itself, set it to 0
-                    M_[pos] = 0;
-                }
-                break;
-            case 4:
-                // another diagonal line close to 135 degrees
-                if (G_[pos - (Width + 1)] >= G_[pos] || G_[pos + (Width + 1)] > G_[pos]) {
-                    M_[pos] = 0;
-                }
-                break;
-            default: M_[pos] = 0; break;
-            }
-        }
+    if (Input == NULL || Output == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Width <= 0 || Height <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+    if (Channels != 1) {
+        return OC_STATUS_ERR_NOTSUPPORTED;
     }
 
+    // Ensure filter specific parameters are within valid ranges
+    if (kernel_size != CannyGaus3x3 && kernel_size != CannyGaus5x5) {
+        kernel_size = CannyGaus3x3;
+    }
+    weak_threshold = clamp(weak_threshold, 0, 255);
+    strong_threshold = clamp(strong_threshold, 0, 255);
 
-    // double threshold
-    for (int x = 0; x < Width; x++) {
-        for (int y = 0; y < Height; y++) {
-            int src_pos = x + (y * Width);
-            if (M_[src_pos] > strong_threshold) {
-                Output[src_pos] = 255;
-            } else if (M_[src_pos] > weak_threshold) {
-                Output[src_pos] = 100;
-            } else {
-                Output[src_pos] = 0;
-            }
-        }
+    // Magnitudes are compared squared, which is exact for integer thresholds and needs no square roots
+    CannyParams params = { Input, Output, Width, Height, kernel_size == CannyGaus5x5 ? 2 : 1,
+                           min(weak_threshold, strong_threshold) * min(weak_threshold, strong_threshold),
+                           strong_threshold * strong_threshold, NULL, NULL, 0 };
+    // Magnitude rows, column sums, blurred rows and octant codes; a multiple of 32 bytes keeps every thread's block aligned
+    params.BufferSize = ((size_t)Width * (3 * sizeof(int) + 3 * sizeof(short) + 3 + 3) + 31) & ~(size_t)31;
+    params.Parent = (int*)ScratchAlloc((size_t)Width * Height * sizeof(int), false);
+    params.Buffers = (unsigned char*)ScratchAlloc(ocularGetThreadCount() * params.BufferSize, false);
+    if (params.Parent == NULL || params.Buffers == NULL) {
+        ScratchFree(params.Buffers);
+        ScratchFree(params.Parent);
+        return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
-    // Connect the border
-    // edges with hysteresis
-    for (int x = 1; x < Width - 1; x++) {
-        for (int y = 1; y < Height - 1; y++) {
-            // The first and last rows, the first and last columns are skipped and not processed.
-            int src_pos = x + (y * Width);
-            if (Output[src_pos] == 255) {
-                Output[src_pos] = 255;
-            } else if (Output[src_pos] == 100) {
-                if (Output[src_pos - 1] == 255 || Output[src_pos + 1] == 255 || Output[src_pos - 1 - Width] == 255 ||
-                    Output[src_pos + 1 - Width] == 255 || Output[src_pos + Width] == 255 || Output[src_pos + Width - 1] == 255 ||
-                    Output[src_pos + Width + 1] == 255) {
-                    Output[src_pos] = 255;
-                    // In the 9-square grid range of 100, if there is 255, adjust it to 255
-                } else {
-                    // Otherwise return to 0
-                    Output[src_pos] = 0;
-                }
-            } else {
-                Output[src_pos] = 0;
+    int Bands = (Height + CANNY_BAND_ROWS - 1) / CANNY_BAND_ROWS;
+    ocularParallelFor(Bands, 1, cannyBands, &params);
+
+    // Join the groups that cross from each band into the next
+    for (int Band = 1; Band < Bands; Band++) {
+        int Y = Band * CANNY_BAND_ROWS;
+        const unsigned char* LinePD = Output + (size_t)Y * Width;
+        for (int X = 1; X < Width - 1; X++) {
+            if (LinePD[X] == 0)
+                continue;
+            int Index = (int)((size_t)Y * Width + X);
+            for (int dx = -1; dx <= 1; dx++) {
+                if (LinePD[X + dx - Width] != 0)
+                    cannyUnion(params.Parent, Index, Index - Width + dx);
             }
         }
     }
 
-    free(G_);
-    free(M_);
-    free(s_);
+    ocularParallelFor(Bands, 1, cannyHysteresis, &params);
 
+    ScratchFree(params.Buffers);
+    ScratchFree(params.Parent);
     return OC_STATUS_OK;
 }
 
+size_t cannyScratchSize(int Width, int Height) {
+    size_t bufferSize = ((size_t)Width * (3 * sizeof(int) + 3 * sizeof(short) + 3 + 3) + 31) & ~(size_t)31;
+    return ScratchBlockSize((size_t)Width * Height * sizeof(int)) + ScratchBlockSize(ocularGetThreadCount() * bufferSize);
+}
+
 OC_STATUS ocularSobelEdgeDetect(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels) {
 
     if ((Input == NULL) || (Output == NULL)) {
@@ -390,11 +438,11 @@ OC_STATUS ocularSobelEdgeDetect(unsigned char* Input, unsigned char* Output, int
         return OC_STATUS_ERR_NOTSUPPORTED;
     }
 
-    unsigned char* SqrLut = (unsigned char*)malloc(65026 * sizeof(unsigned char));
+    unsigned char* SqrLut = (unsigned char*)ScratchAlloc(65026 * sizeof(unsigned char), false);
     if (SqrLut == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    unsigned char* RowCopy = (unsigned char*)malloc((Width + 2) * 3 * sizeof(unsigned char));
+    unsigned char* RowCopy = (unsigned char*)ScratchAlloc((Width + 2) * 3 * sizeof(unsigned char), false);
     if (RowCopy == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
@@ -437,15 +485,19 @@ OC_STATUS ocularSobelEdgeDetect(unsigned char* Input, unsigned char* Output, int
         }
     }
     if (RowCopy) {
-        free(RowCopy);
+        ScratchFree(RowCopy);
     }
     if (SqrLut) {
-        free(SqrLut);
+        ScratchFree(SqrLut);
     }
 
     return OC_STATUS_OK;
 }
 
+size_t sobelScratchSize(int Width) {
+    return ScratchBlockSize(65026) + ScratchBlockSize((size_t)(Width + 2) * 3);
+}
+
 OC_STATUS ocularGradientEdgeDetect(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels) {
 
     if ((Input == NULL) || (Output == NULL)) {
@@ -459,11 +511,11 @@ OC_STATUS ocularGradientEdgeDetect(unsigned char* Input, unsigned char* Output,
         return OC_STATUS_ERR_NOTSUPPORTED;
     }
 
-    unsigned char* RowCopy = (unsigned char*)malloc((Width + 2) * 3 * Channels);
+    unsigned char* RowCopy = (unsigned char*)ScratchAlloc((Width + 2) * 3 * Channels, false);
     if (RowCopy == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    unsigned char* SqrValue = (unsigned char*)malloc(65026 * sizeof(unsigned char));
+    unsigned char* SqrValue = (unsigned char*)ScratchAlloc(65026 * sizeof(unsigned char), false);
     if (SqrValue == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
@@ -515,8 +567,12 @@ OC_STATUS ocularGradientEdgeDetect(unsigned char* Input, unsigned char* Output,
                 LinePD[x] = SqrValue[Value];
         }
     }
-    free(RowCopy);
-    free(SqrValue);
+    ScratchFree(RowCopy);
+    ScratchFree(SqrValue);
 
     return OC_STATUS_OK;
+}
+
+size_t gradientScratchSize(int Width, int Channels) {
+    return ScratchBlockSize((size_t)(Width + 2) * 3 * Channels) + ScratchBlockSize(65026);
 }
\ No newline at end of file
@@ -64,7 +64,9 @@ static const int Gaus5x5Div = 159;
 
 /**
  * @brief Performs Canny edge detection on an image.
- * This is one of the most reliable methods of edge detection.
+ * This is one of the most reliable methods of edge detection. Weak pixels are kept when they connect to a strong pixel
+ * through other weak pixels, however far away. Edges are 255 and everything else 0; the outermost pixels are never edges.
+ * Runs in parallel bands of rows. Input and Output must be different buffers.
  * @ingroup group_ip_filters
  * @param Input The image input data buffer (expects grayscale image).
  * @param Output The image output data buffer.
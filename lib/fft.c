@@ -9,7 +9,9 @@
  */
 
 #include "fft.h"
+#include "parallel.h"
 #include "util.h"
+#include "workspace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -18,213 +20,764 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-// Helper function to check if a number is a power of 2
-static bool isPowerOfTwo(int n) {
-    return n > 0 && (n & (n - 1)) == 0;
+// Largest prime factor handled with a direct butterfly; lengths with a larger one go through Bluestein's algorithm
+#define FFT_MAX_GENERIC_RADIX 64
+#define FFT_MAX_STAGES 32
+// Columns gathered together by the column passes, so every row access reads whole cache lines
+#define FFT_COLUMN_BLOCK 8
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define OcAtomicExchangePointer(p, v) _InterlockedExchangePointer((void* volatile*)(p), (v))
+#else
+    #define OcAtomicExchangePointer(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
+struct OcFFTPlan {
+    int n;
+    bool real;                        // transform of n real samples
+    int numStages;
+    int stages[2 * FFT_MAX_STAGES];   // radix and remaining length of each stage
+    OcComplex* twiddles;              // exp(-2 pi i k / n) followed by its conjugate, k in [0, n)
+    OcFFTPlan* sub;                   // half length plan of even real plans, or the convolution plan of Bluestein
+    OcComplex* chirp;                 // Bluestein: exp(-pi i k^2 / n), k in [0, n)
+    OcComplex* chirpFFT;              // Bluestein: transform of the conjugate chirp, scaled by 1 / sub->n
+    size_t workSize;                  // OcComplex scratch entries needed by one execution
+};
+
+static inline OcComplex cmul(OcComplex a, OcComplex b) {
+    return (OcComplex){ a.real * b.real - a.imag * b.imag, a.real * b.imag + a.imag * b.real };
+}
+
+static inline OcComplex cconj(OcComplex a) {
+    return (OcComplex){ a.real, -a.imag };
 }
 
-// Helper function to find the next power of 2
-static int nextPowerOfTwo(int n) {
-    int power = 1;
-    while (power < n) {
-        power <<= 1;
+// Splits n into radix 4, 2, 3, 5 and then any other prime stages. Returns false if a prime factor is too large for a
+// direct butterfly.
+static bool factorize(OcFFTPlan* plan) {
+    int n = plan->n;
+    int p = 4;
+    plan->numStages = 0;
+    while (n > 1) {
+        while (n % p != 0) {
+            switch (p) {
+                case 4: p = 2; break;
+                case 2: p = 3; break;
+                default: p += 2; break;
+            }
+            if (p * p > n)
+                p = n;
+        }
+        if (p > FFT_MAX_GENERIC_RADIX)
+            return false;
+        n /= p;
+        plan->stages[2 * plan->numStages] = p;
+        plan->stages[2 * plan->numStages + 1] = n;
+        plan->numStages++;
     }
-    return power;
+    return true;
 }
 
-// Bit-reversal permutation for FFT
-static void bitReverse(OcComplex* data, int n) {
-    int j = 0;
-    for (int i = 1; i < n; i++) {
-        int bit = n >> 1;
-        while (j & bit) {
-            j ^= bit;
-            bit >>= 1;
+static void butterfly2(OcComplex* out, size_t fstride, const OcComplex* tw, int m) {
+    for (int k = 0; k < m; k++) {
+        OcComplex t = cmul(out[k + m], tw[k * fstride]);
+        out[k + m] = (OcComplex){ out[k].real - t.real, out[k].imag - t.imag };
+        out[k] = (OcComplex){ out[k].real + t.real, out[k].imag + t.imag };
+    }
+}
+
+static void butterfly3(OcComplex* out, size_t fstride, const OcComplex* tw, int m) {
+    float epi3 = tw[fstride * m].imag;
+    for (int k = 0; k < m; k++) {
+        OcComplex s1 = cmul(out[k + m], tw[k * fstride]);
+        OcComplex s2 = cmul(out[k + 2 * m], tw[2 * k * fstride]);
+        OcComplex s3 = { s1.real + s2.real, s1.imag + s2.imag };
+        OcComplex s0 = { (s1.real - s2.real) * epi3, (s1.imag - s2.imag) * epi3 };
+        OcComplex base = { out[k].real - 0.5f * s3.real, out[k].imag - 0.5f * s3.imag };
+        out[k] = (OcComplex){ out[k].real + s3.real, out[k].imag + s3.imag };
+        out[k + m] = (OcComplex){ base.real - s0.imag, base.imag + s0.real };
+        out[k + 2 * m] = (OcComplex){ base.real + s0.imag, base.imag - s0.real };
+    }
+}
+
+static void butterfly4(OcComplex* out, size_t fstride, const OcComplex* tw, int m, bool inverse) {
+    for (int k = 0; k < m; k++) {
+        OcComplex s0 = cmul(out[k + m], tw[k * fstride]);
+        OcComplex s1 = cmul(out[k + 2 * m], tw[2 * k * fstride]);
+        OcComplex s2 = cmul(out[k + 3 * m], tw[3 * k * fstride]);
+        OcComplex s5 = { out[k].real - s1.real, out[k].imag - s1.imag };
+        OcComplex s6 = { out[k].real + s1.real, out[k].imag + s1.imag };
+        OcComplex s3 = { s0.real + s2.real, s0.imag + s2.imag };
+        OcComplex s4 = { s0.real - s2.real, s0.imag - s2.imag };
+        out[k] = (OcComplex){ s6.real + s3.real, s6.imag + s3.imag };
+        out[k + 2 * m] = (OcComplex){ s6.real - s3.real, s6.imag - s3.imag };
+        // Rotate s4 by -i for the forward transform and by +i for the inverse
+        if (inverse) {
+            out[k + m] = (OcComplex){ s5.real - s4.imag, s5.imag + s4.real };
+            out[k + 3 * m] = (OcComplex){ s5.real + s4.imag, s5.imag - s4.real };
+        } else {
+            out[k + m] = (OcComplex){ s5.real + s4.imag, s5.imag - s4.real };
+            out[k + 3 * m] = (OcComplex){ s5.real - s4.imag, s5.imag + s4.real };
         }
-        j ^= bit;
-        
-        if (i < j) {
-            // Swap data[i] and data[j]
-            OcComplex temp = data[i];
-            data[i] = data[j];
-            data[j] = temp;
+    }
+}
+
+static void butterfly5(OcComplex* out, size_t fstride, const OcComplex* tw, int m) {
+    OcComplex ya = tw[fstride * m];
+    OcComplex yb = tw[2 * fstride * m];
+    for (int k = 0; k < m; k++) {
+        OcComplex s0 = out[k];
+        OcComplex s1 = cmul(out[k + m], tw[k * fstride]);
+        OcComplex s2 = cmul(out[k + 2 * m], tw[2 * k * fstride]);
+        OcComplex s3 = cmul(out[k + 3 * m], tw[3 * k * fstride]);
+        OcComplex s4 = cmul(out[k + 4 * m], tw[4 * k * fstride]);
+        OcComplex s7 = { s1.real + s4.real, s1.imag + s4.imag };
+        OcComplex s10 = { s1.real - s4.real, s1.imag - s4.imag };
+        OcComplex s8 = { s2.real + s3.real, s2.imag + s3.imag };
+        OcComplex s9 = { s2.real - s3.real, s2.imag - s3.imag };
+
+        out[k] = (OcComplex){ s0.real + s7.real + s8.real, s0.imag + s7.imag + s8.imag };
+
+        OcComplex s5 = { s0.real + s7.real * ya.real + s8.real * yb.real, s0.imag + s7.imag * ya.real + s8.imag * yb.real };
+        OcComplex s6 = { s10.imag * ya.imag + s9.imag * yb.imag, -s10.real * ya.imag - s9.real * yb.imag };
+        out[k + m] = (OcComplex){ s5.real - s6.real, s5.imag - s6.imag };
+        out[k + 4 * m] = (OcComplex){ s5.real + s6.real, s5.imag + s6.imag };
+
+        OcComplex s11 = { s0.real + s7.real * yb.real + s8.real * ya.real, s0.imag + s7.imag * yb.real + s8.imag * ya.real };
+        OcComplex s12 = { -s10.imag * yb.imag + s9.imag * ya.imag, s10.real * yb.imag - s9.real * ya.imag };
+        out[k + 2 * m] = (OcComplex){ s11.real + s12.real, s11.imag + s12.imag };
+        out[k + 3 * m] = (OcComplex){ s11.real - s12.real, s11.imag - s12.imag };
+    }
+}
+
+// Direct DFT of any radix up to FFT_MAX_GENERIC_RADIX, folding the stage twiddles into the DFT coefficients
+static void butterflyGeneric(OcComplex* out, size_t fstride, const OcComplex* tw, int m, int p, int n) {
+    OcComplex scratch[FFT_MAX_GENERIC_RADIX];
+    for (int u = 0; u < m; u++) {
+        for (int q = 0; q < p; q++) {
+            scratch[q] = out[u + q * m];
+        }
+        for (int q1 = 0; q1 < p; q1++) {
+            int k = u + q1 * m;
+            size_t step = (size_t)k * fstride % n;
+            size_t index = 0;
+            OcComplex sum = scratch[0];
+            for (int q = 1; q < p; q++) {
+                index += step;
+                if (index >= (size_t)n)
+                    index -= n;
+                OcComplex t = cmul(scratch[q], tw[index]);
+                sum.real += t.real;
+                sum.imag += t.imag;
+            }
+            out[k] = sum;
         }
     }
 }
 
-// Core 1D FFT implementation using Cooley-Tukey algorithm
-OC_STATUS ocularFFT(OcComplex* data, int n, bool inverse) {
-    if (data == NULL || n <= 0) {
+// Decimation in time: transforms the p interleaved subsequences of length m recursively, then combines them
+static void fftStage(OcComplex* out, const OcComplex* in, size_t fstride, const int* stage, const OcFFTPlan* plan, const OcComplex* tw,
+                     bool inverse) {
+    int p = stage[0];
+    int m = stage[1];
+    if (m == 1) {
+        for (int q = 0; q < p; q++) {
+            out[q] = in[q * fstride];
+        }
+    } else {
+        for (int q = 0; q < p; q++) {
+            fftStage(out + q * m, in + q * fstride, fstride * p, stage + 2, plan, tw, inverse);
+        }
+    }
+
+    switch (p) {
+        case 2: butterfly2(out, fstride, tw, m); break;
+        case 3: butterfly3(out, fstride, tw, m); break;
+        case 4: butterfly4(out, fstride, tw, m, inverse); break;
+        case 5: butterfly5(out, fstride, tw, m); break;
+        default: butterflyGeneric(out, fstride, tw, m, p, plan->n); break;
+    }
+}
+
+// Unnormalized complex transform. Input and Output must differ; Work holds plan->workSize entries.
+static void fftComplex(const OcFFTPlan* plan, const OcComplex* Input, OcComplex* Output, bool inverse, OcComplex* Work) {
+    int n = plan->n;
+    if (plan->chirp == NULL) {
+        if (n == 1)
+            Output[0] = Input[0];
+        else
+            fftStage(Output, Input, 1, plan->stages, plan, plan->twiddles + (inverse ? n : 0), inverse);
+        return;
+    }
+
+    // Bluestein: the DFT as a convolution with a chirp, evaluated with a power of two transform. The inverse is computed as the
+    // conjugate of the forward transform of the conjugate input.
+    int m = plan->sub->n;
+    OcComplex* a = Work;
+    OcComplex* b = Work + m;
+    for (int k = 0; k < n; k++) {
+        OcComplex x = inverse ? cconj(Input[k]) : Input[k];
+        a[k] = cmul(x, plan->chirp[k]);
+    }
+    memset(a + n, 0, (size_t)(m - n) * sizeof(OcComplex));
+    fftComplex(plan->sub, a, b, false, NULL);
+    for (int k = 0; k < m; k++) {
+        b[k] = cmul(b[k], plan->chirpFFT[k]);
+    }
+    fftComplex(plan->sub, b, a, true, NULL);
+    for (int k = 0; k < n; k++) {
+        OcComplex y = cmul(a[k], plan->chirp[k]);
+        Output[k] = inverse ? cconj(y) : y;
+    }
+}
+
+// Unnormalized transform of n real samples into n / 2 + 1 bins
+static void fftRealForward(const OcFFTPlan* plan, const float* Input, OcComplex* Output, OcComplex* Work) {
+    int n = plan->n;
+    if (plan->sub == NULL || plan->sub->n * 2 != n) {
+        // Odd lengths run the full complex transform
+        OcComplex* full = Work;
+        OcComplex* spectrum = Work + n;
+        for (int k = 0; k < n; k++) {
+            full[k] = (OcComplex){ Input[k], 0.0f };
+        }
+        fftComplex(plan->sub, full, spectrum, false, Work + 2 * n);
+        memcpy(Output, spectrum, (size_t)(n / 2 + 1) * sizeof(OcComplex));
+        return;
+    }
+
+    // Even lengths pack even and odd samples into one complex sequence of half the length and split its transform
+    int h = n / 2;
+    OcComplex* packed = Work;
+    for (int k = 0; k < h; k++) {
+        packed[k] = (OcComplex){ Input[2 * k], Input[2 * k + 1] };
+    }
+    fftComplex(plan->sub, packed, Output, false, Work + h);
+
+    Output[h] = Output[0];
+    for (int k = 0; k <= h / 2; k++) {
+        OcComplex zk = Output[k];
+        OcComplex zc = cconj(Output[h - k]);
+        OcComplex even = { 0.5f * (zk.real + zc.real), 0.5f * (zk.imag + zc.imag) };
+        // (zk - zc) / 2i
+        OcComplex odd = { 0.5f * (zk.imag - zc.imag), -0.5f * (zk.real - zc.real) };
+        OcComplex t = cmul(odd, plan->twiddles[k]);
+        OcComplex mirrorEven = cconj(even);
+        OcComplex mirrorT = cmul(cconj(odd), plan->twiddles[h - k]);
+        Output[k] = (OcComplex){ even.real + t.real, even.imag + t.imag };
+        Output[h - k] = (OcComplex){ mirrorEven.real + mirrorT.real, mirrorEven.imag + mirrorT.imag };
+    }
+}
+
+// Unnormalized inverse of fftRealForward: n / 2 + 1 bins into n real samples scaled by n
+static void fftRealInverse(const OcFFTPlan* plan, const OcComplex* Input, float* Output, OcComplex* Work) {
+    int n = plan->n;
+    if (plan->sub == NULL || plan->sub->n * 2 != n) {
+        OcComplex* full = Work;
+        OcComplex* signal = Work + n;
+        for (int k = 0; k < n; k++) {
+            full[k] = k <= n / 2 ? Input[k] : cconj(Input[n - k]);
+        }
+        fftComplex(plan->sub, full, signal, true, Work + 2 * n);
+        for (int k = 0; k < n; k++) {
+            Output[k] = signal[k].real;
+        }
+        return;
+    }
+
+    int h = n / 2;
+    OcComplex* packed = Work;
+    OcComplex* signal = Work + h;
+    for (int k = 0; k < h; k++) {
+        OcComplex xk = Input[k];
+        OcComplex xc = cconj(Input[h - k]);
+        OcComplex even = { xk.real + xc.real, xk.imag + xc.imag };
+        OcComplex odd = cmul((OcComplex){ xk.real - xc.real, xk.imag - xc.imag }, cconj(plan->twiddles[k]));
+        packed[k] = (OcComplex){ even.real - odd.imag, even.imag + odd.real };
+    }
+    fftComplex(plan->sub, packed, signal, true, Work + 2 * h);
+    for (int k = 0; k < h; k++) {
+        Output[2 * k] = signal[k].real;
+        Output[2 * k + 1] = signal[k].imag;
+    }
+}
+
+static OC_STATUS createPlan(int n, bool real, OcFFTPlan** Plan) {
+    if (Plan == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
     }
-    
-    if (!isPowerOfTwo(n)) {
+    *Plan = NULL;
+    if (n <= 0) {
         return OC_STATUS_ERR_INVALIDPARAMETER;
     }
-    
-    // Bit-reversal permutation
-    bitReverse(data, n);
-    
-    // FFT computation
-    for (int len = 2; len <= n; len <<= 1) {
-        double angle = (inverse ? 2.0 : -2.0) * M_PI / len;
-        OcComplex wlen = {cos(angle), sin(angle)};
-        
-        for (int i = 0; i < n; i += len) {
-            OcComplex w = {1.0, 0.0};
-            
-            for (int j = 0; j < len / 2; j++) {
-                OcComplex u = data[i + j];
-                OcComplex v = {
-                    data[i + j + len / 2].real * w.real - data[i + j + len / 2].imag * w.imag,
-                    data[i + j + len / 2].real * w.imag + data[i + j + len / 2].imag * w.real
-                };
-                
-                data[i + j] = (OcComplex){u.real + v.real, u.imag + v.imag};
-                data[i + j + len / 2] = (OcComplex){u.real - v.real, u.imag - v.imag};
-                
-                // Update w = w * wlen
-                OcComplex temp_w = {
-                    w.real * wlen.real - w.imag * wlen.imag,
-                    w.real * wlen.imag + w.imag * wlen.real
-                };
-                w = temp_w;
+
+    OcFFTPlan* plan = (OcFFTPlan*)calloc(1, sizeof(OcFFTPlan));
+    if (plan == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    plan->n = n;
+    plan->real = real;
+
+    OC_STATUS status = OC_STATUS_OK;
+    plan->twiddles = (OcComplex*)malloc(2 * (size_t)n * sizeof(OcComplex));
+    if (plan->twiddles == NULL) {
+        status = OC_STATUS_ERR_OUTOFMEMORY;
+    } else {
+        // Every entry is computed directly in double precision rather than by repeated multiplication
+        for (int k = 0; k < n; k++) {
+            double angle = -2.0 * M_PI * k / n;
+            plan->twiddles[k] = (OcComplex){ (float)cos(angle), (float)sin(angle) };
+            plan->twiddles[n + k] = cconj(plan->twiddles[k]);
+        }
+    }
+
+    if (status == OC_STATUS_OK && real) {
+        if (n % 2 == 0 && n > 2) {
+            status = createPlan(n / 2, false, &plan->sub);
+            if (status == OC_STATUS_OK)
+                plan->workSize = (size_t)n + plan->sub->workSize;
+        } else {
+            status = createPlan(n, false, &plan->sub);
+            if (status == OC_STATUS_OK)
+                plan->workSize = 2 * (size_t)n + plan->sub->workSize;
+        }
+    } else if (status == OC_STATUS_OK && !factorize(plan)) {
+        int m = 1;
+        while (m < 2 * n - 1) {
+            m <<= 1;
+        }
+        plan->chirp = (OcComplex*)malloc((size_t)n * sizeof(OcComplex));
+        plan->chirpFFT = (OcComplex*)malloc((size_t)m * sizeof(OcComplex));
+        OcComplex* b = (OcComplex*)calloc(m, sizeof(OcComplex));
+        if (plan->chirp == NULL || plan->chirpFFT == NULL || b == NULL) {
+            status = OC_STATUS_ERR_OUTOFMEMORY;
+        } else {
+            status = createPlan(m, false, &plan->sub);
+        }
+        if (status == OC_STATUS_OK) {
+            for (int k = 0; k < n; k++) {
+                // k^2 is reduced modulo 2n first so large lengths keep their precision
+                double angle = -M_PI * (double)(((long long)k * k) % (2LL * n)) / n;
+                plan->chirp[k] = (OcComplex){ (float)cos(angle), (float)sin(angle) };
+            }
+            b[0] = cconj(plan->chirp[0]);
+            for (int k = 1; k < n; k++) {
+                b[k] = cconj(plan->chirp[k]);
+                b[m - k] = b[k];
+            }
+            fftComplex(plan->sub, b, plan->chirpFFT, false, NULL);
+            for (int k = 0; k < m; k++) {
+                plan->chirpFFT[k].real /= m;
+                plan->chirpFFT[k].imag /= m;
             }
+            plan->workSize = 2 * (size_t)m;
         }
+        free(b);
     }
-    
+
+    if (status != OC_STATUS_OK) {
+        ocularFreeFFTPlan(&plan);
+        return status;
+    }
+    *Plan = plan;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularCreateFFTPlan(int n, OcFFTPlan** Plan) {
+    return createPlan(n, false, Plan);
+}
+
+OC_STATUS ocularCreateRealFFTPlan(int n, OcFFTPlan** Plan) {
+    return createPlan(n, true, Plan);
+}
+
+OC_STATUS ocularFreeFFTPlan(OcFFTPlan** Plan) {
+    if (Plan == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    OcFFTPlan* plan = *Plan;
+    if (plan != NULL) {
+        ocularFreeFFTPlan(&plan->sub);
+        free(plan->twiddles);
+        free(plan->chirp);
+        free(plan->chirpFFT);
+        free(plan);
+        *Plan = NULL;
+    }
+    return OC_STATUS_OK;
+}
+
+// The transforms below keep the last plan of each role, so a stream of same-sized images does not rebuild them
+enum { FFT_PLAN_ROWS, FFT_PLAN_COLUMNS, FFT_PLAN_ROLES };
+static OcFFTPlan* cachedPlans[FFT_PLAN_ROLES] = { NULL };
+
+// Takes the cached plan of a role if it has this length and kind, otherwise creates one. Return it with releasePlan().
+static OC_STATUS acquirePlan(int Role, int n, bool real, OcFFTPlan** Plan) {
+    OcFFTPlan* plan = (OcFFTPlan*)OcAtomicExchangePointer(&cachedPlans[Role], NULL);
+    if (plan != NULL && plan->n == n && plan->real == real) {
+        *Plan = plan;
+        return OC_STATUS_OK;
+    }
+    ocularFreeFFTPlan(&plan);
+    return createPlan(n, real, Plan);
+}
+
+static void releasePlan(int Role, OcFFTPlan** Plan) {
+    if (*Plan == NULL)
+        return;
+    OcFFTPlan* previous = (OcFFTPlan*)OcAtomicExchangePointer(&cachedPlans[Role], *Plan);
+    ocularFreeFFTPlan(&previous);
+    *Plan = NULL;
+}
+
+// OcComplex work entries a plan of this length and kind needs, without building it
+static size_t planWorkSize(int n, bool real) {
+    if (real) {
+        if (n % 2 == 0 && n > 2)
+            return (size_t)n + planWorkSize(n / 2, false);
+        return 2 * (size_t)n + planWorkSize(n, false);
+    }
+    OcFFTPlan plan;
+    plan.n = n;
+    if (factorize(&plan))
+        return 0;
+    int m = 1;
+    while (m < 2 * n - 1) {
+        m <<= 1;
+    }
+    return 2 * (size_t)m;
+}
+
+OC_STATUS ocularFFTExecute(const OcFFTPlan* Plan, const OcComplex* Input, OcComplex* Output, bool inverse) {
+    if (Plan == NULL || Input == NULL || Output == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Plan->real || Input == Output) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    OcComplex* Work = NULL;
+    if (Plan->workSize > 0) {
+        Work = (OcComplex*)ScratchAlloc(Plan->workSize * sizeof(OcComplex), false);
+        if (Work == NULL) {
+            return OC_STATUS_ERR_OUTOFMEMORY;
+        }
+    }
+    fftComplex(Plan, Input, Output, inverse, Work);
+    ScratchFree(Work);
+
     // Normalize for inverse FFT
     if (inverse) {
-        for (int i = 0; i < n; i++) {
-            data[i].real /= n;
-            data[i].imag /= n;
+        float scale = 1.0f / Plan->n;
+        for (int i = 0; i < Plan->n; i++) {
+            Output[i].real *= scale;
+            Output[i].imag *= scale;
         }
     }
-    
     return OC_STATUS_OK;
 }
 
-// 2D FFT implementation
-OC_STATUS ocularFFT2D(OcComplex* data, int width, int height, bool inverse) {
-    if (data == NULL || width <= 0 || height <= 0) {
+OC_STATUS ocularFFTExecuteReal(const OcFFTPlan* Plan, const float* Input, OcComplex* Output) {
+    if (Plan == NULL || Input == NULL || Output == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
     }
-    
-    // FFT on rows
-    for (int y = 0; y < height; y++) {
-        OC_STATUS status = ocularFFT(&data[y * width], width, inverse);
-        if (status != OC_STATUS_OK) {
-            return status;
-        }
+    if (!Plan->real) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
     }
-    
-    // Allocate temporary column buffer
-    OcComplex* column = (OcComplex*)malloc(height * sizeof(OcComplex));
-    if (column == NULL) {
+
+    OcComplex* Work = (OcComplex*)ScratchAlloc(Plan->workSize * sizeof(OcComplex), false);
+    if (Work == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
-    
-    // FFT on columns
-    for (int x = 0; x < width; x++) {
-        // Extract column
-        for (int y = 0; y < height; y++) {
-            column[y] = data[y * width + x];
+    fftRealForward(Plan, Input, Output, Work);
+    ScratchFree(Work);
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularFFTExecuteRealInverse(const OcFFTPlan* Plan, const OcComplex* Input, float* Output) {
+    if (Plan == NULL || Input == NULL || Output == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (!Plan->real) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    OcComplex* Work = (OcComplex*)ScratchAlloc(Plan->workSize * sizeof(OcComplex), false);
+    if (Work == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    fftRealInverse(Plan, Input, Output, Work);
+    ScratchFree(Work);
+
+    float scale = 1.0f / Plan->n;
+    for (int i = 0; i < Plan->n; i++) {
+        Output[i] *= scale;
+    }
+    return OC_STATUS_OK;
+}
+
+// Core 1D FFT for a single transform of any length. Transforms of many lines should create a plan once instead.
+OC_STATUS ocularFFT(OcComplex* data, int n, bool inverse) {
+    if (data == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (n <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    OcFFTPlan* plan = NULL;
+    OC_STATUS status = acquirePlan(FFT_PLAN_ROWS, n, false, &plan);
+    if (status != OC_STATUS_OK) {
+        return status;
+    }
+    OcComplex* copy = (OcComplex*)ScratchAlloc((size_t)n * sizeof(OcComplex), false);
+    if (copy == NULL) {
+        releasePlan(FFT_PLAN_ROWS, &plan);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    memcpy(copy, data, (size_t)n * sizeof(OcComplex));
+    status = ocularFFTExecute(plan, copy, data, inverse);
+    ScratchFree(copy);
+    releasePlan(FFT_PLAN_ROWS, &plan);
+    return status;
+}
+
+//--------------------------2D transforms--------------------------
+
+typedef struct {
+    OcComplex* Data;
+    int Width;        // complex entries per row
+    int Height;
+    const OcFFTPlan* RowPlan;
+    const OcFFTPlan* ColumnPlan;
+    bool Inverse;
+    // Real image filtering: rows are real samples that become Width spectrum entries, and the columns are multiplied by Kernel
+    // between their forward and inverse transforms
+    float* Samples;
+    const OcComplex* Kernel;
+    OcComplex* Scratch;
+    size_t ScratchSize;
+} FFT2DJob;
+
+static void fftRows(void* Context, int Begin, int End, int Thread) {
+    FFT2DJob* job = (FFT2DJob*)Context;
+    OcComplex* line = job->Scratch + (size_t)Thread * job->ScratchSize;
+    OcComplex* work = line + job->Width;
+    for (int y = Begin; y < End; y++) {
+        OcComplex* row = job->Data + (size_t)y * job->Width;
+        memcpy(line, row, (size_t)job->Width * sizeof(OcComplex));
+        fftComplex(job->RowPlan, line, row, job->Inverse, work);
+    }
+}
+
+static void fftRealRowsForward(void* Context, int Begin, int End, int Thread) {
+    FFT2DJob* job = (FFT2DJob*)Context;
+    OcComplex* work = job->Scratch + (size_t)Thread * job->ScratchSize;
+    int n = job->RowPlan->n;
+    for (int y = Begin; y < End; y++) {
+        fftRealForward(job->RowPlan, job->Samples + (size_t)y * n, job->Data + (size_t)y * job->Width, work);
+    }
+}
+
+static void fftRealRowsInverse(void* Context, int Begin, int End, int Thread) {
+    FFT2DJob* job = (FFT2DJob*)Context;
+    OcComplex* work = job->Scratch + (size_t)Thread * job->ScratchSize;
+    int n = job->RowPlan->n;
+    for (int y = Begin; y < End; y++) {
+        fftRealInverse(job->RowPlan, job->Data + (size_t)y * job->Width, job->Samples + (size_t)y * n, work);
+    }
+}
+
+// Column passes work on blocks of FFT_COLUMN_BLOCK columns: the block is transposed into scratch a few rows at a time so every
+// column becomes contiguous, transformed there, and transposed back.
+static void fftColumns(void* Context, int Begin, int End, int Thread) {
+    FFT2DJob* job = (FFT2DJob*)Context;
+    int Height = job->Height;
+    OcComplex* block = job->Scratch + (size_t)Thread * job->ScratchSize;
+    OcComplex* line = block + (size_t)FFT_COLUMN_BLOCK * Height;
+    OcComplex* work = line + Height;
+
+    for (int b = Begin; b < End; b++) {
+        int x0 = b * FFT_COLUMN_BLOCK;
+        int columns = min(FFT_COLUMN_BLOCK, job->Width - x0);
+        for (int y = 0; y < Height; y++) {
+            const OcComplex* row = job->Data + (size_t)y * job->Width + x0;
+            for (int i = 0; i < columns; i++) {
+                block[(size_t)i * Height + y] = row[i];
+            }
         }
-        
-        // Apply FFT to column
-        OC_STATUS status = ocularFFT(column, height, inverse);
-        if (status != OC_STATUS_OK) {
-            free(column);
-            return status;
+
+        for (int i = 0; i < columns; i++) {
+            OcComplex* column = block + (size_t)i * Height;
+            if (job->Kernel == NULL) {
+                fftComplex(job->ColumnPlan, column, line, job->Inverse, work);
+                memcpy(column, line, (size_t)Height * sizeof(OcComplex));
+            } else {
+                const OcComplex* kernel = job->Kernel + x0 + i;
+                fftComplex(job->ColumnPlan, column, line, false, work);
+                for (int y = 0; y < Height; y++) {
+                    line[y] = cmul(line[y], kernel[(size_t)y * job->Width]);
+                }
+                fftComplex(job->ColumnPlan, line, column, true, work);
+            }
         }
-        
-        // Put column back
-        for (int y = 0; y < height; y++) {
-            data[y * width + x] = column[y];
+
+        for (int y = 0; y < Height; y++) {
+            OcComplex* row = job->Data + (size_t)y * job->Width + x0;
+            for (int i = 0; i < columns; i++) {
+                row[i] = block[(size_t)i * Height + y];
+            }
         }
     }
-    
-    free(column);
+}
+
+static OC_STATUS runFFT2D(FFT2DJob* job, OcParallelBody Body, int Count, int Grain, size_t ScratchSize) {
+    job->ScratchSize = ScratchSize;
+    job->Scratch = (OcComplex*)ScratchAlloc(ScratchSize * ocularGetThreadCount() * sizeof(OcComplex), false);
+    if (job->Scratch == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    ocularParallelFor(Count, Grain, Body, job);
+    ScratchFree(job->Scratch);
     return OC_STATUS_OK;
 }
 
+static size_t columnScratchSize(const FFT2DJob* job) {
+    return (size_t)(FFT_COLUMN_BLOCK + 1) * job->Height + job->ColumnPlan->workSize;
+}
+
+// Arena bytes of one runFFT2D() pass with ScratchSize entries per thread
+static size_t passScratchSize(size_t ScratchSize) {
+    return ScratchBlockSize(ScratchSize * ocularGetThreadCount() * sizeof(OcComplex));
+}
+
+static int columnBlocks(const FFT2DJob* job) {
+    return (job->Width + FFT_COLUMN_BLOCK - 1) / FFT_COLUMN_BLOCK;
+}
+
+// 2D FFT implementation
+OC_STATUS ocularFFT2D(OcComplex* data, int width, int height, bool inverse) {
+    if (data == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (width <= 0 || height <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    FFT2DJob job = { data, width, height, NULL, NULL, inverse, NULL, NULL, NULL, 0 };
+    OcFFTPlan* rowPlan = NULL;
+    OcFFTPlan* columnPlan = NULL;
+    OC_STATUS status = acquirePlan(FFT_PLAN_ROWS, width, false, &rowPlan);
+    if (status == OC_STATUS_OK)
+        status = acquirePlan(FFT_PLAN_COLUMNS, height, false, &columnPlan);
+    job.RowPlan = rowPlan;
+    job.ColumnPlan = columnPlan;
+
+    if (status == OC_STATUS_OK)
+        status = runFFT2D(&job, fftRows, height, 4, (size_t)width + rowPlan->workSize);
+    if (status == OC_STATUS_OK)
+        status = runFFT2D(&job, fftColumns, columnBlocks(&job), 1, columnScratchSize(&job));
+
+    // Normalize for inverse FFT
+    if (status == OC_STATUS_OK && inverse) {
+        float scale = 1.0f / ((float)width * height);
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+            data[i].real *= scale;
+            data[i].imag *= scale;
+        }
+    }
+
+    releasePlan(FFT_PLAN_ROWS, &rowPlan);
+    releasePlan(FFT_PLAN_COLUMNS, &columnPlan);
+    return status;
+}
+
+// Value of the filter kernel at (x, y) of a width x height kernel
+static float fftFilterValue(const OcFFTFilterParams* params, int x, int y, int width, int height) {
+    int centerX = width / 2;
+    int centerY = height / 2;
+
+    // Calculate distance from center (normalized frequency)
+    float dx = (float)(x - centerX) / width;
+    float dy = (float)(y - centerY) / height;
+    float freq = sqrt(dx * dx + dy * dy);
+
+    float filterValue = 0.0f;
+    
+    switch (params->filterType) {
+        case OC_FFT_LOWPASS:
+            if (freq <= params->cutoffFreq) {
+                filterValue = 1.0f;
+            } else {
+                // Smooth rolloff
+                float rolloff = (freq - params->cutoffFreq) * params->sharpness;
+                filterValue = exp(-rolloff * rolloff);
+            }
+            break;
+            
+        case OC_FFT_HIGHPASS:
+            if (freq >= params->cutoffFreq) {
+                filterValue = 1.0f;
+            } else {
+                // Smooth rolloff
+                float rolloff = (params->cutoffFreq - freq) * params->sharpness;
+                filterValue = 1.0f - exp(-rolloff * rolloff);
+            }
+            break;
+            
+        case OC_FFT_BANDPASS:
+            if (freq >= params->cutoffFreq && freq <= params->cutoffFreq2) {
+                filterValue = 1.0f;
+            } else {
+                float rolloff1 = (params->cutoffFreq - freq) * params->sharpness;
+                float rolloff2 = (freq - params->cutoffFreq2) * params->sharpness;
+                filterValue = exp(-rolloff1 * rolloff1) * exp(-rolloff2 * rolloff2);
+            }
+            break;
+            
+        case OC_FFT_BANDSTOP:
+            if (freq >= params->cutoffFreq && freq <= params->cutoffFreq2) {
+                float rolloff = fmin((freq - params->cutoffFreq), (params->cutoffFreq2 - freq)) * params->sharpness;
+                filterValue = 1.0f - exp(-rolloff * rolloff);
+            } else {
+                filterValue = 1.0f;
+            }
+            break;
+            
+        case OC_FFT_CUSTOM:
+            // Use custom kernel if provided
+            if (params->customKernel != NULL && params->kernelSize > 0) {
+                int kernelX = (x * params->kernelSize) / width;
+                int kernelY = (y * params->kernelSize) / height;
+                if (kernelX < params->kernelSize && kernelY < params->kernelSize) {
+                    filterValue = params->customKernel[kernelY * params->kernelSize + kernelX];
+                }
+            }
+            break;
+    }
+
+    return filterValue;
+}
+
 // Create FFT filter kernel based on parameters
 OC_STATUS ocularCreateFFTFilterKernel(OcFFTFilterParams* params, int width, int height, OcComplex** kernel) {
-    if (params == NULL || kernel == NULL || width <= 0 || height <= 0) {
+    if (params == NULL || kernel == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
     }
+    if (width <= 0 || height <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
     
-    *kernel = (OcComplex*)calloc(width * height, sizeof(OcComplex));
+    *kernel = (OcComplex*)calloc((size_t)width * height, sizeof(OcComplex));
     if (*kernel == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
     
-    int centerX = width / 2;
-    int centerY = height / 2;
-    
     for (int y = 0; y < height; y++) {
         for (int x = 0; x < width; x++) {
-            // Calculate distance from center (normalized frequency)
-            float dx = (float)(x - centerX) / width;
-            float dy = (float)(y - centerY) / height;
-            float freq = sqrt(dx * dx + dy * dy);
-            
-            float filterValue = 0.0f;
-            
-            switch (params->filterType) {
-                case OC_FFT_LOWPASS:
-                    if (freq <= params->cutoffFreq) {
-                        filterValue = 1.0f;
-                    } else {
-                        // Smooth rolloff
-                        float rolloff = (freq - params->cutoffFreq) * params->sharpness;
-                        filterValue = exp(-rolloff * rolloff);
-                    }
-                    break;
-                    
-                case OC_FFT_HIGHPASS:
-                    if (freq >= params->cutoffFreq) {
-                        filterValue = 1.0f;
-                    } else {
-                        // Smooth rolloff
-                        float rolloff = (params->cutoffFreq - freq) * params->sharpness;
-                        filterValue = 1.0f - exp(-rolloff * rolloff);
-                    }
-                    break;
-                    
-                case OC_FFT_BANDPASS:
-                    if (freq >= params->cutoffFreq && freq <= params->cutoffFreq2) {
-                        filterValue = 1.0f;
-                    } else {
-                        float rolloff1 = (params->cutoffFreq - freq) * params->sharpness;
-                        float rolloff2 = (freq - params->cutoffFreq2) * params->sharpness;
-                        filterValue = exp(-rolloff1 * rolloff1) * exp(-rolloff2 * rolloff2);
-                    }
-                    break;
-                    
-                case OC_FFT_BANDSTOP:
-                    if (freq >= params->cutoffFreq && freq <= params->cutoffFreq2) {
-                        float rolloff = fmin((freq - params->cutoffFreq), (params->cutoffFreq2 - freq)) * params->sharpness;
-                        filterValue = 1.0f - exp(-rolloff * rolloff);
-                    } else {
-                        filterValue = 1.0f;
-                    }
-                    break;
-                    
-                case OC_FFT_CUSTOM:
-                    // Use custom kernel if provided
-                    if (params->customKernel != NULL && params->kernelSize > 0) {
-                        int kernelX = (x * params->kernelSize) / width;
-                        int kernelY = (y * params->kernelSize) / height;
-                        if (kernelX < params->kernelSize && kernelY < params->kernelSize) {
-                            filterValue = params->customKernel[kernelY * params->kernelSize + kernelX];
-                        }
-                    }
-                    break;
-            }
-            
-            (*kernel)[y * width + x].real = filterValue;
-            (*kernel)[y * width + x].imag = 0.0f;
+            (*kernel)[(size_t)y * width + x].real = fftFilterValue(params, x, y, width, height);
+            (*kernel)[(size_t)y * width + x].imag = 0.0f;
         }
     }
     
@@ -249,6 +802,95 @@ OC_STATUS ocularApplyFFTKernel(OcComplex* imageFFT, OcComplex* kernel, int width
     return OC_STATUS_OK;
 }
 
+// Forward transform of one real image plane into its Width / 2 + 1 column half spectrum. With a Kernel the columns are filtered
+// and transformed back as well, and the rows are then inverted into Samples.
+static OC_STATUS realFFT2D(float* Samples, OcComplex* Spectrum, int Width, int Height, const OcComplex* Kernel) {
+    FFT2DJob job = { Spectrum, Width / 2 + 1, Height, NULL, NULL, false, Samples, Kernel, NULL, 0 };
+    OcFFTPlan* rowPlan = NULL;
+    OcFFTPlan* columnPlan = NULL;
+    OC_STATUS status = acquirePlan(FFT_PLAN_ROWS, Width, true, &rowPlan);
+    if (status == OC_STATUS_OK)
+        status = acquirePlan(FFT_PLAN_COLUMNS, Height, false, &columnPlan);
+    job.RowPlan = rowPlan;
+    job.ColumnPlan = columnPlan;
+
+    if (status == OC_STATUS_OK)
+        status = runFFT2D(&job, fftRealRowsForward, Height, 4, rowPlan->workSize);
+    if (status == OC_STATUS_OK)
+        status = runFFT2D(&job, fftColumns, columnBlocks(&job), 1, columnScratchSize(&job));
+    if (status == OC_STATUS_OK && Kernel != NULL)
+        status = runFFT2D(&job, fftRealRowsInverse, Height, 4, rowPlan->workSize);
+
+    releasePlan(FFT_PLAN_ROWS, &rowPlan);
+    releasePlan(FFT_PLAN_COLUMNS, &columnPlan);
+    return status;
+}
+
+// Peak scratch of realFFT2D(); its passes run one after the other
+static size_t realFFT2DScratchSize(int Width, int Height) {
+    size_t rows = passScratchSize(planWorkSize(Width, true));
+    size_t columns = passScratchSize((size_t)(FFT_COLUMN_BLOCK + 1) * Height + planWorkSize(Height, false));
+    return max(rows, columns);
+}
+
+OC_STATUS ocularFFTReal2D(const float* Input, OcComplex* Output, int Width, int Height) {
+    if (Input == NULL || Output == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Width <= 0 || Height <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+    // Samples are only read when no kernel is given
+    return realFFT2D((float*)Input, Output, Width, Height, NULL);
+}
+
+OC_STATUS ocularFFTFilterReal2D(float* Data, int Width, int Height, const OcComplex* Spectrum) {
+    if (Data == NULL || Spectrum == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Width <= 0 || Height <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    size_t specSize = (size_t)(Width / 2 + 1) * Height;
+    OcComplex* kernel = (OcComplex*)ScratchAlloc(specSize * sizeof(OcComplex), false);
+    OcComplex* spectrum = (OcComplex*)ScratchAlloc(specSize * sizeof(OcComplex), false);
+    if (kernel == NULL || spectrum == NULL) {
+        ScratchFree(kernel);
+        ScratchFree(spectrum);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    // The inverse transform's normalization is folded into the multiplier
+    float scale = 1.0f / ((float)Width * Height);
+    for (size_t i = 0; i < specSize; i++) {
+        kernel[i] = (OcComplex){ Spectrum[i].real * scale, Spectrum[i].imag * scale };
+    }
+    OC_STATUS status = realFFT2D(Data, spectrum, Width, Height, kernel);
+    ScratchFree(kernel);
+    ScratchFree(spectrum);
+    return status;
+}
+
+size_t fftReal2DScratchSize(int Width, int Height) {
+    return realFFT2DScratchSize(Width, Height);
+}
+
+size_t fftFilterReal2DScratchSize(int Width, int Height) {
+    size_t specSize = (size_t)(Width / 2 + 1) * Height;
+    return 2 * ScratchBlockSize(specSize * sizeof(OcComplex)) + realFFT2DScratchSize(Width, Height);
+}
+
+int ocularFFTGoodSize(int n) {
+    for (int size = max(n, 1);; size++) {
+        int m = size;
+        while (m % 2 == 0) m /= 2;
+        while (m % 3 == 0) m /= 3;
+        while (m % 5 == 0) m /= 5;
+        if (m == 1)
+            return size;
+    }
+}
+
 // Main FFT filter function
 OC_STATUS ocularFFTFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, OcFFTFilterParams* params) {
     if (Input == NULL || Output == NULL || params == NULL) {
@@ -264,55 +906,43 @@ OC_STATUS ocularFFTFilter(unsigned char* Input, unsigned char* Output, int Width
         return OC_STATUS_ERR_NOTSUPPORTED;
     }
     
-    // Find next power of 2 for FFT dimensions
-    int fftWidth = nextPowerOfTwo(Width);
-    int fftHeight = nextPowerOfTwo(Height);
-    
-    // Allocate FFT buffers
-    OcComplex* imageFFT = (OcComplex*)calloc(fftWidth * fftHeight, sizeof(OcComplex));
-    OcComplex* kernel = NULL;
-    
-    if (imageFFT == NULL) {
-        return OC_STATUS_ERR_OUTOFMEMORY;
-    }
+    // The transforms handle any size, so the image is filtered at its own size instead of being padded to a power of two.
+    // The pixels are real, so only the Width / 2 + 1 columns of the half spectrum are computed.
+    int specWidth = Width / 2 + 1;
+    size_t pixels = (size_t)Width * Height;
+    float* samples = (float*)ScratchAlloc(pixels * sizeof(float), false);
+    OcComplex* spectrum = (OcComplex*)ScratchAlloc((size_t)specWidth * Height * sizeof(OcComplex), false);
+    OcComplex* halfKernel = (OcComplex*)ScratchAlloc((size_t)specWidth * Height * sizeof(OcComplex), false);
     
     OC_STATUS status = OC_STATUS_OK;
+    if (samples == NULL || spectrum == NULL || halfKernel == NULL) {
+        status = OC_STATUS_ERR_OUTOFMEMORY;
+    }
     
-    // Create filter kernel
-    status = ocularCreateFFTFilterKernel(params, fftWidth, fftHeight, &kernel);
-    if (status != OC_STATUS_OK) {
-        free(imageFFT);
-        return status;
+    if (status == OC_STATUS_OK) {
+        // The real part of a full complex filter pass equals filtering with the kernel averaged with its point reflection,
+        // which is what the half spectrum needs. The 1 / (Width * Height) of the inverse transform is folded in as well.
+        float scale = 0.5f / (float)pixels;
+        for (int y = 0; y < Height; y++) {
+            int mirrorY = (Height - y) % Height;
+            for (int x = 0; x < specWidth; x++) {
+                int mirrorX = (Width - x) % Width;
+                halfKernel[(size_t)y * specWidth + x].real =
+                    (fftFilterValue(params, x, y, Width, Height) + fftFilterValue(params, mirrorX, mirrorY, Width, Height)) * scale;
+                halfKernel[(size_t)y * specWidth + x].imag = 0.0f;
+            }
+        }
     }
     
     // Process each channel separately
-    for (int c = 0; c < Channels; c++) {
-        // Copy image data to FFT buffer (zero-padded)
-        memset(imageFFT, 0, fftWidth * fftHeight * sizeof(OcComplex));
-        
+    for (int c = 0; c < Channels && status == OC_STATUS_OK; c++) {
         for (int y = 0; y < Height; y++) {
             for (int x = 0; x < Width; x++) {
-                int srcIdx = y * Stride + x * Channels + c;
-                int dstIdx = y * fftWidth + x;
-                imageFFT[dstIdx].real = (float)Input[srcIdx] / 255.0f;
-                imageFFT[dstIdx].imag = 0.0f;
+                samples[(size_t)y * Width + x] = (float)Input[y * Stride + x * Channels + c] / 255.0f;
             }
         }
         
-        // Forward FFT
-        status = ocularFFT2D(imageFFT, fftWidth, fftHeight, false);
-        if (status != OC_STATUS_OK) {
-            break;
-        }
-        
-        // Apply filter kernel
-        status = ocularApplyFFTKernel(imageFFT, kernel, fftWidth, fftHeight);
-        if (status != OC_STATUS_OK) {
-            break;
-        }
-        
-        // Inverse FFT
-        status = ocularFFT2D(imageFFT, fftWidth, fftHeight, true);
+        status = realFFT2D(samples, spectrum, Width, Height, halfKernel);
         if (status != OC_STATUS_OK) {
             break;
         }
@@ -320,23 +950,27 @@ OC_STATUS ocularFFTFilter(unsigned char* Input, unsigned char* Output, int Width
         // Copy result back to output image
         for (int y = 0; y < Height; y++) {
             for (int x = 0; x < Width; x++) {
-                int srcIdx = y * fftWidth + x;
-                int dstIdx = y * Stride + x * Channels + c;
-                
                 // Convert back to 8-bit and clamp
-                float value = imageFFT[srcIdx].real * 255.0f;
-                Output[dstIdx] = (unsigned char)ClampToByte((int)(value + 0.5f));
+                float value = samples[(size_t)y * Width + x] * 255.0f;
+                Output[y * Stride + x * Channels + c] = (unsigned char)ClampToByte((int)(value + 0.5f));
             }
         }
     }
     
     // Cleanup
-    free(imageFFT);
-    free(kernel);
+    ScratchFree(samples);
+    ScratchFree(spectrum);
+    ScratchFree(halfKernel);
     
     return status;
 }
 
+size_t fftFilterScratchSize(int Width, int Height) {
+    size_t specSize = (size_t)(Width / 2 + 1) * Height;
+    return ScratchBlockSize((size_t)Width * Height * sizeof(float)) + 2 * ScratchBlockSize(specSize * sizeof(OcComplex)) +
+           realFFT2DScratchSize(Width, Height);
+}
+
 // Visualize frequency domain (magnitude spectrum)
 OC_STATUS ocularFFTVisualize(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, bool logScale) {
     if (Input == NULL || Output == NULL) {
@@ -352,13 +986,12 @@ OC_STATUS ocularFFTVisualize(unsigned char* Input, unsigned char* Output, int Wi
         return OC_STATUS_ERR_NOTSUPPORTED;
     }
     
-    // Find next power of 2 for FFT dimensions
-    int fftWidth = nextPowerOfTwo(Width);
-    int fftHeight = nextPowerOfTwo(Height);
-    
-    // Allocate FFT buffer
-    OcComplex* imageFFT = (OcComplex*)calloc(fftWidth * fftHeight, sizeof(OcComplex));
-    if (imageFFT == NULL) {
+    int specWidth = Width / 2 + 1;
+    float* samples = (float*)ScratchAlloc((size_t)Width * Height * sizeof(float), false);
+    OcComplex* spectrum = (OcComplex*)ScratchAlloc((size_t)specWidth * Height * sizeof(OcComplex), false);
+    if (samples == NULL || spectrum == NULL) {
+        ScratchFree(samples);
+        ScratchFree(spectrum);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
     
@@ -366,64 +999,52 @@ OC_STATUS ocularFFTVisualize(unsigned char* Input, unsigned char* Output, int Wi
     for (int y = 0; y < Height; y++) {
         for (int x = 0; x < Width; x++) {
             int srcIdx = y * Stride + x * Channels;
-            int dstIdx = y * fftWidth + x;
             
             if (Channels == 1) {
-                imageFFT[dstIdx].real = (float)Input[srcIdx] / 255.0f;
+                samples[(size_t)y * Width + x] = (float)Input[srcIdx] / 255.0f;
             } else {
                 // Convert to grayscale using luminance formula
-                float gray = (0.299f * Input[srcIdx] + 0.587f * Input[srcIdx + 1] + 0.114f * Input[srcIdx + 2]) / 255.0f;
-                imageFFT[dstIdx].real = gray;
+                samples[(size_t)y * Width + x] = (0.299f * Input[srcIdx] + 0.587f * Input[srcIdx + 1] + 0.114f * Input[srcIdx + 2]) / 255.0f;
             }
-            imageFFT[dstIdx].imag = 0.0f;
         }
     }
     
     // Forward FFT
-    OC_STATUS status = ocularFFT2D(imageFFT, fftWidth, fftHeight, false);
+    OC_STATUS status = realFFT2D(samples, spectrum, Width, Height, NULL);
     if (status != OC_STATUS_OK) {
-        free(imageFFT);
+        ScratchFree(samples);
+        ScratchFree(spectrum);
         return status;
     }
     
-    // Calculate magnitude spectrum and find max for normalization
+    // Calculate magnitude spectrum and find max for normalization. The other half of the spectrum mirrors this one.
     float maxMagnitude = 0.0f;
-    for (int i = 0; i < fftWidth * fftHeight; i++) {
-        float magnitude = sqrt(imageFFT[i].real * imageFFT[i].real + imageFFT[i].imag * imageFFT[i].imag);
+    for (size_t i = 0; i < (size_t)specWidth * Height; i++) {
+        float magnitude = sqrt(spectrum[i].real * spectrum[i].real + spectrum[i].imag * spectrum[i].imag);
         if (magnitude > maxMagnitude) {
             maxMagnitude = magnitude;
         }
     }
     
     // Create visualization with DC component at center (fftshift)
-    // We need to map from output coordinates to FFT coordinates
-    // The goal is to put DC (0,0) at the center of the output image
-    
+    int centerX = Width / 2;
+    int centerY = Height / 2;
     for (int y = 0; y < Height; y++) {
         for (int x = 0; x < Width; x++) {
-            // Calculate the position relative to the center of the output image
-            int centerX = Width / 2;
-            int centerY = Height / 2;
-            
-            // Calculate offset from center
-            int offsetX = x - centerX;
-            int offsetY = y - centerY;
+            // Negative offsets from the center map to the end of the spectrum (due to periodicity)
+            int fftX = x - centerX;
+            int fftY = y - centerY;
+            fftX = fftX >= 0 ? fftX : Width + fftX;
+            fftY = fftY >= 0 ? fftY : Height + fftY;
             
-            // Map to FFT coordinates
-            // Positive offsets map to positive FFT coordinates
-            // Negative offsets map to the end of the FFT array (due to periodicity)
-            int fftX = offsetX >= 0 ? offsetX : fftWidth + offsetX;
-            int fftY = offsetY >= 0 ? offsetY : fftHeight + offsetY;
-            
-            // Clamp to valid bounds
-            fftX = fftX < 0 ? 0 : (fftX >= fftWidth ? fftWidth - 1 : fftX);
-            fftY = fftY < 0 ? 0 : (fftY >= fftHeight ? fftHeight - 1 : fftY);
-            
-            int fftIdx = fftY * fftWidth + fftX;
+            // Columns past the half spectrum have the magnitude of their point reflection
+            if (fftX >= specWidth) {
+                fftX = Width - fftX;
+                fftY = (Height - fftY) % Height;
+            }
             
-            // Calculate magnitude
-            float magnitude = sqrt(imageFFT[fftIdx].real * imageFFT[fftIdx].real + 
-                                 imageFFT[fftIdx].imag * imageFFT[fftIdx].imag);
+            OcComplex value = spectrum[(size_t)fftY * specWidth + fftX];
+            float magnitude = sqrt(value.real * value.real + value.imag * value.imag);
             
             // Normalize and apply scaling
             float normalized = magnitude / (maxMagnitude + 1e-10f);
@@ -443,7 +1064,13 @@ OC_STATUS ocularFFTVisualize(unsigned char* Input, unsigned char* Output, int Wi
         }
     }
     
-    free(imageFFT);
+    ScratchFree(samples);
+    ScratchFree(spectrum);
     return OC_STATUS_OK;
 }
 
+size_t fftVisualizeScratchSize(int Width, int Height) {
+    size_t specSize = (size_t)(Width / 2 + 1) * Height;
+    return ScratchBlockSize((size_t)Width * Height * sizeof(float)) + ScratchBlockSize(specSize * sizeof(OcComplex)) +
+           realFFT2DScratchSize(Width, Height);
+}
@@ -45,7 +45,34 @@ typedef struct {
     float sharpness;        // Filter sharpness/rolloff (1.0 = sharp, higher = smoother)
 } OcFFTFilterParams;
 
-// Core FFT functions
+/**
+ * @brief Precomputed twiddles and factorization for transforms of one length. Lengths are split into radix 2, 3, 4 and 5
+ * stages plus direct butterflies for other small primes; lengths with a prime factor above 64 use Bluestein's algorithm.
+ * A plan is read-only once created and can be shared by several threads.
+ */
+typedef struct OcFFTPlan OcFFTPlan;
+
+// FFT plans
+OC_STATUS ocularCreateFFTPlan(int n, OcFFTPlan** Plan);
+// Plan for transforms of n real samples to and from their n / 2 + 1 non-redundant bins
+OC_STATUS ocularCreateRealFFTPlan(int n, OcFFTPlan** Plan);
+OC_STATUS ocularFreeFFTPlan(OcFFTPlan** Plan);
+// Input and Output must not overlap. Inverse transforms are normalized by 1 / n. The work buffer of an execution comes
+// from the workspace attached to the calling thread, so repeated executions with one attached allocate nothing.
+OC_STATUS ocularFFTExecute(const OcFFTPlan* Plan, const OcComplex* Input, OcComplex* Output, bool inverse);
+OC_STATUS ocularFFTExecuteReal(const OcFFTPlan* Plan, const float* Input, OcComplex* Output);
+OC_STATUS ocularFFTExecuteRealInverse(const OcFFTPlan* Plan, const OcComplex* Input, float* Output);
+
+// Smallest length >= n made of factors 2, 3 and 5, the lengths the plans transform fastest
+int ocularFFTGoodSize(int n);
+
+// Forward 2D transform of a real Width x Height plane into its (Width / 2 + 1) x Height half spectrum
+OC_STATUS ocularFFTReal2D(const float* Input, OcComplex* Output, int Width, int Height);
+// Multiplies the transform of a real plane by a half spectrum (e.g. a kernel transformed with ocularFFTReal2D()) and transforms
+// it back in place, i.e. a circular convolution
+OC_STATUS ocularFFTFilterReal2D(float* Data, int Width, int Height, const OcComplex* Spectrum);
+
+// Core FFT functions, for any length
 OC_STATUS ocularFFT(OcComplex* data, int n, bool inverse);
 OC_STATUS ocularFFT2D(OcComplex* data, int width, int height, bool inverse);
 
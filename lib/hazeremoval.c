@@ -1,54 +1,150 @@
 #include "hazeremoval.h"
 #include "core.h"
+#include "workspace.h"
+#include "parallel.h"
+#include "util.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <float.h>
 
-// Applies minimum filter horizontally across image rows with specified radius
-void minFilterHorizontal(float* input, float* output, int width, int height, int radius) {
-    if (!input || !output || width <= 0 || height <= 0)
-        return;
-
-    for (int y = 0; y < height; y++) {
+// Minimum filters use the van Herk/Gil-Werman scheme: the line is padded by radius on both sides and cut into blocks of
+// 2 * radius + 1 samples. Every window then spans at most two blocks, so its minimum is the suffix minimum of the first block
+// and the prefix minimum of the second, three comparisons per sample whatever the radius.
+
+// Columns handled together by the vertical pass
+#define MIN_FILTER_STRIP 64
+
+typedef struct {
+    const float* Input;
+    float* Output;
+    float* Buffers; // per thread prefix and suffix minimums
+    size_t BufferSize;
+    int Width;
+    int Height;
+    int Radius;
+} MinFilterParams;
+
+static void minFilterRows(void* Context, int Begin, int End, int Thread) {
+    const MinFilterParams* p = (const MinFilterParams*)Context;
+    int width = p->Width, radius = p->Radius;
+    int size = 2 * radius + 1;
+    int length = width + 2 * radius;
+    float* line = p->Buffers + Thread * p->BufferSize;
+    float* prefix = line + length;
+    float* suffix = prefix + length;
+
+    for (int i = 0; i < radius; i++) {
+        line[i] = FLT_MAX;
+        line[width + radius + i] = FLT_MAX;
+    }
+    for (int y = Begin; y < End; y++) {
+        float* out = p->Output + (size_t)y * width;
+        memcpy(line + radius, p->Input + (size_t)y * width, width * sizeof(float));
+        for (int start = 0; start < length; start += size) {
+            int end = min(start + size, length);
+            prefix[start] = line[start];
+            for (int i = start + 1; i < end; i++)
+                prefix[i] = fminf(prefix[i - 1], line[i]);
+            suffix[end - 1] = line[end - 1];
+            for (int i = end - 2; i >= start; i--)
+                suffix[i] = fminf(suffix[i + 1], line[i]);
+        }
         for (int x = 0; x < width; x++) {
-            int startX = (x - radius < 0) ? 0 : x - radius;
-            int endX = (x + radius >= width) ? width - 1 : x + radius;
-
-            if (startX <= endX && startX >= 0 && endX < width) {
-                float minVal = input[y * width + startX]; // Initialize with first valid value
-                for (int kx = startX + 1; kx <= endX; kx++) {
-                    minVal = fminf(minVal, input[y * width + kx]);
-                }
-                output[y * width + x] = minVal;
+            out[x] = fminf(suffix[x], prefix[x + 2 * radius]);
+        }
+    }
+}
+
+static void minFilterColumns(void* Context, int Begin, int End, int Thread) {
+    const MinFilterParams* p = (const MinFilterParams*)Context;
+    int width = p->Width, height = p->Height, radius = p->Radius;
+    int size = 2 * radius + 1;
+    int length = height + 2 * radius;
+    float* prefix = p->Buffers + Thread * p->BufferSize;
+    float* suffix = prefix + (size_t)length * MIN_FILTER_STRIP;
+
+    for (int strip = Begin; strip < End; strip++) {
+        int x0 = strip * MIN_FILTER_STRIP;
+        int count = min(MIN_FILTER_STRIP, width - x0);
+        for (int i = 0; i < length; i++) {
+            float* pre = prefix + (size_t)i * MIN_FILTER_STRIP;
+            if (i < radius || i >= height + radius) {
+                for (int x = 0; x < count; x++)
+                    pre[x] = (i % size == 0) ? FLT_MAX : pre[x - MIN_FILTER_STRIP];
+                continue;
+            }
+            const float* in = p->Input + (size_t)(i - radius) * width + x0;
+            if (i % size == 0) {
+                memcpy(pre, in, count * sizeof(float));
             } else {
-                output[y * width + x] = (startX >= 0 && startX < width) ? input[y * width + startX] : 0.0f;
+                for (int x = 0; x < count; x++)
+                    pre[x] = fminf(pre[x - MIN_FILTER_STRIP], in[x]);
             }
         }
+        for (int i = length - 1; i >= 0; i--) {
+            float* suf = suffix + (size_t)i * MIN_FILTER_STRIP;
+            bool blockEnd = (i % size == size - 1 || i == length - 1);
+            if (i < radius || i >= height + radius) {
+                for (int x = 0; x < count; x++)
+                    suf[x] = blockEnd ? FLT_MAX : suf[x + MIN_FILTER_STRIP];
+                continue;
+            }
+            const float* in = p->Input + (size_t)(i - radius) * width + x0;
+            if (blockEnd) {
+                memcpy(suf, in, count * sizeof(float));
+            } else {
+                for (int x = 0; x < count; x++)
+                    suf[x] = fminf(suf[x + MIN_FILTER_STRIP], in[x]);
+            }
+        }
+        for (int y = 0; y < height; y++) {
+            const float* suf = suffix + (size_t)y * MIN_FILTER_STRIP;
+            const float* pre = prefix + (size_t)(y + 2 * radius) * MIN_FILTER_STRIP;
+            float* out = p->Output + (size_t)y * width + x0;
+            for (int x = 0; x < count; x++)
+                out[x] = fminf(suf[x], pre[x]);
+        }
     }
 }
 
+// Applies minimum filter horizontally across image rows with specified radius
+void minFilterHorizontal(float* input, float* output, int width, int height, int radius) {
+    if (!input || !output || width <= 0 || height <= 0)
+        return;
+
+    radius = max(radius, 0);
+    size_t bufferSize = 3 * ((size_t)width + 2 * radius);
+    float* buffers = (float*)ScratchAlloc(ocularGetThreadCount() * bufferSize * sizeof(float), false);
+    if (!buffers)
+        return;
+
+    MinFilterParams params = { input, output, buffers, bufferSize, width, height, radius };
+    ocularParallelFor(height, 16, minFilterRows, &params);
+    ScratchFree(buffers);
+}
+
 // Applies minimum filter vertically across image columns with specified radius
 void minFilterVertical(float* input, float* output, int width, int height, int radius) {
     if (!input || !output || width <= 0 || height <= 0)
         return;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int startY = (y - radius < 0) ? 0 : y - radius;
-            int endY = (y + radius >= height) ? height - 1 : y + radius;
-
-            if (startY <= endY && startY >= 0 && endY < height) {
-                float minVal = input[startY * width + x]; // Initialize with first valid value
-                for (int ky = startY + 1; ky <= endY; ky++) {
-                    minVal = fminf(minVal, input[ky * width + x]);
-                }
-                output[y * width + x] = minVal;
-            } else {
-                output[y * width + x] = (startY >= 0 && startY < height) ? input[startY * width + x] : 0.0f;
-            }
-        }
-    }
+    radius = max(radius, 0);
+    size_t bufferSize = 2 * ((size_t)height + 2 * radius) * MIN_FILTER_STRIP;
+    float* buffers = (float*)ScratchAlloc(ocularGetThreadCount() * bufferSize * sizeof(float), false);
+    if (!buffers)
+        return;
+
+    MinFilterParams params = { input, output, buffers, bufferSize, width, height, radius };
+    ocularParallelFor((width + MIN_FILTER_STRIP - 1) / MIN_FILTER_STRIP, 1, minFilterColumns, &params);
+    ScratchFree(buffers);
+}
+
+// Peak scratch of minFilterHorizontal() or minFilterVertical(), whichever takes more
+static size_t minFilterScratchSize(int width, int height, int radius) {
+    size_t rows = ScratchBlockSize(ocularGetThreadCount() * 3 * ((size_t)width + 2 * radius) * sizeof(float));
+    size_t columns = ScratchBlockSize(ocularGetThreadCount() * 2 * ((size_t)height + 2 * radius) * MIN_FILTER_STRIP * sizeof(float));
+    return max(rows, columns);
 }
 
 // Computes dark channel prior by finding minimum RGB values in local neighborhoods using separable filters
@@ -68,14 +164,19 @@ void calculateDarkChannelFast(unsigned char* input, float* darkChannel, int widt
     }
 
     // Apply separable minimum filter
-    float* temp = (float*)malloc(size * sizeof(float));
+    float* temp = (float*)ScratchAlloc(size * sizeof(float), false);
     if (temp) {
         minFilterHorizontal(darkChannel, temp, width, height, radius);
         minFilterVertical(temp, darkChannel, width, height, radius);
-        free(temp);
+        ScratchFree(temp);
     }
 }
 
+size_t darkChannelScratchSize(int width, int height, int radius) {
+    // estimateTransmissionFast() takes the same
+    return ScratchBlockSize((size_t)width * height * sizeof(float)) + minFilterScratchSize(width, height, max(radius, 0));
+}
+
 // Estimates atmospheric light value by finding brightest pixels in top 0.1% of dark channel
 float estimateAtmosphericLight(unsigned char* input, float* darkChannel, int width, int height, int stride, float maxAtm) {
     int channels = stride / width;
@@ -86,57 +187,40 @@ float estimateAtmosphericLight(unsigned char* input, float* darkChannel, int wid
     if (topPixelCount < 1)
         topPixelCount = 1;
 
-    // Create array of dark channel values with positions
-    typedef struct {
-        float value;
-        int index;
-    } PixelValue;
-
-    PixelValue* pixels = (PixelValue*)malloc(totalPixels * sizeof(PixelValue));
-    if (!pixels)
-        return 0.8f; // fallback value
-
+    // The dark channel holds byte values scaled to [0, 1], so a histogram finds the value that bounds the brightest pixels
+    int histogram[256] = { 0 };
     for (int i = 0; i < totalPixels; i++) {
-        pixels[i].value = darkChannel[i];
-        pixels[i].index = i;
+        histogram[(int)(darkChannel[i] * 255.0f + 0.5f)]++;
     }
-
-    // Simple selection sort for top pixels (efficient for small counts)
-    int sortCount = (topPixelCount < totalPixels) ? topPixelCount : totalPixels;
-    for (int i = 0; i < sortCount - 1; i++) {
-        int maxIdx = i;
-        for (int j = i + 1; j < totalPixels; j++) {
-            if (pixels[j].value > pixels[maxIdx].value) {
-                maxIdx = j;
-            }
-        }
-        if (maxIdx != i) {
-            PixelValue temp = pixels[i];
-            pixels[i] = pixels[maxIdx];
-            pixels[maxIdx] = temp;
-        }
+    int threshold = 255;
+    int aboveCount = 0; // pixels brighter than the threshold
+    while (threshold > 0 && aboveCount + histogram[threshold] < topPixelCount) {
+        aboveCount += histogram[threshold--];
     }
+    // Pixels equal to the threshold fill the remaining places in scan order
+    int tiesLeft = topPixelCount - aboveCount;
 
     // Find the pixel with highest intensity among the top dark channel pixels
     float maxIntensity = 0.0f;
-    int actualCount = (topPixelCount < totalPixels) ? topPixelCount : totalPixels;
-    for (int i = 0; i < actualCount; i++) {
-        int pixelIdx = pixels[i].index;
-        int y = pixelIdx / width;
-        int x = pixelIdx % width;
-        int imgIdx = y * stride + x * channels;
-
-        float intensity = (float)input[imgIdx]; // R
-        if (channels >= 3) {
-            intensity = fmaxf(intensity, (float)input[imgIdx + 1]); // G
-            intensity = fmaxf(intensity, (float)input[imgIdx + 2]); // B
-        }
+    for (int y = 0; y < height; y++) {
+        const float* dark = darkChannel + (size_t)y * width;
+        const unsigned char* row = input + (size_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            int value = (int)(dark[x] * 255.0f + 0.5f);
+            if (value < threshold || (value == threshold && tiesLeft-- <= 0))
+                continue;
+
+            const unsigned char* pixel = row + x * channels;
+            float intensity = (float)pixel[0]; // R
+            if (channels >= 3) {
+                intensity = fmaxf(intensity, (float)pixel[1]); // G
+                intensity = fmaxf(intensity, (float)pixel[2]); // B
+            }
 
-        maxIntensity = fmaxf(maxIntensity, intensity);
+            maxIntensity = fmaxf(maxIntensity, intensity);
+        }
     }
 
-    free(pixels);
-
     float atmLight = maxIntensity / 255.0f;
     return fminf(atmLight, maxAtm);
 }
@@ -159,11 +243,11 @@ void estimateTransmissionFast(unsigned char* input, float* transmission, int wid
     }
 
     // Apply separable minimum filter
-    float* temp = (float*)malloc(size * sizeof(float));
+    float* temp = (float*)ScratchAlloc(size * sizeof(float), false);
     if (temp) {
         minFilterHorizontal(transmission, temp, width, height, radius);
         minFilterVertical(temp, transmission, width, height, radius);
-        free(temp);
+        ScratchFree(temp);
     }
 
     // Apply omega factor and compute final transmission
@@ -172,88 +256,232 @@ void estimateTransmissionFast(unsigned char* input, float* transmission, int wid
     }
 }
 
-// Applies separable box filter for fast mean filtering with specified radius
-void boxFilterFast(float* input, float* output, int width, int height, int radius) {
-    int size = width * height;
-    float* temp = (float*)malloc(size * sizeof(float));
-    if (!temp) {
-        memcpy(output, input, size * sizeof(float));
-        return;
+typedef struct {
+    const float* Input;
+    float* Output;
+    float* Temp;         // horizontal means
+    double* Sums;        // running column sums of the vertical pass
+    const float* InvCountX;
+    const float* InvCountY;
+    int Width;
+    int Height;
+    int Radius;
+} BoxMeanParams;
+
+static void boxMeanRows(void* Context, int Begin, int End, int Thread) {
+    (void)Thread;
+    const BoxMeanParams* p = (const BoxMeanParams*)Context;
+    int width = p->Width, radius = p->Radius;
+
+    for (int y = Begin; y < End; y++) {
+        const float* in = p->Input + (size_t)y * width;
+        float* out = p->Temp + (size_t)y * width;
+        double sum = 0;
+        for (int x = 0; x <= radius && x < width; x++)
+            sum += in[x];
+        for (int x = 0; x < width; x++) {
+            out[x] = (float)(sum * p->InvCountX[x]);
+            if (x + radius + 1 < width)
+                sum += in[x + radius + 1];
+            if (x - radius >= 0)
+                sum -= in[x - radius];
+        }
     }
+}
 
-    // Horizontal pass
+static void boxMeanColumns(void* Context, int Begin, int End, int Thread) {
+    (void)Thread;
+    const BoxMeanParams* p = (const BoxMeanParams*)Context;
+    int width = p->Width, height = p->Height, radius = p->Radius;
+    double* sums = p->Sums;
+
+    for (int x = Begin; x < End; x++)
+        sums[x] = 0;
+    for (int y = 0; y <= radius && y < height; y++) {
+        const float* in = p->Temp + (size_t)y * width;
+        for (int x = Begin; x < End; x++)
+            sums[x] += in[x];
+    }
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float sum = 0.0f;
-            int count = 0;
-            int startX = (x - radius < 0) ? 0 : x - radius;
-            int endX = (x + radius >= width) ? width - 1 : x + radius;
-
-            for (int kx = startX; kx <= endX; kx++) {
-                sum += input[y * width + kx];
-                count++;
-            }
-            temp[y * width + x] = (count > 0) ? sum / count : 0.0f;
+        float* out = p->Output + (size_t)y * width;
+        double scale = p->InvCountY[y];
+        for (int x = Begin; x < End; x++)
+            out[x] = (float)(sums[x] * scale);
+        if (y + radius + 1 < height) {
+            const float* in = p->Temp + (size_t)(y + radius + 1) * width;
+            for (int x = Begin; x < End; x++)
+                sums[x] += in[x];
+        }
+        if (y - radius >= 0) {
+            const float* in = p->Temp + (size_t)(y - radius) * width;
+            for (int x = Begin; x < End; x++)
+                sums[x] -= in[x];
         }
     }
+}
 
-    // Vertical pass
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            float sum = 0.0f;
-            int count = 0;
-            int startY = (y - radius < 0) ? 0 : y - radius;
-            int endY = (y + radius >= height) ? height - 1 : y + radius;
-
-            for (int ky = startY; ky <= endY; ky++) {
-                sum += temp[ky * width + x];
-                count++;
-            }
-            output[y * width + x] = (count > 0) ? sum / count : 0.0f;
+// Mean over the (2 * radius + 1)^2 window clipped to the image, with running sums so the cost does not depend on the radius.
+// Output may be the same buffer as input.
+void boxFilterFast(float* input, float* output, int width, int height, int radius) {
+    size_t size = (size_t)width * height;
+    float* temp = (float*)ScratchAlloc(size * sizeof(float), false);
+    double* sums = (double*)ScratchAlloc(width * sizeof(double), false);
+    float* invCountX = (float*)ScratchAlloc(width * sizeof(float), false);
+    float* invCountY = (float*)ScratchAlloc(height * sizeof(float), false);
+    if (!temp || !sums || !invCountX || !invCountY) {
+        if (output != input)
+            memcpy(output, input, size * sizeof(float));
+        ScratchFree(temp);
+        ScratchFree(sums);
+        ScratchFree(invCountX);
+        ScratchFree(invCountY);
+        return;
+    }
+
+    for (int x = 0; x < width; x++)
+        invCountX[x] = 1.0f / (min(x + radius, width - 1) - max(x - radius, 0) + 1);
+    for (int y = 0; y < height; y++)
+        invCountY[y] = 1.0f / (min(y + radius, height - 1) - max(y - radius, 0) + 1);
+
+    BoxMeanParams params = { input, output, temp, sums, invCountX, invCountY, width, height, radius };
+    ocularParallelFor(height, 16, boxMeanRows, &params);
+    ocularParallelFor(width, 64, boxMeanColumns, &params);
+
+    ScratchFree(temp);
+    ScratchFree(sums);
+    ScratchFree(invCountX);
+    ScratchFree(invCountY);
+}
+
+static size_t boxFilterScratchSize(int width, int height) {
+    return ScratchBlockSize((size_t)width * height * sizeof(float)) + ScratchBlockSize((size_t)width * sizeof(double)) +
+           ScratchBlockSize((size_t)width * sizeof(float)) + ScratchBlockSize((size_t)height * sizeof(float));
+}
+
+typedef struct {
+    const float* Input;
+    const float* Guide;
+    float* Output;
+    float* LowInput;  // input and guide sampled every Subsample pixels
+    float* LowGuide;
+    const float* MeanA; // smoothed coefficients at the low resolution
+    const float* MeanB;
+    const int* X0;    // horizontal interpolation taps and weights of every output column
+    const int* X1;
+    const float* WeightX;
+    float* Rows;      // two rows of lowWidth floats per thread
+    int Width;
+    int Height;
+    int LowWidth;
+    int LowHeight;
+    int Subsample;
+} GuidedParams;
+
+static void guidedDownsampleRows(void* Context, int Begin, int End, int Thread) {
+    (void)Thread;
+    const GuidedParams* p = (const GuidedParams*)Context;
+    int s = p->Subsample;
+
+    // Point sampling at the block centers keeps the local variance of fine texture, which block averages would smooth away
+    for (int ly = Begin; ly < End; ly++) {
+        int y = min(ly * s + s / 2, p->Height - 1);
+        const float* in = p->Input + (size_t)y * p->Width;
+        const float* guide = p->Guide + (size_t)y * p->Width;
+        float* lowIn = p->LowInput + (size_t)ly * p->LowWidth;
+        float* lowGuide = p->LowGuide + (size_t)ly * p->LowWidth;
+        for (int lx = 0; lx < p->LowWidth; lx++) {
+            int x = min(lx * s + s / 2, p->Width - 1);
+            lowIn[lx] = in[x];
+            lowGuide[lx] = guide[x];
         }
     }
+}
 
-    free(temp);
+static void guidedUpsampleRows(void* Context, int Begin, int End, int Thread) {
+    const GuidedParams* p = (const GuidedParams*)Context;
+    int lowWidth = p->LowWidth;
+    float* rowA = p->Rows + (size_t)Thread * 2 * lowWidth;
+    float* rowB = rowA + lowWidth;
+
+    for (int y = Begin; y < End; y++) {
+        // low resolution pixel ly was sampled at ly * Subsample + Subsample / 2
+        float fy = clamp((float)(y - p->Subsample / 2) / p->Subsample, 0.0f, (float)(p->LowHeight - 1));
+        int y0 = (int)fy;
+        int y1 = min(y0 + 1, p->LowHeight - 1);
+        float wy = fy - y0;
+        const float* a0 = p->MeanA + (size_t)y0 * lowWidth;
+        const float* a1 = p->MeanA + (size_t)y1 * lowWidth;
+        const float* b0 = p->MeanB + (size_t)y0 * lowWidth;
+        const float* b1 = p->MeanB + (size_t)y1 * lowWidth;
+        for (int x = 0; x < lowWidth; x++) {
+            rowA[x] = a0[x] + (a1[x] - a0[x]) * wy;
+            rowB[x] = b0[x] + (b1[x] - b0[x]) * wy;
+        }
+
+        const float* guide = p->Guide + (size_t)y * p->Width;
+        float* out = p->Output + (size_t)y * p->Width;
+        for (int x = 0; x < p->Width; x++) {
+            int x0 = p->X0[x], x1 = p->X1[x];
+            float wx = p->WeightX[x];
+            float a = rowA[x0] + (rowA[x1] - rowA[x0]) * wx;
+            float b = rowB[x0] + (rowB[x1] - rowB[x0]) * wx;
+            out[x] = a * guide[x] + b;
+        }
+    }
 }
 
-// Performs edge-preserving smoothing using guided filter with guide image and regularization parameter
-void guidedFilterFast(float* input, float* guide, float* output, int width, int height, int radius, float epsilon) {
-    int size = width * height;
-    float* meanI = (float*)malloc(size * sizeof(float));
-    float* meanP = (float*)malloc(size * sizeof(float));
-    float* meanIp = (float*)malloc(size * sizeof(float));
-    float* meanII = (float*)malloc(size * sizeof(float));
-    float* corrIp = (float*)malloc(size * sizeof(float));
-    float* corrII = (float*)malloc(size * sizeof(float));
-
-    if (!meanI || !meanP || !meanIp || !meanII || !corrIp || !corrII) {
+// Performs edge-preserving smoothing using guided filter with guide image and regularization parameter.
+// With subsample > 1 the linear coefficients are computed on input and guide sampled every subsample pixels, with the radius
+// scaled down to match, then bilinearly upsampled and applied to the full resolution guide (the fast guided filter
+// of He and Sun). Output may be the same buffer as input, but not as guide.
+void guidedFilterFast(float* input, float* guide, float* output, int width, int height, int radius, float epsilon, int subsample) {
+    int s = clamp(subsample, 1, max(radius, 1));
+    int lowWidth = (width + s - 1) / s;
+    int lowHeight = (height + s - 1) / s;
+    int lowRadius = max((radius + s / 2) / s, 1);
+    size_t size = (size_t)lowWidth * lowHeight;
+    int threads = ocularGetThreadCount();
+
+    float* lowInput = (s > 1) ? (float*)ScratchAlloc(size * sizeof(float), false) : input;
+    float* lowGuide = (s > 1) ? (float*)ScratchAlloc(size * sizeof(float), false) : guide;
+    float* meanI = (float*)ScratchAlloc(size * sizeof(float), false);
+    float* meanP = (float*)ScratchAlloc(size * sizeof(float), false);
+    float* corrIp = (float*)ScratchAlloc(size * sizeof(float), false);
+    float* corrII = (float*)ScratchAlloc(size * sizeof(float), false);
+    int* x0 = (s > 1) ? (int*)ScratchAlloc(width * sizeof(int), false) : NULL;
+    int* x1 = (s > 1) ? (int*)ScratchAlloc(width * sizeof(int), false) : NULL;
+    float* weightX = (s > 1) ? (float*)ScratchAlloc(width * sizeof(float), false) : NULL;
+    float* rows = (s > 1) ? (float*)ScratchAlloc((size_t)threads * 2 * lowWidth * sizeof(float), false) : NULL;
+
+    if (!lowInput || !lowGuide || !meanI || !meanP || !corrIp || !corrII || (s > 1 && (!x0 || !x1 || !weightX || !rows))) {
         // Fallback: copy input to output
-        memcpy(output, input, size * sizeof(float));
-        free(meanI);
-        free(meanP);
-        free(meanIp);
-        free(meanII);
-        free(corrIp);
-        free(corrII);
-        return;
+        if (output != input)
+            memcpy(output, input, (size_t)width * height * sizeof(float));
+        goto cleanup;
+    }
+
+    GuidedParams params = { input, guide, output, lowInput, lowGuide, meanI, meanP, x0, x1, weightX, rows,
+                            width, height, lowWidth, lowHeight, s };
+    if (s > 1) {
+        ocularParallelFor(lowHeight, 4, guidedDownsampleRows, &params);
     }
 
     // Compute correlation and cross-correlation
-    for (int i = 0; i < size; i++) {
-        corrIp[i] = guide[i] * input[i];
-        corrII[i] = guide[i] * guide[i];
+    for (size_t i = 0; i < size; i++) {
+        corrIp[i] = lowGuide[i] * lowInput[i];
+        corrII[i] = lowGuide[i] * lowGuide[i];
     }
 
     // Apply box filter to all terms
-    boxFilterFast(guide, meanI, width, height, radius);
-    boxFilterFast(input, meanP, width, height, radius);
-    boxFilterFast(corrIp, meanIp, width, height, radius);
-    boxFilterFast(corrII, meanII, width, height, radius);
+    boxFilterFast(lowGuide, meanI, lowWidth, lowHeight, lowRadius);
+    boxFilterFast(lowInput, meanP, lowWidth, lowHeight, lowRadius);
+    boxFilterFast(corrIp, corrIp, lowWidth, lowHeight, lowRadius);
+    boxFilterFast(corrII, corrII, lowWidth, lowHeight, lowRadius);
 
     // Calculate linear coefficients
-    for (int i = 0; i < size; i++) {
-        float varI = meanII[i] - meanI[i] * meanI[i];
-        float covIp = meanIp[i] - meanI[i] * meanP[i];
+    for (size_t i = 0; i < size; i++) {
+        float varI = corrII[i] - meanI[i] * meanI[i];
+        float covIp = corrIp[i] - meanI[i] * meanP[i];
 
         float a = covIp / (varI + epsilon);
         float b = meanP[i] - a * meanI[i];
@@ -263,42 +491,89 @@ void guidedFilterFast(float* input, float* guide, float* output, int width, int
     }
 
     // Apply box filter to coefficients
-    boxFilterFast(corrIp, meanI, width, height, radius); // mean_a
-    boxFilterFast(corrII, meanP, width, height, radius); // mean_b
+    boxFilterFast(corrIp, meanI, lowWidth, lowHeight, lowRadius); // mean_a
+    boxFilterFast(corrII, meanP, lowWidth, lowHeight, lowRadius); // mean_b
 
     // Compute final result
-    for (int i = 0; i < size; i++) {
-        output[i] = meanI[i] * guide[i] + meanP[i];
+    if (s == 1) {
+        for (size_t i = 0; i < size; i++) {
+            output[i] = meanI[i] * guide[i] + meanP[i];
+        }
+    } else {
+        for (int x = 0; x < width; x++) {
+            float fx = clamp((float)(x - s / 2) / s, 0.0f, (float)(lowWidth - 1));
+            x0[x] = (int)fx;
+            x1[x] = min(x0[x] + 1, lowWidth - 1);
+            weightX[x] = fx - x0[x];
+        }
+        ocularParallelFor(height, 16, guidedUpsampleRows, &params);
     }
 
-    free(meanI);
-    free(meanP);
-    free(meanIp);
-    free(meanII);
-    free(corrIp);
-    free(corrII);
+cleanup:
+    if (s > 1) {
+        ScratchFree(lowInput);
+        ScratchFree(lowGuide);
+    }
+    ScratchFree(meanI);
+    ScratchFree(meanP);
+    ScratchFree(corrIp);
+    ScratchFree(corrII);
+    ScratchFree(x0);
+    ScratchFree(x1);
+    ScratchFree(weightX);
+    ScratchFree(rows);
 }
 
-// Recovers haze-free scene radiance using transmission map and atmospheric light estimation
-void recoverScene(unsigned char* input, unsigned char* output, int width, int height, int stride, float* transmission, float atmLight, float t0) {
-    int channels = stride / width;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int idx = y * stride + x * channels;
-            int tIdx = y * width + x;
+size_t guidedFilterFastScratchSize(int width, int height, int subsample) {
+    int s = max(subsample, 1);
+    int lowWidth = (width + s - 1) / s;
+    int lowHeight = (height + s - 1) / s;
+    size_t plane = ScratchBlockSize((size_t)lowWidth * lowHeight * sizeof(float));
+    size_t size = 4 * plane + boxFilterScratchSize(lowWidth, lowHeight);
+    if (s > 1) {
+        size += 2 * plane + 2 * ScratchBlockSize((size_t)width * sizeof(int)) + ScratchBlockSize((size_t)width * sizeof(float)) +
+                ScratchBlockSize((size_t)ocularGetThreadCount() * 2 * lowWidth * sizeof(float));
+    }
+    return size;
+}
 
-            float t = fmaxf(transmission[tIdx], t0);
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    const float* Transmission;
+    int Width;
+    int Stride;
+    float AtmLight;
+    float T0;
+} RecoverParams;
+
+static void recoverSceneRows(void* Context, int Begin, int End, int Thread) {
+    (void)Thread;
+    const RecoverParams* p = (const RecoverParams*)Context;
+    int channels = p->Stride / p->Width;
+    float atmLight = p->AtmLight;
+
+    for (int y = Begin; y < End; y++) {
+        const unsigned char* in = p->Input + (size_t)y * p->Stride;
+        unsigned char* out = p->Output + (size_t)y * p->Stride;
+        const float* transmission = p->Transmission + (size_t)y * p->Width;
+        for (int x = 0; x < p->Width; x++, in += channels, out += channels) {
+            float invT = 1.0f / fmaxf(transmission[x], p->T0);
 
             for (int c = 0; c < channels; c++) {
-                float I = (float)input[idx + c] / 255.0f;
-                float J = (I - atmLight) / t + atmLight;
+                float I = (float)in[c] / 255.0f;
+                float J = (I - atmLight) * invT + atmLight;
 
                 // Clamp result to valid range
                 J = fmaxf(0.0f, fminf(1.0f, J));
-                output[idx + c] = (unsigned char)(J * 255.0f + 0.5f);
+                out[c] = (unsigned char)(J * 255.0f + 0.5f);
             }
         }
     }
 }
 
+// Recovers haze-free scene radiance using transmission map and atmospheric light estimation
+void recoverScene(unsigned char* input, unsigned char* output, int width, int height, int stride, float* transmission, float atmLight, float t0) {
+    RecoverParams params = { input, output, transmission, width, stride, atmLight, t0 };
+    ocularParallelFor(height, 16, recoverSceneRows, &params);
+}
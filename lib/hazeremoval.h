@@ -26,9 +26,14 @@ float estimateAtmosphericLight(unsigned char* input, float* darkChannel, int wid
 void estimateTransmissionFast(unsigned char* input, float* transmission, int width, int height, int stride, 
                              float atmLight, int radius, float omega);
 void boxFilterFast(float* input, float* output, int width, int height, int radius);
-void guidedFilterFast(float* input, float* guide, float* output, int width, int height, int radius, float epsilon);
+void guidedFilterFast(float* input, float* guide, float* output, int width, int height, int radius, float epsilon, int subsample);
 void recoverScene(unsigned char* input, unsigned char* output, int width, int height, int stride,
                  float* transmission, float atmLight, float t0);
 
+// Peak scratch of calculateDarkChannelFast(), and of estimateTransmissionFast()
+size_t darkChannelScratchSize(int width, int height, int radius);
+// Peak scratch of guidedFilterFast() with subsample already clamped to [1, radius]
+size_t guidedFilterFastScratchSize(int width, int height, int subsample);
+
 
 #endif /* OCULAR_HAZEREMOVAL_H */
@@ -0,0 +1,274 @@
+/**
+ * @file: image_io.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Memory-mapped PGM, PPM and PAM images.
+ */
+
+#include "image_io.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TOKEN_SIZE 32
+
+// Maps a whole file. Private mappings are copy-on-write, so they can be written to without changing the file. A non-zero
+// CreateSize replaces the file with a new one of that size
+static OC_STATUS mapFile(const char* FileName, bool Writable, size_t CreateSize, unsigned char** Mapping, size_t* MappingSize) {
+#ifdef _WIN32
+    HANDLE File = CreateFileA(FileName, Writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+                              CreateSize != 0 ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+        return OC_STATUS_ERR_FILENOTFOUND;
+
+    LARGE_INTEGER Size;
+    if (CreateSize != 0)
+        Size.QuadPart = (LONGLONG)CreateSize;
+    else if (!GetFileSizeEx(File, &Size)) {
+        CloseHandle(File);
+        return OC_STATUS_ERR_UNKNOWN;
+    }
+    if (Size.QuadPart <= 0 || (unsigned long long)Size.QuadPart > SIZE_MAX) {
+        CloseHandle(File);
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    // The view keeps the file open, so both handles can be closed once it is mapped
+    HANDLE Map = CreateFileMappingA(File, NULL, Writable ? PAGE_READWRITE : PAGE_WRITECOPY, (DWORD)(Size.QuadPart >> 32),
+                                    (DWORD)(Size.QuadPart & 0xFFFFFFFF), NULL);
+    CloseHandle(File);
+    if (Map == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    void* View = MapViewOfFile(Map, Writable ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, (SIZE_T)Size.QuadPart);
+    CloseHandle(Map);
+    if (View == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    *Mapping = (unsigned char*)View;
+    *MappingSize = (size_t)Size.QuadPart;
+    return OC_STATUS_OK;
+#else
+    int Flags = CreateSize != 0 ? O_RDWR | O_CREAT | O_TRUNC : (Writable ? O_RDWR : O_RDONLY);
+    int File = open(FileName, Flags, 0644);
+    if (File < 0)
+        return OC_STATUS_ERR_FILENOTFOUND;
+
+    size_t Size = CreateSize;
+    if (CreateSize != 0) {
+        if (ftruncate(File, (off_t)CreateSize) != 0) {
+            close(File);
+            return OC_STATUS_ERR_OUTOFMEMORY;
+        }
+    } else {
+        struct stat Info;
+        if (fstat(File, &Info) != 0) {
+            close(File);
+            return OC_STATUS_ERR_UNKNOWN;
+        }
+        if (Info.st_size <= 0 || (unsigned long long)Info.st_size > SIZE_MAX) {
+            close(File);
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        }
+        Size = (size_t)Info.st_size;
+    }
+
+    // The mapping keeps the file open, so the descriptor can be closed once it is mapped
+    void* View = mmap(NULL, Size, PROT_READ | PROT_WRITE, Writable ? MAP_SHARED : MAP_PRIVATE, File, 0);
+    close(File);
+    if (View == MAP_FAILED)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    *Mapping = (unsigned char*)View;
+    *MappingSize = Size;
+    return OC_STATUS_OK;
+#endif
+}
+
+void unmapImageFile(void* Mapping, size_t MappingSize) {
+    if (Mapping == NULL)
+        return;
+#ifdef _WIN32
+    (void)MappingSize;
+    UnmapViewOfFile(Mapping);
+#else
+    munmap(Mapping, MappingSize);
+#endif
+}
+
+static bool isSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Reads the next whitespace-separated token of a header, skipping comments. Returns false at the end of the file or for
+// tokens that do not fit
+static bool readToken(const unsigned char* File, size_t Size, size_t* Pos, char* Token) {
+    size_t i = *Pos;
+    for (;;) {
+        while (i < Size && isSpace(File[i]))
+            i++;
+        if (i < Size && File[i] == '#') {
+            while (i < Size && File[i] != '\n')
+                i++;
+            continue;
+        }
+        break;
+    }
+    int Length = 0;
+    while (i < Size && !isSpace(File[i])) {
+        if (Length == TOKEN_SIZE - 1)
+            return false;
+        Token[Length++] = (char)File[i++];
+    }
+    Token[Length] = '\0';
+    *Pos = i;
+    return Length > 0;
+}
+
+static bool readNumber(const unsigned char* File, size_t Size, size_t* Pos, int* Value) {
+    char Token[TOKEN_SIZE];
+    if (!readToken(File, Size, Pos, Token))
+        return false;
+    char* End;
+    long Number = strtol(Token, &End, 10);
+    if (*End != '\0' || Number < 1 || Number > INT32_MAX)
+        return false;
+    *Value = (int)Number;
+    return true;
+}
+
+// Parses the header of a binary PGM, PPM or PAM file and returns the offset of the first pixel in HeaderSize
+static OC_STATUS parseHeader(const unsigned char* File, size_t Size, int* Width, int* Height, int* Channels, size_t* HeaderSize) {
+    if (Size < 3 || File[0] != 'P' || !isSpace(File[2]))
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    size_t Pos = 2;
+    int MaxValue = 0;
+    *Width = *Height = *Channels = 0;
+    if (File[1] == '5' || File[1] == '6') {
+        if (!readNumber(File, Size, &Pos, Width) || !readNumber(File, Size, &Pos, Height) || !readNumber(File, Size, &Pos, &MaxValue))
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        // A single whitespace character separates the header from the pixels
+        if (Pos >= Size || !isSpace(File[Pos]))
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        Pos++;
+        *Channels = File[1] == '5' ? 1 : 3;
+    } else if (File[1] == '7') {
+        char Token[TOKEN_SIZE];
+        for (;;) {
+            if (!readToken(File, Size, &Pos, Token))
+                return OC_STATUS_ERR_INVALIDPARAMETER;
+            if (strcmp(Token, "ENDHDR") == 0)
+                break;
+            bool Parsed = true;
+            if (strcmp(Token, "WIDTH") == 0)
+                Parsed = readNumber(File, Size, &Pos, Width);
+            else if (strcmp(Token, "HEIGHT") == 0)
+                Parsed = readNumber(File, Size, &Pos, Height);
+            else if (strcmp(Token, "DEPTH") == 0)
+                Parsed = readNumber(File, Size, &Pos, Channels);
+            else if (strcmp(Token, "MAXVAL") == 0)
+                Parsed = readNumber(File, Size, &Pos, &MaxValue);
+            else {
+                // TUPLTYPE and unknown keywords take the rest of the line; the depth alone decides the layout
+                while (Pos < Size && File[Pos] != '\n')
+                    Pos++;
+            }
+            if (!Parsed)
+                return OC_STATUS_ERR_INVALIDPARAMETER;
+        }
+        while (Pos < Size && File[Pos] != '\n')
+            Pos++;
+        Pos++;
+        if (*Width == 0 || *Height == 0 || *Channels == 0 || MaxValue == 0)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        if (*Channels > 4)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+    } else {
+        return OC_STATUS_ERR_NOTSUPPORTED;
+    }
+    if (MaxValue != 255)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    // Rows must fit in an int stride and the pixels in the file
+    if ((long long)*Width * *Channels > INT32_MAX)
+        return OC_STATUS_ERR_OVERFLOW;
+    size_t LineSize = (size_t)*Width * *Channels;
+    if (Pos > Size || (size_t)*Height > (Size - Pos) / LineSize)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    *HeaderSize = Pos;
+    return OC_STATUS_OK;
+}
+
+static OC_STATUS wrapMapping(unsigned char* Mapping, size_t MappingSize, size_t HeaderSize, int Width, int Height, int Channels,
+                             OcImage** image) {
+    OC_STATUS ret = ocularWrapImage(Mapping + HeaderSize, Width, Height, Width * Channels, OC_DEPTH_8U, Channels, image);
+    if (ret != OC_STATUS_OK)
+        return ret;
+    (*image)->Storage = OC_IMAGE_MAPPED;
+    (*image)->Mapping = Mapping;
+    (*image)->MappingSize = MappingSize;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularMapImage(const char* FileName, bool Writable, OcImage** image) {
+    if (FileName == NULL || image == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    unsigned char* Mapping;
+    size_t MappingSize;
+    OC_STATUS ret = mapFile(FileName, Writable, 0, &Mapping, &MappingSize);
+    if (ret != OC_STATUS_OK)
+        return ret;
+
+    int Width, Height, Channels;
+    size_t HeaderSize;
+    ret = parseHeader(Mapping, MappingSize, &Width, &Height, &Channels, &HeaderSize);
+    if (ret == OC_STATUS_OK)
+        ret = wrapMapping(Mapping, MappingSize, HeaderSize, Width, Height, Channels, image);
+    if (ret != OC_STATUS_OK)
+        unmapImageFile(Mapping, MappingSize);
+    return ret;
+}
+
+OC_STATUS ocularCreateMappedImage(const char* FileName, int Width, int Height, int Channels, OcImage** image) {
+    if (FileName == NULL || image == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width < 1 || Height < 1 || Channels < 1 || Channels > 4)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if ((long long)Width * Channels > INT32_MAX || (unsigned long long)Width * Channels * Height > SIZE_MAX / 2)
+        return OC_STATUS_ERR_OVERFLOW;
+
+    char Header[128];
+    int HeaderSize;
+    if (Channels == 1 || Channels == 3)
+        HeaderSize = snprintf(Header, sizeof(Header), "P%c\n%d %d\n255\n", Channels == 1 ? '5' : '6', Width, Height);
+    else
+        HeaderSize = snprintf(Header, sizeof(Header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", Width,
+                              Height, Channels, Channels == 2 ? "GRAYSCALE_ALPHA" : "RGB_ALPHA");
+
+    unsigned char* Mapping;
+    size_t MappingSize;
+    OC_STATUS ret = mapFile(FileName, true, HeaderSize + (size_t)Width * Channels * Height, &Mapping, &MappingSize);
+    if (ret != OC_STATUS_OK)
+        return ret;
+
+    // The file was extended with zeros, so only the header needs writing
+    memcpy(Mapping, Header, HeaderSize);
+    ret = wrapMapping(Mapping, MappingSize, HeaderSize, Width, Height, Channels, image);
+    if (ret != OC_STATUS_OK)
+        unmapImageFile(Mapping, MappingSize);
+    return ret;
+}
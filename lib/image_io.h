@@ -0,0 +1,52 @@
+/**
+ * @file: image_io.h
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Memory-mapped images backed by raw Netpbm files.
+ *
+ * Binary PGM (P5), PPM (P6) and PAM (P7) files store their pixels uncompressed right after a short text header, so the
+ * pixels of a mapped file can be used in place as an OcImage. Nothing is read up front: the operating system pages rows in
+ * as they are touched and can drop them again under memory pressure, which lets filters walk over images much larger than
+ * memory, one band or view at a time.
+ */
+
+#ifndef OCULAR_IMAGE_IO_H
+#define OCULAR_IMAGE_IO_H
+
+#include "core.h"
+
+/**
+ * @brief Maps an 8-bit PGM, PPM or PAM file as an image without reading it.
+ * PGM files give 1 channel and PPM files 3. PAM files give their DEPTH, from 1 to 4. Rows are stored without padding, so
+ * Stride is Width * Channels.
+ * @ingroup group_ip_utility
+ * @param FileName The path of the file.
+ * @param Writable If true, changes to the pixels are written back to the file. Otherwise they are private to the
+ *                 process and the file is left untouched; only the pages written to are copied.
+ * @param[out] image The returned image data structure, released with ocularFreeImage().
+ * @return OC_STATUS_OK if successful, OC_STATUS_ERR_FILENOTFOUND if the file cannot be opened, OC_STATUS_ERR_NOTSUPPORTED
+ * for other formats or a MAXVAL other than 255, OC_STATUS_ERR_INVALIDPARAMETER for a malformed or truncated file.
+ */
+OC_STATUS ocularMapImage(const char* FileName, bool Writable, OcImage** image);
+
+/**
+ * @brief Creates an 8-bit image file of the given size and maps it writable, so results can be written to disk without
+ * holding them in memory. 1 channel images are written as PGM, 3 channel images as PPM and others as PAM. An existing file
+ * is replaced. The pixels start as zero.
+ * @ingroup group_ip_utility
+ * @param FileName The path of the file.
+ * @param Width The width of the image in pixels.
+ * @param Height The height of the image in pixels.
+ * @param Channels The number of color channels of the image, 1 to 4.
+ * @param[out] image The returned image data structure, released with ocularFreeImage().
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularCreateMappedImage(const char* FileName, int Width, int Height, int Channels, OcImage** image);
+
+// Internal use: releases the mapping of an OC_IMAGE_MAPPED image, called by ocularFreeImage()
+void unmapImageFile(void* Mapping, size_t MappingSize);
+
+#endif // OCULAR_IMAGE_IO_H
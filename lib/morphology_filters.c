@@ -1,11 +1,16 @@
+#include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include "morphology_filters.h"
+#include "parallel.h"
 #include "util.h"
+#include "workspace.h"
 
 #ifndef max
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -14,144 +19,398 @@ extern "C" {
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
-OC_STATUS ocularErodeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+//--------------------------Rank filter engine--------------------------
 
-    if (Input == NULL || Output == NULL) {
-        return OC_STATUS_ERR_NULLREFERENCE;
-    }
-    if (Width <= 0 || Height <= 0 || Stride <= 0) {
-        return OC_STATUS_ERR_INVALIDPARAMETER;
-    }
+// Width in bytes of the column strips processed by the vertical passes
+#define RANK_STRIP_BYTES 256
 
-    // Ensure filter specific parameters are within valid ranges
-    Radius = max(Radius, 1);
-
-    int Channels = Stride / Width;
+static inline unsigned char rankOp(unsigned char a, unsigned char b, const bool IsMax) {
+    if (IsMax)
+        return a > b ? a : b;
+    return a < b ? a : b;
+}
 
-    if (Channels == 1) {
-        for (int y = 0; y < Height; y++) {
-            for (int x = 0; x < Width; x++) {
-                int minPixelValue = 255;
-                for (int ky = -Radius; ky <= Radius; ky++) {
-                    for (int kx = -Radius; kx <= Radius; kx++) {
-                        int offsetX = x + kx;
-                        int offsetY = y + ky;
-                        if (offsetX >= 0 && offsetX < Width && offsetY >= 0 && offsetY < Height) {
-                            int pixelValue = Input[offsetY * Width + offsetX];
-                            if (pixelValue < minPixelValue) {
-                                minPixelValue = pixelValue;
-                            }
-                        }
-                    }
-                }
-                for (int c = 0; c < Channels; c++) {
-                    Output[y * Width + x + c] = minPixelValue;
-                }
-            }
+// Van Herk/Gil-Werman running minimum (or maximum) along one line of Count elements of Span bytes. Every element becomes the
+// extremum of the elements at offsets [Lo, Hi] from it, ignoring those that fall outside the line, at a cost of three
+// comparisons per byte whatever the window length. Src and Dst may be the same line. With Accumulate the result is also
+// combined with what Dst already holds. G and H are scratch buffers of (Count + Hi - Lo) * Span bytes.
+static inline void rankLineImpl(const unsigned char* Src, ptrdiff_t srcStep, unsigned char* Dst, ptrdiff_t dstStep, int Count, int Span,
+                                int Lo, int Hi, bool Accumulate, unsigned char* G, unsigned char* H, const bool IsMax) {
+    const unsigned char Neutral = IsMax ? 0 : 255;
+    int Window = Hi - Lo + 1;
+    int Length = Count + Window - 1;
+    int blockBytes = Window * Span;
+    int lineBytes = Length * Span;
+
+    // Element t of the extended line is source element t + Lo, or Neutral beyond the ends
+    int First = clamp(-Lo, 0, Length);
+    int Last = clamp(Count - Lo, First, Length);
+    memset(G, Neutral, (size_t)First * Span);
+    memset(G + (size_t)Last * Span, Neutral, (size_t)(Length - Last) * Span);
+    if (srcStep == Span) {
+        memcpy(G + (size_t)First * Span, Src + (First + Lo) * srcStep, (size_t)(Last - First) * Span);
+    } else {
+        for (int t = First; t < Last; t++) {
+            memcpy(G + (size_t)t * Span, Src + (t + Lo) * srcStep, Span);
         }
     }
-    if (Channels == 3) {
+    memcpy(H, G, lineBytes);
 
-        unsigned char* SrcR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+    // G holds the prefix extrema of each block of Window elements and H the suffix extrema
+    for (int blockStart = 0; blockStart < lineBytes; blockStart += blockBytes) {
+        int blockEnd = min(blockStart + blockBytes, lineBytes);
+        for (int i = blockStart + Span; i < blockEnd; i++) {
+            G[i] = rankOp(G[i], G[i - Span], IsMax);
+        }
+        for (int i = blockEnd - Span - 1; i >= blockStart; i--) {
+            H[i] = rankOp(H[i], H[i + Span], IsMax);
+        }
+    }
 
-        unsigned char* DstR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+    // The window of element i spans extended elements [i, i + Window - 1], which straddle at most one block boundary
+    const unsigned char* pG = G + (size_t)(Window - 1) * Span;
+    if (dstStep == Span && !Accumulate) {
+        for (int i = 0; i < Count * Span; i++) {
+            Dst[i] = rankOp(H[i], pG[i], IsMax);
+        }
+        return;
+    }
+    for (int i = 0; i < Count; i++) {
+        const unsigned char* pH = H + (size_t)i * Span;
+        const unsigned char* pW = pG + (size_t)i * Span;
+        unsigned char* pDst = Dst + i * dstStep;
+        if (Accumulate) {
+            for (int c = 0; c < Span; c++) {
+                pDst[c] = rankOp(pDst[c], rankOp(pH[c], pW[c], IsMax), IsMax);
+            }
+        } else {
+            for (int c = 0; c < Span; c++) {
+                pDst[c] = rankOp(pH[c], pW[c], IsMax);
+            }
+        }
+    }
+}
 
-        SplitRGB(Input, SrcB, SrcG, SrcR, Width, Height, Stride);
+void rankLine(const unsigned char* Src, ptrdiff_t srcStep, unsigned char* Dst, ptrdiff_t dstStep, int Count, int Span, int Lo, int Hi,
+              bool IsMax, bool Accumulate, unsigned char* G, unsigned char* H) {
+    // Separate instantiations let the compiler drop the min/max selection from the inner loops
+    if (IsMax)
+        rankLineImpl(Src, srcStep, Dst, dstStep, Count, Span, Lo, Hi, Accumulate, G, H, true);
+    else
+        rankLineImpl(Src, srcStep, Dst, dstStep, Count, Span, Lo, Hi, Accumulate, G, H, false);
+}
 
-        ocularErodeFilter(SrcR, DstR, Width, Height, Width, Radius);
-        ocularErodeFilter(SrcG, DstG, Width, Height, Width, Radius);
-        ocularErodeFilter(SrcB, DstB, Width, Height, Width, Radius);
+typedef struct {
+    const unsigned char* Src;
+    unsigned char* Dst;
+    int Width;
+    int Height;
+    int srcStride;
+    int dstStride;
+    int Channels;
+    int Lo;
+    int Hi;
+    bool IsMax;
+    bool Accumulate;
+    bool AntiDiagonal;
+    int TileRows;
+    unsigned char* Scratch;
+    size_t ScratchSize;
+} RankPass;
+
+static void rankRows(void* Context, int Begin, int End, int Thread) {
+    RankPass* p = (RankPass*)Context;
+    unsigned char* G = p->Scratch + (size_t)Thread * p->ScratchSize;
+    unsigned char* H = G + p->ScratchSize / 2;
+    for (int Y = Begin; Y < End; Y++) {
+        rankLine(p->Src + (size_t)Y * p->srcStride, p->Channels, p->Dst + (size_t)Y * p->dstStride, p->Channels, p->Width, p->Channels,
+                 p->Lo, p->Hi, p->IsMax, p->Accumulate, G, H);
+    }
+}
 
-        CombineRGB(DstB, DstG, DstR, Output, Width, Height, Stride);
+static void rankColumns(void* Context, int Begin, int End, int Thread) {
+    RankPass* p = (RankPass*)Context;
+    unsigned char* G = p->Scratch + (size_t)Thread * p->ScratchSize;
+    unsigned char* H = G + p->ScratchSize / 2;
+    int rowBytes = p->Width * p->Channels;
+    for (int Strip = Begin; Strip < End; Strip++) {
+        int Offset = Strip * RANK_STRIP_BYTES;
+        int Span = min(RANK_STRIP_BYTES, rowBytes - Offset);
+        rankLine(p->Src + Offset, p->srcStride, p->Dst + Offset, p->dstStride, p->Height, Span, p->Lo, p->Hi, p->IsMax, p->Accumulate,
+                 G, H);
+    }
+}
 
-        free(SrcR);
-        free(SrcG);
-        free(SrcB);
-        free(DstR);
-        free(DstG);
-        free(DstB);
+// Pass along diagonals, run row by row over a tile of rows so the image is read in memory order. G and H hold the block prefix
+// and suffix extrema of every diagonal as whole rows, widened by Pad pixels on both sides for the diagonals that enter or leave
+// through the side edges. Src and Dst must not overlap.
+static void rankDiagonalTile(RankPass* p, int Tile, int Thread) {
+    int Channels = p->Channels;
+    int Shift = p->AntiDiagonal ? -Channels : Channels;
+    int Window = p->Hi - p->Lo + 1;
+    int Pad = Window - 1 + max(abs(p->Lo), abs(p->Hi));
+    int rowBytes = p->Width * Channels;
+    int lineBytes = rowBytes + 2 * Pad * Channels;
+    const unsigned char Neutral = p->IsMax ? 0 : 255;
+    int yBegin = Tile * p->TileRows;
+    int yEnd = min(yBegin + p->TileRows, p->Height);
+    int Length = yEnd - yBegin + Window - 1;
+    unsigned char* G = p->Scratch + (size_t)Thread * p->ScratchSize;
+    unsigned char* H = G + p->ScratchSize / 2;
+
+    // Row t of G and H holds source row yBegin + t + Lo, or Neutral outside the image
+    for (int t = 0; t < Length; t++) {
+        int Y = yBegin + t + p->Lo;
+        unsigned char* pG = G + (size_t)t * lineBytes;
+        unsigned char* pH = H + (size_t)t * lineBytes;
+        memset(pG, Neutral, lineBytes);
+        if (Y >= 0 && Y < p->Height)
+            memcpy(pG + Pad * Channels, p->Src + (size_t)Y * p->srcStride, rowBytes);
+        memcpy(pH, pG, lineBytes);
+    }
+    // The previous element of a diagonal sits one row up and one pixel back; the first pixel of each row has none
+    for (int t = 0; t < Length; t++) {
+        if (t % Window == 0)
+            continue;
+        unsigned char* pG = G + (size_t)t * lineBytes;
+        const unsigned char* pPrev = pG - lineBytes - Shift;
+        int First = Shift > 0 ? Shift : 0;
+        int Last = Shift > 0 ? lineBytes : lineBytes + Shift;
+        if (p->IsMax) {
+            for (int i = First; i < Last; i++) pG[i] = rankOp(pG[i], pPrev[i], true);
+        } else {
+            for (int i = First; i < Last; i++) pG[i] = rankOp(pG[i], pPrev[i], false);
+        }
+    }
+    for (int t = Length - 2; t >= 0; t--) {
+        if ((t + 1) % Window == 0)
+            continue;
+        unsigned char* pH = H + (size_t)t * lineBytes;
+        const unsigned char* pNext = pH + lineBytes + Shift;
+        int First = Shift > 0 ? 0 : -Shift;
+        int Last = Shift > 0 ? lineBytes - Shift : lineBytes;
+        if (p->IsMax) {
+            for (int i = First; i < Last; i++) pH[i] = rankOp(pH[i], pNext[i], true);
+        } else {
+            for (int i = First; i < Last; i++) pH[i] = rankOp(pH[i], pNext[i], false);
+        }
     }
 
-    return OC_STATUS_OK;
+    for (int Y = yBegin; Y < yEnd; Y++) {
+        int t = Y - yBegin;
+        // The window of pixel X starts at X + Lo on row t and ends Window - 1 rows and pixels further along the diagonal
+        const unsigned char* pH = H + (size_t)t * lineBytes + (Pad + p->Lo * (Shift / Channels)) * Channels;
+        const unsigned char* pG = G + (size_t)(t + Window - 1) * lineBytes + (Pad + p->Hi * (Shift / Channels)) * Channels;
+        unsigned char* pDst = p->Dst + (size_t)Y * p->dstStride;
+        if (p->IsMax) {
+            for (int i = 0; i < rowBytes; i++) pDst[i] = rankOp(pH[i], pG[i], true);
+        } else {
+            for (int i = 0; i < rowBytes; i++) pDst[i] = rankOp(pH[i], pG[i], false);
+        }
+    }
 }
 
-OC_STATUS ocularDilateFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
-
-    if (Input == NULL || Output == NULL) {
-        return OC_STATUS_ERR_NULLREFERENCE;
+static void rankDiagonals(void* Context, int Begin, int End, int Thread) {
+    for (int Tile = Begin; Tile < End; Tile++) {
+        rankDiagonalTile((RankPass*)Context, Tile, Thread);
     }
-    if (Width <= 0 || Height <= 0 || Stride <= 0) {
-        return OC_STATUS_ERR_INVALIDPARAMETER;
+}
+
+typedef enum {
+    RANK_ROWS,
+    RANK_COLUMNS,
+    RANK_DIAGONALS,
+    RANK_ANTI_DIAGONALS,
+} RankDirection;
+
+// Runs one rank pass over a whole image in the given direction with window offsets [Lo, Hi]. Src and Dst may be the same image,
+// except for the diagonal passes.
+static OC_STATUS rankImage(const unsigned char* Src, int srcStride, unsigned char* Dst, int dstStride, int Width, int Height, int Channels,
+                           RankDirection Direction, int Lo, int Hi, bool IsMax, bool Accumulate) {
+    RankPass p = { Src, Dst, Width, Height, srcStride, dstStride, Channels, Lo, Hi, IsMax, Accumulate, Direction == RANK_ANTI_DIAGONALS,
+                   0, NULL, 0 };
+
+    int Count, Grain, lineLength, Span;
+    OcParallelBody Body;
+    switch (Direction) {
+        case RANK_ROWS:
+            Count = Height;
+            Grain = 8;
+            lineLength = Width;
+            Span = Channels;
+            Body = rankRows;
+            break;
+        case RANK_COLUMNS:
+            Count = (Width * Channels + RANK_STRIP_BYTES - 1) / RANK_STRIP_BYTES;
+            Grain = 1;
+            lineLength = Height;
+            Span = min(RANK_STRIP_BYTES, Width * Channels);
+            Body = rankColumns;
+            break;
+        default:
+            // Tiles of rows, each at least one window tall to bound the rows recomputed at tile edges
+            p.TileRows = min(max(Hi - Lo + 1, 64), Height);
+            Count = (Height + p.TileRows - 1) / p.TileRows;
+            Grain = 1;
+            lineLength = p.TileRows;
+            Span = (Width + 2 * (Hi - Lo + max(abs(Lo), abs(Hi)))) * Channels;
+            Body = rankDiagonals;
+            break;
+    }
+
+    p.ScratchSize = 2 * (size_t)(lineLength + Hi - Lo) * Span;
+    p.Scratch = (unsigned char*)ScratchAlloc(p.ScratchSize * ocularGetThreadCount(), false);
+    if (p.Scratch == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
     }
+    ocularParallelFor(Count, Grain, Body, &p);
+    ScratchFree(p.Scratch);
+    return OC_STATUS_OK;
+}
 
-    // Ensure filter specific parameters are within valid ranges
-    Radius = max(Radius, 1);
+// Scratch of one rankImage() pass
+static size_t rankImageScratchSize(int Width, int Height, int Channels, RankDirection Direction, int Lo, int Hi) {
+    int lineLength, Span;
+    switch (Direction) {
+        case RANK_ROWS:
+            lineLength = Width;
+            Span = Channels;
+            break;
+        case RANK_COLUMNS:
+            lineLength = Height;
+            Span = min(RANK_STRIP_BYTES, Width * Channels);
+            break;
+        default:
+            lineLength = min(max(Hi - Lo + 1, 64), Height);
+            Span = (Width + 2 * (Hi - Lo + max(abs(Lo), abs(Hi)))) * Channels;
+            break;
+    }
+    return ScratchBlockSize(2 * (size_t)(lineLength + Hi - Lo) * Span * ocularGetThreadCount());
+}
 
-    int Channels = Stride / Width;
+size_t rankRectangleScratchSize(int Width, int Height, int Channels, int RadiusX, int RadiusY) {
+    // The row and column passes of rankRectangle() run one after the other
+    return max(rankImageScratchSize(Width, Height, Channels, RANK_ROWS, -RadiusX, RadiusX),
+               rankImageScratchSize(Width, Height, Channels, RANK_COLUMNS, -RadiusY, RadiusY));
+}
 
-    if (Channels == 1) {
-        for (int y = 0; y < Height; y++) {
-            for (int x = 0; x < Width; x++) {
-                int maxPixelValue = 0;
-                for (int ky = -Radius; ky <= Radius; ky++) {
-                    for (int kx = -Radius; kx <= Radius; kx++) {
-                        int offsetX = x + kx;
-                        int offsetY = y + ky;
-                        if (offsetX >= 0 && offsetX < Width && offsetY >= 0 && offsetY < Height) {
-                            int pixelValue = Input[offsetY * Width + offsetX];
-                            if (pixelValue > maxPixelValue) {
-                                maxPixelValue = pixelValue;
-                            }
-                        }
-                    }
-                }
-                for (int c = 0; c < Channels; c++) {
-                    Output[y * Width + x + c] = maxPixelValue;
-                }
-            }
-        }
-    }
-    if (Channels == 3) {
+// Minimum or maximum over a (2 * RadiusX + 1) x (2 * RadiusY + 1) rectangle, as a row pass followed by a column pass
+static OC_STATUS rankRectangle(const unsigned char* Src, int srcStride, unsigned char* Dst, int dstStride, int Width, int Height,
+                               int Channels, int RadiusX, int RadiusY, bool IsMax) {
+    OC_STATUS Status = rankImage(Src, srcStride, Dst, dstStride, Width, Height, Channels, RANK_ROWS, -RadiusX, RadiusX, IsMax, false);
+    if (Status == OC_STATUS_OK)
+        Status = rankImage(Dst, dstStride, Dst, dstStride, Width, Height, Channels, RANK_COLUMNS, -RadiusY, RadiusY, IsMax, false);
+    return Status;
+}
 
-        unsigned char* SrcR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* SrcB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+// Minimum or maximum over the 5 pixel cross, i.e. a diamond of radius 1. Dst must not overlap Src.
+static OC_STATUS rankCross(const unsigned char* Src, unsigned char* Dst, int Width, int Height, int Channels, bool IsMax) {
+    int Stride = Width * Channels;
+    OC_STATUS Status = rankImage(Src, Stride, Dst, Stride, Width, Height, Channels, RANK_ROWS, -1, 1, IsMax, false);
+    if (Status == OC_STATUS_OK)
+        Status = rankImage(Src, Stride, Dst, Stride, Width, Height, Channels, RANK_COLUMNS, -1, 1, IsMax, true);
+    return Status;
+}
 
-        unsigned char* DstR = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstG = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
-        unsigned char* DstB = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+// Minimum or maximum over a diamond or octagon. Both are built from shapes whose Minkowski sum is the element: a square, two
+// diagonal lines (whose sum covers every other pixel of a diamond) and one or two crosses to fill in the rest. The image is
+// padded by the radius so the intermediate results just outside it are exact, then cropped back.
+static void rankDecomposition(int Radius, OcStructuringElement Element, int* squareRadius, int* lineRadius, int* crosses) {
+    int diamondRadius = Radius;
+    if (Element == OC_MORPH_OCTAGON) {
+        // Sizes the diamond so the octagon's diagonal extent matches that of a disk of the same radius
+        diamondRadius = (int)(2.0 * Radius * (1.0 - 0.70710678) + 0.5);
+    }
+    *squareRadius = Radius - diamondRadius;
+    *lineRadius = (diamondRadius - 1) / 2;
+    *crosses = diamondRadius - 2 * *lineRadius;
+}
 
-        SplitRGB(Input, SrcB, SrcG, SrcR, Width, Height, Stride);
+static OC_STATUS rankDecomposed(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Channels,
+                                int Radius, OcStructuringElement Element, bool IsMax) {
+    int squareRadius, lineRadius, crosses;
+    rankDecomposition(Radius, Element, &squareRadius, &lineRadius, &crosses);
+
+    int padWidth = Width + 2 * Radius;
+    int padHeight = Height + 2 * Radius;
+    int padStride = padWidth * Channels;
+    size_t padSize = (size_t)padHeight * padStride;
+    unsigned char* Pad = (unsigned char*)ScratchAlloc(padSize, false);
+    unsigned char* Temp = (unsigned char*)ScratchAlloc(padSize, false);
+    if (Pad == NULL || Temp == NULL) {
+        ScratchFree(Pad);
+        ScratchFree(Temp);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
 
-        ocularDilateFilter(SrcR, DstR, Width, Height, Width, Radius);
-        ocularDilateFilter(SrcG, DstG, Width, Height, Width, Radius);
-        ocularDilateFilter(SrcB, DstB, Width, Height, Width, Radius);
+    memset(Pad, IsMax ? 0 : 255, padSize);
+    for (int Y = 0; Y < Height; Y++) {
+        memcpy(Pad + (size_t)(Y + Radius) * padStride + Radius * Channels, Input + (size_t)Y * Stride, Width * Channels);
+    }
 
-        CombineRGB(DstB, DstG, DstR, Output, Width, Height, Stride);
+    OC_STATUS Status = OC_STATUS_OK;
+    if (squareRadius > 0)
+        Status = rankRectangle(Pad, padStride, Pad, padStride, padWidth, padHeight, Channels, squareRadius, squareRadius, IsMax);
+    for (int i = 0; i < 2 + crosses && Status == OC_STATUS_OK; i++) {
+        if (i < 2) {
+            if (lineRadius == 0)
+                continue;
+            Status = rankImage(Pad, padStride, Temp, padStride, padWidth, padHeight, Channels, i == 0 ? RANK_DIAGONALS : RANK_ANTI_DIAGONALS,
+                               -lineRadius, lineRadius, IsMax, false);
+        } else {
+            Status = rankCross(Pad, Temp, padWidth, padHeight, Channels, IsMax);
+        }
+        unsigned char* Swap = Pad;
+        Pad = Temp;
+        Temp = Swap;
+    }
 
-        free(SrcR);
-        free(SrcG);
-        free(SrcB);
-        free(DstR);
-        free(DstG);
-        free(DstB);
+    if (Status == OC_STATUS_OK) {
+        for (int Y = 0; Y < Height; Y++) {
+            memcpy(Output + (size_t)Y * Stride, Pad + (size_t)(Y + Radius) * padStride + Radius * Channels, Width * Channels);
+        }
     }
 
-    return OC_STATUS_OK;
+    ScratchFree(Pad);
+    ScratchFree(Temp);
+    return Status;
 }
 
-OC_STATUS ocularMinFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+static size_t rankDecomposedScratchSize(int Width, int Height, int Channels, int Radius, OcStructuringElement Element) {
+    int squareRadius, lineRadius, crosses;
+    rankDecomposition(Radius, Element, &squareRadius, &lineRadius, &crosses);
+
+    int padWidth = Width + 2 * Radius;
+    int padHeight = Height + 2 * Radius;
+    size_t passes = 0;
+    if (squareRadius > 0)
+        passes = rankRectangleScratchSize(padWidth, padHeight, Channels, squareRadius, squareRadius);
+    if (lineRadius > 0) {
+        passes = max(passes, rankImageScratchSize(padWidth, padHeight, Channels, RANK_DIAGONALS, -lineRadius, lineRadius));
+    }
+    if (crosses > 0)
+        passes = max(passes, rankRectangleScratchSize(padWidth, padHeight, Channels, 1, 1));
+    return 2 * ScratchBlockSize((size_t)padHeight * padWidth * Channels) + passes;
+}
 
+size_t rankShapeScratchSize(int Width, int Height, int Channels, int Radius) {
+    // The largest of the elements
+    size_t size = rankRectangleScratchSize(Width, Height, Channels, Radius, Radius);
+    size = max(size, rankDecomposedScratchSize(Width, Height, Channels, Radius, OC_MORPH_DIAMOND));
+    return max(size, rankDecomposedScratchSize(Width, Height, Channels, Radius, OC_MORPH_OCTAGON));
+}
+
+static OC_STATUS rankShape(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius, OcStructuringElement Element,
+                           bool IsMax) {
     if (Input == NULL || Output == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
     }
     if (Width <= 0 || Height <= 0 || Stride <= 0) {
         return OC_STATUS_ERR_INVALIDPARAMETER;
     }
+    if (Element < OC_MORPH_SQUARE || Element > OC_MORPH_OCTAGON) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
 
     int Channels = Stride / Width;
     if (Channels != 1 && Channels != 3 && Channels != 4) {
@@ -161,78 +420,29 @@ OC_STATUS ocularMinFilter(unsigned char* Input, unsigned char* Output, int Width
     // Ensure filter specific parameters are within valid ranges
     Radius = max(Radius, 1);
 
-    // Pre-calculate circle mask
-    const int maskSize = (Radius * 2 + 1);
-    char* circleMask = (char*)malloc(maskSize * maskSize);
-    int radiusSquared = Radius * Radius;
-
-    for (int y = 0; y < maskSize; y++) {
-        for (int x = 0; x < maskSize; x++) {
-            int dx = x - Radius;
-            int dy = y - Radius;
-            circleMask[y * maskSize + x] = (dx * dx + dy * dy <= radiusSquared);
-        }
-    }
-
-    // Process image in chunks for better cache utilization
-    const int CHUNK_SIZE = 32;
-    for (int blockY = 0; blockY < Height; blockY += CHUNK_SIZE) {
-        for (int blockX = 0; blockX < Width; blockX += CHUNK_SIZE) {
-            int endY = min(blockY + CHUNK_SIZE, Height);
-            int endX = min(blockX + CHUNK_SIZE, Width);
-
-            for (int y = blockY; y < endY; y++) {
-                unsigned char* pOutput = Output + (y * Stride) + (blockX * Channels);
-
-                for (int x = blockX; x < endX; x++) {
-                    unsigned char minValues[4] = { 255, 255, 255, 255 };
-
-                    // Scan only the pixels within the circle mask
-                    for (int ky = 0; ky < maskSize; ky++) {
-                        int ny = y + ky - Radius;
-                        if (ny < 0 || ny >= Height)
-                            continue;
-
-                        unsigned char* pInput = Input + (ny * Stride);
-
-                        for (int kx = 0; kx < maskSize; kx++) {
-                            if (!circleMask[ky * maskSize + kx])
-                                continue;
-
-                            int nx = x + kx - Radius;
-                            if (nx < 0 || nx >= Width)
-                                continue;
-
-                            unsigned char* pixel = pInput + (nx * Channels);
-
-                            // Unrolled channel comparison
-                            if (Channels >= 1 && pixel[0] < minValues[0])
-                                minValues[0] = pixel[0];
-                            if (Channels >= 2 && pixel[1] < minValues[1])
-                                minValues[1] = pixel[1];
-                            if (Channels >= 3 && pixel[2] < minValues[2])
-                                minValues[2] = pixel[2];
-                            if (Channels == 4 && pixel[3] < minValues[3])
-                                minValues[3] = pixel[3];
-                        }
-                    }
-
-                    for (int c = 0; c < Channels; c++) {
-                        pOutput[c] = minValues[c];
-                    }
-                    pOutput += Channels;
-                }
-            }
-        }
-    }
-
-    free(circleMask);
-
-    return OC_STATUS_OK;
+    if (Element == OC_MORPH_SQUARE)
+        return rankRectangle(Input, Stride, Output, Stride, Width, Height, Channels, Radius, Radius, IsMax);
+    return rankDecomposed(Input, Output, Width, Height, Stride, Channels, Radius, Element, IsMax);
 }
 
-OC_STATUS ocularMaxFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+// Rows [Row, returned row] above and below the center share the half width of the disk
+static int diskRun(int Radius, int Row, int* halfWidth) {
+    int radiusSquared = Radius * Radius;
+    int half = (int)sqrt((double)(radiusSquared - Row * Row));
+    while ((half + 1) * (half + 1) <= radiusSquared - Row * Row)
+        half++;
+    while (half * half > radiusSquared - Row * Row)
+        half--;
+    int rowEnd = Row;
+    while (rowEnd < Radius && (rowEnd + 1) * (rowEnd + 1) + half * half <= radiusSquared)
+        rowEnd++;
+    *halfWidth = half;
+    return rowEnd;
+}
 
+// Minimum or maximum over the pixels within Radius of the center. The disk is the union of rectangles formed by runs of rows
+// with the same half width, so the cost grows with the number of distinct widths rather than the area of the disk.
+static OC_STATUS rankDisk(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius, bool IsMax) {
     if (Input == NULL || Output == NULL) {
         return OC_STATUS_ERR_NULLREFERENCE;
     }
@@ -248,75 +458,86 @@ OC_STATUS ocularMaxFilter(unsigned char* Input, unsigned char* Output, int Width
     // Ensure filter specific parameters are within valid ranges
     Radius = max(Radius, 1);
 
-    // Pre-calculate circle mask
-    const int maskSize = (Radius * 2 + 1);
-    char* circleMask = (char*)malloc(maskSize * maskSize);
-    int radiusSquared = Radius * Radius;
+    size_t imageSize = (size_t)Height * Stride;
+    unsigned char* Rows = (unsigned char*)ScratchAlloc(imageSize, false);
+    // Results are gathered apart from the input when filtering in place, since every rectangle reads the original
+    unsigned char* Result = (Input == Output) ? (unsigned char*)ScratchAlloc(imageSize, false) : Output;
+    if (Rows == NULL || Result == NULL) {
+        ScratchFree(Rows);
+        if (Result != Output)
+            ScratchFree(Result);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
 
-    for (int y = 0; y < maskSize; y++) {
-        for (int x = 0; x < maskSize; x++) {
-            int dx = x - Radius;
-            int dy = y - Radius;
-            circleMask[y * maskSize + x] = (dx * dx + dy * dy <= radiusSquared);
+    OC_STATUS Status = OC_STATUS_OK;
+    int rowBegin = 0;
+    while (rowBegin <= Radius && Status == OC_STATUS_OK) {
+        int halfWidth = 0;
+        int rowEnd = diskRun(Radius, rowBegin, &halfWidth);
+
+        Status = rankImage(Input, Stride, Rows, Stride, Width, Height, Channels, RANK_ROWS, -halfWidth, halfWidth, IsMax, false);
+        if (Status != OC_STATUS_OK)
+            break;
+        if (rowBegin == 0) {
+            Status = rankImage(Rows, Stride, Result, Stride, Width, Height, Channels, RANK_COLUMNS, -rowEnd, rowEnd, IsMax, false);
+        } else {
+            Status = rankImage(Rows, Stride, Result, Stride, Width, Height, Channels, RANK_COLUMNS, rowBegin, rowEnd, IsMax, true);
+            if (Status == OC_STATUS_OK)
+                Status = rankImage(Rows, Stride, Result, Stride, Width, Height, Channels, RANK_COLUMNS, -rowEnd, -rowBegin, IsMax, true);
         }
+        rowBegin = rowEnd + 1;
     }
 
-    // Process image in chunks for better cache utilization
-    const int CHUNK_SIZE = 32;
-    for (int blockY = 0; blockY < Height; blockY += CHUNK_SIZE) {
-        for (int blockX = 0; blockX < Width; blockX += CHUNK_SIZE) {
-            int endY = min(blockY + CHUNK_SIZE, Height);
-            int endX = min(blockX + CHUNK_SIZE, Width);
-
-            for (int y = blockY; y < endY; y++) {
-                unsigned char* pOutput = Output + (y * Stride) + (blockX * Channels);
-
-                for (int x = blockX; x < endX; x++) {
-                    unsigned char maxValues[4] = { 0, 0, 0, 0 };
-
-                    // Scan only the pixels within the circle mask
-                    for (int ky = 0; ky < maskSize; ky++) {
-                        int ny = y + ky - Radius;
-                        if (ny < 0 || ny >= Height)
-                            continue;
-
-                        unsigned char* pInput = Input + (ny * Stride);
-
-                        for (int kx = 0; kx < maskSize; kx++) {
-                            if (!circleMask[ky * maskSize + kx])
-                                continue;
-
-                            int nx = x + kx - Radius;
-                            if (nx < 0 || nx >= Width)
-                                continue;
-
-                            unsigned char* pixel = pInput + (nx * Channels);
-
-                            // Unrolled channel comparison
-                            if (Channels >= 1 && pixel[0] > maxValues[0])
-                                maxValues[0] = pixel[0];
-                            if (Channels >= 2 && pixel[1] > maxValues[1])
-                                maxValues[1] = pixel[1];
-                            if (Channels >= 3 && pixel[2] > maxValues[2])
-                                maxValues[2] = pixel[2];
-                            if (Channels == 4 && pixel[3] > maxValues[3])
-                                maxValues[3] = pixel[3];
-                        }
-                    }
-
-                    // Write output values
-                    for (int c = 0; c < Channels; c++) {
-                        pOutput[c] = maxValues[c];
-                    }
-                    pOutput += Channels;
-                }
-            }
-        }
+    if (Result != Output) {
+        if (Status == OC_STATUS_OK)
+            memcpy(Output, Result, imageSize);
+        ScratchFree(Result);
     }
+    ScratchFree(Rows);
+    return Status;
+}
 
-    free(circleMask);
+size_t rankDiskScratchSize(int Width, int Height, int Stride, int Channels, int Radius) {
+    // Filtering in place takes a second image
+    size_t size = 2 * ScratchBlockSize((size_t)Height * Stride);
+    size_t passes = 0;
+    for (int rowBegin = 0; rowBegin <= Radius;) {
+        int halfWidth = 0;
+        int rowEnd = diskRun(Radius, rowBegin, &halfWidth);
+        passes = max(passes, rankImageScratchSize(Width, Height, Channels, RANK_ROWS, -halfWidth, halfWidth));
+        if (rowBegin == 0)
+            passes = max(passes, rankImageScratchSize(Width, Height, Channels, RANK_COLUMNS, -rowEnd, rowEnd));
+        else
+            passes = max(passes, rankImageScratchSize(Width, Height, Channels, RANK_COLUMNS, rowBegin, rowEnd));
+        rowBegin = rowEnd + 1;
+    }
+    return size + passes;
+}
 
-    return OC_STATUS_OK;
+OC_STATUS ocularErodeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+    return rankShape(Input, Output, Width, Height, Stride, Radius, OC_MORPH_SQUARE, false);
+}
+
+OC_STATUS ocularDilateFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+    return rankShape(Input, Output, Width, Height, Stride, Radius, OC_MORPH_SQUARE, true);
+}
+
+OC_STATUS ocularErodeShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                 OcStructuringElement Element) {
+    return rankShape(Input, Output, Width, Height, Stride, Radius, Element, false);
+}
+
+OC_STATUS ocularDilateShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                  OcStructuringElement Element) {
+    return rankShape(Input, Output, Width, Height, Stride, Radius, Element, true);
+}
+
+OC_STATUS ocularMinFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+    return rankDisk(Input, Output, Width, Height, Stride, Radius, false);
+}
+
+OC_STATUS ocularMaxFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
+    return rankDisk(Input, Output, Width, Height, Stride, Radius, true);
 }
 
 OC_STATUS ocularHighPassFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius) {
@@ -336,26 +557,31 @@ OC_STATUS ocularHighPassFilter(unsigned char* Input, unsigned char* Output, int
     // Ensure filter specific parameters are within valid ranges
     Radius = max(Radius, 1);
 
-    // Create temporary buffer for blur result
-    unsigned char* blurBuffer = (unsigned char*)malloc((size_t)Height * Stride);
+    // Create temporary buffer for the unrounded blur result
+    size_t rowFloats = (size_t)Width * Channels;
+    float* blurBuffer = (float*)ScratchAlloc(rowFloats * Height * sizeof(float), false);
     if (blurBuffer == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
     // First apply Gaussian blur to get low frequency components
-    ocularGaussianBlurFilter(Input, blurBuffer, Width, Height, Stride, Radius);
+    OC_STATUS status = gaussianBlurFloat(Input, blurBuffer, Width, Height, Stride, (float)Radius);
+    if (status != OC_STATUS_OK) {
+        ScratchFree(blurBuffer);
+        return status;
+    }
 
     // Subtract blurred image from original to get high frequency components
     for (int y = 0; y < Height; y++) {
         unsigned char* pInput = Input + (y * Stride);
-        unsigned char* pBlur = blurBuffer + (y * Stride);
+        const float* pBlur = blurBuffer + y * rowFloats;
         unsigned char* pOutput = Output + (y * Stride);
 
         for (int x = 0; x < Width; x++) {
             for (int c = 0; c < (Channels == 4 ? 3 : Channels); c++) {
                 // High pass = Original - Low pass (blur)
                 // Add 128 to center the result around middle gray
-                int highPass = 128 + (pInput[c] - pBlur[c]);
+                float highPass = 128.5f + (pInput[c] - pBlur[c]);
                 pOutput[c] = ClampToByte(highPass);
             }
 
@@ -370,7 +596,7 @@ OC_STATUS ocularHighPassFilter(unsigned char* Input, unsigned char* Output, int
         }
     }
 
-    free(blurBuffer);
+    ScratchFree(blurBuffer);
 
     return OC_STATUS_OK;
 }
@@ -461,7 +687,7 @@ OC_STATUS ocularSkeletonizeFilter(unsigned char* Input, unsigned char* Output, i
     Threshold = ClampToByte(Threshold);
 
     size_t n = (size_t)Width * Height;
-    unsigned char* bin = (unsigned char*)malloc(n);
+    unsigned char* bin = (unsigned char*)ScratchAlloc(n, false);
     if (bin == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
@@ -484,9 +710,9 @@ OC_STATUS ocularSkeletonizeFilter(unsigned char* Input, unsigned char* Output, i
     }
 
     /* Working copy for iterative thinning (algorithm uses 0/1; we use 0/255) */
-    unsigned char* work = (unsigned char*)malloc(n);
+    unsigned char* work = (unsigned char*)ScratchAlloc(n, false);
     if (work == NULL) {
-        free(bin);
+        ScratchFree(bin);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
     for (size_t i = 0; i < n; i++) {
@@ -541,7 +767,7 @@ OC_STATUS ocularSkeletonizeFilter(unsigned char* Input, unsigned char* Output, i
         if (!changed) break;
     }
 
-    free(work);
+    ScratchFree(work);
 
     /* Write output: skeleton black on white background */
     if (Channels == 1) {
@@ -562,10 +788,14 @@ OC_STATUS ocularSkeletonizeFilter(unsigned char* Input, unsigned char* Output, i
         }
     }
 
-    free(bin);
+    ScratchFree(bin);
     return OC_STATUS_OK;
 }
 
+size_t skeletonizeScratchSize(int Width, int Height) {
+    return 2 * ScratchBlockSize((size_t)Width * Height);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,12 +1,29 @@
 #ifndef OCULAR_MORPHOLOGY_FILTERS_H
 #define OCULAR_MORPHOLOGY_FILTERS_H
 
+#include <stddef.h>
 #include "core.h"
 #include "util.h"
 #include "blur_filters.h"
 
+/**
+ * @enum OcStructuringElement
+ * @brief Shape of the neighborhood used by the erode and dilate filters.
+ */
+typedef enum {
+    OC_MORPH_SQUARE = 0,  // (2 * Radius + 1) square
+    OC_MORPH_DIAMOND = 1, // pixels within a city block distance of Radius
+    OC_MORPH_OCTAGON = 2, // square and diamond combined; the closest of the three to a disk
+} OcStructuringElement;
+
+// Internal use: running minimum (or maximum) over the elements at offsets [Lo, Hi] along one line of Count elements of Span
+// bytes, for the pipeline stages. G and H are scratch buffers of (Count + Hi - Lo) * Span bytes each.
+void rankLine(const unsigned char* Src, ptrdiff_t srcStep, unsigned char* Dst, ptrdiff_t dstStep, int Count, int Span, int Lo, int Hi,
+              bool IsMax, bool Accumulate, unsigned char* G, unsigned char* H);
+
 /**
  * @brief Performs a minimum rank filter that replaces the central pixel with the darkest one in the radius.
+ * The cost per pixel does not depend on the radius.
  *  @ingroup group_ip_filters
  *  @param Input The image input data buffer.
  *  @param Output The image output data buffer.
@@ -20,6 +37,7 @@ OC_STATUS ocularErodeFilter(unsigned char* Input, unsigned char* Output, int Wid
 
 /**
  * @brief Performs a maximum rank filter that replaces the central pixel with the lightest one in the radius.
+ * The cost per pixel does not depend on the radius.
  *  @ingroup group_ip_filters
  *  @param Input The image input data buffer.
  *  @param Output The image output data buffer.
@@ -31,8 +49,41 @@ OC_STATUS ocularErodeFilter(unsigned char* Input, unsigned char* Output, int Wid
  */
 OC_STATUS ocularDilateFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius);
 
+/**
+ * @brief Performs a minimum rank filter over a square, diamond or octagon. Every shape is decomposed into line passes, so the
+ * cost per pixel does not depend on the radius.
+ *  @ingroup group_ip_filters
+ *  @param Input The image input data buffer.
+ *  @param Output The image output data buffer.
+ *  @param Width The width of the image in pixels.
+ *  @param Height The height of the image in pixels.
+ *  @param Stride The number of bytes in one row of pixels.
+ *  @param Radius A radius in pixels to use for calculation, >= 0
+ *  @param Element The shape of the neighborhood.
+ *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularErodeShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                 OcStructuringElement Element);
+
+/**
+ * @brief Performs a maximum rank filter over a square, diamond or octagon. Every shape is decomposed into line passes, so the
+ * cost per pixel does not depend on the radius.
+ *  @ingroup group_ip_filters
+ *  @param Input The image input data buffer.
+ *  @param Output The image output data buffer.
+ *  @param Width The width of the image in pixels.
+ *  @param Height The height of the image in pixels.
+ *  @param Stride The number of bytes in one row of pixels.
+ *  @param Radius A radius in pixels to use for calculation, >= 0
+ *  @param Element The shape of the neighborhood.
+ *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularDilateShapeFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius,
+                                  OcStructuringElement Element);
+
 /**
  * @brief Apply a minimum filter. This is the same as Erode except it uses a circular kernel that accounts for edges.
+ * The circle is processed as rectangles of rows sharing the same width, so the cost grows linearly with the radius.
  * @ingroup group_ip_filters
  * @param Input The image input data buffer
  * @param Output The image output data buffer
@@ -46,6 +97,7 @@ OC_STATUS ocularMinFilter(unsigned char* Input, unsigned char* Output, int Width
 
 /**
  * @brief Apply a maximum filter. This is the same as Dilate except it uses a circular kernel that accounts for edges.
+ * The circle is processed as rectangles of rows sharing the same width, so the cost grows linearly with the radius.
  * @ingroup group_ip_filters
  * @param Input The image input data buffer
  * @param Output The image output data buffer
@@ -1,19 +1,149 @@
 #include "ocr.h"
 #include "util.h"
+#include "parallel.h"
+#include "workspace.h"
+
+
+// Counts per channel: 256 fine bins followed by 16 coarse bins of 16 values each
+#define DESPECKLE_HISTOGRAM 272
+#define DESPECKLE_MAX_SCALES 63
+
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    int* Histograms; // per thread, one histogram per window size and channel
+    size_t HistogramSize;
+    int Width;
+    int Height;
+    int Stride;
+    int Channels;
+    int Scales; // window sizes 3, 5, ... 2 * Scales + 1
+    int Threshold;
+} DespeckleParams;
+
+// Adds (Delta 1) or removes (Delta -1) the samples of column X in rows [Y0, Y1] for every channel
+static inline void despeckleColumn(const DespeckleParams* p, int* histogram, int X, int Y0, int Y1, int Delta) {
+    const unsigned char* in = p->Input + (size_t)Y0 * p->Stride + X * p->Channels;
+    for (int y = Y0; y <= Y1; y++, in += p->Stride) {
+        for (int c = 0; c < p->Channels; c++) {
+            int* h = histogram + c * DESPECKLE_HISTOGRAM;
+            h[in[c]] += Delta;
+            h[256 + (in[c] >> 4)] += Delta;
+        }
+    }
+}
+
+static void despeckleRows(void* Context, int Begin, int End, int Thread) {
+    const DespeckleParams* p = (const DespeckleParams*)Context;
+    int width = p->Width, height = p->Height, channels = p->Channels;
+    int* histograms = p->Histograms + Thread * p->HistogramSize;
+    // Center column of every window size's histogram; each is slid along the row only when a sample needs that size
+    int positions[DESPECKLE_MAX_SCALES];
+
+    for (int y = Begin; y < End; y++) {
+        const unsigned char* in = p->Input + (size_t)y * p->Stride;
+        unsigned char* out = p->Output + (size_t)y * p->Stride;
+        for (int s = 0; s < p->Scales; s++)
+            positions[s] = -1;
+
+        for (int x = 0; x < width; x++, in += channels, out += channels) {
+            bool pending[4] = { true, true, true, true };
+            int remaining = channels;
+
+            for (int s = 0; s < p->Scales && remaining > 0; s++) {
+                int radius = s + 1;
+                int size = 2 * radius + 1;
+                int y0 = max(y - radius, 0), y1 = min(y + radius, height - 1);
+                int* histogram = histograms + s * channels * DESPECKLE_HISTOGRAM;
+
+                // Rebuild when sliding would touch more columns than the window holds
+                if (positions[s] < 0 || 2 * (x - positions[s]) >= size) {
+                    memset(histogram, 0, channels * DESPECKLE_HISTOGRAM * sizeof(int));
+                    for (int wx = max(x - radius, 0); wx <= min(x + radius, width - 1); wx++)
+                        despeckleColumn(p, histogram, wx, y0, y1, 1);
+                } else {
+                    for (int pos = positions[s]; pos < x; pos++) {
+                        if (pos - radius >= 0)
+                            despeckleColumn(p, histogram, pos - radius, y0, y1, -1);
+                        if (pos + radius + 1 < width)
+                            despeckleColumn(p, histogram, pos + radius + 1, y0, y1, 1);
+                    }
+                }
+                positions[s] = x;
+
+                int area = size * size;
+                int outside = area - (min(x + radius, width - 1) - max(x - radius, 0) + 1) * (y1 - y0 + 1);
+                int rank = area / 2;
 
+                for (int c = 0; c < channels; c++) {
+                    if (!pending[c])
+                        continue;
 
-unsigned char getMedian(unsigned char* window, int size) {
-    // Simple bubble sort
-    for (int i = 0; i < size - 1; i++) {
-        for (int j = 0; j < size - i - 1; j++) {
-            if (window[j] > window[j + 1]) {
-                unsigned char temp = window[j];
-                window[j] = window[j + 1];
-                window[j + 1] = temp;
+                    // Median of the window, counting the samples beyond the border as copies of the center
+                    const int* h = histogram + c * DESPECKLE_HISTOGRAM;
+                    int current = in[c];
+                    int below = 0;
+                    int bin = 0;
+                    for (;; bin++) {
+                        int count = h[256 + bin] + ((current >> 4) == bin ? outside : 0);
+                        if (below + count > rank)
+                            break;
+                        below += count;
+                    }
+                    int median = bin * 16;
+                    int count;
+                    for (;; median++) {
+                        count = h[median] + (median == current ? outside : 0);
+                        if (below + count > rank)
+                            break;
+                        below += count;
+                    }
+                    int above = area - below - count;
+
+                    if (abs(current - median) <= p->Threshold) {
+                        out[c] = (unsigned char)current;
+                    } else if ((below > 0 && above > 0) || s == p->Scales - 1) {
+                        // the median lies strictly between the window minimum and maximum, or the largest window is reached
+                        out[c] = (unsigned char)median;
+                    } else {
+                        continue;
+                    }
+                    pending[c] = false;
+                    remaining--;
+                }
             }
         }
     }
-    return window[size / 2];
+}
+
+bool adaptiveMedianFilter(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int maxWindowSize,
+                          int Threshold) {
+    int channels = Stride / Width;
+    int scales = min((maxWindowSize - 1) / 2, DESPECKLE_MAX_SCALES);
+
+    if (scales < 1) {
+        for (int y = 0; y < Height; y++)
+            memcpy(Output + (size_t)y * Stride, Input + (size_t)y * Stride, (size_t)Width * channels);
+        return true;
+    }
+
+    size_t histogramSize = (size_t)scales * channels * DESPECKLE_HISTOGRAM;
+    int* histograms = (int*)ScratchAlloc(ocularGetThreadCount() * histogramSize * sizeof(int), false);
+    if (histograms == NULL)
+        return false;
+
+    DespeckleParams params = { Input, Output, histograms, histogramSize, Width, Height, Stride, channels, scales, Threshold };
+    ocularParallelFor(Height, 4, despeckleRows, &params);
+
+    ScratchFree(histograms);
+    return true;
+}
+
+size_t adaptiveMedianScratchSize(int Channels, int maxWindowSize) {
+    int scales = min((maxWindowSize - 1) / 2, DESPECKLE_MAX_SCALES);
+    if (scales < 1)
+        return 0;
+    return ScratchBlockSize(ocularGetThreadCount() * (size_t)scales * Channels * DESPECKLE_HISTOGRAM * sizeof(int));
 }
 
 bool isTextImage(unsigned char* Input, int Width, int Height) {
@@ -81,6 +211,46 @@ bool isTextImage(unsigned char* Input, int Width, int Height) {
     return true;
 }
 
+typedef struct {
+    const float* pointX;
+    const float* pointY;
+    int numPoints;
+    const float* sinMap;
+    const float* cosMap;
+    int halfHoughWidth;
+    int houghWidth;
+    unsigned int* houghMap;
+} SkewVoteParams;
+
+// Points voted per block: the block's coordinates stay in L1 while every theta row of the band is visited
+#define SKEW_VOTE_BLOCK 1024
+
+// Each band owns whole theta rows of the hough map, so the votes need no merging
+static void skewVoteRows(void* Context, int Begin, int End, int Thread) {
+    const SkewVoteParams* p = (const SkewVoteParams*)Context;
+    (void)Thread;
+    int radii[SKEW_VOTE_BLOCK];
+    for (int start = 0; start < p->numPoints; start += SKEW_VOTE_BLOCK) {
+        const float* pointX = p->pointX + start;
+        const float* pointY = p->pointY + start;
+        int count = min(SKEW_VOTE_BLOCK, p->numPoints - start);
+        for (int theta = Begin; theta < End; theta++) {
+            float cosTheta = p->cosMap[theta];
+            float sinTheta = p->sinMap[theta];
+            // separate pass so the compiler vectorizes it
+            for (int k = 0; k < count; k++) {
+                radii[k] = (int)(cosTheta * pointX[k] - sinTheta * pointY[k]) + p->halfHoughWidth;
+            }
+            unsigned int* houghMapLine = p->houghMap + (size_t)theta * p->houghWidth;
+            for (int k = 0; k < count; k++) {
+                if ((unsigned int)radii[k] < (unsigned int)p->houghWidth) {
+                    houghMapLine[radii[k]]++;
+                }
+            }
+        }
+    }
+}
+
 float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRectPtr, int maxSkewToDetect, int stepsPerDegree,
                     int localPeakRadius, int nLineCount) {
     OcRect CheckRect = *CheckRectPtr;
@@ -94,6 +264,7 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
     maxSkewToDetect = clamp(maxSkewToDetect, 0, 91);
     localPeakRadius = clamp(localPeakRadius, 1, 10);
     stepsPerDegree = clamp(stepsPerDegree, 1, 10);
+    nLineCount = max(nLineCount, 1);
     int houghHeight = (2 * maxSkewToDetect * stepsPerDegree);
     float thetaStep = (2 * maxSkewToDetect * M_PI / 180) / houghHeight;
     int halfWidth = Width >> 1;
@@ -102,83 +273,81 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
     int halfHoughWidth = (int)sqrtf((float)(halfWidth * halfWidth + halfHeight * halfHeight));
     int houghWidth = (halfHoughWidth * 2);
     float minTheta = 90.0f - maxSkewToDetect;
-    unsigned short* houghMap = (unsigned short*)calloc(houghHeight * houghWidth, sizeof(unsigned short));
-    float* sinMap = (float*)malloc(houghHeight * sizeof(float));
-    float* cosMap = (float*)malloc(houghHeight * sizeof(float));
-    HoughLine* HoughLines = (HoughLine*)calloc(houghHeight * houghWidth, sizeof(HoughLine));
-    if (houghMap == NULL || sinMap == NULL || cosMap == NULL || HoughLines == NULL) {
-        if (houghMap) {
-            free(houghMap);
-            houghMap = NULL;
-        }
-        if (sinMap) {
-            free(sinMap);
-            sinMap = NULL;
-        }
-        if (cosMap) {
-            free(cosMap);
-            cosMap = NULL;
-        }
-        if (HoughLines) {
-            free(HoughLines);
-            HoughLines = NULL;
-        }
-        return 0.0f;
-    } else {
-        // precomputed sin and cos tables
-        float mt = (minTheta * M_PI / 180.0f);
-        for (int i = 0; i < houghHeight; i++) {
-            float cur_weight = mt + (i * thetaStep);
-            sinMap[i] = fastSin(cur_weight);
-            cosMap[i] = fastCos(cur_weight);
-        }
-    }
+
     int startX = -halfWidth + CheckRect.x;
     int startY = -halfHeight + CheckRect.y;
     int stopX = Width - halfWidth - (Width - CheckRect.Width);
     int stopY = Height - halfHeight - (Height - CheckRect.Height) - 1;
-    int offset = Width - CheckRect.Width;
 
+    // edge points are dark pixels above light ones; count them first so the list is allocated exactly
+    int numPoints = 0;
+    for (int Y = startY; Y < stopY; Y++) {
+        const unsigned char* src = Input + (Y - startY + CheckRect.y) * Width + CheckRect.x;
+        const unsigned char* srcBelow = src + Width;
+        for (int X = 0; X < stopX - startX; X++) {
+            numPoints += (src[X] < 128) && (srcBelow[X] >= 128);
+        }
+    }
 
-    unsigned char* src = Input + CheckRect.y * Width + CheckRect.x;
-    unsigned char* srcBelow = src + Width;
+    unsigned int* houghMap = (unsigned int*)ScratchAlloc((size_t)houghHeight * houghWidth * sizeof(unsigned int), true);
+    float* sinMap = (float*)ScratchAlloc(houghHeight * sizeof(float), false);
+    float* cosMap = (float*)ScratchAlloc(houghHeight * sizeof(float), false);
+    float* pointX = (float*)ScratchAlloc(max(numPoints, 1) * sizeof(float), false);
+    float* pointY = (float*)ScratchAlloc(max(numPoints, 1) * sizeof(float), false);
+    HoughLine* HoughLines = (HoughLine*)ScratchAlloc(nLineCount * sizeof(HoughLine), false);
+    if (houghMap == NULL || sinMap == NULL || cosMap == NULL || pointX == NULL || pointY == NULL || HoughLines == NULL) {
+        ScratchFree(houghMap);
+        ScratchFree(sinMap);
+        ScratchFree(cosMap);
+        ScratchFree(pointX);
+        ScratchFree(pointY);
+        ScratchFree(HoughLines);
+        return 0.0f;
+    }
+
+    // precomputed sin and cos tables
+    float mt = (minTheta * M_PI / 180.0f);
+    for (int i = 0; i < houghHeight; i++) {
+        float cur_weight = mt + (i * thetaStep);
+        sinMap[i] = fastSin(cur_weight);
+        cosMap[i] = fastCos(cur_weight);
+    }
 
+    // collect the edge points in one row-major pass
+    int n = 0;
     for (int Y = startY; Y < stopY; Y++) {
+        const unsigned char* src = Input + (Y - startY + CheckRect.y) * Width + CheckRect.x;
+        const unsigned char* srcBelow = src + Width;
         for (int X = startX; X < stopX; X++, src++, srcBelow++) {
             if ((*src < 128) && (*srcBelow >= 128)) {
-                for (int theta = 0; theta < houghHeight; theta++) {
-                    int radius = (int)(cosMap[theta] * X - sinMap[theta] * Y) + halfHoughWidth;
-
-                    if ((radius < 0) || (radius >= houghWidth)) {
-                        continue;
-                    }
-
-                    houghMap[theta * houghWidth + radius]++;
-                }
+                pointX[n] = (float)X;
+                pointY[n] = (float)Y;
+                n++;
             }
         }
-        src += offset;
-        srcBelow += offset;
     }
 
+    SkewVoteParams params = { pointX, pointY, numPoints, sinMap, cosMap, halfHoughWidth, houghWidth, houghMap };
+    ocularParallelFor(houghHeight, 8, skewVoteRows, &params);
 
     // find the maximum value of the hough map
     float maxMapIntensity = 0.0000000001f;
     for (int theta = 0; theta < houghHeight; theta++) {
-        unsigned short* houghMapLine = houghMap + theta * houghWidth;
+        unsigned int* houghMapLine = houghMap + theta * houghWidth;
         for (int radius = 0; radius < houghWidth; radius++) {
             maxMapIntensity = max(maxMapIntensity, houghMapLine[radius]);
         }
     }
     int minLineIntensity = Width / 10;
 
-    // collects straight lines greater than or equal to the specified intensity
+    // collects straight lines greater than or equal to the specified intensity, keeping the nLineCount strongest in
+    // descending order (earlier lines first among equals)
 
     int lineIntensity = 0;
     bool foundGreater = false;
     int lineSize = 0;
     for (int theta = 0; theta < houghHeight; theta++) {
-        unsigned short* houghMapLine = houghMap + theta * houghWidth;
+        unsigned int* houghMapLine = houghMap + theta * houghWidth;
         for (int radius = 0; radius < houghWidth; radius++) {
             // get current intensity
             lineIntensity = houghMapLine[radius];
@@ -186,6 +355,9 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
             if (lineIntensity < minLineIntensity) {
                 continue;
             }
+            if (lineSize == nLineCount && lineIntensity <= HoughLines[lineSize - 1].Intensity) {
+                continue;
+            }
 
             foundGreater = false;
 
@@ -212,7 +384,7 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
                         break;
                     }
                     // compare current value with adjacent edge
-                    if (houghMap[t * houghWidth + r] > lineIntensity) {
+                    if (houghMap[t * houghWidth + r] > (unsigned int)lineIntensity) {
                         foundGreater = true;
                         break;
                     }
@@ -225,31 +397,23 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
                 tempVar.Radius = (radius - halfHoughWidth);
                 tempVar.Intensity = lineIntensity;
                 tempVar.RelativeIntensity = lineIntensity / maxMapIntensity;
-                HoughLines[lineSize] = tempVar;
-                lineSize++;
+
+                int pos = min(lineSize, nLineCount - 1);
+                while (pos > 0 && HoughLines[pos - 1].Intensity < lineIntensity) {
+                    HoughLines[pos] = HoughLines[pos - 1];
+                    pos--;
+                }
+                HoughLines[pos] = tempVar;
+                lineSize = min(lineSize + 1, nLineCount);
             }
         }
     }
 
     float skewAngle = 0;
     if (lineSize > 0) {
-        // sort from large to small
-        HoughLine temp;
-        for (int i = 0; i < lineSize; i++) {
-            for (int j = 0; j < lineSize - 1; j++) {
-                if (HoughLines[j].Intensity < HoughLines[j + 1].Intensity) {
-                    temp = HoughLines[j + 1];
-                    HoughLines[j + 1] = HoughLines[j];
-                    HoughLines[j] = temp;
-                }
-            }
-        }
-
-        int n = min(nLineCount, lineSize);
-
         float sumIntensity = 0;
 
-        for (int i = 0; i < n; i++) {
+        for (int i = 0; i < lineSize; i++) {
             if (HoughLines[i].RelativeIntensity > 0.5f) {
                 skewAngle += (HoughLines[i].Theta * HoughLines[i].RelativeIntensity);
                 sumIntensity += HoughLines[i].RelativeIntensity;
@@ -257,24 +421,28 @@ float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRe
         }
         skewAngle = skewAngle / sumIntensity;
     }
-    if (houghMap) {
-        free(houghMap);
-        houghMap = NULL;
-    }
-    if (sinMap) {
-        free(sinMap);
-        sinMap = NULL;
-    }
-    if (cosMap) {
-        free(cosMap);
-        cosMap = NULL;
-    }
-    if (HoughLines) {
-        free(HoughLines);
-        HoughLines = NULL;
-    }
+    ScratchFree(houghMap);
+    ScratchFree(sinMap);
+    ScratchFree(cosMap);
+    ScratchFree(pointX);
+    ScratchFree(pointY);
+    ScratchFree(HoughLines);
     if (skewAngle != 0) {
         return skewAngle - 90.0f;
     }
     return skewAngle;
-}
\ No newline at end of file
+}
+
+size_t skewAngleScratchSize(int Width, int Height, int maxSkewToDetect, int stepsPerDegree, int nLineCount) {
+    maxSkewToDetect = clamp(maxSkewToDetect, 0, 91);
+    stepsPerDegree = clamp(stepsPerDegree, 1, 10);
+    int houghHeight = 2 * maxSkewToDetect * stepsPerDegree;
+    int halfWidth = Width >> 1;
+    int halfHeight = Height >> 1;
+    int houghWidth = 2 * (int)sqrtf((float)(halfWidth * halfWidth + halfHeight * halfHeight));
+    // Edge points need a light row below a dark one, so at most every other row of the whole image holds them
+    size_t rows = max(Height - 1, 1) - 1;
+    size_t numPoints = max((size_t)max(Width - 1, 1) * ((rows + 1) / 2), (size_t)1);
+    return ScratchBlockSize((size_t)houghHeight * houghWidth * sizeof(unsigned int)) + 2 * ScratchBlockSize(houghHeight * sizeof(float)) +
+           2 * ScratchBlockSize(numPoints * sizeof(float)) + ScratchBlockSize(max(nLineCount, 1) * sizeof(HoughLine));
+}
@@ -12,6 +12,7 @@
 #define OCULAR_OCR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct {
     float Theta;
@@ -27,14 +28,19 @@ typedef struct {
     int Height;
 } OcRect;
 
-// Determine the median of the current pixel window (used for Despeckle)
-unsigned char getMedian(unsigned char* window, int size);
+// Adaptive median filter behind ocularDespeckle. For every sample the window grows from 3x3 in steps of 2 up to maxWindowSize
+// until the median is not an impulse; samples beyond the border take the value of the center pixel.
+bool adaptiveMedianFilter(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int maxWindowSize,
+                          int Threshold);
+size_t adaptiveMedianScratchSize(int Channels, int maxWindowSize);
 
 // Determine if an image is primarily text based.
 bool isTextImage(unsigned char* Input, int Width, int Height);
 
 float calcSkewAngle(unsigned char* Input, int Width, int Height, OcRect* CheckRectPtr, int maxSkewToDetect, int stepsPerDegree,
                     int localPeakRadius, int nLineCount);
+// Largest scratch of calcSkewAngle() over a whole Width x Height image
+size_t skewAngleScratchSize(int Width, int Height, int maxSkewToDetect, int stepsPerDegree, int nLineCount);
 
 
 #endif  /* OCULAR_OCR_H */
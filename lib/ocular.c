@@ -14,6 +14,7 @@ extern "C" {
 #include "ocular.h"
 #include "util.h"
 #include "auxiliary.h"
+#include "resample.h"
 
 
     /*
@@ -60,6 +61,22 @@ extern "C" {
         true,
     }; */
 
+    typedef struct {
+        unsigned char* Input;
+        unsigned char* Output;
+        int Width;
+        int Stride;
+        int Channels;
+    } GrayscaleParams;
+
+    static void grayscaleRows(void* Context, int Begin, int End, int Thread) {
+        const GrayscaleParams* p = (const GrayscaleParams*)Context;
+        (void)Thread;
+        for (int Y = Begin; Y < End; Y++) {
+            simdGrayscaleRow(p->Input + Y * p->Stride, p->Output + Y * p->Width, p->Width, p->Channels);
+        }
+    }
+
     OC_STATUS ocularGrayscaleFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride) {
 
         if (Input == NULL || Output == NULL)
@@ -71,46 +88,20 @@ extern "C" {
         if (Channels != 1 && Channels != 3 && Channels != 4)
             return OC_STATUS_ERR_NOTSUPPORTED;
 
-        const int B_WT = (int)(0.114 * 256 + 0.5);
-        const int G_WT = (int)(0.587 * 256 + 0.5);
-        const int R_WT = 256 - B_WT - G_WT; //     int(0.299 * 256 + 0.5);
-        int Channel = Stride / Width;
-        if (Channel == 3) {
-            for (int Y = 0; Y < Height; Y++) {
-                unsigned char* LinePS = Input + Y * Stride;
-                unsigned char* LinePD = Output + Y * Width;
-                int X = 0;
-                for (; X < Width - 4; X += 4, LinePS += Channel * 4) {
-                    LinePD[X + 0] = (B_WT * LinePS[0] + G_WT * LinePS[1] + R_WT * LinePS[2]) >> 8;
-                    LinePD[X + 1] = (B_WT * LinePS[3] + G_WT * LinePS[4] + R_WT * LinePS[5]) >> 8;
-                    LinePD[X + 2] = (B_WT * LinePS[6] + G_WT * LinePS[7] + R_WT * LinePS[8]) >> 8;
-                    LinePD[X + 3] = (B_WT * LinePS[9] + G_WT * LinePS[10] + R_WT * LinePS[11]) >> 8;
-                }
-                for (; X < Width; X++, LinePS += Channel) {
-                    LinePD[X] = (B_WT * LinePS[0] + G_WT * LinePS[1] + R_WT * LinePS[2]) >> 8;
-                }
-            }
-        } else if (Channel == 4) {
-            for (int Y = 0; Y < Height; Y++) {
-                unsigned char* LinePS = Input + Y * Stride;
-                unsigned char* LinePD = Output + Y * Width;
-                int X = 0;
-                for (; X < Width - 4; X += 4, LinePS += Channel * 4) {
-                    LinePD[X + 0] = (B_WT * LinePS[0] + G_WT * LinePS[1] + R_WT * LinePS[2]) >> 8;
-                    LinePD[X + 1] = (B_WT * LinePS[4] + G_WT * LinePS[5] + R_WT * LinePS[6]) >> 8;
-                    LinePD[X + 2] = (B_WT * LinePS[8] + G_WT * LinePS[9] + R_WT * LinePS[10]) >> 8;
-                    LinePD[X + 3] = (B_WT * LinePS[12] + G_WT * LinePS[13] + R_WT * LinePS[14]) >> 8;
-                }
-                for (; X < Width; X++, LinePS += Channel) {
-                    LinePD[X] = (B_WT * LinePS[0] + G_WT * LinePS[1] + R_WT * LinePS[2]) >> 8;
-                }
-            }
-        } else if (Channel == 1) {
+        if (Channels == 1) {
             if (Output != Input) {
                 memcpy(Output, Input, Height * Stride);
             }
+            return OC_STATUS_OK;
         }
 
+        GrayscaleParams params = { Input, Output, Width, Stride, Channels };
+        // The packed output rows overlap the input rows when filtering in place, which only a top-down pass handles
+        if (Input == Output)
+            grayscaleRows(&params, 0, Height, 0);
+        else
+            ocularParallelFor(Height, 16, grayscaleRows, &params);
+
         return OC_STATUS_OK;
     }
 
@@ -139,17 +130,7 @@ extern "C" {
             AdjustMapG[pixel] = (unsigned char)(pixel * greenAdjustment);
             AdjustMapB[pixel] = (unsigned char)(pixel * blueAdjustment);
         }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                pOutput[0] = AdjustMapR[pInput[0]];
-                pOutput[1] = AdjustMapG[pInput[1]];
-                pOutput[2] = AdjustMapB[pInput[2]];
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, AdjustMapR, AdjustMapG, AdjustMapB);
 
         return OC_STATUS_OK;
     }
@@ -873,26 +854,14 @@ extern "C" {
         }
 
         // Create lookup tables to speed up calculation
-        unsigned char GammaMap[256][3];
+        unsigned char GammaMap[3][256];
         for (int i = 0; i < 256; i++) {
             for (int c = 0; c < Channels; c++) {
                 // calculate gamma
-                GammaMap[i][c] = ClampToByte(pow((float)i / 255.0, gamma[c]) * 255.0f);
-                GammaMap[i][c] = ClampToByte(pow((float)i / 255.0, gamma[c]) * 255.0f);
-                GammaMap[i][c] = ClampToByte(pow((float)i / 255.0, gamma[c]) * 255.0f);
-            }
-        }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                for (int c = 0; c < Channels; c++) {
-                    pOutput[c] = GammaMap[pInput[c]][c];
-                }
-                pInput += Channels;
-                pOutput += Channels;
+                GammaMap[c][i] = ClampToByte(pow((float)i / 255.0, gamma[c]) * 255.0f);
             }
         }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, GammaMap[0], GammaMap[1], GammaMap[2]);
 
         return OC_STATUS_OK;
     }
@@ -932,27 +901,7 @@ extern "C" {
             brightnessContrastMap[pixel] = ClampToByte(brightnessValue);
         }
 
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                if (Channels == 1) {
-                    // Grayscale
-                    pOutput[0] = brightnessContrastMap[pInput[0]];
-                } else {
-                    // RGB or RGBA
-                    pOutput[0] = brightnessContrastMap[pInput[0]];
-                    pOutput[1] = brightnessContrastMap[pInput[1]];
-                    pOutput[2] = brightnessContrastMap[pInput[2]];
-                    // Preserve alpha channel if present
-                    if (Channels == 4) {
-                        pOutput[3] = pInput[3];
-                    }
-                }
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, brightnessContrastMap, brightnessContrastMap, brightnessContrastMap);
 
         return OC_STATUS_OK;
     }
@@ -977,17 +926,7 @@ extern "C" {
         for (int pixel = 0; pixel < 256; pixel++) {
             contrastMap[pixel] = ClampToByte((pixel - 127) * contrast + 127);
         }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                pOutput[0] = contrastMap[pInput[0]];
-                pOutput[1] = contrastMap[pInput[1]];
-                pOutput[2] = contrastMap[pInput[2]];
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, contrastMap, contrastMap, contrastMap);
 
         return OC_STATUS_OK;
     }
@@ -1011,27 +950,7 @@ extern "C" {
         for (int pixel = 0; pixel < 256; pixel++) {
             exposureMap[pixel] = ClampToByte(pixel * pow(2.0, exposure));
         }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                if (Channels == 1) {
-                    // Grayscale
-                    pOutput[0] = exposureMap[pInput[0]];
-                } else {
-                    // RGB or RGBA
-                    pOutput[0] = exposureMap[pInput[0]];
-                    pOutput[1] = exposureMap[pInput[1]];
-                    pOutput[2] = exposureMap[pInput[2]];
-                    // Preserve alpha channel if present
-                    if (Channels == 4) {
-                        pOutput[3] = pInput[3];
-                    }
-                }
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, exposureMap, exposureMap, exposureMap);
 
         return OC_STATUS_OK;
     }
@@ -1056,17 +975,7 @@ extern "C" {
         for (int pixel = 0; pixel < 256; pixel++) {
             BrightnessMap[pixel] = ClampToByte(pixel + brightness);
         }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                pOutput[0] = BrightnessMap[pInput[0]];
-                pOutput[1] = BrightnessMap[pInput[1]];
-                pOutput[2] = BrightnessMap[pInput[2]];
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, BrightnessMap, BrightnessMap, BrightnessMap);
 
         return OC_STATUS_OK;
     }
@@ -1145,14 +1054,14 @@ extern "C" {
         unsigned short sIntensity = (unsigned short)max(min(intensity, 100), 0);
         int c1 = 256 * (100 - sIntensity) / 100;
         int c2 = 256 * (100 - (100 - sIntensity)) / 100;
-        short* distanceColorMap = (short*)malloc(Height * sizeof(short));
-        short* patchDistanceMap = (short*)malloc(Height * sizeof(short));
+        short* distanceColorMap = (short*)ScratchAlloc(Height * sizeof(short), false);
+        short* patchDistanceMap = (short*)ScratchAlloc(Height * sizeof(short), false);
         if (distanceColorMap == NULL || patchDistanceMap == NULL) {
             if (distanceColorMap) {
-                free(distanceColorMap);
+                ScratchFree(distanceColorMap);
             }
             if (patchDistanceMap) {
-                free(patchDistanceMap);
+                ScratchFree(patchDistanceMap);
             }
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
@@ -1179,12 +1088,16 @@ extern "C" {
                 pOutput += Channels;
             }
         }
-        free(distanceColorMap);
-        free(patchDistanceMap);
+        ScratchFree(distanceColorMap);
+        ScratchFree(patchDistanceMap);
 
         return OC_STATUS_OK;
     }
 
+    size_t hazeFilterScratchSize(int Height) {
+        return 2 * ScratchBlockSize((size_t)Height * sizeof(short));
+    }
+
     OC_STATUS ocularOpacityFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
                                    float opacity) {
 
@@ -1291,17 +1204,7 @@ extern "C" {
             }
         }
 
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                pOutput[0] = LevelMapR[pInput[0]];
-                pOutput[1] = LevelMapG[pInput[1]];
-                pOutput[2] = LevelMapB[pInput[2]];
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, LevelMapR, LevelMapG, LevelMapB);
 
         return OC_STATUS_OK;
     }
@@ -1629,17 +1532,7 @@ extern "C" {
         for (int pixel = 0; pixel < 256; pixel++) {
             invertMap[pixel] = (unsigned char)(255 - pixel);
         }
-        for (int Y = 0; Y < Height; Y++) {
-            unsigned char* pOutput = Output + (Y * Stride);
-            unsigned char* pInput = Input + (Y * Stride);
-            for (int X = 0; X < Width; X++) {
-                pOutput[0] = invertMap[pInput[0]];
-                pOutput[1] = invertMap[pInput[1]];
-                pOutput[2] = invertMap[pInput[2]];
-                pInput += Channels;
-                pOutput += Channels;
-            }
-        }
+        applyCurve(Input, Output, Width, Height, Channels, Stride, invertMap, invertMap, invertMap);
 
         return OC_STATUS_OK;
     }
@@ -1743,7 +1636,7 @@ extern "C" {
         if (Channels != 1 && Channels != 3 && Channels != 4)
             return OC_STATUS_ERR_NOTSUPPORTED;
 
-        unsigned char* Luminance = (unsigned char*)malloc(Width * Height * 2 * sizeof(unsigned char));
+        unsigned char* Luminance = (unsigned char*)ScratchAlloc(Width * Height * 2 * sizeof(unsigned char), false);
         unsigned char* Mask = Luminance + (Width * Height);
         if (Luminance == NULL)
             return OC_STATUS_ERR_OUTOFMEMORY;
@@ -1772,11 +1665,16 @@ extern "C" {
                 pInput += Channels;
             }
         }
-        free(Luminance);
+        ScratchFree(Luminance);
 
         return OC_STATUS_OK;
     }
 
+    size_t autoContrastScratchSize(int Width, int Height) {
+        // The box blur of the luminance runs while both planes are held
+        return ScratchBlockSize((size_t)Width * Height * 2) + boxBlurScratchSize(Width, Height, 1);
+    }
+
     OC_STATUS ocularAutoGammaCorrection(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride) {
 
         if ((Input == NULL) || (Output == NULL))
@@ -1796,7 +1694,7 @@ extern "C" {
             for (int y = 0; y < 256; y++) {
                 Table[y] = ClampToByte((int)(pow(y / 255.0f, Gamma) * 255.0f));
             }
-            applyCurve(Input, Output, Width, Height, Stride, Channels, Table, Table, Table);
+            applyCurve(Input, Output, Width, Height, Channels, Stride, Table, Table, Table);
         } else {
             float GammaR = -0.3 / (log10(AvgR / 256.0f));
             float GammaG = -0.3 / (log10(AvgG / 256.0f));
@@ -2162,161 +2060,174 @@ extern "C" {
         return OC_STATUS_OK;
     }
 
-    static void bilateralHorizontal(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, float* range_table_f,
-                                    float inv_alpha_f, float* left_Color_Buffer, float* left_Factor_Buffer, float* right_Color_Buffer,
-                                    float* right_Factor_Buffer) {
-
-        // Left and right pass
-        int Stride = Width * Channels;
-        const unsigned char* src_left_color = Input;
-        float* left_Color = left_Color_Buffer;
-        float* left_Factor = left_Factor_Buffer;
-
-        int last_index = Stride * Height - 1;
-        const unsigned char* src_right_color = Input + last_index;
-        float* right_Color = right_Color_Buffer + last_index;
-        float* right_Factor = right_Factor_Buffer + Width * Height - 1;
-
-        for (int y = 0; y < Height; y++) {
-            const unsigned char* src_left_prev = Input;
-            const float* left_prev_factor = left_Factor;
-            const float* left_prev_color = left_Color;
-
-            const unsigned char* src_right_prev = src_right_color;
-            const float* right_prev_factor = right_Factor;
-            const float* right_prev_color = right_Color;
-
-            // process 1st pixel separately since it has no previous
-            {
-                // if x = 0
-                *left_Factor++ = 1.f;
-                *right_Factor-- = 1.f;
-                for (int c = 0; c < Channels; c++) {
-                    *left_Color++ = *src_left_color++;
-                    *right_Color-- = *src_right_color--;
-                }
-            }
-            // handle other pixels
-            for (int x = 1; x < Width; x++) {
-                // determine difference in pixel color between current and previous
-                // calculation is different depending on number of channels
-                int left_diff = getDiffFactor(src_left_color, src_left_prev, Channels);
-                src_left_prev = src_left_color;
+    // Columns per band of the vertical bilateral pass
+    #define BILATERAL_STRIP 16
+
+    // Recursive bilateral state in fixed point: colors are Q8 and weights (factors) are Q15. Every step mixes the new
+    // value with the previous state using weights in Q16 that sum to at most 1, so the 32-bit sums cannot overflow.
+    typedef struct {
+        const unsigned char* Input;
+        unsigned char* Output;
+        int Width;
+        int Height;
+        int Stride;
+        int Channels;
+        unsigned int InvAlpha;        // 1 - alpha, Q16
+        unsigned int RangeTable[256]; // alpha * range weight of a color difference, Q16
+        unsigned short* Buffers;      // per thread: a row, or a strip of columns, of forward colors and factors
+        size_t BufferSize;            // in shorts
+    } BilateralParams;
+
+    // Same difference measure as getDiffFactor()
+    static inline int bilateralDiff(const unsigned char* A, const unsigned char* B, int Channels) {
+        switch (Channels) {
+            case 1: return abs(A[0] - B[0]);
+            case 3: return ((abs(A[0] - B[0]) + abs(A[2] - B[2])) >> 2) + (abs(A[1] - B[1]) >> 1);
+            default: return (abs(A[0] - B[0]) + abs(A[1] - B[1]) + abs(A[2] - B[2]) + abs(A[3] - B[3])) >> 2;
+        }
+    }
 
-                int right_diff = getDiffFactor(src_right_color, src_right_color - Channels, Channels);
-                src_right_prev = src_right_color;
+    static inline unsigned int bilateralStep(unsigned int InvAlpha, unsigned int Value, unsigned int Weight, unsigned int Previous) {
+        return (InvAlpha * Value + Weight * Previous + 32768) >> 16;
+    }
 
-                float left_alpha_f = range_table_f[left_diff];
-                float right_alpha_f = range_table_f[right_diff];
-                *left_Factor++ = inv_alpha_f + left_alpha_f * (*left_prev_factor++);
-                *right_Factor-- = inv_alpha_f + right_alpha_f * (*right_prev_factor--);
+    // Averages the forward and backward passes: (color + color) / (factor + factor), back from Q8 / Q15, rounded
+    static inline void bilateralResolve(const unsigned short* ForwardColor, unsigned int ForwardFactor, const unsigned int* BackColor,
+                                        unsigned int BackFactor, unsigned char* Dst, int Channels) {
+        float scale = 128.0f / (float)(ForwardFactor + BackFactor);
+        for (int c = 0; c < Channels; c++)
+            Dst[c] = (unsigned char)min((int)((ForwardColor[c] + BackColor[c]) * scale + 0.5f), 255);
+    }
 
+    // Left to right into the row buffer, then right to left resolving each pixel. The result goes to Output and feeds the
+    // vertical pass. The right pass keeps the unfiltered neighbor in Next so this pass alone tolerates Output == Input
+    static inline void bilateralRowsOf(const BilateralParams* p, int Begin, int End, int Thread, int Channels) {
+        int Width = p->Width;
+        unsigned short* Factor = p->Buffers + Thread * p->BufferSize;
+        unsigned short* Color = Factor + Width;
+
+        for (int Y = Begin; Y < End; Y++) {
+            const unsigned char* LinePS = p->Input + (size_t)Y * p->Stride;
+            unsigned char* LinePD = p->Output + (size_t)Y * p->Stride;
+
+            Factor[0] = 32768;
+            for (int c = 0; c < Channels; c++)
+                Color[c] = (unsigned short)(LinePS[c] << 8);
+            for (int X = 1; X < Width; X++) {
+                const unsigned char* Pixel = LinePS + X * Channels;
+                unsigned int Weight = p->RangeTable[bilateralDiff(Pixel, Pixel - Channels, Channels)];
+                Factor[X] = (unsigned short)bilateralStep(p->InvAlpha, 32768, Weight, Factor[X - 1]);
+                for (int c = 0; c < Channels; c++)
+                    Color[X * Channels + c] = (unsigned short)bilateralStep(p->InvAlpha, Pixel[c] << 8, Weight, Color[(X - 1) * Channels + c]);
+            }
+
+            unsigned int BackFactor = 32768, BackColor[4];
+            unsigned char Next[4];
+            const unsigned char* Pixel = LinePS + (Width - 1) * Channels;
+            for (int c = 0; c < Channels; c++) {
+                BackColor[c] = Pixel[c] << 8;
+                Next[c] = Pixel[c];
+            }
+            bilateralResolve(Color + (Width - 1) * Channels, Factor[Width - 1], BackColor, BackFactor, LinePD + (Width - 1) * Channels, Channels);
+            for (int X = Width - 2; X >= 0; X--) {
+                Pixel = LinePS + X * Channels;
+                unsigned int Weight = p->RangeTable[bilateralDiff(Pixel, Next, Channels)];
+                BackFactor = bilateralStep(p->InvAlpha, 32768, Weight, BackFactor);
                 for (int c = 0; c < Channels; c++) {
-                    *left_Color++ = (inv_alpha_f * (*src_left_color++) + left_alpha_f * (*left_prev_color++));
-                    *right_Color-- = (inv_alpha_f * (*src_right_color--) + right_alpha_f * (*right_prev_color--));
+                    BackColor[c] = bilateralStep(p->InvAlpha, Pixel[c] << 8, Weight, BackColor[c]);
+                    Next[c] = Pixel[c];
                 }
+                bilateralResolve(Color + X * Channels, Factor[X], BackColor, BackFactor, LinePD + X * Channels, Channels);
             }
         }
-        // vertical pass will be applied on top on horizontal pass, while using pixel differences from original image
-        // result color stored in 'leftcolor' and vertical pass will use it as source color
-        {
-            unsigned char* dst_color = Output; // use as temporary buffer
-            const float* leftcolor = left_Color_Buffer;
-            const float* leftfactor = left_Factor_Buffer;
-            const float* rightcolor = right_Color_Buffer;
-            const float* rightfactor = right_Factor_Buffer;
-
-            int width_height = Width * Height;
-            for (int i = 0; i < width_height; i++) {
-                // average color divided by average factor
-                float factor = 1.f / ((*leftfactor++) + (*rightfactor++));
-                for (int c = 0; c < Channels; c++) {
+    }
 
-                    *dst_color++ = (factor * ((*leftcolor++) + (*rightcolor++)));
-                }
-            }
+    static void bilateralRows(void* Context, int Begin, int End, int Thread) {
+        const BilateralParams* p = (const BilateralParams*)Context;
+        // A constant channel count lets the compiler unroll the channel loops
+        switch (p->Channels) {
+            case 1: bilateralRowsOf(p, Begin, End, Thread, 1); break;
+            case 3: bilateralRowsOf(p, Begin, End, Thread, 3); break;
+            default: bilateralRowsOf(p, Begin, End, Thread, 4); break;
         }
     }
 
-    static void bilateralVertical(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, float* range_table_f, float inv_alpha_f,
-                                  float* down_Color_Buffer, float* down_Factor_Buffer, float* up_Color_Buffer, float* up_Factor_Buffer) {
-
-        // Down pass and Up pass
-        int Stride = Width * Channels;
-        const unsigned char* src_color_first_hor = Output; // result of horizontal pass filter
-        const unsigned char* src_down_color = Input;
-        float* down_color = down_Color_Buffer;
-        float* down_factor = down_Factor_Buffer;
-
-        const unsigned char* src_down_prev = src_down_color;
-        const float* down_prev_color = down_color;
-        const float* down_prev_factor = down_factor;
-
-        int last_index = Stride * Height - 1;
-        const unsigned char* src_up_color = Input + last_index;
-        const unsigned char* src_color_last_hor = Output + last_index; // result of horizontal pass filter
-        float* up_color = up_Color_Buffer + last_index;
-        float* up_factor = up_Factor_Buffer + (Width * Height - 1);
-
-        const float* up_prev_color = up_color;
-        const float* up_prev_factor = up_factor;
-
-        // 1st line done separately because no previous line
-        {
-            // if y=0
-            for (int x = 0; x < Width; x++) {
-                *down_factor++ = 1.f;
-                *up_factor-- = 1.f;
-                for (int c = 0; c < Channels; c++) {
-                    *down_color++ = *src_color_first_hor++;
-                    *up_color-- = *src_color_last_hor--;
+    // Top to bottom over a strip of columns of the horizontal result into the strip buffer, then bottom to top resolving
+    // each pixel. Color differences are taken from Input, which in place already holds the horizontal result
+    static inline void bilateralColumnsOf(const BilateralParams* p, int Begin, int End, int Thread, int Channels) {
+        ptrdiff_t Stride = p->Stride;
+        unsigned short* Buffer = p->Buffers + Thread * p->BufferSize;
+
+        for (int Strip = Begin; Strip < End; Strip++) {
+            int Left = Strip * BILATERAL_STRIP, Count = min(BILATERAL_STRIP, p->Width - Left);
+            int RowShorts = Count * (Channels + 1);
+
+            // Row Y of the buffer holds Count factors followed by Count * Channels colors
+            const unsigned char* LinePS = p->Input + Left * Channels;
+            const unsigned char* LineHS = p->Output + Left * Channels;
+            for (int X = 0; X < Count; X++) {
+                Buffer[X] = 32768;
+                for (int c = 0; c < Channels; c++)
+                    Buffer[Count + X * Channels + c] = (unsigned short)(LineHS[X * Channels + c] << 8);
+            }
+            for (int Y = 1; Y < p->Height; Y++) {
+                LinePS += Stride;
+                LineHS += Stride;
+                const unsigned short* Prev = Buffer + (size_t)(Y - 1) * RowShorts;
+                unsigned short* Cur = Buffer + (size_t)Y * RowShorts;
+                for (int X = 0; X < Count; X++) {
+                    const unsigned char* Pixel = LinePS + X * Channels;
+                    unsigned int Weight = p->RangeTable[bilateralDiff(Pixel, Pixel - Stride, Channels)];
+                    Cur[X] = (unsigned short)bilateralStep(p->InvAlpha, 32768, Weight, Prev[X]);
+                    for (int c = 0; c < Channels; c++) {
+                        int i = Count + X * Channels + c;
+                        Cur[i] = (unsigned short)bilateralStep(p->InvAlpha, LineHS[X * Channels + c] << 8, Weight, Prev[i]);
+                    }
                 }
-                src_down_color += Channels;
-                src_up_color -= Channels;
             }
-        }
-        // handle other lines
-        for (int y = 1; y < Height; y++) {
-            for (int x = 0; x < Width; x++) {
-                // determine difference in pixel color between current and previous
-                // calculation is different depending on number of channels
-                int down_diff = getDiffFactor(src_down_color, src_down_prev, Channels);
-                src_down_prev += Channels;
-                src_down_color += Channels;
-                src_up_color -= Channels;
-                int up_diff = getDiffFactor(src_up_color, src_up_color + Stride, Channels);
-                float down_alpha_f = range_table_f[down_diff];
-                float up_alpha_f = range_table_f[up_diff];
-
-                *down_factor++ = inv_alpha_f + down_alpha_f * (*down_prev_factor++);
-                *up_factor-- = inv_alpha_f + up_alpha_f * (*up_prev_factor--);
 
-                for (int c = 0; c < Channels; c++) {
-                    *down_color++ = inv_alpha_f * (*src_color_first_hor++) + down_alpha_f * (*down_prev_color++);
-                    *up_color-- = inv_alpha_f * (*src_color_last_hor--) + up_alpha_f * (*up_prev_color--);
+            unsigned int BackFactor[BILATERAL_STRIP], BackColor[BILATERAL_STRIP][4];
+            unsigned char* LinePD = p->Output + (size_t)(p->Height - 1) * Stride + Left * Channels;
+            const unsigned short* Cur = Buffer + (size_t)(p->Height - 1) * RowShorts;
+            for (int X = 0; X < Count; X++) {
+                BackFactor[X] = 32768;
+                for (int c = 0; c < Channels; c++)
+                    BackColor[X][c] = LinePD[X * Channels + c] << 8;
+                bilateralResolve(Cur + Count + X * Channels, Cur[X], BackColor[X], BackFactor[X], LinePD + X * Channels, Channels);
+            }
+            for (int Y = p->Height - 2; Y >= 0; Y--) {
+                LinePS -= Stride;
+                LinePD -= Stride;
+                Cur -= RowShorts;
+                for (int X = 0; X < Count; X++) {
+                    const unsigned char* Pixel = LinePS + X * Channels;
+                    unsigned int Weight = p->RangeTable[bilateralDiff(Pixel, Pixel + Stride, Channels)];
+                    BackFactor[X] = bilateralStep(p->InvAlpha, 32768, Weight, BackFactor[X]);
+                    for (int c = 0; c < Channels; c++)
+                        BackColor[X][c] = bilateralStep(p->InvAlpha, LinePD[X * Channels + c] << 8, Weight, BackColor[X][c]);
+                    bilateralResolve(Cur + Count + X * Channels, Cur[X], BackColor[X], BackFactor[X], LinePD + X * Channels, Channels);
                 }
             }
         }
+    }
 
-        // average result of vertical pass is written to output buffer
-        {
-            unsigned char* dst_color = Output;
-            const float* downcolor = down_Color_Buffer;
-            const float* downfactor = down_Factor_Buffer;
-            const float* upcolor = up_Color_Buffer;
-            const float* upfactor = up_Factor_Buffer;
-
-            int width_height = Width * Height;
-            for (int i = 0; i < width_height; i++) {
-                // average color divided by average factor
-                float factor = 1.f / ((*upfactor++) + (*downfactor++));
-                for (int c = 0; c < Channels; c++) {
-                    *dst_color++ = (factor * ((*upcolor++) + (*downcolor++)));
-                }
-            }
+    static void bilateralColumns(void* Context, int Begin, int End, int Thread) {
+        const BilateralParams* p = (const BilateralParams*)Context;
+        switch (p->Channels) {
+            case 1: bilateralColumnsOf(p, Begin, End, Thread, 1); break;
+            case 3: bilateralColumnsOf(p, Begin, End, Thread, 3); break;
+            default: bilateralColumnsOf(p, Begin, End, Thread, 4); break;
         }
     }
 
+    static size_t bilateralBufferShorts(int Width, int Height, int Channels) {
+        return max((size_t)Width, (size_t)Height * BILATERAL_STRIP) * (Channels + 1);
+    }
+
+    size_t bilateralScratchSize(int Width, int Height, int Channels) {
+        return ScratchBlockSize(ocularGetThreadCount() * bilateralBufferShorts(Width, Height, Channels) * sizeof(unsigned short));
+    }
+
     OC_STATUS ocularBilateralFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
                                     float sigmaSpatial, float sigmaRange) {
 
@@ -2333,69 +2244,28 @@ extern "C" {
         sigmaSpatial = clamp(sigmaSpatial, 0.0f, 1.0f);
         sigmaRange = clamp(sigmaRange, 0.0f, 1.0f);
 
-        int reserveWidth = Width;
-        int reserveHeight = Height;
-
-        int reservePixels = reserveWidth * reserveHeight;
-        int numberOfPixels = reservePixels * Channels;
-
-        float* leftColorBuffer = (float*)calloc(sizeof(float) * numberOfPixels, 1);
-        float* leftFactorBuffer = (float*)calloc(sizeof(float) * reservePixels, 1);
-        float* rightColorBuffer = (float*)calloc(sizeof(float) * numberOfPixels, 1);
-        float* rightFactorBuffer = (float*)calloc(sizeof(float) * reservePixels, 1);
-
-        if (leftColorBuffer == NULL || leftFactorBuffer == NULL || rightColorBuffer == NULL || rightFactorBuffer == NULL) {
-            if (leftColorBuffer)
-                free(leftColorBuffer);
-            if (leftFactorBuffer)
-                free(leftFactorBuffer);
-            if (rightColorBuffer)
-                free(rightColorBuffer);
-            if (rightFactorBuffer)
-                free(rightFactorBuffer);
-
+        BilateralParams params = { Input, Output, Width, Height, Stride, Channels, 0, { 0 }, NULL, 0 };
+        params.BufferSize = bilateralBufferShorts(Width, Height, Channels);
+        params.Buffers = (unsigned short*)ScratchAlloc(ocularGetThreadCount() * params.BufferSize * sizeof(unsigned short), false);
+        if (params.Buffers == NULL)
             return OC_STATUS_ERR_OUTOFMEMORY;
-        }
-        float* downColorBuffer = leftColorBuffer;
-        float* downFactorBuffer = leftFactorBuffer;
-        float* upColorBuffer = rightColorBuffer;
-        float* upFactorBuffer = rightFactorBuffer;
+
         // compute a lookup table
         float alpha_f = (float)(exp(-sqrt(2.0) / (sigmaSpatial * 255)));
-        float inv_alpha_f = 1.f - alpha_f;
+        unsigned int alpha = (unsigned int)(alpha_f * 65536.0f + 0.5f);
+        params.InvAlpha = 65536 - alpha;
 
-        float range_table_f[255 + 1];
         float inv_sigma_range = 1.0f / (sigmaRange * 255);
-
-        float ii = 0.f;
-        for (int i = 0; i <= 255; i++, ii -= 1.f) {
-            range_table_f[i] = alpha_f * exp(ii * inv_sigma_range);
-        }
-        bilateralHorizontal(Input, Output, Width, Height, Channels, range_table_f, inv_alpha_f, leftColorBuffer, leftFactorBuffer,
-                            rightColorBuffer, rightFactorBuffer);
-        bilateralVertical(Input, Output, Width, Height, Channels, range_table_f, inv_alpha_f, downColorBuffer, downFactorBuffer,
-                          upColorBuffer, upFactorBuffer);
-
-        if (leftColorBuffer) {
-            free(leftColorBuffer);
-            leftColorBuffer = NULL;
+        for (int i = 0; i <= 255; i++) {
+            // With a zero range sigma only equal colors are mixed
+            float weight = i == 0 ? 1.0f : expf(-i * inv_sigma_range);
+            params.RangeTable[i] = min((unsigned int)(alpha_f * weight * 65536.0f + 0.5f), alpha);
         }
 
-        if (leftFactorBuffer) {
-            free(leftFactorBuffer);
-            leftFactorBuffer = NULL;
-        }
-
-        if (rightColorBuffer) {
-            free(rightColorBuffer);
-            rightColorBuffer = NULL;
-        }
-
-        if (rightFactorBuffer) {
-            free(rightFactorBuffer);
-            rightFactorBuffer = NULL;
-        }
+        ocularParallelFor(Height, 8, bilateralRows, &params);
+        ocularParallelFor((Width + BILATERAL_STRIP - 1) / BILATERAL_STRIP, 1, bilateralColumns, &params);
 
+        ScratchFree(params.Buffers);
         return OC_STATUS_OK;
     }
 
@@ -2416,72 +2286,26 @@ extern "C" {
         threshold = clamp(threshold, 0.0f, 100.0f);
 
         // Convert threshold percentage to pixel difference value (0-255)
-        float boostedIntensity = intensity;
         float thresholdValue = (threshold / 100.0f) * 255.0f;
 
-        // Allocate blur buffer for the entire image
-        unsigned char* Blur = (unsigned char*)malloc(Width * Height * Channels);
+        // Blur the whole image, kept unrounded so small differences survive the threshold
+        size_t rowFloats = (size_t)Width * Channels;
+        float* Blur = (float*)ScratchAlloc(rowFloats * Height * sizeof(float), false);
         if (Blur == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-
-        // Copy input to blur buffer
-        memcpy(Blur, Input, Width * Height * Channels);
-
-        // Apply Gaussian blur
-        ocularGaussianBlurFilter(Blur, Blur, Width, Height, Stride, GaussianSigma);
+        OC_STATUS status = gaussianBlurFloat(Input, Blur, Width, Height, Stride, GaussianSigma);
+        if (status != OC_STATUS_OK) {
+            ScratchFree(Blur);
+            return status;
+        }
 
         // Apply unsharp mask with threshold and smooth blending
         for (int Y = 0; Y < Height; Y++) {
-            for (int X = 0; X < Width; X++) {
-                // Calculate luminance delta for edge detection
-                float lumDelta = 0.0f;
-                if (Channels >= 3) {
-                    // Calculate luminance for original and blurred using BT.709 coefficients
-                    int idx = Y * Stride + X * Channels;
-                    float lumOrig = 0.2126f * Input[idx] + 0.7152f * Input[idx + 1] + 0.0722f * Input[idx + 2];
-                    float lumBlur = 0.2126f * Blur[idx] + 0.7152f * Blur[idx + 1] + 0.0722f * Blur[idx + 2];
-                    lumDelta = fabsf(lumOrig - lumBlur);
-                }
-
-                for (int c = 0; c < Channels; c++) {
-                    int idx = Y * Stride + X * Channels + c;
-
-                    // Skip alpha channel if present
-                    if (Channels == 4 && c == 3) {
-                        Output[idx] = Input[idx];
-                        continue;
-                    }
-
-                    // Calculate difference between original and blurred
-                    float diff = (float)(Input[idx] - Blur[idx]);
-
-                    // For grayscale images, use direct difference as luminance delta
-                    if (Channels == 1) {
-                        lumDelta = fabsf(diff);
-                    }
-
-                    // Apply threshold with smooth transition based on luminance delta
-                    if (lumDelta < thresholdValue) {
-                        float thresholdFactor = lumDelta / thresholdValue;
-                        diff *= thresholdFactor * thresholdFactor; // Smooth quadratic falloff
-                    }
-
-                    // Calculate sharpened value
-                    int sharpened = Input[idx] + (int)(diff * boostedIntensity);
-                    sharpened = clamp(sharpened, 0, 255);
-
-                    // Calculate blend factor based on luminance delta
-                    float blendFactor = lumDelta / 255.0f; // Normalize difference to 0-1 range
-                    blendFactor = clamp(blendFactor * (intensity), 0.0f, 1.0f);
-
-                    // Smooth blend between original and sharpened
-                    Output[idx] = (unsigned char)(Input[idx] * (1.0f - blendFactor) + sharpened * blendFactor);
-                }
-            }
+            unsharpMaskRow(Input + Y * Stride, Blur + Y * rowFloats, Output + Y * Stride, Width, Channels, intensity, thresholdValue);
         }
 
-        free(Blur);
+        ScratchFree(Blur);
         return OC_STATUS_OK;
     }
 
@@ -2533,7 +2357,7 @@ extern "C" {
                         ? (-1.0f) 
                         : ((0.0 == PhotometricStandardDeviation) ? (0.0) : (1.0f));
         }
-        float *cache = (float *)calloc(Stride * Height, sizeof(float));
+        float *cache = (float *)ScratchAlloc(Stride * Height * sizeof(float), true);
         if (cache == NULL)
             return OC_STATUS_ERR_OUTOFMEMORY;
 
@@ -2612,11 +2436,15 @@ extern "C" {
                 lineCache += Channels;
             }
         }
-        free(cache);
+        ScratchFree(cache);
 
         return OC_STATUS_OK;
     }
 
+    size_t beepsScratchSize(int Height, int Stride) {
+        return ScratchBlockSize((size_t)Stride * Height * sizeof(float));
+    }
+
     OC_STATUS ocularSharpenFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, float Strength) {
 
         if (Input == NULL || Output == NULL) {
@@ -2697,27 +2525,106 @@ extern "C" {
     OC_STATUS ocularResamplingFilter(unsigned char* Input, int Width, int Height, unsigned int Stride, unsigned char* Output,
                                 int newWidth, int newHeight, int dstStride, OcInterpolationMode InterpolationMode) {
 
-        int Channels = Stride / Width;
         if ((Input == NULL) || (Output == NULL))
             return OC_STATUS_ERR_NULLREFERENCE;
-        if ((Width <= 0) || (Height <= 0) || (newWidth <= 0) || (newHeight <= 0))
+        if ((Width <= 0) || (Height <= 0) || (newWidth <= 0) || (newHeight <= 0) || (dstStride <= 0))
             return OC_STATUS_ERR_INVALIDPARAMETER;
+        int Channels = Stride / Width;
         if ((Channels != 1) && (Channels != 3) && (Channels != 4))
             return OC_STATUS_ERR_NOTSUPPORTED;
+        if ((InterpolationMode < OC_INTERPOLATE_NEAREST) || (InterpolationMode > OC_INTERPOLATE_MITCHELL))
+            return OC_STATUS_ERR_NOTSUPPORTED;
+        if (dstStride < newWidth * Channels)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
 
-        if ((Width == newWidth) && (Height == newHeight)) {
-            memcpy(Output, Input, Width * Height * Channels * sizeof(unsigned char));
+        if ((Width == newWidth) && (Height == newHeight) && (InterpolationMode != OC_INTERPOLATE_MITCHELL)) {
+            for (int Y = 0; Y < Height; Y++) {
+                memcpy(Output + (size_t)Y * dstStride, Input + (size_t)Y * Stride, Width * Channels);
+            }
             return OC_STATUS_OK;
         }
 
-        switch (InterpolationMode) {
-            case OC_INTERPOLATE_NEAREST: nearestNeighborResize(Input, Output, Width, Height, newWidth, newHeight, Channels); break;
-            case OC_INTERPOLATE_BILINEAR: bilinearResize(Input, Output, Width, Height, newWidth, newHeight, Channels); break;
-            case OC_INTERPOLATE_BICUBIC: bicubicResize(Input, Output, Width, Height, newWidth, newHeight, Channels); break;
-            case OC_INTERPOLATE_LANZCOS: lanzcosResize(Input, Width, Height, Stride, Output, newWidth, newHeight, dstStride); break;
-        }
+        Resampler resampler;
+        OC_STATUS status = createResampler(InterpolationMode, Width, Height, newWidth, newHeight, Channels, &resampler);
+        if (status == OC_STATUS_OK)
+            status = resampleImage(&resampler, Input, Stride, Output, dstStride);
+        freeResampler(&resampler);
+        return status;
+    }
 
-        return OC_STATUS_OK;
+    // Smallest level of the pyramid that is still at least as large as the thumbnail. Nearest neighbor does not filter, so it
+    // always reads the full image.
+    static int thumbnailLevel(const int* LevelWidth, const int* LevelHeight, int Levels, const OcThumbnail* Thumbnail,
+                              OcInterpolationMode InterpolationMode) {
+        int k = 0;
+        while ((InterpolationMode != OC_INTERPOLATE_NEAREST) && (k + 1 < Levels) && (LevelWidth[k + 1] >= Thumbnail->Width) &&
+               (LevelHeight[k + 1] >= Thumbnail->Height))
+            k++;
+        return k;
+    }
+
+    OC_STATUS ocularResamplingThumbnails(const unsigned char* Input, int Width, int Height, int Stride, OcThumbnail* Thumbnails, int Count,
+                                         OcInterpolationMode InterpolationMode) {
+
+        if ((Input == NULL) || (Thumbnails == NULL))
+            return OC_STATUS_ERR_NULLREFERENCE;
+        if ((Width <= 0) || (Height <= 0) || (Count <= 0))
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        int Channels = Stride / Width;
+        if ((Channels != 1) && (Channels != 3) && (Channels != 4))
+            return OC_STATUS_ERR_NOTSUPPORTED;
+        if ((InterpolationMode < OC_INTERPOLATE_NEAREST) || (InterpolationMode > OC_INTERPOLATE_MITCHELL))
+            return OC_STATUS_ERR_NOTSUPPORTED;
+
+        int LevelWidth[32] = { Width }, LevelHeight[32] = { Height };
+        int Levels = 1;
+        while ((LevelWidth[Levels - 1] >= 2) && (LevelHeight[Levels - 1] >= 2)) {
+            LevelWidth[Levels] = LevelWidth[Levels - 1] / 2;
+            LevelHeight[Levels] = LevelHeight[Levels - 1] / 2;
+            Levels++;
+        }
+        int Deepest = 0;
+        for (int i = 0; i < Count; i++) {
+            if (Thumbnails[i].Data == NULL)
+                return OC_STATUS_ERR_NULLREFERENCE;
+            if ((Thumbnails[i].Width <= 0) || (Thumbnails[i].Height <= 0) || (Thumbnails[i].Stride < Thumbnails[i].Width * Channels))
+                return OC_STATUS_ERR_INVALIDPARAMETER;
+            Deepest = max(Deepest, thumbnailLevel(LevelWidth, LevelHeight, Levels, &Thumbnails[i], InterpolationMode));
+        }
+
+        // Build the levels the thumbnails need, packed one after the other
+        size_t PyramidSize = 0;
+        for (int k = 1; k <= Deepest; k++) {
+            PyramidSize += (size_t)LevelWidth[k] * LevelHeight[k] * Channels;
+        }
+        unsigned char* Pyramid = NULL;
+        if (PyramidSize > 0) {
+            Pyramid = (unsigned char*)ScratchAlloc(PyramidSize, false);
+            if (Pyramid == NULL)
+                return OC_STATUS_ERR_OUTOFMEMORY;
+        }
+        const unsigned char* LevelData[32] = { Input };
+        int LevelStride[32] = { Stride };
+        unsigned char* Next = Pyramid;
+        for (int k = 1; k <= Deepest; k++) {
+            halveImage(LevelData[k - 1], LevelWidth[k - 1], LevelHeight[k - 1], LevelStride[k - 1], Channels, Next);
+            LevelData[k] = Next;
+            LevelStride[k] = LevelWidth[k] * Channels;
+            Next += (size_t)LevelHeight[k] * LevelStride[k];
+        }
+
+        OC_STATUS status = OC_STATUS_OK;
+        for (int i = 0; (i < Count) && (status == OC_STATUS_OK); i++) {
+            int k = thumbnailLevel(LevelWidth, LevelHeight, Levels, &Thumbnails[i], InterpolationMode);
+            Resampler resampler;
+            status = createResampler(InterpolationMode, LevelWidth[k], LevelHeight[k], Thumbnails[i].Width, Thumbnails[i].Height, Channels,
+                                     &resampler);
+            if (status == OC_STATUS_OK)
+                status = resampleImage(&resampler, LevelData[k], LevelStride[k], Thumbnails[i].Data, Thumbnails[i].Stride);
+            freeResampler(&resampler);
+        }
+        ScratchFree(Pyramid);
+        return status;
     }
 
     OC_STATUS ocularRotateImage(unsigned char* Input, int Width, int Height, int Stride, unsigned char* Output, 
@@ -2795,14 +2702,20 @@ extern "C" {
         // Ensure filter specific parameters are within valid ranges
         cropX = clamp(cropX, 0, Width - 1);
         cropY = clamp(cropY, 0, Height - 1);
+        dstWidth = min(dstWidth, Width - cropX);
+        dstHeight = min(dstHeight, Height - cropY);
 
         int Channels = srcStride / Width;
+        int LineSize = dstWidth * Channels;
+        if (dstStride < LineSize)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
 
         const unsigned char* src = Input + cropY * srcStride + cropX * Channels;
         unsigned char* dst = Output;
 
+        // With dstStride no larger than srcStride rows only move towards the start of the buffer, so Output may be Input
         for (int y = 0; y < dstHeight; y++) {
-            memcpy(dst, src, dstStride);
+            memmove(dst, src, LineSize);
             src += srcStride;
             dst += dstStride;
         }
@@ -2857,69 +2770,20 @@ extern "C" {
         maxWindowSize = clamp(maxWindowSize, 1, 127);
         Threshold = clamp(Threshold, 2, 255);
 
-        int windowSize, x, y, c;
-        unsigned char* window = (unsigned char*)malloc(maxWindowSize * maxWindowSize * sizeof(unsigned char));
-        if (window == NULL)
-            return OC_STATUS_ERR_OUTOFMEMORY;
-
         int Channels = Stride / Width;
+        if (Channels < 1 || Channels > 4)
+            return OC_STATUS_ERR_NOTSUPPORTED;
 
-        for (y = 0; y < Height; y++) {
-            for (x = 0; x < Width; x++) {
-                for (c = 0; c < Channels; c++) {
-                    windowSize = 3; // Start with a 3x3 window
-                    while (windowSize <= maxWindowSize) {
-                        int windowOffset = windowSize / 2;
-                        int windowIndex = 0;
-
-                        // Fill the window
-                        for (int wy = -windowOffset; wy <= windowOffset; wy++) {
-                            for (int wx = -windowOffset; wx <= windowOffset; wx++) {
-                                int sx = x + wx;
-                                int sy = y + wy;
-                                if (sx >= 0 && sx < Width && sy >= 0 && sy < Height) {
-                                    window[windowIndex++] = Input[(sy * Width + sx) * Channels + c];
-                                } else {
-                                    window[windowIndex++] = Input[(y * Width + x) * Channels + c];
-                                }
-                            }
-                        }
-
-                        unsigned char median = getMedian(window, windowSize * windowSize);
-                        unsigned char minValue = window[0];
-                        unsigned char maxValue = window[0];
-                        for (int i = 1; i < windowSize * windowSize; i++) {
-                            if (window[i] < minValue)
-                                minValue = window[i];
-                            if (window[i] > maxValue)
-                                maxValue = window[i];
-                        }
-
-                        unsigned char currentPixel = Input[(y * Width + x) * Channels + c];
-                        int difference = abs((int)currentPixel - (int)median);
-
-                        if (difference <= Threshold) {
-                            Output[(y * Width + x) * Channels + c] = currentPixel;
-                            break;
-                        } else if (median > minValue && median < maxValue) {
-                            Output[(y * Width + x) * Channels + c] = median;
-                            break;
-                        } else {
-                            windowSize += 2;
-                            if (windowSize > maxWindowSize) {
-                                Output[(y * Width + x) * Channels + c] = median;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-
-        free(window);
+        if (!adaptiveMedianFilter(Input, Output, Width, Height, Stride, maxWindowSize, Threshold))
+            return OC_STATUS_ERR_OUTOFMEMORY;
 
         return OC_STATUS_OK;
     }
 
+    size_t despeckleScratchSize(int Channels, int maxWindowSize) {
+        return adaptiveMedianScratchSize(Channels, clamp(maxWindowSize, 1, 127));
+    }
+
     OC_STATUS ocularDocumentDeskew(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
                                     bool* Skewed) {
 
@@ -2955,6 +2819,11 @@ extern "C" {
         return OC_STATUS_OK;
     }
 
+    size_t documentDeskewScratchSize(int Width, int Height) {
+        // The angle search with the settings above; the rotation takes nothing
+        return skewAngleScratchSize(Width, Height, 89, 1, 2);
+    }
+
     OC_STATUS ocularAutoLevel(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
                                 float fraction) {
 
@@ -3198,30 +3067,31 @@ extern "C" {
         return OC_STATUS_OK;
     }
 
-    OC_STATUS ocularAutoThreshold(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
-                                    OcAutoThresholdMethod method) {
-
-        if (Input == NULL || Output == NULL)
-            return OC_STATUS_ERR_NULLREFERENCE;
-        if (Width <= 0 || Height <= 0 || Stride <= 0)
-            return OC_STATUS_ERR_INVALIDPARAMETER;
-
-        int Channels = Stride / Width;
-        if (Channels != 1)
-            return OC_STATUS_ERR_NOTSUPPORTED;
-
+    // Histogram threshold of a 1 channel image picked by one of the automatic methods, <= 0 if the method found none
+    static int autoThresholdValue(const unsigned char* Input, int Width, int Height, int Stride, OcAutoThresholdMethod method) {
         int histogram[256] = { 0 };
         int* histogramSmooth[256] = { 0 }; // for future use
         int threshold = 0;
 
-        // get histogram
+        // get histogram; documents are long runs of one value, so four interleaved counts keep increments of the same bin
+        // from waiting on each other
+        int partial[4][256] = { { 0 } };
         for (int y = 0; y < Height; y++) {
-            unsigned char* pInput = Input + (y * Stride);
-            for (int x = 0; x < Width; x++) {
-                histogram[pInput[0]]++;
-                pInput++;
+            const unsigned char* pInput = Input + (y * Stride);
+            int x = 0;
+            for (; x + 4 <= Width; x += 4) {
+                partial[0][pInput[x]]++;
+                partial[1][pInput[x + 1]]++;
+                partial[2][pInput[x + 2]]++;
+                partial[3][pInput[x + 3]]++;
+            }
+            for (; x < Width; x++) {
+                partial[0][pInput[x]]++;
             }
         }
+        for (int i = 0; i < 256; i++) {
+            histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+        }
 
         switch (method) {
             case OC_AUTO_THRESHOLD_MEAN: threshold = GetMeanThreshold(histogram); break;
@@ -3239,7 +3109,40 @@ extern "C" {
             case OC_AUTO_THRESHOLD_YEN: threshold = GetYenThreshold(histogram); break;
             default: break;
         }
+        return threshold;
+    }
+
+    // The local method behind an adaptive OcAutoThresholdMethod and its default window radius and constant; false for the
+    // global methods
+    static bool localThresholdMethod(OcAutoThresholdMethod method, int Width, int Height, LocalThresholdMethod* Local, int* Radius,
+                                     float* K) {
+        switch (method) {
+            case OC_AUTO_THRESHOLD_NIBLACK: *Local = LOCAL_THRESHOLD_NIBLACK; *Radius = 15; *K = -0.2f; return true;
+            case OC_AUTO_THRESHOLD_SAUVOLA: *Local = LOCAL_THRESHOLD_SAUVOLA; *Radius = 15; *K = 0.34f; return true;
+            case OC_AUTO_THRESHOLD_BRADLEY: *Local = LOCAL_THRESHOLD_BRADLEY; *Radius = max(Width, Height) / 16; *K = 0.15f; return true;
+            default: return false;
+        }
+    }
+
+    OC_STATUS ocularAutoThreshold(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, 
+                                    OcAutoThresholdMethod method) {
+
+        if (Input == NULL || Output == NULL)
+            return OC_STATUS_ERR_NULLREFERENCE;
+        if (Width <= 0 || Height <= 0 || Stride <= 0)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
 
+        int Channels = Stride / Width;
+        if (Channels != 1)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+
+        LocalThresholdMethod local;
+        int radius;
+        float k;
+        if (localThresholdMethod(method, Width, Height, &local, &radius, &k))
+            return localThreshold(Input, Output, NULL, Width, Height, Stride, local, radius, k);
+
+        int threshold = autoThresholdValue(Input, Width, Height, Stride, method);
         if (threshold <= 0)
             return OC_STATUS_ERR_UNKNOWN; // selected method failed to calculate a threshold for whatever reason
 
@@ -3256,6 +3159,55 @@ extern "C" {
         return OC_STATUS_OK;
     }
 
+    OC_STATUS ocularAutoThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, OcAutoThresholdMethod method,
+                                        OcImage* Output) {
+
+        if (Input == NULL || Output == NULL)
+            return OC_STATUS_ERR_NULLREFERENCE;
+        if (Width <= 0 || Height <= 0 || Stride <= 0)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        if (Stride / Width != 1)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+
+        LocalThresholdMethod local;
+        int radius;
+        float k;
+        if (localThresholdMethod(method, Width, Height, &local, &radius, &k)) {
+            if (Output->Data == NULL)
+                return OC_STATUS_ERR_NULLREFERENCE;
+            if (Output->Depth != OC_DEPTH_1U)
+                return OC_STATUS_ERR_NOTSUPPORTED;
+            if (Output->Width != Width || Output->Height != Height)
+                return OC_STATUS_ERR_PARAMISMATCH;
+            return localThreshold(Input, NULL, Output, Width, Height, Stride, local, radius, k);
+        }
+
+        int threshold = autoThresholdValue(Input, Width, Height, Stride, method);
+        if (threshold <= 0)
+            return OC_STATUS_ERR_UNKNOWN;
+
+        return ocularThresholdToBits(Input, Width, Height, Stride, threshold, Output);
+    }
+
+    OC_STATUS ocularAdaptiveThreshold(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
+                                      OcAutoThresholdMethod method, int Radius, float K) {
+
+        if (Input == NULL || Output == NULL)
+            return OC_STATUS_ERR_NULLREFERENCE;
+        if (Width <= 0 || Height <= 0 || Stride <= 0 || Radius < 1)
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+        if (Stride / Width != 1)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+
+        LocalThresholdMethod local;
+        int radius;
+        float k;
+        if (!localThresholdMethod(method, Width, Height, &local, &radius, &k))
+            return OC_STATUS_ERR_NOTSUPPORTED;
+
+        return localThreshold(Input, Output, NULL, Width, Height, Stride, local, Radius, K);
+    }
+
     OC_STATUS ocularBacklightRepair(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride) {
 
         // Implementation of the paper "Adaptive and integrated neighborhood-dependent approach for nonlinear 
@@ -3276,12 +3228,21 @@ extern "C" {
         const float MinCDF = 0.1f;
         const float Inv255 = 1.0f / 255.0f;
 
-        int* Histogram = (int*)calloc(256, sizeof(int));
-        unsigned char* Table = (unsigned char*)malloc(256 * 256 * sizeof(unsigned char));
-        unsigned char* BlurS = (unsigned char*)malloc(Width * Height * sizeof(unsigned char)); //     Blur of each scale
-        unsigned char* BlurM = (unsigned char*)malloc(Width * Height * sizeof(unsigned char)); //     Blur of each scale
-        unsigned char* BlurL = (unsigned char*)malloc(Width * Height * sizeof(unsigned char)); //     Blur of each scale
-        unsigned char* Luminance = (unsigned char*)malloc(Width * Height * sizeof(unsigned char));
+        int* Histogram = (int*)ScratchAlloc(256 * sizeof(int), true);
+        unsigned char* Table = (unsigned char*)ScratchAlloc(256 * 256 * sizeof(unsigned char), false);
+        unsigned char* BlurS = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false); //     Blur of each scale
+        unsigned char* BlurM = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false); //     Blur of each scale
+        unsigned char* BlurL = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false); //     Blur of each scale
+        unsigned char* Luminance = (unsigned char*)ScratchAlloc(Width * Height * sizeof(unsigned char), false);
+        if (!Histogram || !Table || !BlurS || !BlurM || !BlurL || !Luminance) {
+            ScratchFree(Histogram);
+            ScratchFree(Table);
+            ScratchFree(BlurS);
+            ScratchFree(BlurM);
+            ScratchFree(BlurL);
+            ScratchFree(Luminance);
+            return OC_STATUS_ERR_OUTOFMEMORY;
+        }
 
         float Z = 0, P = 0;
         ocularGrayscaleFilter(Input, Luminance, Width, Height, Stride); // get the brightness component
@@ -3351,16 +3312,22 @@ extern "C" {
                 }
             }
         }
-        free(Histogram);
-        free(Table);
-        free(BlurS);
-        free(BlurM);
-        free(BlurL);
-        free(Luminance);
+        ScratchFree(Histogram);
+        ScratchFree(Table);
+        ScratchFree(BlurS);
+        ScratchFree(BlurM);
+        ScratchFree(BlurL);
+        ScratchFree(Luminance);
 
         return OC_STATUS_OK;
     }
 
+    size_t backlightRepairScratchSize(int Width, int Height) {
+        size_t plane = ScratchBlockSize((size_t)Width * Height);
+        // The blurs run one after another while every buffer is held
+        return ScratchBlockSize(256 * sizeof(int)) + ScratchBlockSize(256 * 256) + 4 * plane + gaussianBlurScratchSize(Width, Height, 1);
+    }
+
     OC_STATUS ocularLayerBlend(unsigned char* baseInput, int bWidth, int bHeight, int bStride, unsigned char* mixInput, 
                                int mWidth, int mHeight, int mStride, OcBlendMode blendMode, int alpha) {
 
@@ -3369,29 +3336,17 @@ extern "C" {
         if (bWidth <= 0 || bHeight <= 0 || mWidth <= 0 || mHeight <= 0 || bStride <= 0 || mStride <= 0)
             return OC_STATUS_ERR_INVALIDPARAMETER;
 
+        int Channels = bStride / bWidth;
+        if (Channels != 3 && Channels != 4)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+        if (mStride / mWidth != Channels)
+            return OC_STATUS_ERR_PARAMISMATCH;
+
         // Ensure filter specific parameters are within valid ranges
         alpha = clamp(alpha, 0, 100);
 
-        for (int y = 0; y < bHeight; y++) {
-            unsigned char* pBaseInput = baseInput + (y * bStride);
-            unsigned char* pMixInput = mixInput + (y * bStride);
-            for (int x = 0; x < bWidth; x++) {
-                int baseR = pBaseInput[0];
-                int baseG = pBaseInput[1];
-                int baseB = pBaseInput[2];
-                int mixR = pMixInput[0];
-                int mixG = pMixInput[1];
-                int mixB = pMixInput[2];
-                int resR = 0;
-                int resG = 0;
-                int resB = 0;
-                layerBlend(baseR, baseG, baseB, mixR, mixG, mixB, &resR, &resG, &resB, blendMode, alpha);
-                pBaseInput[0] = resR;
-                pBaseInput[1] = resG;
-                pBaseInput[2] = resB;
-                pBaseInput += 3;
-            }
-        }
+        // A smaller mix image covers the top left corner of the base
+        layerBlendImage(baseInput, bStride, mixInput, mStride, min(bWidth, mWidth), min(bHeight, mHeight), Channels, blendMode, alpha);
 
         return OC_STATUS_OK;
     }
@@ -3560,6 +3515,13 @@ extern "C" {
         return OC_STATUS_OK;
     }
 
+    size_t retinexScratchSize(int Width, int Height, int Channels) {
+        size_t channelSize = (size_t)Width * Height;
+        // The float image, one channel in and out, and the two line buffers of gausssmooth()
+        return ScratchBlockSize(channelSize * Channels * sizeof(float)) + 2 * ScratchBlockSize(channelSize * sizeof(float)) +
+               2 * ScratchBlockSize((max(Width, Height) + 3) * sizeof(float));
+    }
+
     OC_STATUS ocularMultiscaleRetinex(unsigned char* input, unsigned char* output, int width, int height, int channels, 
                                  OcRetinexMode mode, int scale, float numScales, float dynamic) {
 
@@ -3602,23 +3564,23 @@ extern "C" {
 
         // Allocate all the memory needed for algorithm
         size = width * height * channels;
-        dst = (float*)malloc(size * sizeof(float));
+        dst = (float*)ScratchAlloc(size * sizeof(float), false);
         if (dst == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
         memset(dst, 0, size * sizeof(float));
 
         channelsize = (width * height);
-        in = (float*)malloc(channelsize * sizeof(float));
+        in = (float*)ScratchAlloc(channelsize * sizeof(float), false);
         if (in == NULL) {
-            free(dst);
+            ScratchFree(dst);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
-        out = (float*)malloc(channelsize * sizeof(float));
+        out = (float*)ScratchAlloc(channelsize * sizeof(float), false);
         if (out == NULL) {
-            free(in);
-            free(dst);
+            ScratchFree(in);
+            ScratchFree(dst);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
@@ -3676,8 +3638,8 @@ extern "C" {
                 }
             }
         }
-        free(in);
-        free(out);
+        ScratchFree(in);
+        ScratchFree(out);
 
         /*
         Final calculation with original value and cumulated filter values.
@@ -3729,13 +3691,13 @@ extern "C" {
             }
         }
 
-        free(dst);
+        ScratchFree(dst);
 
         return OC_STATUS_OK;
     }
 
     OC_STATUS ocularDarkChannelPriorHazeRemoval(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int radius,
-                                                int guideRadius, float maxAtm, float omega, float epsilon, float t0) {
+                                                int guideRadius, float maxAtm, float omega, float epsilon, float t0, int subsample) {
         // Parameter validation
         if (!Input || !Output)
             return OC_STATUS_ERR_NULLREFERENCE;
@@ -3753,20 +3715,21 @@ extern "C" {
         omega = fmaxf(0.1f, fminf(1.0f, omega));
         epsilon = fmaxf(0.0001f, fminf(1.0f, epsilon));
         t0 = fmaxf(0.01f, fminf(1.0f, t0));
+        subsample = clamp(subsample, 1, guideRadius);
 
         int size = Width * Height;
 
         // Allocate working buffers
-        float* darkChannel = (float*)malloc(size * sizeof(float));
-        float* transmission = (float*)malloc(size * sizeof(float));
-        float* refinedTransmission = (float*)malloc(size * sizeof(float));
-        float* guideImage = (float*)malloc(size * sizeof(float));
+        float* darkChannel = (float*)ScratchAlloc(size * sizeof(float), false);
+        float* transmission = (float*)ScratchAlloc(size * sizeof(float), false);
+        float* refinedTransmission = (float*)ScratchAlloc(size * sizeof(float), false);
+        float* guideImage = (float*)ScratchAlloc(size * sizeof(float), false);
 
         if (!darkChannel || !transmission || !refinedTransmission || !guideImage) {
-            free(darkChannel);
-            free(transmission);
-            free(refinedTransmission);
-            free(guideImage);
+            ScratchFree(darkChannel);
+            ScratchFree(transmission);
+            ScratchFree(refinedTransmission);
+            ScratchFree(guideImage);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
 
@@ -3792,20 +3755,27 @@ extern "C" {
         }
 
         // Step 5: Refine transmission map using guided filter
-        guidedFilterFast(transmission, guideImage, refinedTransmission, Width, Height, guideRadius, epsilon);
+        guidedFilterFast(transmission, guideImage, refinedTransmission, Width, Height, guideRadius, epsilon, subsample);
 
         // Step 6: Recover scene radiance
         recoverScene(Input, Output, Width, Height, Stride, refinedTransmission, atmLight, t0);
 
         // Cleanup
-        free(darkChannel);
-        free(transmission);
-        free(refinedTransmission);
-        free(guideImage);
+        ScratchFree(darkChannel);
+        ScratchFree(transmission);
+        ScratchFree(refinedTransmission);
+        ScratchFree(guideImage);
 
         return OC_STATUS_OK;
     }
 
+    size_t darkChannelPriorScratchSize(int Width, int Height, int Radius) {
+        size_t plane = ScratchBlockSize((size_t)Width * Height * sizeof(float));
+        // Subsampling the guided filter by 2 can take more than none on tiny images; larger factors take less
+        size_t guided = max(guidedFilterFastScratchSize(Width, Height, 1), guidedFilterFastScratchSize(Width, Height, 2));
+        return 4 * plane + max(darkChannelScratchSize(Width, Height, Radius), guided);
+    }
+
     OC_STATUS ocularHoughLineDetection(unsigned char* Input, int* LineNumber, struct LineParameter* DetectedLine, 
                                        int Height, int Width, int threshold) {
 
@@ -3814,7 +3784,7 @@ extern "C" {
         }
 
         // Ensure filter specific parameters are within valid ranges
-        threshold = max(threshold, 1); // max number of lines to return
+        threshold = max(threshold, 1); // votes a line must exceed
 
         float diagonalLength = sqrt((float)(Height * Height + Width * Width));
         float minAngle = 0;
@@ -3827,22 +3797,17 @@ extern "C" {
         int numAnglesCoarse = (int)(maxAngle / angleIntervalCoarse) + 1;
         int numDistancesCoarse = (int)diagonalLength / distanceIntervalCoarse + 1;
 
-        // build and initialize the vote tables for coarse angle and distance
-        unsigned int** voteTableCoarse = (unsigned int**)malloc(numAnglesCoarse * sizeof(unsigned int*));
+        // build and initialize the vote table for coarse angle and distance
+        unsigned int* voteTableCoarse = (unsigned int*)ScratchAlloc((size_t)numAnglesCoarse * numDistancesCoarse * sizeof(unsigned int), true);
         if (voteTableCoarse == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        for (int i = 0; i < numAnglesCoarse; i++) {
-            voteTableCoarse[i] = (unsigned int*)malloc(numDistancesCoarse * sizeof(unsigned int));
-        }
-        for (int i = 0; i < numAnglesCoarse; i++) {
-            for (int j = 0; j < numDistancesCoarse; j++) {
-                voteTableCoarse[i][j] = 0;
-            }
-        }
 
-        houghTransformLine(Input, minAngle, angleIntervalCoarse, numAnglesCoarse, 0, distanceIntervalCoarse, numDistancesCoarse,
-                           voteTableCoarse, Height, Width);
+        if (!houghTransformLine(Input, minAngle, angleIntervalCoarse, numAnglesCoarse, 0, distanceIntervalCoarse, numDistancesCoarse,
+                                voteTableCoarse, Width, Height)) {
+            ScratchFree(voteTableCoarse);
+            return OC_STATUS_ERR_OUTOFMEMORY;
+        }
 
         int maxVote = 110;
         int m = 0;
@@ -3850,51 +3815,61 @@ extern "C" {
 
         while (maxVote > threshold) {
             FindMaxVote(voteTableCoarse, numAnglesCoarse, numDistancesCoarse, &m, &n);
-            maxVote = voteTableCoarse[m][n];
+            maxVote = voteTableCoarse[m * numDistancesCoarse + n];
+            if (maxVote <= threshold) {
+                break;
+            }
             float angleWithMaxVoteCoarse = minAngle + m * angleIntervalCoarse;
             float distanceWithMaxVoteCoarse = n * distanceIntervalCoarse;
             (*LineNumber)++;
             DetectedLine[(*LineNumber) - 1].angle = angleWithMaxVoteCoarse;
             DetectedLine[(*LineNumber) - 1].distance = distanceWithMaxVoteCoarse;
 
+            // suppress the peak and its neighbors
+            voteTableCoarse[m * numDistancesCoarse + n] = 0;
             if (n > 0) {
-                voteTableCoarse[m][n - 1] = 0;
+                voteTableCoarse[m * numDistancesCoarse + n - 1] = 0;
                 if (m > 0) {
-                    voteTableCoarse[m - 1][n - 1] = 0;
+                    voteTableCoarse[(m - 1) * numDistancesCoarse + n - 1] = 0;
                 }
                 if (m < numAnglesCoarse - 1) {
-                    voteTableCoarse[n + 1][n - 1] = 0;
+                    voteTableCoarse[(m + 1) * numDistancesCoarse + n - 1] = 0;
                 }
             }
 
             if (n < numDistancesCoarse - 1) {
-                voteTableCoarse[m][n + 1] = 0;
+                voteTableCoarse[m * numDistancesCoarse + n + 1] = 0;
                 if (m > 0) {
-                    voteTableCoarse[m - 1][n + 1] = 0;
+                    voteTableCoarse[(m - 1) * numDistancesCoarse + n + 1] = 0;
                 }
                 if (m < numAnglesCoarse - 1) {
-                    voteTableCoarse[m + 1][n + 1] = 0;
+                    voteTableCoarse[(m + 1) * numDistancesCoarse + n + 1] = 0;
                 }
             }
 
             if (m > 0) {
-                voteTableCoarse[m - 1][n] = 0;
+                voteTableCoarse[(m - 1) * numDistancesCoarse + n] = 0;
             }
 
             if (m < numAnglesCoarse - 1) {
-                voteTableCoarse[m + 1][n] = 0;
+                voteTableCoarse[(m + 1) * numDistancesCoarse + n] = 0;
             }
         }
 
-        for (int i = 0; i < numAnglesCoarse; i++) {
-            free(voteTableCoarse[i]);
-        }
-
-        free(voteTableCoarse);
+        ScratchFree(voteTableCoarse);
 
         return OC_STATUS_OK;
     }
 
+    size_t houghLineScratchSize(int Width, int Height) {
+        float diagonalLength = sqrt((float)(Height * Height + Width * Width));
+        int numAngles = (int)(90 / 2.0f) + 1;
+        int numDistances = (int)diagonalLength / 2.0f + 1;
+        // The vote table, and the coordinates of the edge points, at most every pixel
+        return ScratchBlockSize((size_t)numAngles * numDistances * sizeof(unsigned int)) +
+               2 * ScratchBlockSize((size_t)Width * Height * sizeof(int));
+    }
+
     OC_STATUS ocularDrawLine(unsigned char* canvas, int width, int height, int stride, int x1, int y1, int x2, int y2, 
                              unsigned char R, unsigned char G, unsigned char B) {
 
@@ -4114,15 +4089,271 @@ extern "C" {
         return has_image_size;
     }
 
-    OC_STATUS ocularConvolution2DFilter(unsigned char* input, unsigned char* output, int width, int height, int channels, float* kernel,
-                                        unsigned char filterW, unsigned char cfactor, unsigned char bias) {
+    typedef struct {
+        const unsigned char* Padded; // color channels with a FilterW / 2 pixel edge margin on every side
+        int PadWidth;
+        int PadHeight;
+        const unsigned char* Input;
+        unsigned char* Output;
+        int Width;
+        int Height;
+        int Stride;
+        int Channels;
+        int Colors;
+        OcEdgeMode edgeMode;
+        int FilterW;
+        const float* Kernel; // FilterW x FilterW, pre-multiplied by the factor
+        const float* RowKernel;
+        const float* ColumnKernel;
+        float* Temp;    // separable path: PadHeight rows of Width * Colors horizontally filtered values
+        float* Scratch; // separable path: one Width * Colors accumulator row per thread
+        int bias;
+    } ConvolutionParams;
+
+    static void convolutionPadRows(void* Context, int Begin, int End, int Thread) {
+        const ConvolutionParams* p = (const ConvolutionParams*)Context;
+        (void)Thread;
+        const int halfW = p->FilterW / 2;
+        for (int Y = Begin; Y < End; Y++) {
+            unsigned char* padRow = (unsigned char*)p->Padded + (size_t)Y * p->PadWidth * p->Colors;
+            int sy = GetEdgeCoordinate(Y - halfW, p->Height, p->edgeMode);
+            if (sy < 0) {
+                memset(padRow, 0, (size_t)p->PadWidth * p->Colors);
+                continue;
+            }
+            const unsigned char* inRow = p->Input + (size_t)sy * p->Stride;
+            for (int X = 0; X < p->PadWidth; X++) {
+                int sx = GetEdgeCoordinate(X - halfW, p->Width, p->edgeMode);
+                for (int c = 0; c < p->Colors; c++) {
+                    padRow[X * p->Colors + c] = (sx < 0) ? 0 : inRow[sx * p->Channels + c];
+                }
+            }
+        }
+    }
+
+    // Writes one color value of an output pixel from its kernel sum, copying alpha through after the last color
+    static inline void convolutionStore(const ConvolutionParams* p, int X, int Y, int c, float sum) {
+        size_t pos = (size_t)Y * p->Stride + X * p->Channels;
+        p->Output[pos + c] = ClampToByte((int)(sum / 256) + p->bias);
+        if (p->Channels == 4 && c == 2) {
+            p->Output[pos + 3] = p->Input[pos + 3]; // Preserve alpha
+        }
+    }
+
+    static void convolutionDirectRows(void* Context, int Begin, int End, int Thread) {
+        const ConvolutionParams* p = (const ConvolutionParams*)Context;
+        (void)Thread;
+        const int padStride = p->PadWidth * p->Colors;
+        for (int Y = Begin; Y < End; Y++) {
+            for (int X = 0; X < p->Width; X++) {
+                float sum[3] = { 0, 0, 0 };
+                for (int ky = 0; ky < p->FilterW; ky++) {
+                    const unsigned char* pixel = p->Padded + (size_t)(Y + ky) * padStride + X * p->Colors;
+                    const float* k = p->Kernel + ky * p->FilterW;
+                    for (int kx = 0; kx < p->FilterW; kx++, pixel += p->Colors) {
+                        for (int c = 0; c < p->Colors; c++) {
+                            sum[c] += pixel[c] * k[kx];
+                        }
+                    }
+                }
+                for (int c = 0; c < p->Colors; c++) {
+                    convolutionStore(p, X, Y, c, sum[c]);
+                }
+            }
+        }
+    }
+
+    static void convolutionHorizontalRows(void* Context, int Begin, int End, int Thread) {
+        const ConvolutionParams* p = (const ConvolutionParams*)Context;
+        (void)Thread;
+        const int rowSize = p->Width * p->Colors;
+        for (int Y = Begin; Y < End; Y++) {
+            const unsigned char* padRow = p->Padded + (size_t)Y * p->PadWidth * p->Colors;
+            float* tempRow = p->Temp + (size_t)Y * rowSize;
+            for (int i = 0; i < rowSize; i++) {
+                tempRow[i] = 0;
+            }
+            for (int kx = 0; kx < p->FilterW; kx++) {
+                const unsigned char* src = padRow + kx * p->Colors;
+                const float k = p->RowKernel[kx];
+                for (int i = 0; i < rowSize; i++) {
+                    tempRow[i] += src[i] * k;
+                }
+            }
+        }
+    }
+
+    static void convolutionVerticalRows(void* Context, int Begin, int End, int Thread) {
+        const ConvolutionParams* p = (const ConvolutionParams*)Context;
+        const int rowSize = p->Width * p->Colors;
+        float* sum = p->Scratch + (size_t)Thread * rowSize;
+        for (int Y = Begin; Y < End; Y++) {
+            for (int i = 0; i < rowSize; i++) {
+                sum[i] = 0;
+            }
+            for (int ky = 0; ky < p->FilterW; ky++) {
+                const float* src = p->Temp + (size_t)(Y + ky) * rowSize;
+                const float k = p->ColumnKernel[ky];
+                for (int i = 0; i < rowSize; i++) {
+                    sum[i] += src[i] * k;
+                }
+            }
+            for (int X = 0; X < p->Width; X++) {
+                for (int c = 0; c < p->Colors; c++) {
+                    convolutionStore(p, X, Y, c, sum[X * p->Colors + c]);
+                }
+            }
+        }
+    }
 
-        if (input == NULL || output == NULL || kernel == NULL) {
+    static long long gcdLL(long long a, long long b) {
+        while (b != 0) {
+            long long t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    // Factors a rank one kernel into Column[ky] * Row[kx]. Integral kernels are split into integer vectors, so that both
+    // passes sum exactly the same integers as the direct path; other kernels are factored within a small tolerance.
+    static bool convolutionFactorKernel(const float* Kernel, int FilterW, bool Integral, float* Row, float* Column) {
+        int pivot = 0;
+        for (int i = 1; i < FilterW * FilterW; i++) {
+            if (fabsf(Kernel[i]) > fabsf(Kernel[pivot]))
+                pivot = i;
+        }
+        if (Kernel[pivot] == 0)
+            return false;
+        const int pivotRow = pivot / FilterW;
+        const int pivotColumn = pivot % FilterW;
+        const float* row = Kernel + pivotRow * FilterW;
+
+        if (Integral) {
+            long long divisor = 0;
+            for (int kx = 0; kx < FilterW; kx++) {
+                divisor = gcdLL(divisor, llabs((long long)row[kx]));
+            }
+            for (int kx = 0; kx < FilterW; kx++) {
+                Row[kx] = (float)((long long)row[kx] / divisor);
+            }
+            const long long pivotValue = (long long)Row[pivotColumn];
+            for (int ky = 0; ky < FilterW; ky++) {
+                long long value = (long long)Kernel[ky * FilterW + pivotColumn];
+                if (value % pivotValue != 0)
+                    return false;
+                Column[ky] = (float)(value / pivotValue);
+            }
+            for (int ky = 0; ky < FilterW; ky++) {
+                for (int kx = 0; kx < FilterW; kx++) {
+                    if ((long long)Kernel[ky * FilterW + kx] != (long long)Column[ky] * (long long)Row[kx])
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        const float tolerance = fabsf(Kernel[pivot]) * 1e-5f;
+        for (int kx = 0; kx < FilterW; kx++) {
+            Row[kx] = row[kx] / Kernel[pivot];
+        }
+        for (int ky = 0; ky < FilterW; ky++) {
+            Column[ky] = Kernel[ky * FilterW + pivotColumn];
+        }
+        for (int ky = 0; ky < FilterW; ky++) {
+            for (int kx = 0; kx < FilterW; kx++) {
+                if (fabsf(Kernel[ky * FilterW + kx] - Column[ky] * Row[kx]) > tolerance)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Convolves each color plane through the FFT engine. The padded plane is zero extended to sizes the plans handle well,
+    // large enough that the circular convolution never wraps into the pixels that are kept.
+    static OC_STATUS convolutionFFT(const ConvolutionParams* p, bool Integral) {
+        const int fftWidth = ocularFFTGoodSize(p->PadWidth);
+        const int fftHeight = ocularFFTGoodSize(p->PadHeight);
+        const size_t planeSize = (size_t)fftWidth * fftHeight;
+        const size_t specSize = (size_t)(fftWidth / 2 + 1) * fftHeight;
+
+        float* plane = (float*)ScratchAlloc(planeSize * sizeof(float), false);
+        OcComplex* kernelSpectrum = (OcComplex*)ScratchAlloc(specSize * sizeof(OcComplex), false);
+        if (plane == NULL || kernelSpectrum == NULL) {
+            ScratchFree(plane);
+            ScratchFree(kernelSpectrum);
+            return OC_STATUS_ERR_OUTOFMEMORY;
+        }
+
+        // The kernel is mirrored around the origin so the convolution at (X, Y) sums the window whose top left is (X, Y)
+        memset(plane, 0, planeSize * sizeof(float));
+        for (int ky = 0; ky < p->FilterW; ky++) {
+            for (int kx = 0; kx < p->FilterW; kx++) {
+                plane[(size_t)((fftHeight - ky) % fftHeight) * fftWidth + (fftWidth - kx) % fftWidth] = p->Kernel[ky * p->FilterW + kx];
+            }
+        }
+        OC_STATUS status = ocularFFTReal2D(plane, kernelSpectrum, fftWidth, fftHeight);
+
+        for (int c = 0; c < p->Colors && status == OC_STATUS_OK; c++) {
+            memset(plane, 0, planeSize * sizeof(float));
+            for (int Y = 0; Y < p->PadHeight; Y++) {
+                const unsigned char* padRow = p->Padded + (size_t)Y * p->PadWidth * p->Colors + c;
+                float* planeRow = plane + (size_t)Y * fftWidth;
+                for (int X = 0; X < p->PadWidth; X++) {
+                    planeRow[X] = padRow[X * p->Colors];
+                }
+            }
+            status = ocularFFTFilterReal2D(plane, fftWidth, fftHeight, kernelSpectrum);
+            if (status != OC_STATUS_OK)
+                break;
+            for (int Y = 0; Y < p->Height; Y++) {
+                const float* planeRow = plane + (size_t)Y * fftWidth;
+                for (int X = 0; X < p->Width; X++) {
+                    // Integral kernels have integral sums, so rounding removes most of the transform noise. It is not exact:
+                    // the error grows with the kernel size and magnitude and can still leave a level off.
+                    convolutionStore(p, X, Y, c, Integral ? rintf(planeRow[X]) : planeRow[X]);
+                }
+            }
+        }
+
+        ScratchFree(plane);
+        ScratchFree(kernelSpectrum);
+        return status;
+    }
+
+    size_t convolution2DScratchSize(int Width, int Height, int Channels, int FilterW) {
+        const int colors = (Channels == 4) ? 3 : Channels;
+        const int halfW = FilterW / 2;
+        const size_t padWidth = Width + 2 * halfW;
+        const size_t padHeight = Height + 2 * halfW;
+        size_t size = ScratchBlockSize((FilterW * FilterW + 2 * FilterW) * sizeof(float)) + ScratchBlockSize(padWidth * padHeight * colors);
+
+        // The larger of the paths the kernel may take
+        size_t rowSize = (size_t)Width * colors;
+        size_t path = ScratchBlockSize(rowSize * padHeight * sizeof(float)) + ScratchBlockSize(rowSize * ocularGetThreadCount() * sizeof(float));
+        if (FilterW > 15) {
+            int fftWidth = ocularFFTGoodSize((int)padWidth);
+            int fftHeight = ocularFFTGoodSize((int)padHeight);
+            size_t fft = ScratchBlockSize((size_t)fftWidth * fftHeight * sizeof(float)) +
+                         ScratchBlockSize((size_t)(fftWidth / 2 + 1) * fftHeight * sizeof(OcComplex)) +
+                         max(fftReal2DScratchSize(fftWidth, fftHeight), fftFilterReal2DScratchSize(fftWidth, fftHeight));
+            path = max(path, fft);
+        }
+        return size + path;
+    }
+
+    OC_STATUS ocularConvolution2DFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Channels,
+                                        float* kernel, unsigned char filterW, unsigned char cfactor, unsigned char bias, OcEdgeMode edgeMode) {
+
+        if (Input == NULL || Output == NULL || kernel == NULL) {
             return OC_STATUS_ERR_NULLREFERENCE;
         }
-        if (width <= 0 || height <= 0) {
+        if (Width <= 0 || Height <= 0 || Stride < Width * Channels) {
             return OC_STATUS_ERR_INVALIDPARAMETER;
         }
+        if (Channels != 1 && Channels != 3 && Channels != 4) {
+            return OC_STATUS_ERR_NOTSUPPORTED;
+        }
 
         // Ensure kernel size is odd
         if (filterW % 2 == 0) {
@@ -4136,120 +4367,75 @@ extern "C" {
 
         const int factor = 256 / cfactor;
         const int halfW = (filterW - 1) / 2;
-        const int CHUNK_SIZE = 32; // Process image in chunks for better cache utilization
+        const int kernelSize = filterW * filterW;
 
-        // Pre-calculate kernel lookup table
-        float* kernelLUT = (float*)malloc(filterW * filterW * sizeof(float));
+        // Pre-calculate kernel lookup table, followed by room for the separable row and column vectors
+        float* kernelLUT = (float*)ScratchAlloc((kernelSize + 2 * filterW) * sizeof(float), false);
         if (!kernelLUT)
             return OC_STATUS_ERR_OUTOFMEMORY;
 
-        // Flatten and pre-multiply kernel values
-        for (int i = 0; i < filterW * filterW; i++) {
+        // Flatten and pre-multiply kernel values. Sums of integral values stay exact in float while they remain below 2^24.
+        bool integral = true;
+        float magnitude = 0;
+        for (int i = 0; i < kernelSize; i++) {
             kernelLUT[i] = kernel[i] * factor;
+            integral = integral && kernelLUT[i] == floorf(kernelLUT[i]);
+            magnitude += fabsf(kernelLUT[i]);
+        }
+        integral = integral && magnitude * 255 < 16777216.0f;
+
+        ConvolutionParams params = { 0 };
+        params.PadWidth = Width + 2 * halfW;
+        params.PadHeight = Height + 2 * halfW;
+        params.Input = Input;
+        params.Output = Output;
+        params.Width = Width;
+        params.Height = Height;
+        params.Stride = Stride;
+        params.Channels = Channels;
+        params.Colors = (Channels == 4) ? 3 : Channels;
+        params.edgeMode = edgeMode;
+        params.FilterW = filterW;
+        params.Kernel = kernelLUT;
+        params.RowKernel = kernelLUT + kernelSize;
+        params.ColumnKernel = kernelLUT + kernelSize + filterW;
+        params.bias = bias;
+
+        // Borders are resolved once into a padded copy, which also lets the filter run in place
+        unsigned char* padded = (unsigned char*)ScratchAlloc((size_t)params.PadWidth * params.PadHeight * params.Colors, false);
+        if (padded == NULL) {
+            ScratchFree(kernelLUT);
+            return OC_STATUS_ERR_OUTOFMEMORY;
         }
-
-        if (channels == 3 || channels == 4) {
-            // Process image in chunks
-            for (int blockY = 0; blockY < height; blockY += CHUNK_SIZE) {
-                for (int blockX = 0; blockX < width; blockX += CHUNK_SIZE) {
-                    int endY = min(blockY + CHUNK_SIZE, height);
-                    int endX = min(blockX + CHUNK_SIZE, width);
-
-                    for (int y = blockY; y < endY; y++) {
-                        unsigned char* outRow = output + (y * width + blockX) * channels;
-
-                        for (int x = blockX; x < endX; x++) {
-                            float sumR = 0, sumG = 0, sumB = 0;
-
-                            // Unroll the kernel loops for common 3x3 case
-                            if (filterW == 3) {
-                                for (int ky = -1; ky <= 1; ky++) {
-                                    int sy = (y + ky + height) % height;
-                                    const unsigned char* inRow = input + (sy * width) * channels;
-
-                                    for (int kx = -1; kx <= 1; kx++) {
-                                        int sx = (x + kx + width) % width;
-                                        const unsigned char* pixel = inRow + sx * channels;
-                                        float k = kernelLUT[(ky + 1) * 3 + (kx + 1)];
-
-                                        sumR += pixel[0] * k;
-                                        sumG += pixel[1] * k;
-                                        sumB += pixel[2] * k;
-                                    }
-                                }
-                            } else {
-                                // other kernel sizes
-                                for (int ky = -halfW; ky <= halfW; ky++) {
-                                    int sy = (y + ky + height) % height;
-                                    const unsigned char* inRow = input + (sy * width) * channels;
-
-                                    for (int kx = -halfW; kx <= halfW; kx++) {
-                                        int sx = (x + kx + width) % width;
-                                        const unsigned char* pixel = inRow + sx * channels;
-                                        float k = kernelLUT[(ky + halfW) * filterW + (kx + halfW)];
-
-                                        sumR += pixel[0] * k;
-                                        sumG += pixel[1] * k;
-                                        sumB += pixel[2] * k;
-                                    }
-                                }
-                            }
-
-                            // Write results with bias
-                            outRow[0] = ClampToByte((int)(sumR / 256) + bias);
-                            outRow[1] = ClampToByte((int)(sumG / 256) + bias);
-                            outRow[2] = ClampToByte((int)(sumB / 256) + bias);
-                            if (channels == 4) {
-                                outRow[3] = input[(y * width + x) * channels + 3]; // Preserve alpha
-                            }
-                            outRow += channels;
-                        }
-                    }
-                }
-            }
-        } else if (channels == 1) {
-            for (int blockY = 0; blockY < height; blockY += CHUNK_SIZE) {
-                for (int blockX = 0; blockX < width; blockX += CHUNK_SIZE) {
-                    int endY = min(blockY + CHUNK_SIZE, height);
-                    int endX = min(blockX + CHUNK_SIZE, width);
-
-                    for (int y = blockY; y < endY; y++) {
-                        unsigned char* outRow = output + y * width + blockX;
-
-                        for (int x = blockX; x < endX; x++) {
-                            float sum = 0;
-
-                            if (filterW == 3) {
-                                for (int ky = -1; ky <= 1; ky++) {
-                                    int sy = (y + ky + height) % height;
-                                    const unsigned char* inRow = input + sy * width;
-
-                                    for (int kx = -1; kx <= 1; kx++) {
-                                        int sx = (x + kx + width) % width;
-                                        sum += inRow[sx] * kernelLUT[(ky + 1) * 3 + (kx + 1)];
-                                    }
-                                }
-                            } else {
-                                for (int ky = -halfW; ky <= halfW; ky++) {
-                                    int sy = (y + ky + height) % height;
-                                    const unsigned char* inRow = input + sy * width;
-
-                                    for (int kx = -halfW; kx <= halfW; kx++) {
-                                        int sx = (x + kx + width) % width;
-                                        sum += inRow[sx] * kernelLUT[(ky + halfW) * filterW + (kx + halfW)];
-                                    }
-                                }
-                            }
-
-                            *outRow++ = ClampToByte((int)(sum / 256) + bias);
-                        }
-                    }
-                }
+        params.Padded = padded;
+        ocularParallelFor(params.PadHeight, 16, convolutionPadRows, &params);
+
+        OC_STATUS status = OC_STATUS_OK;
+        bool separable = filterW > 3 &&
+                         convolutionFactorKernel(kernelLUT, filterW, integral, (float*)params.RowKernel, (float*)params.ColumnKernel);
+        if (separable) {
+            // Two 1D passes of filterW taps each instead of filterW * filterW
+            const size_t rowSize = (size_t)Width * params.Colors;
+            params.Temp = (float*)ScratchAlloc(rowSize * params.PadHeight * sizeof(float), false);
+            params.Scratch = (float*)ScratchAlloc(rowSize * ocularGetThreadCount() * sizeof(float), false);
+            if (params.Temp != NULL && params.Scratch != NULL) {
+                ocularParallelFor(params.PadHeight, 8, convolutionHorizontalRows, &params);
+                ocularParallelFor(Height, 8, convolutionVerticalRows, &params);
+            } else {
+                status = OC_STATUS_ERR_OUTOFMEMORY;
             }
+            ScratchFree(params.Temp);
+            ScratchFree(params.Scratch);
+        } else if (filterW > 15) {
+            // Large kernels cost less through the frequency domain
+            status = convolutionFFT(&params, integral);
+        } else {
+            ocularParallelFor(Height, 4, convolutionDirectRows, &params);
         }
 
-        free(kernelLUT);
-        return OC_STATUS_OK;
+        ScratchFree(padded);
+        ScratchFree(kernelLUT);
+        return status;
     }
 
     OC_STATUS ocularPalettetizeFromFile(unsigned char* input, unsigned char* output, int width, int height, int channels,
@@ -4338,14 +4524,14 @@ extern "C" {
         Levels = clamp(Levels, 2, 255);
         
         // Allocate memory for centroids and pixel assignments
-        float* centroids = (float*)malloc(Levels * sizeof(float));
-        int* assignments = (int*)malloc(Width * Height * Channels * sizeof(int));
-        int* centroidCounts = (int*)malloc(Levels * sizeof(int));
+        float* centroids = (float*)ScratchAlloc(Levels * sizeof(float), false);
+        int* assignments = (int*)ScratchAlloc(Width * Height * Channels * sizeof(int), false);
+        int* centroidCounts = (int*)ScratchAlloc(Levels * sizeof(int), false);
         
         if (!centroids || !assignments || !centroidCounts) {
-            free(centroids);
-            free(assignments);
-            free(centroidCounts);
+            ScratchFree(centroids);
+            ScratchFree(assignments);
+            ScratchFree(centroidCounts);
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
         
@@ -4358,7 +4544,7 @@ extern "C" {
         const int MAX_ITERATIONS = 10;
         for (int iter = 0; iter < MAX_ITERATIONS; iter++) {
             // Reset centroid accumulators
-            float* newCentroids = (float*)calloc(Levels, sizeof(float));
+            float* newCentroids = (float*)ScratchAlloc(Levels * sizeof(float), true);
             memset(centroidCounts, 0, Levels * sizeof(int));
             
             // Assignment step
@@ -4402,7 +4588,7 @@ extern "C" {
                 }
             }
             
-            free(newCentroids);
+            ScratchFree(newCentroids);
             
             // If centroids haven't changed significantly, stop iterating
             if (!changed) break;
@@ -4425,13 +4611,19 @@ extern "C" {
             }
         }
         
-        free(centroids);
-        free(assignments);
-        free(centroidCounts);
+        ScratchFree(centroids);
+        ScratchFree(assignments);
+        ScratchFree(centroidCounts);
         
         return OC_STATUS_OK;
     }
 
+    size_t posterizeScratchSize(int Width, int Height, int Channels) {
+        // With the most levels
+        size_t levels = ScratchBlockSize(255 * sizeof(float));
+        return 3 * levels + ScratchBlockSize((size_t)Width * Height * Channels * sizeof(int));
+    }
+
     OC_STATUS ocularLoadPalette(const char* filename, OcPalette* palette) {
 
         PaletteFormat format = detect_palette_format(filename);
@@ -39,6 +39,12 @@ extern "C" {
 #include "curves.h"
 #include "version.h"
 #include "fft.h"
+#include "parallel.h"
+#include "simd.h"
+#include "pipeline.h"
+#include "image_io.h"
+#include "binary.h"
+#include "workspace.h"
 #include "util.h"
 #include <math.h>
 #include <stdbool.h>
@@ -51,34 +57,6 @@ extern "C" {
 static const char* ocular_version = VERSION_MAJOR "." VERSION_MINOR "." VERSION_PATCH "." VERSION_BUILD ;
 static char timestamp[] = __DATE__ " " __TIME__;
 
-    /** @enum OcInterpolationMode
-     * @brief Interpolation method to use for resampling filter
-     */
-    typedef enum {
-        OC_INTERPOLATE_NEAREST,
-        OC_INTERPOLATE_BILINEAR,
-        OC_INTERPOLATE_BICUBIC,
-        OC_INTERPOLATE_LANZCOS,
-    } OcInterpolationMode;
-
-    /**
-     * @struct Parameters for Levels filter
-     * @var levelMinimum color level minimum
-     * @var levelMiddle color scale median
-     * @var levelMaximum maximum value of color scale
-     * @var minOutput minimum output value
-     * @var maxOutput maximum output value
-     * @var Enable Flag used to determine if to apply
-     */
-    typedef struct {
-        int levelMinimum;
-        int levelMiddle;
-        int levelMaximum;
-        int minOutput;
-        int maxOutput;
-        bool Enable;
-    } ocularLevelParams;
-
     /**
      * @enum OcDirection
      * @brief Parameter for image flip function
@@ -105,6 +83,10 @@ static char timestamp[] = __DATE__ " " __TIME__;
         OC_AUTO_THRESHOLD_ISODATA,
         OC_AUTO_THRESHOLD_SHANBHAG,
         OC_AUTO_THRESHOLD_YEN,
+        // Locally adaptive methods: every pixel gets the threshold of the window around it, for unevenly lit scans
+        OC_AUTO_THRESHOLD_NIBLACK,  // mean + k * standard deviation; 31x31 window, k = -0.2
+        OC_AUTO_THRESHOLD_SAUVOLA,  // mean * (1 + k * (standard deviation / 128 - 1)); 31x31 window, k = 0.34
+        OC_AUTO_THRESHOLD_BRADLEY,  // mean * (1 - t); window of an eighth of the longer side, t = 0.15
     } OcAutoThresholdMethod;
 
     /** @enum OcToneBalanceMode 
@@ -680,7 +662,7 @@ static char timestamp[] = __DATE__ " " __TIME__;
     OC_STATUS ocularHistogramStretch(uint8_t* input, uint8_t* output, int width, int height, int channels);
 
     /**
-     * @brief Performs global thresholding using various methods.
+     * @brief Performs global thresholding using various methods, or local thresholding with the adaptive ones.
      * Pixels above calculated threshold value are turned to white, else black.
      *  @ingroup group_color_filters
      *  @param Input The image input data buffer. Requires single channel image.
@@ -693,6 +675,40 @@ static char timestamp[] = __DATE__ " " __TIME__;
      */
     OC_STATUS ocularAutoThreshold(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, OcAutoThresholdMethod method);
 
+    /**
+     * @brief Performs global thresholding like ocularAutoThreshold(), writing a bit image: pixels above the calculated
+     * threshold become set bits. Takes an eighth of the memory of the 0/255 result and feeds the bit image filters of
+     * binary.h.
+     *  @ingroup group_color_filters
+     *  @param Input The image input data buffer. Requires single channel image.
+     *  @param Width The width of the image in pixels.
+     *  @param Height The height of the image in pixels.
+     *  @param Stride The number of bytes in one row of pixels.
+     *  @param method The method to use for automatically calculating threshold value. Good default OC_AUTO_THRESHOLD_OTSU.
+     *  @param Output An OC_DEPTH_1U image of the same size.
+     *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+     */
+    OC_STATUS ocularAutoThresholdToBits(const unsigned char* Input, int Width, int Height, int Stride, OcAutoThresholdMethod method,
+                                        OcImage* Output);
+
+    /**
+     * @brief Performs locally adaptive thresholding with a chosen window and constant. Each pixel is compared to a threshold
+     * computed from the mean and standard deviation of its window, clipped to the image. The window sums come from running
+     * sums, so the cost per pixel does not depend on the radius. Rows are processed in parallel bands.
+     *  @ingroup group_color_filters
+     *  @param Input The image input data buffer. Requires single channel image.
+     *  @param Output The image output data buffer. May be Input.
+     *  @param Width The width of the image in pixels.
+     *  @param Height The height of the image in pixels.
+     *  @param Stride The number of bytes in one row of pixels.
+     *  @param method OC_AUTO_THRESHOLD_NIBLACK, OC_AUTO_THRESHOLD_SAUVOLA or OC_AUTO_THRESHOLD_BRADLEY.
+     *  @param Radius The window is (2 * Radius + 1) pixels square, >= 1. Around the height of two text lines works well.
+     *  @param K The k of Niblack (typically -0.2) or Sauvola (0.2 to 0.5), or the t of Bradley (0.1 to 0.2).
+     *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+     */
+    OC_STATUS ocularAdaptiveThreshold(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride,
+                                      OcAutoThresholdMethod method, int Radius, float K);
+
     /**
      * @brief Attempts to correct images that were captured under extremely low or non-uniform lighting conditions.
      * This is an excellent non-linear color enhancement that combines global curve adjustment and local information.
@@ -708,14 +724,16 @@ static char timestamp[] = __DATE__ " " __TIME__;
 
     /**
      * @brief Applies a Photoshop-style layer blending mode to an image using a secondary image to mix with.
+     * Both images have 3 channels, or 4 channels with premultiplied alpha, in which case the blended mix is composited over
+     * the base. A mix image smaller than the base covers its top left corner. Each mode runs its own row kernel.
      * @ingroup group_color_filters
      * @param baseInput The base image input data buffer. Effect is applied to this data.
      * @param bWidth The width of the base image in pixels.
      * @param bHeight The height of the base image in pixels.
      * @param bStride The number of bytes in one row of pixels for base image.
-     * @param mixInput The mix image input data buffer.
-     * @param mWidth The width of the base image in pixels.
-     * @param mHeight The height of the base image in pixels.
+     * @param mixInput The mix image input data buffer, with the channel count of the base image.
+     * @param mWidth The width of the mix image in pixels.
+     * @param mHeight The height of the mix image in pixels.
      * @param mStride The number of bytes in one row of pixels for mix image.
      * @param blendMode The blending mode to apply. All 27 Photoshop blend are available.
      * @param alpha The transparency to apply. Range [0 - 100].
@@ -793,12 +811,14 @@ static char timestamp[] = __DATE__ " " __TIME__;
      * @param omega Haze retention factor (Range: 0.1-1.0)
      * @param epsilon Regularization parameter for guided filter (Range: 0.0001-1.0)
      * @param t0 Minimum transmission value to preserve (Range 0.01-1.0)
+     * @param subsample Refines the transmission with the fast guided filter, computing it on an image this many times
+     *                  smaller. 1 filters at full resolution; 4 to 8 suit large photos (Range: 1-guideRadius)
      * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
      */
     OC_STATUS ocularDarkChannelPriorHazeRemoval(unsigned char* Input, unsigned char* Output, 
                                                int Width, int Height, int Stride,
                                                int radius, int guideRadius, float maxAtm, 
-                                               float omega, float epsilon, float t0);
+                                               float omega, float epsilon, float t0, int subsample);
 
     //--------------------------Color adjustments--------------------------
 
@@ -830,9 +850,12 @@ static char timestamp[] = __DATE__ " " __TIME__;
 
     /** @brief Performs a non-linear, edge-preserving and noise-reducing smoothing of an image.
      *  This is a fast implementation, like gaussian blur, that performs vertical/horizontal passes independently.
+     *  The recursive passes run in 16-bit fixed point over independent rows and strips of columns in parallel, within 1 level
+     *  of a double precision implementation rounded to nearest, and only need a row or a strip of buffers per thread.
      *  @ingroup group_ip_filters
      *  @param Input The image input data buffer.
-     *  @param Output The image output data buffer.
+     *  @param Output The image output data buffer. It may be Input, but the vertical pass then measures color differences
+     *  on the horizontally filtered image, so the result differs from a separate Output.
      *  @param Width The width of the image in pixels.
      *  @param Height The height of the image in pixels.
      *  @param Stride The number of bytes in one row of pixels.
@@ -891,22 +914,31 @@ static char timestamp[] = __DATE__ " " __TIME__;
     //--------------------------Misc--------------------------
 
     /** @brief Applies a 2D convolution to an image using a kernel.
+     *  Rank one (separable) kernels run as two 1D passes and large kernels (over 15x15) through the FFT. Integral kernels give
+     *  the same result on the direct and separable paths; the single precision FFT matches them within rounding, its error
+     *  growing with the kernel size and magnitude. Input and Output may be the same buffer.
      *  @ingroup group_ip_filters
      *  @param Input The image input data buffer.
      *  @param Output The image output data buffer.
      *  @param Width The width of the image in pixels.
      *  @param Height The height of the image in pixels.
-     *  @param Channels The number of color channels in the image.
+     *  @param Stride The number of bytes in one row of pixels, which may include padding.
+     *  @param Channels The number of color channels in the image (1, 3 or 4).
      *  @param kernel The kernel matrix to apply. Width and height must be odd. This expects a 1D array.
      *  @param filterW The kernel matrix width.
      *  @param cfactor The sum of all values greater than 0 in the kernel.
      *  @param bias Used to increase/decrease all values greater than 0 in the kernel.
+     *  @param edgeMode How pixels beyond the image border are sampled. OC_EDGE_WRAP matches earlier versions.
      *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
      */
-    OC_STATUS ocularConvolution2DFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Channels, float* kernel,
-                                       unsigned char filterW, unsigned char cfactor, unsigned char bias);
+    OC_STATUS ocularConvolution2DFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Channels,
+                                       float* kernel, unsigned char filterW, unsigned char cfactor, unsigned char bias, OcEdgeMode edgeMode);
 
-    /** @brief Resizes an image using Nearest-neighbor, Bilinear, Bicubic or Lanczos interpolation.
+    /** @brief Resizes an image using Nearest-neighbor, Bilinear, Bicubic (Catmull-Rom), Lanczos-3 or Mitchell interpolation.
+     *  The filter runs separably, horizontally then vertically, with weights computed once per size and pixel centers
+     *  aligned. When shrinking, the filter is widened by the scale factor so that every source pixel contributes and
+     *  downscaled images do not alias; nearest neighbor picks pixels without filtering. Results are within 1 level of
+     *  exact arithmetic. Works on 1, 3 or 4 channels, all filtered alike.
      *  @ingroup group_ip_general
      *  @param Input The image input data buffer.
      *  @param Output The image output data buffer.
@@ -915,15 +947,33 @@ static char timestamp[] = __DATE__ " " __TIME__;
      *  @param Stride The number of bytes in one row of pixels.
      *  @param newWidth The new width of the image.
      *  @param newHeight The new height of the image.
-     *  @param dstStride The number of bytes in one row of pixels for output. Used to calculate destination offset.
-     *  @param InterpolationMode The interpolation mode to use. 
-     *  [OC_INTERPOLATION_NEAREST_NEIGHBOR, OC_INTERPOLATION_BILINEAR, OC_INTERPOLATION_BICUBIC, OC_INTERPOLATION_LANCZOS]
+     *  @param dstStride The number of bytes in one row of output pixels, at least newWidth * Channels.
+     *  @param InterpolationMode The interpolation mode to use.
+     *  [OC_INTERPOLATE_NEAREST, OC_INTERPOLATE_BILINEAR, OC_INTERPOLATE_BICUBIC, OC_INTERPOLATE_LANZCOS, OC_INTERPOLATE_MITCHELL]
      *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
      */
     OC_STATUS ocularResamplingFilter(unsigned char* Input, int Width, int Height, unsigned int Stride,
                                     unsigned char* Output, int newWidth, int newHeight, int dstStride, 
                                     OcInterpolationMode InterpolationMode);
 
+    /** @brief Resizes an image to several sizes at once, as for thumbnails. A pyramid of 2x2 averages is built once, as deep
+     *  as the smallest thumbnail allows, and each thumbnail is resampled as by ocularResamplingFilter() from the smallest
+     *  level still at least its size, so large reductions read a fraction of the pixels. Results are a little softer than
+     *  resampling the full image; an odd last row or column of a level is dropped when halving it. Nearest neighbor
+     *  thumbnails are picked from the full image. Works on 1, 3 or 4 channels.
+     *  @ingroup group_ip_general
+     *  @param Input The image input data buffer.
+     *  @param Width The width of the image in pixels.
+     *  @param Height The height of the image in pixels.
+     *  @param Stride The number of bytes in one row of pixels.
+     *  @param Thumbnails The sizes and output buffers of the thumbnails, each with the channels of the input.
+     *  @param Count The number of thumbnails, >= 1.
+     *  @param InterpolationMode The interpolation mode to use, see ocularResamplingFilter().
+     *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+     */
+    OC_STATUS ocularResamplingThumbnails(const unsigned char* Input, int Width, int Height, int Stride, OcThumbnail* Thumbnails, int Count,
+                                         OcInterpolationMode InterpolationMode);
+
     /**
      * @brief Rotates an image using nearest neighbor, bilinear, or bicubic interpolation. Non-image areas are filled with color or transparency.
      * @ingroup group_ip_general
@@ -950,6 +1000,8 @@ static char timestamp[] = __DATE__ " " __TIME__;
                                  unsigned char fillColorB);
 
     /** @brief Outputs only a selected portion of an image.
+     *  The rectangle is clipped to the image. Output may be Input when dstStride is no larger than srcStride. To crop an
+     *  OcImage without copying, use ocularCreateImageView().
      *  @ingroup group_ip_general
      *  @param Input The image input data buffer.
      *  @param Width The width of the image in pixels.
@@ -987,8 +1039,8 @@ static char timestamp[] = __DATE__ " " __TIME__;
      * @param Width The width of the image in pixels.
      * @param Height The height of the image in pixels.
      * @param Stride The number of bytes in one row of pixels.
-     * @param maxWindowSize The filter window size (should be a scalar between 1 and 7). Window size (ws) is defined as
-                            W = 2*ws + 1 so that W = 3 is a 3x3 filter window.
+     * @param maxWindowSize The largest filter window size. Windows grow from 3x3 in steps of 2 (5x5, 7x7, ...) up to this size
+                            until the median is not an impulse; sizes below 3 copy the input. (Range: 1-127)
         * @param Threshold The adaptive theshold (0 = normal median behavior). Higher values reduce the "aggresiveness" of the filter.
         * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
         */
@@ -1066,7 +1118,7 @@ static char timestamp[] = __DATE__ " " __TIME__;
     *  @param[out] DetectedLine A location where parameters of detected lines are to be stored.
     *  @param Height The height of the input image.
     *  @param Width The width of the input image.
-    *  @param threshold The maximum number of lines to return.
+    *  @param threshold The number of votes a line must exceed to be returned.
     *  @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
     */
     OC_STATUS ocularHoughLineDetection(unsigned char* Input, int* LineNumber, struct LineParameter* DetectedLine, int Height,
@@ -0,0 +1,231 @@
+/**
+ * @file: parallel.c
+ * @author Warren Galyen
+ * Created: 10-16-2026
+ * Last Updated: 10-16-2026
+ * Last update: initial implementation
+ *
+ * @brief Persistent worker pool behind ocularParallelFor.
+ */
+
+#include "parallel.h"
+#include "util.h"
+#include <stdlib.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <intrin.h>
+typedef HANDLE OcThread;
+typedef SRWLOCK OcMutex;
+typedef CONDITION_VARIABLE OcCond;
+    #define OC_MUTEX_INIT SRWLOCK_INIT
+    #define OC_COND_INIT CONDITION_VARIABLE_INIT
+    #define OcMutexLock(m) AcquireSRWLockExclusive(m)
+    #define OcMutexTryLock(m) (TryAcquireSRWLockExclusive(m) != 0)
+    #define OcMutexUnlock(m) ReleaseSRWLockExclusive(m)
+    #define OcCondWait(c, m) SleepConditionVariableSRW((c), (m), INFINITE, 0)
+    #define OcCondBroadcast(c) WakeAllConditionVariable(c)
+    #define OcAtomicAdd(p, v) _InterlockedExchangeAdd((volatile long*)(p), (long)(v))
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+typedef pthread_t OcThread;
+typedef pthread_mutex_t OcMutex;
+typedef pthread_cond_t OcCond;
+    #define OC_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+    #define OC_COND_INIT PTHREAD_COND_INITIALIZER
+    #define OcMutexLock(m) pthread_mutex_lock(m)
+    #define OcMutexTryLock(m) (pthread_mutex_trylock(m) == 0)
+    #define OcMutexUnlock(m) pthread_mutex_unlock(m)
+    #define OcCondWait(c, m) pthread_cond_wait((c), (m))
+    #define OcCondBroadcast(c) pthread_cond_broadcast(c)
+    #define OcAtomicAdd(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#endif
+
+// Number of bands handed out per thread; more bands balance uneven rows better at a small scheduling cost.
+#define BANDS_PER_THREAD 4
+
+typedef struct {
+    OcParallelBody Body;
+    void* Context;
+    int Count;
+    int Band;
+    long Next;
+} OcParallelJob;
+
+typedef struct {
+    OcMutex Lock;        // guards everything below
+    OcCond Wake;         // signalled when a new job is posted or on shutdown
+    OcCond Done;         // signalled when the last worker finishes a job
+    OcMutex Dispatch;    // held by the thread currently owning the pool
+    OcThread Workers[OC_MAX_THREADS];
+    int NumWorkers;      // workers besides the calling thread
+    int Pending;         // workers that have not finished the current job
+    unsigned int Generation;
+    bool Shutdown;
+    OcParallelJob* Job;
+} OcThreadPool;
+
+static OcThreadPool pool = { OC_MUTEX_INIT, OC_COND_INIT, OC_COND_INIT, OC_MUTEX_INIT, { 0 }, 0, 0, 0, false, NULL };
+static int requestedThreads = 0;
+static OC_THREAD_LOCAL int insideParallel = 0;
+
+static int getProcessorCount(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+static void runBands(OcParallelJob* job, int thread) {
+    for (;;) {
+        long begin = OcAtomicAdd(&job->Next, job->Band);
+        if (begin >= job->Count)
+            break;
+        long end = begin + job->Band;
+        if (end > job->Count)
+            end = job->Count;
+        job->Body(job->Context, (int)begin, (int)end, thread);
+    }
+}
+
+typedef struct {
+    int Index;
+    unsigned int Generation; // generation current when the worker was created, so it cannot miss the first job
+} OcWorkerArgs;
+
+static OcWorkerArgs workerArgs[OC_MAX_THREADS];
+
+#if defined(_WIN32)
+static DWORD WINAPI workerMain(LPVOID param) {
+#else
+static void* workerMain(void* param) {
+#endif
+    int index = ((OcWorkerArgs*)param)->Index;
+    unsigned int seen = ((OcWorkerArgs*)param)->Generation;
+    insideParallel = 1;
+
+    OcMutexLock(&pool.Lock);
+    for (;;) {
+        while (!pool.Shutdown && seen == pool.Generation)
+            OcCondWait(&pool.Wake, &pool.Lock);
+        if (pool.Shutdown)
+            break;
+        seen = pool.Generation;
+        OcParallelJob* job = pool.Job;
+        OcMutexUnlock(&pool.Lock);
+
+        runBands(job, index);
+
+        OcMutexLock(&pool.Lock);
+        if (--pool.Pending == 0)
+            OcCondBroadcast(&pool.Done);
+    }
+    OcMutexUnlock(&pool.Lock);
+    return 0;
+}
+
+// Starts the workers for the requested thread count. Called with pool.Dispatch held.
+static void startWorkers(int numWorkers) {
+    OcMutexLock(&pool.Lock);
+    pool.Shutdown = false;
+    OcMutexUnlock(&pool.Lock);
+    for (int i = 0; i < numWorkers; i++) {
+        workerArgs[i].Index = i + 1;
+        workerArgs[i].Generation = pool.Generation;
+#if defined(_WIN32)
+        pool.Workers[i] = CreateThread(NULL, 0, workerMain, &workerArgs[i], 0, NULL);
+        if (pool.Workers[i] == NULL)
+            break;
+#else
+        if (pthread_create(&pool.Workers[i], NULL, workerMain, &workerArgs[i]) != 0)
+            break;
+#endif
+        pool.NumWorkers++;
+    }
+}
+
+// Stops and joins every worker. Called with pool.Dispatch held.
+static void stopWorkers(void) {
+    OcMutexLock(&pool.Lock);
+    pool.Shutdown = true;
+    OcCondBroadcast(&pool.Wake);
+    OcMutexUnlock(&pool.Lock);
+    for (int i = 0; i < pool.NumWorkers; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(pool.Workers[i], INFINITE);
+        CloseHandle(pool.Workers[i]);
+#else
+        pthread_join(pool.Workers[i], NULL);
+#endif
+    }
+    pool.NumWorkers = 0;
+}
+
+OC_STATUS ocularSetThreadCount(int Count) {
+    if (Count < 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (insideParallel)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    OcMutexLock(&pool.Dispatch);
+    stopWorkers();
+    requestedThreads = min(Count, OC_MAX_THREADS);
+    OcMutexUnlock(&pool.Dispatch);
+
+    return OC_STATUS_OK;
+}
+
+int ocularGetThreadCount(void) {
+    int count = requestedThreads > 0 ? requestedThreads : getProcessorCount();
+    return clamp(count, 1, OC_MAX_THREADS);
+}
+
+void ocularParallelFor(int Count, int Grain, OcParallelBody Body, void* Context) {
+    if (Count <= 0 || Body == NULL)
+        return;
+    if (Grain < 1)
+        Grain = 1;
+
+    int threads = ocularGetThreadCount();
+    int band = (Count + threads * BANDS_PER_THREAD - 1) / (threads * BANDS_PER_THREAD);
+    if (band < Grain)
+        band = Grain;
+
+    // Run serially when there is only a single band, when called from inside another parallel loop
+    // or when a different thread already owns the pool.
+    if (threads == 1 || band >= Count || insideParallel || !OcMutexTryLock(&pool.Dispatch)) {
+        Body(Context, 0, Count, 0);
+        return;
+    }
+
+    if (pool.NumWorkers != threads - 1) {
+        stopWorkers();
+        startWorkers(threads - 1);
+    }
+
+    OcParallelJob job = { Body, Context, Count, band, 0 };
+    OcMutexLock(&pool.Lock);
+    pool.Job = &job;
+    pool.Pending = pool.NumWorkers;
+    pool.Generation++;
+    OcCondBroadcast(&pool.Wake);
+    OcMutexUnlock(&pool.Lock);
+
+    insideParallel = 1;
+    runBands(&job, 0);
+    insideParallel = 0;
+
+    OcMutexLock(&pool.Lock);
+    while (pool.Pending > 0)
+        OcCondWait(&pool.Done, &pool.Lock);
+    pool.Job = NULL;
+    OcMutexUnlock(&pool.Lock);
+
+    OcMutexUnlock(&pool.Dispatch);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file: parallel.h
+ * @author Warren Galyen
+ * Created: 10-16-2026
+ * Last Updated: 10-16-2026
+ * Last update: initial implementation
+ *
+ * @brief Library-wide worker pool used by filters to split work into row (or column) bands.
+ */
+
+#ifndef OCULAR_PARALLEL_H
+#define OCULAR_PARALLEL_H
+
+#include "core.h"
+
+/** Upper bound on the number of worker threads the pool will create. */
+#define OC_MAX_THREADS 256
+
+/**
+ * @brief Body of a parallel loop. Processes the half-open range [Begin, End).
+ * @param Context Filter specific data shared by every band.
+ * @param Begin First index of the band (usually a row or column).
+ * @param End One past the last index of the band.
+ * @param Thread Index of the executing thread in [0, ocularGetThreadCount()), usable to select per-thread scratch buffers.
+ */
+typedef void (*OcParallelBody)(void* Context, int Begin, int End, int Thread);
+
+/**
+ * @brief Sets the number of threads filters may use. Not safe to call while another thread is running a filter.
+ * @ingroup group_ip_utility
+ * @param Count The number of threads, 0 to use one thread per logical processor, 1 to run every filter serially.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularSetThreadCount(int Count);
+
+/**
+ * @brief Gets the number of threads filters will use.
+ * @ingroup group_ip_utility
+ * @return The effective thread count (always >= 1).
+ */
+int ocularGetThreadCount(void);
+
+/**
+ * @brief Runs Body over [0, Count) split into bands that are claimed dynamically by the worker pool, so faster threads pick up
+ * the remaining bands of slower ones. The calling thread takes part in the work and the call returns once every band is done.
+ * Bands never overlap, so a body that only writes the outputs of its own range produces results identical to a serial run.
+ * Nested calls (from inside a body) and calls made while the pool is busy with another caller run serially on the calling thread.
+ * @param Count The number of indices to process.
+ * @param Grain The minimum number of indices per band; keeps bands large enough to amortize scheduling.
+ * @param Body The function run for every band.
+ * @param Context Passed unchanged to Body.
+ */
+void ocularParallelFor(int Count, int Grain, OcParallelBody Body, void* Context);
+
+#endif /* OCULAR_PARALLEL_H */
@@ -0,0 +1,910 @@
+/**
+ * @file: pipeline.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Multi-stage filter pipelines that run a whole chain of filters in a single banded pass.
+ */
+
+#include "pipeline.h"
+#include "ocular.h"
+#include "morphology_filters.h"
+#include "parallel.h"
+#include "resample.h"
+#include "simd.h"
+#include "util.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Target size of one band of output rows; small enough that a band and its intermediates stay in a core's L2 cache.
+#define PIPELINE_BAND_BYTES (256 * 1024)
+// Width in bytes of the column strips the vertical rank pass works on
+#define PIPELINE_RANK_STRIP 256
+
+typedef enum {
+    STAGE_LOOKUP,
+    STAGE_SATURATION,
+    STAGE_UNSHARP_MASK,
+    STAGE_BLUR,
+    STAGE_RANK,
+    STAGE_RESAMPLE,
+} PipelineStageType;
+
+typedef struct {
+    PipelineStageType Type;
+    unsigned char Table[3][256];  // STAGE_LOOKUP
+    unsigned char* SaturationMap; // STAGE_SATURATION, 256 x 256 indexed by gray level and value
+    float* Kernel;                // STAGE_UNSHARP_MASK and STAGE_BLUR, 2 * Radius + 1 normalized symmetric weights
+    int Radius;                   // also STAGE_RANK
+    float Intensity;
+    float ThresholdValue;
+    bool KeepAlpha; // STAGE_BLUR
+    bool IsMax;     // STAGE_RANK
+    int NewWidth; // STAGE_RESAMPLE
+    int NewHeight;
+    OcInterpolationMode Mode;
+} PipelineStage;
+
+struct OcPipeline {
+    PipelineStage Stages[OC_PIPELINE_MAX_STAGES];
+    int NumStages;
+};
+
+// Runs of point stages execute as a single pass; every other stage is a pass of its own.
+typedef enum {
+    PASS_POINT,
+    PASS_BLUR, // STAGE_BLUR or STAGE_UNSHARP_MASK
+    PASS_RANK,
+    PASS_RESAMPLE,
+} PipelinePassType;
+
+typedef struct {
+    PipelinePassType Type;
+    const PipelineStage* Stages;
+    int NumStages;
+    int InWidth;
+    int InHeight;
+    int OutWidth;
+    int OutHeight;
+    Resampler Tables; // PASS_RESAMPLE
+} PipelinePass;
+
+typedef struct {
+    PipelinePass Passes[OC_PIPELINE_MAX_STAGES];
+    int NumPasses;
+    const unsigned char* Input; // holds input rows from InputRow on
+    int InputRow;
+    int Stride;
+    unsigned char* Output; // holds output rows from OutputRow on
+    int OutputRow;
+    int dstStride;
+    int Channels;
+    int InHeight;
+    int BandRows;
+    int FirstRow; // bands cover output rows [FirstRow, LastRow)
+    int LastRow;
+    int OutHeight;
+    int WindowRows; // most input rows any band reads
+    unsigned char* Scratch;
+    size_t ScratchSize; // bytes of scratch per thread
+    size_t BufferSize;  // bytes of each of the two band buffers
+    size_t WorkSize;    // bytes of working memory of the blur, rank and resampling passes
+} PipelineJob;
+
+struct OcPipelineStream {
+    PipelineJob Job;
+    unsigned char* Window; // input rows [WindowBegin, WindowEnd), packed
+    int WindowBegin;
+    int WindowEnd;
+    int NextRow; // next output row to produce
+};
+
+//--------------------------Building--------------------------
+
+OC_STATUS ocularCreatePipeline(OcPipeline** Pipeline) {
+    if (Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    *Pipeline = (OcPipeline*)calloc(1, sizeof(OcPipeline));
+    if (*Pipeline == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularFreePipeline(OcPipeline** Pipeline) {
+    if (Pipeline == NULL || *Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    for (int i = 0; i < (*Pipeline)->NumStages; i++) {
+        free((*Pipeline)->Stages[i].SaturationMap);
+        free((*Pipeline)->Stages[i].Kernel);
+    }
+    free(*Pipeline);
+    *Pipeline = NULL;
+
+    return OC_STATUS_OK;
+}
+
+static OC_STATUS addStage(OcPipeline* Pipeline, PipelineStage** stage) {
+    if (Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Pipeline->NumStages == OC_PIPELINE_MAX_STAGES)
+        return OC_STATUS_ERR_OVERFLOW;
+
+    *stage = &Pipeline->Stages[Pipeline->NumStages++];
+    memset(*stage, 0, sizeof(PipelineStage));
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineAddLookup(OcPipeline* Pipeline, const unsigned char* TableR, const unsigned char* TableG, const unsigned char* TableB) {
+    if (Pipeline == NULL || TableR == NULL || TableG == NULL || TableB == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    const unsigned char* Tables[3] = { TableR, TableG, TableB };
+
+    // Consecutive lookups collapse into one table: out = new[old[in]]
+    if (Pipeline->NumStages > 0 && Pipeline->Stages[Pipeline->NumStages - 1].Type == STAGE_LOOKUP) {
+        PipelineStage* last = &Pipeline->Stages[Pipeline->NumStages - 1];
+        for (int c = 0; c < 3; c++) {
+            for (int i = 0; i < 256; i++) {
+                last->Table[c][i] = Tables[c][last->Table[c][i]];
+            }
+        }
+        return OC_STATUS_OK;
+    }
+
+    PipelineStage* stage;
+    OC_STATUS status = addStage(Pipeline, &stage);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    stage->Type = STAGE_LOOKUP;
+    for (int c = 0; c < 3; c++) {
+        memcpy(stage->Table[c], Tables[c], 256);
+    }
+    return OC_STATUS_OK;
+}
+
+// Point filters are captured by running them over a 256 pixel ramp holding every value in each channel;
+// the filtered ramp is the filter's lookup table.
+static void fillRamp(unsigned char* Ramp) {
+    for (int i = 0; i < 256; i++) {
+        Ramp[i * 3 + 0] = (unsigned char)i;
+        Ramp[i * 3 + 1] = (unsigned char)i;
+        Ramp[i * 3 + 2] = (unsigned char)i;
+    }
+}
+
+static OC_STATUS addRampLookup(OcPipeline* Pipeline, const unsigned char* Ramp) {
+    unsigned char Tables[3][256];
+    for (int i = 0; i < 256; i++) {
+        Tables[0][i] = Ramp[i * 3 + 0];
+        Tables[1][i] = Ramp[i * 3 + 1];
+        Tables[2][i] = Ramp[i * 3 + 2];
+    }
+    return ocularPipelineAddLookup(Pipeline, Tables[0], Tables[1], Tables[2]);
+}
+
+OC_STATUS ocularPipelineAddLevels(OcPipeline* Pipeline, const ocularLevelParams* redLevelParams, const ocularLevelParams* greenLevelParams,
+                                  const ocularLevelParams* blueLevelParams) {
+    if (Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    // ocularLevelsFilter clamps its parameters in place, so hand it copies
+    ocularLevelParams Params[3] = { { 0 } };
+    if (redLevelParams != NULL)
+        Params[0] = *redLevelParams;
+    if (greenLevelParams != NULL)
+        Params[1] = *greenLevelParams;
+    if (blueLevelParams != NULL)
+        Params[2] = *blueLevelParams;
+
+    unsigned char Ramp[256 * 3];
+    fillRamp(Ramp);
+    OC_STATUS status = ocularLevelsFilter(Ramp, Ramp, 256, 1, 256 * 3, &Params[0], &Params[1], &Params[2]);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    return addRampLookup(Pipeline, Ramp);
+}
+
+OC_STATUS ocularPipelineAddCurves(OcPipeline* Pipeline, const OcCurve* curveR, const OcCurve* curveG, const OcCurve* curveB) {
+    if (Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    unsigned char Ramp[256 * 3];
+    fillRamp(Ramp);
+    OC_STATUS status = ocularCurvesFilter(Ramp, Ramp, 256, 1, 256 * 3, curveR, curveG, curveB, NULL);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    return addRampLookup(Pipeline, Ramp);
+}
+
+OC_STATUS ocularPipelineAddGamma(OcPipeline* Pipeline, const float gamma[3]) {
+    if (Pipeline == NULL || gamma == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    float Gamma[3] = { gamma[0], gamma[1], gamma[2] };
+    unsigned char Ramp[256 * 3];
+    fillRamp(Ramp);
+    OC_STATUS status = ocularGammaFilter(Ramp, Ramp, 256, 1, 256 * 3, Gamma);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    return addRampLookup(Pipeline, Ramp);
+}
+
+OC_STATUS ocularPipelineAddBrightnessAndContrast(OcPipeline* Pipeline, float brightness, float contrast) {
+    if (Pipeline == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    unsigned char Ramp[256 * 3];
+    fillRamp(Ramp);
+    OC_STATUS status = ocularBrightnessAndContrastFilter(Ramp, Ramp, 256, 1, 256 * 3, brightness, contrast);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    return addRampLookup(Pipeline, Ramp);
+}
+
+OC_STATUS ocularPipelineAddSaturation(OcPipeline* Pipeline, float saturation) {
+    PipelineStage* stage;
+    OC_STATUS status = addStage(Pipeline, &stage);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    stage->SaturationMap = (unsigned char*)malloc(256 * 256);
+    if (stage->SaturationMap == NULL) {
+        Pipeline->NumStages--;
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    stage->Type = STAGE_SATURATION;
+
+    // Same table as ocularSaturationFilter
+    saturation = clamp(saturation, 0.0, 1.0);
+    for (int gray = 0; gray < 256; gray++) {
+        unsigned char* pSaturationMap = stage->SaturationMap + (gray << 8);
+        for (int i = 0; i < 256; i++) {
+            pSaturationMap[i] = (unsigned char)((mix_u8((unsigned char)gray, (unsigned char)i, saturation) + i) * 0.5f);
+        }
+    }
+    return OC_STATUS_OK;
+}
+
+// Adds a stage of the given type with a Gaussian kernel truncated at 3 sigma, or a box of Radius if GaussianSigma is 0
+static OC_STATUS addKernelStage(OcPipeline* Pipeline, PipelineStageType Type, float GaussianSigma, int Radius, PipelineStage** stage) {
+    if (GaussianSigma > 0.0f)
+        Radius = max(1, (int)ceilf(GaussianSigma * 3.0f));
+
+    float* Kernel = (float*)malloc((2 * Radius + 1) * sizeof(float));
+    if (Kernel == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    float sum = 0.0f;
+    for (int i = -Radius; i <= Radius; i++) {
+        Kernel[i + Radius] = (GaussianSigma > 0.0f) ? expf(-(float)(i * i) / (2.0f * GaussianSigma * GaussianSigma)) : 1.0f;
+        sum += Kernel[i + Radius];
+    }
+    for (int i = 0; i < 2 * Radius + 1; i++) {
+        Kernel[i] /= sum;
+    }
+
+    OC_STATUS status = addStage(Pipeline, stage);
+    if (status != OC_STATUS_OK) {
+        free(Kernel);
+        return status;
+    }
+
+    (*stage)->Type = Type;
+    (*stage)->Kernel = Kernel;
+    (*stage)->Radius = Radius;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineAddUnsharpMask(OcPipeline* Pipeline, float GaussianSigma, float intensity, float threshold) {
+    PipelineStage* stage;
+    OC_STATUS status = addKernelStage(Pipeline, STAGE_UNSHARP_MASK, clamp(GaussianSigma, 0.1f, 200.0f), 0, &stage);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    stage->Intensity = clamp(intensity, 0.0f, 4.0f);
+    stage->ThresholdValue = (clamp(threshold, 0.0f, 100.0f) / 100.0f) * 255.0f;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineAddGaussianBlur(OcPipeline* Pipeline, float GaussianSigma) {
+    PipelineStage* stage;
+    return addKernelStage(Pipeline, STAGE_BLUR, clamp(GaussianSigma, 0.1f, 200.0f), 0, &stage);
+}
+
+OC_STATUS ocularPipelineAddBoxBlur(OcPipeline* Pipeline, int Radius) {
+    if (Radius < 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    // ocularBoxBlurFilter leaves alpha alone
+    PipelineStage* stage;
+    OC_STATUS status = addKernelStage(Pipeline, STAGE_BLUR, 0.0f, Radius, &stage);
+    if (status == OC_STATUS_OK)
+        stage->KeepAlpha = true;
+    return status;
+}
+
+static OC_STATUS addRankStage(OcPipeline* Pipeline, int Radius, bool IsMax) {
+    if (Radius < 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    PipelineStage* stage;
+    OC_STATUS status = addStage(Pipeline, &stage);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    stage->Type = STAGE_RANK;
+    // As in ocularErodeFilter() and ocularDilateFilter()
+    stage->Radius = max(Radius, 1);
+    stage->IsMax = IsMax;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineAddErode(OcPipeline* Pipeline, int Radius) {
+    return addRankStage(Pipeline, Radius, false);
+}
+
+OC_STATUS ocularPipelineAddDilate(OcPipeline* Pipeline, int Radius) {
+    return addRankStage(Pipeline, Radius, true);
+}
+
+OC_STATUS ocularPipelineAddResample(OcPipeline* Pipeline, int newWidth, int newHeight, OcInterpolationMode InterpolationMode) {
+    if (newWidth <= 0 || newHeight <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (InterpolationMode < OC_INTERPOLATE_NEAREST || InterpolationMode > OC_INTERPOLATE_MITCHELL)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    PipelineStage* stage;
+    OC_STATUS status = addStage(Pipeline, &stage);
+    if (status != OC_STATUS_OK)
+        return status;
+
+    stage->Type = STAGE_RESAMPLE;
+    stage->NewWidth = newWidth;
+    stage->NewHeight = newHeight;
+    stage->Mode = InterpolationMode;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineGetOutputSize(const OcPipeline* Pipeline, int Width, int Height, int* newWidth, int* newHeight) {
+    if (Pipeline == NULL || newWidth == NULL || newHeight == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width <= 0 || Height <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    for (int i = 0; i < Pipeline->NumStages; i++) {
+        if (Pipeline->Stages[i].Type == STAGE_RESAMPLE) {
+            Width = Pipeline->Stages[i].NewWidth;
+            Height = Pipeline->Stages[i].NewHeight;
+        }
+    }
+    *newWidth = Width;
+    *newHeight = Height;
+    return OC_STATUS_OK;
+}
+
+//--------------------------Row kernels--------------------------
+
+static void saturationRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels, const unsigned char* SaturationMap) {
+    for (int X = 0; X < Width; X++) {
+        const unsigned char* pSaturationMap = SaturationMap + (((13926 * Input[0] + 46884 * Input[1] + 4725 * Input[2]) >> 16) << 8);
+        Output[0] = pSaturationMap[Input[0]];
+        Output[1] = pSaturationMap[Input[1]];
+        Output[2] = pSaturationMap[Input[2]];
+        if (Channels == 4)
+            Output[3] = Input[3];
+        Input += Channels;
+        Output += Channels;
+    }
+}
+
+static void pointRow(const PipelinePass* pass, const unsigned char* Input, unsigned char* Output, int Width, int Channels) {
+    for (int i = 0; i < pass->NumStages; i++) {
+        const PipelineStage* stage = &pass->Stages[i];
+        if (stage->Type == STAGE_LOOKUP)
+            simdCurveRow(Input, Output, Width, Channels, stage->Table[0], stage->Table[1], stage->Table[2]);
+        else
+            saturationRow(Input, Output, Width, Channels, stage->SaturationMap);
+        Input = Output;
+    }
+}
+
+// Horizontal Gaussian of one row into floats, with the row edges clamped.
+static void blurRowHorizontal(const unsigned char* Input, float* Output, unsigned char* Line, int Width, int Channels, const float* Kernel,
+                              int Radius) {
+    int rowBytes = Width * Channels;
+    for (int i = 0; i < Radius; i++) {
+        memcpy(Line + i * Channels, Input, Channels);
+        memcpy(Line + (Radius + Width + i) * Channels, Input + rowBytes - Channels, Channels);
+    }
+    memcpy(Line + Radius * Channels, Input, rowBytes);
+
+    // The kernel is symmetric, so mirrored taps share one multiply
+    const float* Half = Kernel + Radius;
+    for (int i = 0; i < rowBytes; i++) {
+        const unsigned char* pLine = Line + Radius * Channels + i;
+        float sum = Half[0] * pLine[0];
+        for (int k = 1; k <= Radius; k++) {
+            sum += Half[k] * (float)(pLine[-k * Channels] + pLine[k * Channels]);
+        }
+        Output[i] = sum;
+    }
+}
+
+static void copyRows(const unsigned char* Input, int srcStride, unsigned char* Output, int dstStride, int rowBytes, int Rows) {
+    for (int Y = 0; Y < Rows; Y++) {
+        memcpy(Output + (size_t)Y * dstStride, Input + (size_t)Y * srcStride, rowBytes);
+    }
+}
+
+//--------------------------Execution--------------------------
+
+// Rows a pass reads above and below each row it produces; resampling passes map rows instead.
+static int passHalo(const PipelinePass* pass) {
+    return (pass->Type == PASS_BLUR || pass->Type == PASS_RANK) ? pass->Stages[0].Radius : 0;
+}
+
+// Fills RowBegin/RowEnd[k] with the rows the input of pass k needs so the last pass produces output rows [y0, y1).
+// Index NumPasses is the output of the pipeline.
+static void bandRows(const PipelineJob* job, int y0, int y1, int* RowBegin, int* RowEnd) {
+    RowBegin[job->NumPasses] = y0;
+    RowEnd[job->NumPasses] = y1;
+    for (int k = job->NumPasses - 1; k >= 0; k--) {
+        const PipelinePass* pass = &job->Passes[k];
+        int begin = RowBegin[k + 1];
+        int end = RowEnd[k + 1];
+        if (pass->Type == PASS_RESAMPLE) {
+            resampleSourceRows(&pass->Tables, begin, end, &RowBegin[k], &RowEnd[k]);
+        } else {
+            RowBegin[k] = max(begin - passHalo(pass), 0);
+            RowEnd[k] = min(end + passHalo(pass), pass->InHeight);
+        }
+    }
+}
+
+// Blurs input rows [inBegin, inEnd) with the stage kernel, horizontally then vertically, and finishes output rows
+// [outBegin, outEnd) either as the blur itself or as an unsharp mask of the input.
+static void runBlur(const PipelineJob* job, const PipelinePass* pass, const unsigned char* Input, int inBegin, int inEnd, unsigned char* Output,
+                    int outBegin, int outEnd, unsigned char* Work) {
+    const PipelineStage* stage = pass->Stages;
+    int Channels = job->Channels;
+    int rowBytes = pass->InWidth * Channels;
+    int Radius = stage->Radius;
+    float* BlurRows = (float*)Work;
+    float* Sum = BlurRows + (size_t)(inEnd - inBegin) * rowBytes;
+    unsigned char* Line = (unsigned char*)(Sum + rowBytes);
+
+    for (int Y = inBegin; Y < inEnd; Y++) {
+        blurRowHorizontal(Input + (Y - inBegin) * rowBytes, BlurRows + (size_t)(Y - inBegin) * rowBytes, Line, pass->InWidth, Channels,
+                          stage->Kernel, Radius);
+    }
+
+    for (int Y = outBegin; Y < outEnd; Y++) {
+        const float* Half = stage->Kernel + Radius;
+        const float* pCenter = BlurRows + (size_t)(Y - inBegin) * rowBytes;
+        for (int i = 0; i < rowBytes; i++) {
+            Sum[i] = Half[0] * pCenter[i];
+        }
+        for (int k = 1; k <= Radius; k++) {
+            // Rows beyond the image edge repeat the edge row; they always lie inside the band
+            const float* pAbove = BlurRows + (size_t)(max(Y - k, 0) - inBegin) * rowBytes;
+            const float* pBelow = BlurRows + (size_t)(min(Y + k, pass->InHeight - 1) - inBegin) * rowBytes;
+            float weight = Half[k];
+            for (int i = 0; i < rowBytes; i++) {
+                Sum[i] += weight * (pAbove[i] + pBelow[i]);
+            }
+        }
+        unsigned char* pOutput = Output + (Y - outBegin) * rowBytes;
+        if (stage->Type == STAGE_UNSHARP_MASK) {
+            unsharpMaskRow(Input + (Y - inBegin) * rowBytes, Sum, pOutput, pass->InWidth, Channels, stage->Intensity, stage->ThresholdValue);
+        } else {
+            const unsigned char* pInput = Input + (Y - inBegin) * rowBytes;
+            for (int i = 0; i < rowBytes; i++) {
+                pOutput[i] = ClampToByte(Sum[i] + 0.5f);
+            }
+            if (stage->KeepAlpha && Channels == 4) {
+                for (int i = 3; i < rowBytes; i += 4) {
+                    pOutput[i] = pInput[i];
+                }
+            }
+        }
+    }
+}
+
+// Minimum or maximum over the (2 * Radius + 1) square around each pixel of output rows [outBegin, outEnd): a running
+// extremum along the input rows, then down column strips of the band. Pixels outside the image are ignored, as in
+// ocularErodeFilter(), and the band holds every row the output rows see.
+static void runRank(const PipelineJob* job, const PipelinePass* pass, const unsigned char* Input, int inBegin, int inEnd, unsigned char* Output,
+                    int outBegin, int outEnd, unsigned char* Work) {
+    const PipelineStage* stage = pass->Stages;
+    int Channels = job->Channels;
+    int rowBytes = pass->InWidth * Channels;
+    int Radius = stage->Radius;
+    int inRows = inEnd - inBegin;
+    unsigned char* Rows = Work;
+    unsigned char* G = Rows + (size_t)inRows * rowBytes;
+    unsigned char* H = G + max((size_t)(pass->InWidth + 2 * Radius) * Channels, (size_t)(inRows + 2 * Radius) * PIPELINE_RANK_STRIP);
+
+    for (int Y = 0; Y < inRows; Y++) {
+        rankLine(Input + (size_t)Y * rowBytes, Channels, Rows + (size_t)Y * rowBytes, Channels, pass->InWidth, Channels, -Radius, Radius,
+                 stage->IsMax, false, G, H);
+    }
+    for (int x = 0; x < rowBytes; x += PIPELINE_RANK_STRIP) {
+        int Span = min(PIPELINE_RANK_STRIP, rowBytes - x);
+        rankLine(Rows + x, rowBytes, Rows + x, rowBytes, inRows, Span, -Radius, Radius, stage->IsMax, false, G, H);
+    }
+    copyRows(Rows + (size_t)(outBegin - inBegin) * rowBytes, rowBytes, Output, rowBytes, rowBytes, outEnd - outBegin);
+}
+
+static void runResample(const PipelinePass* pass, const unsigned char* Input, int inBegin, unsigned char* Output, int outBegin, int outEnd,
+                        unsigned char* Work) {
+    int Channels = pass->Tables.Channels;
+    resampleRows(&pass->Tables, Input, pass->InWidth * Channels, inBegin, Output, pass->OutWidth * Channels, outBegin, outEnd, Work);
+}
+
+static void runBands(void* Context, int Begin, int End, int Thread) {
+    const PipelineJob* job = (const PipelineJob*)Context;
+    unsigned char* scratch = job->Scratch + Thread * job->ScratchSize;
+    unsigned char* buffers[2] = { scratch, scratch + job->BufferSize };
+    unsigned char* Work = scratch + 2 * job->BufferSize;
+    int Channels = job->Channels;
+    int RowBegin[OC_PIPELINE_MAX_STAGES + 1];
+    int RowEnd[OC_PIPELINE_MAX_STAGES + 1];
+
+    for (int band = Begin; band < End; band++) {
+        int y0 = job->FirstRow + band * job->BandRows;
+        int y1 = min(y0 + job->BandRows, job->LastRow);
+        bandRows(job, y0, y1, RowBegin, RowEnd);
+
+        // Rows of the current intermediate live in buffers[current], packed; point passes work in place.
+        int current = 0;
+        for (int k = 0; k < job->NumPasses; k++) {
+            const PipelinePass* pass = &job->Passes[k];
+            int inRowBytes = pass->InWidth * Channels;
+            int outRowBytes = pass->OutWidth * Channels;
+            int inRows = RowEnd[k] - RowBegin[k];
+            int outRows = RowEnd[k + 1] - RowBegin[k + 1];
+            bool first = k == 0;
+            bool last = k == job->NumPasses - 1;
+            const unsigned char* input = first ? job->Input + (size_t)(RowBegin[0] - job->InputRow) * job->Stride : NULL;
+            unsigned char* output = last ? job->Output + (size_t)(RowBegin[k + 1] - job->OutputRow) * job->dstStride : NULL;
+
+            if (pass->Type == PASS_POINT) {
+                // The first and last point passes read the input and write the output directly
+                const unsigned char* src = first ? input : buffers[current];
+                int srcStride = first ? job->Stride : inRowBytes;
+                unsigned char* dst = last ? output : buffers[current];
+                int dstStride = last ? job->dstStride : outRowBytes;
+                for (int Y = 0; Y < outRows; Y++) {
+                    pointRow(pass, src + Y * srcStride, dst + Y * dstStride, pass->InWidth, Channels);
+                }
+                continue;
+            }
+
+            if (first)
+                copyRows(input, job->Stride, buffers[current], inRowBytes, inRowBytes, inRows);
+
+            unsigned char* dst = buffers[current ^ 1];
+            if (pass->Type == PASS_BLUR)
+                runBlur(job, pass, buffers[current], RowBegin[k], RowEnd[k], dst, RowBegin[k + 1], RowEnd[k + 1], Work);
+            else if (pass->Type == PASS_RANK)
+                runRank(job, pass, buffers[current], RowBegin[k], RowEnd[k], dst, RowBegin[k + 1], RowEnd[k + 1], Work);
+            else
+                runResample(pass, buffers[current], RowBegin[k], dst, RowBegin[k + 1], RowEnd[k + 1], Work);
+            current ^= 1;
+
+            if (last)
+                copyRows(dst, outRowBytes, output, job->dstStride, outRowBytes, outRows);
+        }
+    }
+}
+
+// Releases the resampling tables of the passes
+static void freeJob(PipelineJob* job) {
+    for (int k = 0; k < job->NumPasses; k++) {
+        if (job->Passes[k].Type == PASS_RESAMPLE)
+            freeResampler(&job->Passes[k].Tables);
+    }
+}
+
+// Groups the stages into passes for an image of the given size and sizes the bands and their buffers. With AnyStart the
+// sizes hold for bands starting on any output row, as the stream produces them, rather than on multiples of BandRows.
+static OC_STATUS planJob(const OcPipeline* Pipeline, int Width, int Height, int Channels, bool AnyStart, PipelineJob* job) {
+    job->Channels = Channels;
+    job->InHeight = Height;
+
+    // Group the stages into passes and track the image size through them
+    int curWidth = Width, curHeight = Height;
+    for (int i = 0; i < Pipeline->NumStages; i++) {
+        const PipelineStage* stage = &Pipeline->Stages[i];
+        PipelinePass* pass = &job->Passes[job->NumPasses];
+        bool isPoint = stage->Type == STAGE_LOOKUP || stage->Type == STAGE_SATURATION;
+
+        if (stage->Type == STAGE_SATURATION && Channels == 1)
+            return OC_STATUS_ERR_NOTSUPPORTED;
+        // Resampling to the same size is a copy, as in ocularResamplingFilter
+        if (stage->Type == STAGE_RESAMPLE && stage->NewWidth == curWidth && stage->NewHeight == curHeight &&
+            stage->Mode != OC_INTERPOLATE_MITCHELL)
+            continue;
+
+        if (isPoint && job->NumPasses > 0 && job->Passes[job->NumPasses - 1].Type == PASS_POINT &&
+            job->Passes[job->NumPasses - 1].Stages + job->Passes[job->NumPasses - 1].NumStages == stage) {
+            job->Passes[job->NumPasses - 1].NumStages++;
+            continue;
+        }
+
+        switch (stage->Type) {
+            case STAGE_UNSHARP_MASK:
+            case STAGE_BLUR:
+                pass->Type = PASS_BLUR;
+                break;
+            case STAGE_RANK:
+                pass->Type = PASS_RANK;
+                break;
+            case STAGE_RESAMPLE:
+                pass->Type = PASS_RESAMPLE;
+                break;
+            default:
+                pass->Type = PASS_POINT;
+                break;
+        }
+        pass->Stages = stage;
+        pass->NumStages = 1;
+        pass->InWidth = curWidth;
+        pass->InHeight = curHeight;
+        if (stage->Type == STAGE_RESAMPLE) {
+            curWidth = stage->NewWidth;
+            curHeight = stage->NewHeight;
+        }
+        pass->OutWidth = curWidth;
+        pass->OutHeight = curHeight;
+        job->NumPasses++;
+        if (pass->Type == PASS_RESAMPLE) {
+            OC_STATUS status = createResampler(stage->Mode, pass->InWidth, pass->InHeight, curWidth, curHeight, Channels, &pass->Tables);
+            if (status != OC_STATUS_OK)
+                return status;
+        }
+    }
+    job->OutHeight = curHeight;
+    job->FirstRow = 0;
+    job->LastRow = curHeight;
+    job->BandRows = min(max(PIPELINE_BAND_BYTES / (curWidth * Channels), 8), curHeight);
+    if (job->NumPasses == 0) {
+        job->WindowRows = job->BandRows;
+        return OC_STATUS_OK;
+    }
+
+    // Size the bands so each stays in cache, but no thinner than the widest halo so halos do not dominate the work
+    int maxHalo = 0;
+    for (int k = 0; k < job->NumPasses; k++) {
+        maxHalo = max(maxHalo, passHalo(&job->Passes[k]));
+    }
+    job->BandRows = min(max(job->BandRows, maxHalo), curHeight);
+
+    // Find the largest intermediate any band needs
+    int RowBegin[OC_PIPELINE_MAX_STAGES + 1];
+    int RowEnd[OC_PIPELINE_MAX_STAGES + 1];
+    for (int y0 = 0; y0 < curHeight; y0 += AnyStart ? 1 : job->BandRows) {
+        bandRows(job, y0, min(y0 + job->BandRows, curHeight), RowBegin, RowEnd);
+        job->WindowRows = max(job->WindowRows, RowEnd[0] - RowBegin[0]);
+        for (int k = 0; k < job->NumPasses; k++) {
+            const PipelinePass* pass = &job->Passes[k];
+            int inRows = RowEnd[k] - RowBegin[k];
+            size_t inRowBytes = (size_t)pass->InWidth * Channels;
+            size_t inBytes = inRows * inRowBytes;
+            size_t outBytes = (size_t)(RowEnd[k + 1] - RowBegin[k + 1]) * pass->OutWidth * Channels;
+            job->BufferSize = max(job->BufferSize, max(inBytes, outBytes));
+            int Radius = passHalo(pass);
+            if (pass->Type == PASS_BLUR) {
+                size_t lineSize = (size_t)(pass->InWidth + 2 * Radius) * Channels;
+                job->WorkSize = max(job->WorkSize, (inBytes + inRowBytes) * sizeof(float) + lineSize);
+            } else if (pass->Type == PASS_RANK) {
+                size_t lineSize = max((size_t)(pass->InWidth + 2 * Radius) * Channels, (size_t)(inRows + 2 * Radius) * PIPELINE_RANK_STRIP);
+                job->WorkSize = max(job->WorkSize, inBytes + 2 * lineSize);
+            } else if (pass->Type == PASS_RESAMPLE) {
+                job->WorkSize = max(job->WorkSize, resampleWorkSize(&pass->Tables));
+            }
+        }
+    }
+    // Keep each thread's float rows aligned
+    job->BufferSize = (job->BufferSize + 63) & ~(size_t)63;
+    job->ScratchSize = (2 * job->BufferSize + job->WorkSize + 63) & ~(size_t)63;
+    return OC_STATUS_OK;
+}
+
+// Produces output rows [job->FirstRow, job->LastRow) in parallel bands
+static OC_STATUS runJob(PipelineJob* job) {
+    job->Scratch = (unsigned char*)ScratchAlloc(job->ScratchSize * ocularGetThreadCount(), false);
+    if (job->Scratch == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    int numBands = (job->LastRow - job->FirstRow + job->BandRows - 1) / job->BandRows;
+    ocularParallelFor(numBands, 1, runBands, job);
+
+    ScratchFree(job->Scratch);
+    job->Scratch = NULL;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineRun(const OcPipeline* Pipeline, const unsigned char* Input, int Width, int Height, int Stride, unsigned char* Output,
+                            int dstStride) {
+    if (Pipeline == NULL || Input == NULL || Output == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width <= 0 || Height <= 0 || Stride <= 0 || dstStride <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    int Channels = Stride / Width;
+    if (Channels != 1 && Channels != 3 && Channels != 4)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    PipelineJob job = { 0 };
+    OC_STATUS status = planJob(Pipeline, Width, Height, Channels, false, &job);
+    if (status != OC_STATUS_OK) {
+        freeJob(&job);
+        return status;
+    }
+
+    if (job.NumPasses == 0) {
+        copyRows(Input, Stride, Output, dstStride, Width * Channels, Height);
+        return OC_STATUS_OK;
+    }
+
+    job.Input = Input;
+    job.Stride = Stride;
+    job.Output = Output;
+    job.dstStride = dstStride;
+    status = runJob(&job);
+    freeJob(&job);
+    return status;
+}
+
+//--------------------------Streaming--------------------------
+
+OC_STATUS ocularCreatePipelineStream(const OcPipeline* Pipeline, int Width, int Height, int Channels, OcPipelineStream** Stream) {
+    if (Pipeline == NULL || Stream == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (Width <= 0 || Height <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    if (Channels != 1 && Channels != 3 && Channels != 4)
+        return OC_STATUS_ERR_NOTSUPPORTED;
+
+    OcPipelineStream* stream = (OcPipelineStream*)calloc(1, sizeof(OcPipelineStream));
+    if (stream == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    OC_STATUS status = planJob(Pipeline, Width, Height, Channels, true, &stream->Job);
+    if (status != OC_STATUS_OK) {
+        freeJob(&stream->Job);
+        free(stream);
+        return status;
+    }
+    stream->Job.Stride = Width * Channels;
+    stream->Window = (unsigned char*)malloc((size_t)stream->Job.WindowRows * stream->Job.Stride);
+    if (stream->Window == NULL) {
+        freeJob(&stream->Job);
+        free(stream);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+
+    *Stream = stream;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularFreePipelineStream(OcPipelineStream** Stream) {
+    if (Stream == NULL || *Stream == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    freeJob(&(*Stream)->Job);
+    free((*Stream)->Window);
+    free(*Stream);
+    *Stream = NULL;
+
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineStreamGetWindow(const OcPipelineStream* Stream, int* InputRows) {
+    if (Stream == NULL || InputRows == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    *InputRows = Stream->Job.WindowRows;
+    return OC_STATUS_OK;
+}
+
+// First input row a later band reads
+static int firstInputRow(const OcPipelineStream* Stream) {
+    const PipelineJob* job = &Stream->Job;
+    if (Stream->NextRow == job->OutHeight)
+        return job->InHeight;
+    int RowBegin[OC_PIPELINE_MAX_STAGES + 1];
+    int RowEnd[OC_PIPELINE_MAX_STAGES + 1];
+    bandRows(job, Stream->NextRow, Stream->NextRow + 1, RowBegin, RowEnd);
+    return RowBegin[0];
+}
+
+OC_STATUS ocularPipelineStreamPush(OcPipelineStream* Stream, const unsigned char* Input, int Rows, int Stride, int* Accepted) {
+    if (Stream == NULL || Input == NULL || Accepted == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+
+    const PipelineJob* job = &Stream->Job;
+    if (Rows < 0 || Stride < job->Stride)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    // Rows no band reads, such as those a nearest neighbor downscale skips, are accepted without being kept
+    int skip = 0;
+    if (Stream->WindowBegin == Stream->WindowEnd) {
+        skip = min(Rows, max(firstInputRow(Stream) - Stream->WindowEnd, 0));
+        Stream->WindowEnd += skip;
+        Stream->WindowBegin = Stream->WindowEnd;
+    }
+
+    // Take what fits in the window and is still part of the image
+    int held = Stream->WindowEnd - Stream->WindowBegin;
+    int count = min(Rows - skip, min(job->WindowRows - held, job->InHeight - Stream->WindowEnd));
+    copyRows(Input + (size_t)skip * Stride, Stride, Stream->Window + (size_t)held * job->Stride, job->Stride, job->Stride, count);
+    Stream->WindowEnd += count;
+    *Accepted = skip + count;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularPipelineStreamPull(OcPipelineStream* Stream, unsigned char* Output, int MaxRows, int dstStride, int* Rows) {
+    if (Stream == NULL || Output == NULL || Rows == NULL)
+        return OC_STATUS_ERR_NULLREFERENCE;
+    if (MaxRows < 0 || dstStride <= 0)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    PipelineJob* job = &Stream->Job;
+    int RowBegin[OC_PIPELINE_MAX_STAGES + 1];
+    int RowEnd[OC_PIPELINE_MAX_STAGES + 1];
+
+    // Output rows whose bands only read input rows already pushed
+    int y0 = Stream->NextRow;
+    int limit = min(y0 + MaxRows, job->OutHeight);
+    int y1 = y0;
+    while (y1 < limit) {
+        int end = min(y1 + job->BandRows, limit);
+        bandRows(job, y1, end, RowBegin, RowEnd);
+        if (RowEnd[0] > Stream->WindowEnd)
+            break;
+        y1 = end;
+    }
+    *Rows = y1 - y0;
+    if (y1 == y0)
+        return OC_STATUS_OK;
+
+    if (job->NumPasses == 0) {
+        copyRows(Stream->Window + (size_t)(y0 - Stream->WindowBegin) * job->Stride, job->Stride, Output, dstStride, job->Stride, y1 - y0);
+    } else {
+        job->Input = Stream->Window;
+        job->InputRow = Stream->WindowBegin;
+        job->Output = Output;
+        job->OutputRow = y0;
+        job->dstStride = dstStride;
+        job->FirstRow = y0;
+        job->LastRow = y1;
+        OC_STATUS status = runJob(job);
+        if (status != OC_STATUS_OK) {
+            *Rows = 0;
+            return status;
+        }
+    }
+    Stream->NextRow = y1;
+
+    // Drop the input rows no later band reads
+    int keep = min(firstInputRow(Stream), Stream->WindowEnd);
+    if (keep > Stream->WindowBegin) {
+        memmove(Stream->Window, Stream->Window + (size_t)(keep - Stream->WindowBegin) * job->Stride,
+                (size_t)(Stream->WindowEnd - keep) * job->Stride);
+        Stream->WindowBegin = keep;
+    }
+    return OC_STATUS_OK;
+}
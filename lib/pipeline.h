@@ -0,0 +1,259 @@
+/**
+ * @file: pipeline.h
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Multi-stage filter pipelines that run a whole chain of filters in a single banded pass.
+ *
+ * Stages are added in order and run when ocularPipelineRun() is called. Adjacent lookup table stages (levels, curves, gamma,
+ * brightness/contrast) are composed into one table when they are added, and every run of point stages is applied row by row
+ * in the same pass. The output is produced in bands of rows small enough to stay in cache; each band pulls only the input
+ * rows it needs through the chain, including the halo rows of neighborhood stages, so intermediate images are never
+ * materialized. Bands are processed in parallel.
+ *
+ * A pipeline can also run as a stream over images too large to hold in memory: the caller pushes strips of input rows and
+ * pulls strips of output rows, and the stream only keeps the input rows that the next band still needs.
+ */
+
+#ifndef OCULAR_PIPELINE_H
+#define OCULAR_PIPELINE_H
+
+#include "core.h"
+#include "curves.h"
+
+/** Maximum number of stages a pipeline can hold. */
+#define OC_PIPELINE_MAX_STAGES 32
+
+/** @brief Opaque filter pipeline, created with ocularCreatePipeline(). */
+typedef struct OcPipeline OcPipeline;
+
+/** @brief Opaque streaming run of a pipeline, created with ocularCreatePipelineStream(). */
+typedef struct OcPipelineStream OcPipelineStream;
+
+/**
+ * @brief Creates an empty pipeline. An empty pipeline copies its input.
+ * @ingroup group_ip_general
+ * @param[out] Pipeline The returned pipeline, released with ocularFreePipeline().
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularCreatePipeline(OcPipeline** Pipeline);
+
+/**
+ * @brief Releases a pipeline and its stages.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to release; set to NULL on return.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularFreePipeline(OcPipeline** Pipeline);
+
+/**
+ * @brief Adds a per-channel lookup table stage. Single channel images use TableR only; alpha is copied through.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param TableR The 256 entry table for the red (or only) channel.
+ * @param TableG The 256 entry table for the green channel.
+ * @param TableB The 256 entry table for the blue channel.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddLookup(OcPipeline* Pipeline, const unsigned char* TableR, const unsigned char* TableG, const unsigned char* TableB);
+
+/**
+ * @brief Adds a stage equivalent to ocularLevelsFilter(). NULL parameters leave the channel unchanged.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param redLevelParams The red channel parameters for min, mid, max and output values.
+ * @param greenLevelParams The green channel parameters for min, mid, max and output values.
+ * @param blueLevelParams The blue channel parameters for min, mid, max and output values.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddLevels(OcPipeline* Pipeline, const ocularLevelParams* redLevelParams, const ocularLevelParams* greenLevelParams,
+                                  const ocularLevelParams* blueLevelParams);
+
+/**
+ * @brief Adds a stage equivalent to ocularCurvesFilter() without a luminance curve. NULL curves leave the channel unchanged.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param curveR Curve for the red channel, already built with curveBuild().
+ * @param curveG Curve for the green channel.
+ * @param curveB Curve for the blue channel.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddCurves(OcPipeline* Pipeline, const OcCurve* curveR, const OcCurve* curveG, const OcCurve* curveB);
+
+/**
+ * @brief Adds a stage equivalent to ocularGammaFilter().
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param gamma The gamma for the red, green and blue channels.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddGamma(OcPipeline* Pipeline, const float gamma[3]);
+
+/**
+ * @brief Adds a stage equivalent to ocularBrightnessAndContrastFilter().
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param brightness The brightness adjustment (-1.0 to 1.0).
+ * @param contrast The contrast adjustment (-1.0 to 1.0).
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddBrightnessAndContrast(OcPipeline* Pipeline, float brightness, float contrast);
+
+/**
+ * @brief Adds a stage equivalent to ocularSaturationFilter(). Requires a 3 or 4 channel image.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param saturation The saturation (0.0 to 1.0).
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddSaturation(OcPipeline* Pipeline, float saturation);
+
+/**
+ * @brief Adds an unsharp mask stage using the blending of ocularUnsharpMaskFilter(). The blur is a true separable Gaussian
+ * truncated at 3 sigma with clamped edges, which a band can compute from its halo alone; the standalone filter uses a
+ * recursive approximation, so results differ somewhat for the same sigma.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param GaussianSigma The blur radius (0.1 to 200.0).
+ * @param intensity The sharpening strength (0.0 to 4.0).
+ * @param threshold The minimum luminance difference, as a percentage, that is fully sharpened (0.0 to 100.0).
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddUnsharpMask(OcPipeline* Pipeline, float GaussianSigma, float intensity, float threshold);
+
+/**
+ * @brief Adds a Gaussian blur stage. Like the unsharp mask stage, the blur is a true separable Gaussian truncated at 3 sigma
+ * with clamped edges, so results differ somewhat from ocularGaussianBlurFilter() for the same sigma.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param GaussianSigma The blur radius (0.1 to 200.0).
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddGaussianBlur(OcPipeline* Pipeline, float GaussianSigma);
+
+/**
+ * @brief Adds a stage equivalent to ocularBoxBlurFilter(), up to rounding.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param Radius The radius of the box in pixels, >= 0.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddBoxBlur(OcPipeline* Pipeline, int Radius);
+
+/**
+ * @brief Adds a stage equivalent to ocularErodeFilter().
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param Radius The radius of the square neighborhood in pixels, >= 0; 0 is taken as 1 like the filter does.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddErode(OcPipeline* Pipeline, int Radius);
+
+/**
+ * @brief Adds a stage equivalent to ocularDilateFilter().
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param Radius The radius of the square neighborhood in pixels, >= 0; 0 is taken as 1 like the filter does.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddDilate(OcPipeline* Pipeline, int Radius);
+
+/**
+ * @brief Adds a resampling stage equivalent to ocularResamplingFilter(). Later stages work at the new size.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to extend.
+ * @param newWidth The width of the resampled image.
+ * @param newHeight The height of the resampled image.
+ * @param InterpolationMode The interpolation method.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineAddResample(OcPipeline* Pipeline, int newWidth, int newHeight, OcInterpolationMode InterpolationMode);
+
+/**
+ * @brief Gets the size of the image the pipeline produces from an input of the given size.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to query.
+ * @param Width The width of the input image in pixels.
+ * @param Height The height of the input image in pixels.
+ * @param[out] newWidth The width of the output image.
+ * @param[out] newHeight The height of the output image.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineGetOutputSize(const OcPipeline* Pipeline, int Width, int Height, int* newWidth, int* newHeight);
+
+/**
+ * @brief Runs every stage of the pipeline over an image. Input and Output must not overlap.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to run.
+ * @param Input The image input data buffer.
+ * @param Width The width of the image in pixels.
+ * @param Height The height of the image in pixels.
+ * @param Stride The number of bytes in one row of pixels.
+ * @param Output The image output data buffer, sized as reported by ocularPipelineGetOutputSize().
+ * @param dstStride The number of bytes in one row of output pixels.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineRun(const OcPipeline* Pipeline, const unsigned char* Input, int Width, int Height, int Stride, unsigned char* Output,
+                            int dstStride);
+
+/**
+ * @brief Starts a streaming run of a pipeline over an image that is supplied and produced a strip of rows at a time. The
+ * stream holds at most ocularPipelineStreamGetWindow() input rows, plus the bands being processed, whatever the image
+ * height. The pipeline must not be changed or released while the stream is in use.
+ * @ingroup group_ip_general
+ * @param Pipeline The pipeline to run.
+ * @param Width The width of the input image in pixels.
+ * @param Height The height of the input image in pixels.
+ * @param Channels The number of interleaved channels, 1, 3 or 4.
+ * @param[out] Stream The returned stream, released with ocularFreePipelineStream().
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularCreatePipelineStream(const OcPipeline* Pipeline, int Width, int Height, int Channels, OcPipelineStream** Stream);
+
+/**
+ * @brief Releases a pipeline stream.
+ * @ingroup group_ip_general
+ * @param Stream The stream to release; set to NULL on return.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularFreePipelineStream(OcPipelineStream** Stream);
+
+/**
+ * @brief Gets the number of input rows a stream holds at most, which is also the most rows one push can need before
+ * output can be pulled. It follows from the vertical halo of every stage and the scale of the resampling stages.
+ * @ingroup group_ip_general
+ * @param Stream The stream to query.
+ * @param[out] InputRows The size of the input window in rows.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineStreamGetWindow(const OcPipelineStream* Stream, int* InputRows);
+
+/**
+ * @brief Supplies the next rows of the input image, top to bottom. The stream takes as many as fit in its window; pull
+ * output to make room for the rest.
+ * @ingroup group_ip_general
+ * @param Stream The stream to feed.
+ * @param Input The first of the rows to add.
+ * @param Rows The number of rows available at Input.
+ * @param Stride The number of bytes in one row of input pixels.
+ * @param[out] Accepted The number of rows the stream took, from the top of Input.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineStreamPush(OcPipelineStream* Stream, const unsigned char* Input, int Rows, int Stride, int* Accepted);
+
+/**
+ * @brief Produces the next rows of the output image, top to bottom, as far as the input pushed so far allows. Once the whole
+ * output, sized as reported by ocularPipelineGetOutputSize(), has been pulled, further calls return no rows.
+ * @ingroup group_ip_general
+ * @param Stream The stream to run.
+ * @param Output The buffer receiving the rows.
+ * @param MaxRows The most rows Output can hold.
+ * @param dstStride The number of bytes in one row of output pixels.
+ * @param[out] Rows The number of rows written, 0 when more input is needed.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularPipelineStreamPull(OcPipelineStream* Stream, unsigned char* Output, int MaxRows, int dstStride, int* Rows);
+
+#endif /* OCULAR_PIPELINE_H */
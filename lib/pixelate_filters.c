@@ -11,6 +11,7 @@
 #include "pixelate_filters.h"
 #include "core.h"
 #include "util.h"
+#include "workspace.h"
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -211,6 +212,9 @@ OC_STATUS ocularPointillizeFilter(unsigned char* input, unsigned char* output,
     }
     
     int channels = stride / width;
+    if (channels != 3 && channels != 4) {
+        return OC_STATUS_ERR_NOTSUPPORTED; // Dots are drawn in RGB
+    }
     
     // Fill output with specified background color
     for (int i = 0; i < height * stride; i += channels) {
@@ -460,11 +464,11 @@ OC_STATUS ocularFragmentFilter(unsigned char* Input, unsigned char* Output, int
     unsigned char* tempBuffer = NULL;
 
     if (Input == Output) {
-        tempBuffer = (unsigned char*)malloc(Height * Stride);
+        tempBuffer = (unsigned char*)ScratchAlloc((size_t)Height * Stride, false);
         if (tempBuffer == NULL) {
             return OC_STATUS_ERR_OUTOFMEMORY;
         }
-        memcpy(tempBuffer, Input, Height * Stride);
+        memcpy(tempBuffer, Input, (size_t)Height * Stride);
         source = tempBuffer;
     }
 
@@ -517,12 +521,17 @@ OC_STATUS ocularFragmentFilter(unsigned char* Input, unsigned char* Output, int
 
     // Free temporary buffer if allocated
     if (tempBuffer != NULL) {
-        free(tempBuffer);
+        ScratchFree(tempBuffer);
     }
 
     return OC_STATUS_OK;
 }
 
+size_t fragmentScratchSize(int Height, int Stride) {
+    // The copy of the input when filtering in place
+    return ScratchBlockSize((size_t)Height * Stride);
+}
+
 // Hash table entry for cell lookup
 typedef struct HashEntry {
     int gridX, gridY;
@@ -559,14 +568,14 @@ static unsigned int gridHash(int gridX, int gridY, int tableSize) {
 
 // Create hash map
 static HashMap* createHashMap(int expectedCells) {
-    HashMap* map = (HashMap*)malloc(sizeof(HashMap));
+    HashMap* map = (HashMap*)ScratchAlloc(sizeof(HashMap), false);
     if (!map)
         return NULL;
 
     map->size = expectedCells * 2;
-    map->buckets = (HashEntry**)calloc(map->size, sizeof(HashEntry*));
+    map->buckets = (HashEntry**)ScratchAlloc(map->size * sizeof(HashEntry*), true);
     if (!map->buckets) {
-        free(map);
+        ScratchFree(map);
         return NULL;
     }
     return map;
@@ -575,7 +584,7 @@ static HashMap* createHashMap(int expectedCells) {
 // Add cell to hash map
 static void addToHashMap(HashMap* map, int gridX, int gridY, int cellIndex) {
     unsigned int idx = gridHash(gridX, gridY, map->size);
-    HashEntry* entry = (HashEntry*)malloc(sizeof(HashEntry));
+    HashEntry* entry = (HashEntry*)ScratchAlloc(sizeof(HashEntry), false);
     if (entry) {
         entry->gridX = gridX;
         entry->gridY = gridY;
@@ -607,12 +616,12 @@ static void freeHashMap(HashMap* map) {
         HashEntry* entry = map->buckets[i];
         while (entry) {
             HashEntry* next = entry->next;
-            free(entry);
+            ScratchFree(entry);
             entry = next;
         }
     }
-    free(map->buckets);
-    free(map);
+    ScratchFree(map->buckets);
+    ScratchFree(map);
 }
 
 // Generate random point in grid cell
@@ -651,7 +660,7 @@ OC_STATUS ocularCrystallizeFilter(unsigned char* input, unsigned char* output, i
     if (maxCellsNeeded < 1000)
         maxCellsNeeded = 1000;
 
-    WorleyCell* cells = (WorleyCell*)calloc(maxCellsNeeded, sizeof(WorleyCell));
+    WorleyCell* cells = (WorleyCell*)ScratchAlloc(maxCellsNeeded * sizeof(WorleyCell), true);
     int numActiveCells = 0;
 
     if (cells == NULL) {
@@ -661,7 +670,7 @@ OC_STATUS ocularCrystallizeFilter(unsigned char* input, unsigned char* output, i
     // Create hash map for O(1) lookups
     HashMap* cellMap = createHashMap(maxCellsNeeded);
     if (!cellMap) {
-        free(cells);
+        ScratchFree(cells);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -712,14 +721,14 @@ OC_STATUS ocularCrystallizeFilter(unsigned char* input, unsigned char* output, i
     int maxGridX = (int)(width / fCellSize) + 3;
     int maxGridY = (int)(height / fCellSize) + 3;
     int totalGridCells = maxGridX * maxGridY;
-    float* precomputedPointsX = (float*)malloc(totalGridCells * sizeof(float));
-    float* precomputedPointsY = (float*)malloc(totalGridCells * sizeof(float));
+    float* precomputedPointsX = (float*)ScratchAlloc(totalGridCells * sizeof(float), false);
+    float* precomputedPointsY = (float*)ScratchAlloc(totalGridCells * sizeof(float), false);
 
     if (!precomputedPointsX || !precomputedPointsY) {
-        free(precomputedPointsX);
-        free(precomputedPointsY);
+        ScratchFree(precomputedPointsX);
+        ScratchFree(precomputedPointsY);
         freeHashMap(cellMap);
-        free(cells);
+        ScratchFree(cells);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -850,10 +859,24 @@ OC_STATUS ocularCrystallizeFilter(unsigned char* input, unsigned char* output, i
     }
 
     // Clean up
-    free(precomputedPointsX);
-    free(precomputedPointsY);
+    ScratchFree(precomputedPointsX);
+    ScratchFree(precomputedPointsY);
     freeHashMap(cellMap);
-    free(cells);
+    ScratchFree(cells);
 
     return OC_STATUS_OK;
+}
+
+size_t crystallizeScratchSize(int Width, int Height, int cellSize) {
+    cellSize = clamp(cellSize, 3, 100);
+    int maxCellsNeeded = (int)((((Width / cellSize) + 3) * ((Height / cellSize) + 3)) * 1.5f);
+    if (maxCellsNeeded < 1000)
+        maxCellsNeeded = 1000;
+    // One hash entry per grid cell the pixels fall in
+    size_t gridCells = (size_t)((Width - 1) / cellSize + 1) * ((Height - 1) / cellSize + 1);
+    size_t entries = min(gridCells, (size_t)maxCellsNeeded);
+    size_t totalGridCells = (size_t)((Width / cellSize) + 3) * ((Height / cellSize) + 3);
+    return ScratchBlockSize((size_t)maxCellsNeeded * sizeof(WorleyCell)) + ScratchBlockSize(sizeof(HashMap)) +
+           ScratchBlockSize((size_t)maxCellsNeeded * 2 * sizeof(HashEntry*)) + entries * ScratchBlockSize(sizeof(HashEntry)) +
+           2 * ScratchBlockSize(totalGridCells * sizeof(float));
 }
\ No newline at end of file
@@ -55,7 +55,7 @@ OC_STATUS ocularMosaicFilter(const unsigned char* Input, unsigned char* Output,
  * @param output Output image buffer (must be different from input)
  * @param width Image width in pixels
  * @param height Image height in pixels
- * @param stride Row stride (typically width * channels)
+ * @param stride Row stride (width * 3 or width * 4; other channel counts are not supported)
  * @param cellSize Size of each cell in pixels (3-100)
  *                 Smaller values = more detailed, more dots
  *                 Larger values = more abstract, fewer larger dots
@@ -0,0 +1,266 @@
+/**
+ * @file: resample.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Separable resampling with precomputed fixed-point weights.
+ */
+
+#include "resample.h"
+#include "parallel.h"
+#include "simd.h"
+#include "util.h"
+#include "workspace.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Output rows per parallel band; each band filters the few source rows it shares with its neighbours again
+#define RESAMPLE_BAND_ROWS 64
+// Output rows per task of the pyramid reduction
+#define HALVE_GRAIN 16
+
+#define RESAMPLE_ONE (1 << RESAMPLE_WEIGHT_BITS)
+
+static double lanczos3Kernel(double x) {
+    x = fabs(x);
+    if (x < 1e-8)
+        return 1.0;
+    if (x >= 3.0)
+        return 0.0;
+    double px = M_PI * x;
+    return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+}
+
+// The Mitchell-Netravali family of cubics; B = 0, C = 0.5 is Catmull-Rom
+static double cubicKernel(double x, double B, double C) {
+    x = fabs(x);
+    if (x < 1.0)
+        return ((12.0 - 9.0 * B - 6.0 * C) * x * x * x + (-18.0 + 12.0 * B + 6.0 * C) * x * x + (6.0 - 2.0 * B)) / 6.0;
+    if (x < 2.0)
+        return ((-B - 6.0 * C) * x * x * x + (6.0 * B + 30.0 * C) * x * x + (-12.0 * B - 48.0 * C) * x + (8.0 * B + 24.0 * C)) / 6.0;
+    return 0.0;
+}
+
+static double kernelValue(OcInterpolationMode Mode, double x) {
+    switch (Mode) {
+        case OC_INTERPOLATE_BILINEAR: x = fabs(x); return x < 1.0 ? 1.0 - x : 0.0;
+        case OC_INTERPOLATE_BICUBIC: return cubicKernel(x, 0.0, 0.5);
+        case OC_INTERPOLATE_MITCHELL: return cubicKernel(x, 1.0 / 3.0, 1.0 / 3.0);
+        default: return lanczos3Kernel(x);
+    }
+}
+
+static double kernelRadius(OcInterpolationMode Mode) {
+    switch (Mode) {
+        case OC_INTERPOLATE_BILINEAR: return 1.0;
+        case OC_INTERPOLATE_BICUBIC:
+        case OC_INTERPOLATE_MITCHELL: return 2.0;
+        default: return 3.0;
+    }
+}
+
+static OC_STATUS allocateAxis(ResampleAxis* Axis, int SrcSize, int DstSize, int Taps) {
+    Axis->SrcSize = SrcSize;
+    Axis->DstSize = DstSize;
+    Axis->Taps = Taps;
+    Axis->Begin = (int*)ScratchAlloc((size_t)DstSize * sizeof(int), false);
+    Axis->Weights = (short*)ScratchAlloc((size_t)DstSize * Taps * sizeof(short), false);
+    if (Axis->Begin == NULL || Axis->Weights == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    return OC_STATUS_OK;
+}
+
+// Output sample i is centered on source position (i + 0.5) * SrcSize / DstSize. Taps beyond the edges fold onto the edge
+// samples, which repeats them.
+static OC_STATUS buildAxis(OcInterpolationMode Mode, int SrcSize, int DstSize, ResampleAxis* Axis) {
+    double scale = (double)SrcSize / DstSize;
+
+    // Nearest neighbour, and interpolating kernels at scale 1, pick a single sample
+    if (Mode == OC_INTERPOLATE_NEAREST || (SrcSize == DstSize && Mode != OC_INTERPOLATE_MITCHELL)) {
+        OC_STATUS status = allocateAxis(Axis, SrcSize, DstSize, 1);
+        if (status != OC_STATUS_OK)
+            return status;
+        for (int i = 0; i < DstSize; i++) {
+            Axis->Begin[i] = min((int)((i + 0.5) * scale), SrcSize - 1);
+            Axis->Weights[i] = RESAMPLE_ONE;
+        }
+        return OC_STATUS_OK;
+    }
+
+    // Stretch the kernel over the source when shrinking
+    double filterScale = scale > 1.0 ? scale : 1.0;
+    double support = kernelRadius(Mode) * filterScale;
+    int Taps = 1;
+    for (int i = 0; i < DstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int left = (int)floor(center - support - 0.5) + 1;
+        int right = (int)ceil(center + support - 0.5) - 1;
+        Taps = max(Taps, right - left + 1);
+    }
+    Taps = min(Taps, SrcSize);
+
+    OC_STATUS status = allocateAxis(Axis, SrcSize, DstSize, Taps);
+    if (status != OC_STATUS_OK)
+        return status;
+    double* Sums = (double*)ScratchAlloc(Taps * sizeof(double), false);
+    if (Sums == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    for (int i = 0; i < DstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int left = (int)floor(center - support - 0.5) + 1;
+        int right = (int)ceil(center + support - 0.5) - 1;
+        int begin = clamp(left, 0, SrcSize - Taps);
+        memset(Sums, 0, Taps * sizeof(double));
+        double total = 0.0;
+        for (int j = left; j <= right; j++) {
+            double weight = kernelValue(Mode, (j + 0.5 - center) / filterScale);
+            Sums[clamp(j, 0, SrcSize - 1) - begin] += weight;
+            total += weight;
+        }
+
+        // Quantize, then put the rounding error on the largest weight so the weights sum to exactly one
+        short* Weights = Axis->Weights + (size_t)i * Taps;
+        int sum = 0, largest = 0;
+        for (int t = 0; t < Taps; t++) {
+            Weights[t] = (short)lround(Sums[t] / total * RESAMPLE_ONE);
+            sum += Weights[t];
+            if (abs(Weights[t]) > abs(Weights[largest]))
+                largest = t;
+        }
+        Weights[largest] += RESAMPLE_ONE - sum;
+        Axis->Begin[i] = begin;
+    }
+    ScratchFree(Sums);
+    return OC_STATUS_OK;
+}
+
+OC_STATUS createResampler(OcInterpolationMode Mode, int Width, int Height, int newWidth, int newHeight, int Channels, Resampler* Resampler) {
+    memset(Resampler, 0, sizeof(*Resampler));
+    Resampler->Channels = Channels;
+    OC_STATUS status = buildAxis(Mode, Width, newWidth, &Resampler->Columns);
+    if (status != OC_STATUS_OK)
+        return status;
+    return buildAxis(Mode, Height, newHeight, &Resampler->Rows);
+}
+
+void freeResampler(Resampler* Resampler) {
+    ScratchFree(Resampler->Columns.Begin);
+    ScratchFree(Resampler->Columns.Weights);
+    ScratchFree(Resampler->Rows.Begin);
+    ScratchFree(Resampler->Rows.Weights);
+    memset(Resampler, 0, sizeof(*Resampler));
+}
+
+void resampleSourceRows(const Resampler* Resampler, int dstYBegin, int dstYEnd, int* srcYBegin, int* srcYEnd) {
+    *srcYBegin = Resampler->Rows.Begin[dstYBegin];
+    *srcYEnd = Resampler->Rows.Begin[dstYEnd - 1] + Resampler->Rows.Taps;
+}
+
+// Row stride in shorts of the ring of horizontally filtered rows; keeps every row 32-byte aligned
+static size_t ringStride(const Resampler* Resampler) {
+    return ((size_t)Resampler->Columns.DstSize * Resampler->Channels + 15) & ~(size_t)15;
+}
+
+size_t resampleWorkSize(const Resampler* Resampler) {
+    return (size_t)Resampler->Rows.Taps * (ringStride(Resampler) * sizeof(short) + sizeof(short*));
+}
+
+void resampleRows(const Resampler* Resampler, const unsigned char* Input, int Stride, int srcYBegin, unsigned char* Output, int dstStride,
+                  int dstYBegin, int dstYEnd, void* Work) {
+    const ResampleAxis* Columns = &Resampler->Columns;
+    const ResampleAxis* Rows = &Resampler->Rows;
+    const int Taps = Rows->Taps;
+    const size_t rowStride = ringStride(Resampler);
+    const int Count = Columns->DstSize * Resampler->Channels;
+    // Source row Y is filtered once into slot Y % Taps of the ring; the Taps rows an output row reads never share a slot
+    short* Ring = (short*)Work;
+    const short** Window = (const short**)(Ring + Taps * rowStride);
+
+    // Nearest neighbor picks pixels without weighting them
+    if (Columns->Taps == 1 && Taps == 1) {
+        int Channels = Resampler->Channels;
+        for (int Y = dstYBegin; Y < dstYEnd; Y++) {
+            const unsigned char* pInput = Input + (size_t)(Rows->Begin[Y] - srcYBegin) * Stride;
+            unsigned char* pOutput = Output + (size_t)(Y - dstYBegin) * dstStride;
+            for (int X = 0; X < Columns->DstSize; X++, pOutput += Channels) {
+                memcpy(pOutput, pInput + Columns->Begin[X] * Channels, Channels);
+            }
+        }
+        return;
+    }
+
+    int next = Rows->Begin[dstYBegin];
+    for (int Y = dstYBegin; Y < dstYEnd; Y++) {
+        int first = Rows->Begin[Y];
+        next = max(next, first);
+        for (; next < first + Taps; next++) {
+            simdResampleRow(Input + (size_t)(next - srcYBegin) * Stride, Ring + (size_t)(next % Taps) * rowStride, Columns->Begin,
+                            Columns->Weights, Columns->Taps, Columns->SrcSize, Columns->DstSize, Resampler->Channels);
+        }
+        for (int t = 0; t < Taps; t++) {
+            Window[t] = Ring + (size_t)((first + t) % Taps) * rowStride;
+        }
+        simdResampleColumns(Window, Rows->Weights + (size_t)Y * Taps, Taps, Output + (size_t)(Y - dstYBegin) * dstStride, Count);
+    }
+}
+
+typedef struct {
+    const Resampler* Resampler;
+    const unsigned char* Input;
+    int Stride;
+    unsigned char* Output;
+    int dstStride;
+    unsigned char* Work;
+    size_t WorkSize;
+} ResampleParams;
+
+static void resampleBands(void* Context, int Begin, int End, int Thread) {
+    const ResampleParams* p = (const ResampleParams*)Context;
+    int Height = p->Resampler->Rows.DstSize;
+    for (int band = Begin; band < End; band++) {
+        int y0 = band * RESAMPLE_BAND_ROWS;
+        int y1 = min(y0 + RESAMPLE_BAND_ROWS, Height);
+        resampleRows(p->Resampler, p->Input, p->Stride, 0, p->Output + (size_t)y0 * p->dstStride, p->dstStride, y0, y1,
+                     p->Work + Thread * p->WorkSize);
+    }
+}
+
+OC_STATUS resampleImage(const Resampler* Resampler, const unsigned char* Input, int Stride, unsigned char* Output, int dstStride) {
+    ResampleParams params = { Resampler, Input, Stride, Output, dstStride, NULL, (resampleWorkSize(Resampler) + 31) & ~(size_t)31 };
+    params.Work = (unsigned char*)ScratchAlloc(params.WorkSize * ocularGetThreadCount(), false);
+    if (params.Work == NULL)
+        return OC_STATUS_ERR_OUTOFMEMORY;
+
+    int numBands = (Resampler->Rows.DstSize + RESAMPLE_BAND_ROWS - 1) / RESAMPLE_BAND_ROWS;
+    ocularParallelFor(numBands, 1, resampleBands, &params);
+
+    ScratchFree(params.Work);
+    return OC_STATUS_OK;
+}
+
+typedef struct {
+    const unsigned char* Input;
+    int Stride;
+    unsigned char* Output;
+    int Width;
+    int Channels;
+} HalveParams;
+
+static void halveRows(void* Context, int Begin, int End, int Thread) {
+    const HalveParams* p = (const HalveParams*)Context;
+    (void)Thread;
+    size_t rowBytes = (size_t)p->Width * p->Channels;
+    for (int Y = Begin; Y < End; Y++) {
+        const unsigned char* Row0 = p->Input + (size_t)(2 * Y) * p->Stride;
+        simdHalveRow(Row0, Row0 + p->Stride, p->Output + Y * rowBytes, p->Width, p->Channels);
+    }
+}
+
+void halveImage(const unsigned char* Input, int Width, int Height, int Stride, int Channels, unsigned char* Output) {
+    HalveParams params = { Input, Stride, Output, Width / 2, Channels };
+    ocularParallelFor(Height / 2, HALVE_GRAIN, halveRows, &params);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file: resample.h
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Separable resampling engine behind ocularResamplingFilter() and the resampling stages of pipelines.
+ *
+ * Each axis gets a table of fixed-point weights, computed once per size: output sample i reads Taps consecutive source
+ * samples from Begin[i]. Pixel centers are aligned, so the image keeps its extent and does not shift. When shrinking, the
+ * kernel is stretched by the scale factor so every source pixel contributes and thumbnails do not alias. Rows are filtered
+ * horizontally into 16-bit intermediates, then columns vertically; the source rows an output band reads are known up front,
+ * so a band can be resampled without the rest of the image.
+ */
+
+#ifndef OCULAR_RESAMPLE_H
+#define OCULAR_RESAMPLE_H
+
+#include "core.h"
+#include <stddef.h>
+
+// Weights are Q14, intermediates Q6
+#define RESAMPLE_WEIGHT_BITS 14
+#define RESAMPLE_INTERMEDIATE_BITS 6
+
+typedef struct {
+    int SrcSize;
+    int DstSize;
+    int Taps;       // source samples per output sample
+    int* Begin;     // DstSize first source samples, non-decreasing and at most SrcSize - Taps
+    short* Weights; // DstSize * Taps weights summing to 1 << RESAMPLE_WEIGHT_BITS
+} ResampleAxis;
+
+typedef struct {
+    ResampleAxis Columns;
+    ResampleAxis Rows;
+    int Channels;
+} Resampler;
+
+// Internal use: builds the tables for resampling a Width x Height image to newWidth x newHeight, taking them from the
+// attached workspace. Released with freeResampler(), also after a failure.
+OC_STATUS createResampler(OcInterpolationMode Mode, int Width, int Height, int newWidth, int newHeight, int Channels, Resampler* Resampler);
+
+// Internal use: releases the tables of createResampler()
+void freeResampler(Resampler* Resampler);
+
+// Internal use: the source rows [*srcYBegin, *srcYEnd) read when producing output rows [dstYBegin, dstYEnd)
+void resampleSourceRows(const Resampler* Resampler, int dstYBegin, int dstYEnd, int* srcYBegin, int* srcYEnd);
+
+// Internal use: bytes of working memory resampleRows() needs
+size_t resampleWorkSize(const Resampler* Resampler);
+
+// Internal use: produces output rows [dstYBegin, dstYEnd) into Output, whose first row is dstYBegin. Input holds the source
+// rows reported by resampleSourceRows() starting at srcYBegin. Work is resampleWorkSize() bytes, 32-byte aligned.
+void resampleRows(const Resampler* Resampler, const unsigned char* Input, int Stride, int srcYBegin, unsigned char* Output, int dstStride,
+                  int dstYBegin, int dstYEnd, void* Work);
+
+// Internal use: resamples a whole image in parallel bands
+OC_STATUS resampleImage(const Resampler* Resampler, const unsigned char* Input, int Stride, unsigned char* Output, int dstStride);
+
+// Internal use: averages the 2x2 blocks of an image into the next level of a pyramid, Width / 2 x Height / 2 pixels with
+// rows packed. An odd last row or column is dropped.
+void halveImage(const unsigned char* Input, int Width, int Height, int Stride, int Channels, unsigned char* Output);
+
+#endif // OCULAR_RESAMPLE_H
@@ -1,4 +1,5 @@
 #include "retinex.h"
+#include "workspace.h"
 
 void retinex_scales_distribution(float* scales, int nscales, int mode, int s) {
     if (nscales == 1) { /* For one filter we choose the median scale */
@@ -101,8 +102,8 @@ void gausssmooth(float* in, float* out, int size, int rowstride, gauss3_coefs* c
     /* forward pass */
     bufferSize = size + 3;
     size -= 1;
-    w1 = (float*)malloc(bufferSize * sizeof(float));
-    w2 = (float*)malloc(bufferSize * sizeof(float));
+    w1 = (float*)ScratchAlloc(bufferSize * sizeof(float), false);
+    w2 = (float*)ScratchAlloc(bufferSize * sizeof(float), false);
     w1[0] = in[0];
     w1[1] = in[0];
     w1[2] = in[0];
@@ -117,6 +118,6 @@ void gausssmooth(float* in, float* out, int size, int rowstride, gauss3_coefs* c
         w2[n] = out[i * rowstride] = (float)(c->B * w1[n] + ((c->b[1] * w2[n + 1] + c->b[2] * w2[n + 2] + c->b[3] * w2[n + 3]) / c->b[0]));
     }
 
-    free(w1);
-    free(w2);
+    ScratchFree(w1);
+    ScratchFree(w2);
 }
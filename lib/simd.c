@@ -0,0 +1,744 @@
+/**
+ * @file: simd.c
+ * @author Warren Galyen
+ * Created: 10-16-2026
+ * Last Updated: 10-16-2026
+ * Last update: initial implementation
+ *
+ * @brief Runtime CPU feature detection and the vectorized row kernels shared by the point-operation filters.
+ * Every kernel is compiled with a per-function target attribute, so the library needs no global instruction set flags
+ * and still runs on CPUs without the extensions.
+ */
+
+#include "simd.h"
+#include "resample.h"
+#include "util.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define OC_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define OC_TARGET(isa)
+    #else
+        #define OC_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#else
+    #define OC_X86 0
+#endif
+
+// Integer luminance weights used by ocularGrayscaleFilter; they sum to 256.
+#define B_WT 29  // (int)(0.114 * 256 + 0.5)
+#define G_WT 150 // (int)(0.587 * 256 + 0.5)
+#define R_WT (256 - B_WT - G_WT)
+
+#if defined(_MSC_VER)
+    #define OcAtomicLoad(p) (*(volatile long*)(p))
+    #define OcAtomicStore(p, v) (*(volatile long*)(p) = (v))
+#else
+    #define OcAtomicLoad(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+    #define OcAtomicStore(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#endif
+
+// Read and written atomically, since any thread may be the first to ask for the level
+static long detectedLevel = -1;
+static long levelCap = OC_SIMD_AVX512;
+
+static OcSimdLevel detectSimdLevel(void) {
+#if OC_X86 && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        // ymm state must be enabled by the OS for AVX2, opmask and zmm state for AVX-512
+        avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+        avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (info[2] & (1 << 1)) != 0 && (xcr0 & 0xE6) == 0xE6;
+    }
+    if (avx512 && avx2)
+        return OC_SIMD_AVX512;
+    if (avx2)
+        return OC_SIMD_AVX2;
+    if (ssse3)
+        return OC_SIMD_SSSE3;
+    return OC_SIMD_NONE;
+#elif OC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vbmi"))
+        return OC_SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return OC_SIMD_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return OC_SIMD_SSSE3;
+    return OC_SIMD_NONE;
+#else
+    return OC_SIMD_NONE;
+#endif
+}
+
+OcSimdLevel ocularGetSimdLevel(void) {
+    // Detection is idempotent, so concurrent first calls at worst detect twice and store the same level
+    long level = OcAtomicLoad(&detectedLevel);
+    if (level < 0) {
+        level = (long)detectSimdLevel();
+        OcAtomicStore(&detectedLevel, level);
+    }
+    return (OcSimdLevel)min(level, OcAtomicLoad(&levelCap));
+}
+
+OC_STATUS ocularSetSimdLevel(OcSimdLevel Level) {
+    if (Level < OC_SIMD_NONE || Level > OC_SIMD_AVX512)
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+
+    OcAtomicStore(&levelCap, (long)Level);
+    return OC_STATUS_OK;
+}
+
+//--------------------------Grayscale--------------------------
+
+static void grayscaleRow_C(const unsigned char* Input, unsigned char* Output, int Width, int Channels, int X) {
+    const unsigned char* LinePS = Input + X * Channels;
+    for (; X < Width; X++, LinePS += Channels) {
+        Output[X] = (unsigned char)((B_WT * LinePS[0] + G_WT * LinePS[1] + R_WT * LinePS[2]) >> 8);
+    }
+}
+
+#if OC_X86
+
+// Weighted sum of four BGRX pixels, one 32-bit result per pixel.
+// Channels 0/2 and 1/3 are split into 16-bit words so pmaddwd applies two weights at once.
+OC_TARGET("ssse3")
+static inline __m128i grayscaleBGRX_SSE(__m128i Pixels) {
+    __m128i even = _mm_and_si128(Pixels, _mm_set1_epi16(0x00FF));
+    __m128i odd = _mm_srli_epi16(Pixels, 8);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(even, _mm_set1_epi32(B_WT | (R_WT << 16))), _mm_madd_epi16(odd, _mm_set1_epi32(G_WT)));
+    return _mm_srli_epi32(sum, 8);
+}
+
+OC_TARGET("ssse3")
+static int grayscaleRow_SSSE3(const unsigned char* Input, unsigned char* Output, int Width, int Channels) {
+    // Spreads four packed BGR pixels to BGRX
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i sum[4];
+    int X = 0;
+    if (Channels == 4) {
+        for (; X + 16 <= Width; X += 16) {
+            const unsigned char* LinePS = Input + X * 4;
+            for (int i = 0; i < 4; i++) {
+                sum[i] = grayscaleBGRX_SSE(_mm_loadu_si128((const __m128i*)(LinePS + i * 16)));
+            }
+            __m128i gray = _mm_packus_epi16(_mm_packs_epi32(sum[0], sum[1]), _mm_packs_epi32(sum[2], sum[3]));
+            _mm_storeu_si128((__m128i*)(Output + X), gray);
+        }
+    } else {
+        // The last load of a block reads 4 bytes past it, so stop while a full 16 bytes remain
+        for (; X + 18 <= Width; X += 16) {
+            const unsigned char* LinePS = Input + X * 3;
+            for (int i = 0; i < 4; i++) {
+                sum[i] = grayscaleBGRX_SSE(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(LinePS + i * 12)), expand));
+            }
+            __m128i gray = _mm_packus_epi16(_mm_packs_epi32(sum[0], sum[1]), _mm_packs_epi32(sum[2], sum[3]));
+            _mm_storeu_si128((__m128i*)(Output + X), gray);
+        }
+    }
+    return X;
+}
+
+OC_TARGET("avx2")
+static inline __m256i grayscaleBGRX_AVX2(__m256i Pixels) {
+    __m256i even = _mm256_and_si256(Pixels, _mm256_set1_epi16(0x00FF));
+    __m256i odd = _mm256_srli_epi16(Pixels, 8);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(even, _mm256_set1_epi32(B_WT | (R_WT << 16))),
+                                   _mm256_madd_epi16(odd, _mm256_set1_epi32(G_WT)));
+    return _mm256_srli_epi32(sum, 8);
+}
+
+OC_TARGET("avx2")
+static int grayscaleRow_AVX2(const unsigned char* Input, unsigned char* Output, int Width, int Channels) {
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    // The packs below work per 128-bit lane; this restores pixel order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i sum[4];
+    int X = 0;
+    if (Channels == 4) {
+        for (; X + 32 <= Width; X += 32) {
+            const unsigned char* LinePS = Input + X * 4;
+            for (int i = 0; i < 4; i++) {
+                sum[i] = grayscaleBGRX_AVX2(_mm256_loadu_si256((const __m256i*)(LinePS + i * 32)));
+            }
+            __m256i gray = _mm256_packus_epi16(_mm256_packs_epi32(sum[0], sum[1]), _mm256_packs_epi32(sum[2], sum[3]));
+            _mm256_storeu_si256((__m256i*)(Output + X), _mm256_permutevar8x32_epi32(gray, order));
+        }
+    } else {
+        for (; X + 34 <= Width; X += 32) {
+            const unsigned char* LinePS = Input + X * 3;
+            for (int i = 0; i < 4; i++) {
+                __m128i lo = _mm_loadu_si128((const __m128i*)(LinePS + i * 24));
+                __m128i hi = _mm_loadu_si128((const __m128i*)(LinePS + i * 24 + 12));
+                __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                sum[i] = grayscaleBGRX_AVX2(_mm256_shuffle_epi8(pixels, expand));
+            }
+            __m256i gray = _mm256_packus_epi16(_mm256_packs_epi32(sum[0], sum[1]), _mm256_packs_epi32(sum[2], sum[3]));
+            _mm256_storeu_si256((__m256i*)(Output + X), _mm256_permutevar8x32_epi32(gray, order));
+        }
+    }
+    return X;
+}
+
+#endif /* OC_X86 */
+
+void simdGrayscaleRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels) {
+    int X = 0;
+#if OC_X86
+    OcSimdLevel level = ocularGetSimdLevel();
+    if (level >= OC_SIMD_AVX2)
+        X = grayscaleRow_AVX2(Input, Output, Width, Channels);
+    else if (level >= OC_SIMD_SSSE3)
+        X = grayscaleRow_SSSE3(Input, Output, Width, Channels);
+#endif
+    grayscaleRow_C(Input, Output, Width, Channels, X);
+}
+
+//--------------------------Lookup tables--------------------------
+
+static void curveRow_C(const unsigned char* Input, unsigned char* Output, int Width, int Channels, const unsigned char* TableR,
+                       const unsigned char* TableG, const unsigned char* TableB) {
+    if (Channels == 1) {
+        for (int X = 0; X < Width; X++) {
+            Output[X] = TableR[Input[X]];
+        }
+        return;
+    }
+    for (int X = 0; X < Width; X++) {
+        Output[0] = TableR[Input[0]];
+        Output[1] = TableG[Input[1]];
+        Output[2] = TableB[Input[2]];
+        if (Channels == 4)
+            Output[3] = Input[3];
+        Input += Channels;
+        Output += Channels;
+    }
+}
+
+#if OC_X86
+
+// Looks up 64 bytes in a 256 entry table held in four registers: two 128 entry byte permutes, selected by bit 7 of the index.
+OC_TARGET("avx512f,avx512bw,avx512vbmi")
+static inline __m512i lookup256_AVX512(__m512i Index, const __m512i* Table) {
+    __m512i lo = _mm512_permutex2var_epi8(Table[0], Index, Table[1]);
+    __m512i hi = _mm512_permutex2var_epi8(Table[2], Index, Table[3]);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(Index), lo, hi);
+}
+
+OC_TARGET("avx512f,avx512bw,avx512vbmi")
+static void curveRow_AVX512(const unsigned char* Input, unsigned char* Output, int Width, int Channels, const unsigned char* TableR,
+                            const unsigned char* TableG, const unsigned char* TableB) {
+    const unsigned char* Tables[3] = { TableR, TableG, TableB };
+    __m512i table[3][4];
+    int numTables = Channels == 1 ? 1 : 3;
+    for (int t = 0; t < numTables; t++) {
+        for (int i = 0; i < 4; i++) {
+            table[t][i] = _mm512_loadu_si512((const void*)(Tables[t] + i * 64));
+        }
+    }
+
+    // Byte j of a block starting at byte offset Offset belongs to channel (Offset + j) % Channels.
+    // 64 is a multiple of 4 (and of 1), so only 3 channel rows need more than one phase.
+    __mmask64 channelMask[3][3] = { { 0 } };
+    int numPhases = Channels == 3 ? 3 : 1;
+    for (int phase = 0; phase < numPhases; phase++) {
+        for (int j = 0; j < 64; j++) {
+            int channel = (phase + j) % Channels;
+            if (channel < 3)
+                channelMask[phase][channel] |= (__mmask64)1 << j;
+        }
+    }
+
+    int length = Width * Channels;
+    int phase = 0;
+    for (int i = 0; i < length; i += 64) {
+        // Masked loads and stores cover the tail, so no scalar epilogue is needed
+        __mmask64 valid = length - i >= 64 ? ~(__mmask64)0 : ((__mmask64)1 << (length - i)) - 1;
+        __m512i index = _mm512_maskz_loadu_epi8(valid, Input + i);
+        __m512i result;
+        if (Channels == 1) {
+            result = lookup256_AVX512(index, table[0]);
+        } else {
+            result = index; // alpha passes through unchanged
+            for (int t = 0; t < 3; t++) {
+                result = _mm512_mask_mov_epi8(result, channelMask[phase][t], lookup256_AVX512(index, table[t]));
+            }
+            phase = (phase + 64) % numPhases;
+        }
+        _mm512_mask_storeu_epi8(Output + i, valid, result);
+    }
+}
+
+#endif /* OC_X86 */
+
+void simdCurveRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels, const unsigned char* TableR,
+                  const unsigned char* TableG, const unsigned char* TableB) {
+#if OC_X86
+    if (ocularGetSimdLevel() >= OC_SIMD_AVX512) {
+        curveRow_AVX512(Input, Output, Width, Channels, TableR, TableG, TableB);
+        return;
+    }
+#endif
+    curveRow_C(Input, Output, Width, Channels, TableR, TableG, TableB);
+}
+
+//--------------------------Sobel--------------------------
+
+// tan(22.5 degrees) in Q15, the rounding multiply used by pmulhrsw
+#define TAN_22_5_Q15 13573
+
+static void sobelRow_C(const unsigned char* Prev, const unsigned char* Cur, const unsigned char* Next, int* Magnitude,
+                       unsigned char* Octant, int Width, int X) {
+    for (; X < Width - 1; X++) {
+        int gx = (Prev[X + 1] - Prev[X - 1]) + 2 * (Cur[X + 1] - Cur[X - 1]) + (Next[X + 1] - Next[X - 1]);
+        int gy = (Prev[X - 1] + 2 * Prev[X] + Prev[X + 1]) - (Next[X - 1] + 2 * Next[X] + Next[X + 1]);
+        int ax = abs(gx), ay = abs(gy);
+        int notShallow = ay > ((ax * TAN_22_5_Q15 + 16384) >> 15);
+        int steep = ((ay * TAN_22_5_Q15 + 16384) >> 15) > ax;
+        Magnitude[X] = gx * gx + gy * gy;
+        Octant[X] = (unsigned char)(notShallow | (steep << 1) | (((gx ^ gy) < 0) << 2));
+    }
+}
+
+#if OC_X86
+
+OC_TARGET("ssse3")
+static int sobelRow_SSSE3(const unsigned char* Prev, const unsigned char* Cur, const unsigned char* Next, int* Magnitude,
+                          unsigned char* Octant, int Width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i tangent = _mm_set1_epi16(TAN_22_5_Q15);
+    int X = 1;
+    for (; X + 8 <= Width - 1; X += 8) {
+        __m128i p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Prev + X - 1)), zero);
+        __m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Prev + X)), zero);
+        __m128i p2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Prev + X + 1)), zero);
+        __m128i c0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Cur + X - 1)), zero);
+        __m128i c2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Cur + X + 1)), zero);
+        __m128i n0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Next + X - 1)), zero);
+        __m128i n1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Next + X)), zero);
+        __m128i n2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Next + X + 1)), zero);
+
+        __m128i centre = _mm_sub_epi16(c2, c0);
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(p2, p0), _mm_sub_epi16(n2, n0)), _mm_add_epi16(centre, centre));
+        __m128i top = _mm_add_epi16(_mm_add_epi16(p0, p2), _mm_add_epi16(p1, p1));
+        __m128i bottom = _mm_add_epi16(_mm_add_epi16(n0, n2), _mm_add_epi16(n1, n1));
+        __m128i gy = _mm_sub_epi16(top, bottom);
+
+        __m128i ax = _mm_abs_epi16(gx), ay = _mm_abs_epi16(gy);
+        __m128i notShallow = _mm_cmpgt_epi16(ay, _mm_mulhrs_epi16(ax, tangent));
+        __m128i steep = _mm_cmpgt_epi16(_mm_mulhrs_epi16(ay, tangent), ax);
+        __m128i opposite = _mm_srai_epi16(_mm_xor_si128(gx, gy), 15);
+        __m128i octant = _mm_or_si128(_mm_or_si128(_mm_and_si128(notShallow, _mm_set1_epi16(1)), _mm_and_si128(steep, _mm_set1_epi16(2))),
+                                      _mm_and_si128(opposite, _mm_set1_epi16(4)));
+        _mm_storel_epi64((__m128i*)(Octant + X), _mm_packus_epi16(octant, octant));
+
+        // gx * gx + gy * gy for each interleaved pair
+        __m128i lo = _mm_unpacklo_epi16(gx, gy), hi = _mm_unpackhi_epi16(gx, gy);
+        _mm_storeu_si128((__m128i*)(Magnitude + X), _mm_madd_epi16(lo, lo));
+        _mm_storeu_si128((__m128i*)(Magnitude + X + 4), _mm_madd_epi16(hi, hi));
+    }
+    return X;
+}
+
+OC_TARGET("avx2")
+static inline __m256i loadWords_AVX2(const unsigned char* Src) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)Src));
+}
+
+OC_TARGET("avx2")
+static int sobelRow_AVX2(const unsigned char* Prev, const unsigned char* Cur, const unsigned char* Next, int* Magnitude,
+                         unsigned char* Octant, int Width) {
+    const __m256i tangent = _mm256_set1_epi16(TAN_22_5_Q15);
+    int X = 1;
+    for (; X + 16 <= Width - 1; X += 16) {
+        __m256i p0 = loadWords_AVX2(Prev + X - 1), p1 = loadWords_AVX2(Prev + X), p2 = loadWords_AVX2(Prev + X + 1);
+        __m256i c0 = loadWords_AVX2(Cur + X - 1), c2 = loadWords_AVX2(Cur + X + 1);
+        __m256i n0 = loadWords_AVX2(Next + X - 1), n1 = loadWords_AVX2(Next + X), n2 = loadWords_AVX2(Next + X + 1);
+
+        __m256i centre = _mm256_sub_epi16(c2, c0);
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(p2, p0), _mm256_sub_epi16(n2, n0)), _mm256_add_epi16(centre, centre));
+        __m256i top = _mm256_add_epi16(_mm256_add_epi16(p0, p2), _mm256_add_epi16(p1, p1));
+        __m256i bottom = _mm256_add_epi16(_mm256_add_epi16(n0, n2), _mm256_add_epi16(n1, n1));
+        __m256i gy = _mm256_sub_epi16(top, bottom);
+
+        __m256i ax = _mm256_abs_epi16(gx), ay = _mm256_abs_epi16(gy);
+        __m256i notShallow = _mm256_cmpgt_epi16(ay, _mm256_mulhrs_epi16(ax, tangent));
+        __m256i steep = _mm256_cmpgt_epi16(_mm256_mulhrs_epi16(ay, tangent), ax);
+        __m256i opposite = _mm256_srai_epi16(_mm256_xor_si256(gx, gy), 15);
+        __m256i octant = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(notShallow, _mm256_set1_epi16(1)),
+                                                         _mm256_and_si256(steep, _mm256_set1_epi16(2))),
+                                         _mm256_and_si256(opposite, _mm256_set1_epi16(4)));
+        __m128i codes = _mm_packus_epi16(_mm256_castsi256_si128(octant), _mm256_extracti128_si256(octant, 1));
+        _mm_storeu_si128((__m128i*)(Octant + X), codes);
+
+        // The unpacks work per 128-bit lane; putting quadwords in 0, 2, 1, 3 order keeps the pixels in order
+        gx = _mm256_permute4x64_epi64(gx, 0xD8);
+        gy = _mm256_permute4x64_epi64(gy, 0xD8);
+        __m256i lo = _mm256_unpacklo_epi16(gx, gy), hi = _mm256_unpackhi_epi16(gx, gy);
+        _mm256_storeu_si256((__m256i*)(Magnitude + X), _mm256_madd_epi16(lo, lo));
+        _mm256_storeu_si256((__m256i*)(Magnitude + X + 8), _mm256_madd_epi16(hi, hi));
+    }
+    return X;
+}
+
+#endif /* OC_X86 */
+
+void simdSobelRow(const unsigned char* Prev, const unsigned char* Cur, const unsigned char* Next, int* Magnitude, unsigned char* Octant,
+                  int Width) {
+    int X = 1;
+#if OC_X86
+    OcSimdLevel level = ocularGetSimdLevel();
+    if (level >= OC_SIMD_AVX2)
+        X = sobelRow_AVX2(Prev, Cur, Next, Magnitude, Octant, Width);
+    else if (level >= OC_SIMD_SSSE3)
+        X = sobelRow_SSSE3(Prev, Cur, Next, Magnitude, Octant, Width);
+#endif
+    sobelRow_C(Prev, Cur, Next, Magnitude, Octant, Width, X);
+}
+
+//--------------------------Resampling--------------------------
+
+#define HORIZONTAL_SHIFT (RESAMPLE_WEIGHT_BITS - RESAMPLE_INTERMEDIATE_BITS)
+#define RESAMPLE_SHIFT (RESAMPLE_WEIGHT_BITS + RESAMPLE_INTERMEDIATE_BITS)
+
+static inline void resampleRowOf(const unsigned char* Input, short* Output, const int* Begin, const short* Weights, int Taps, int newWidth,
+                                 int Channels, int X) {
+    Weights += (size_t)X * Taps;
+    Output += X * Channels;
+    for (; X < newWidth; X++, Weights += Taps, Output += Channels) {
+        const unsigned char* pInput = Input + Begin[X] * Channels;
+        int Sum[4] = { 0, 0, 0, 0 };
+        for (int t = 0; t < Taps; t++, pInput += Channels) {
+            int weight = Weights[t];
+            for (int c = 0; c < Channels; c++) {
+                Sum[c] += weight * pInput[c];
+            }
+        }
+        for (int c = 0; c < Channels; c++) {
+            Output[c] = (short)((Sum[c] + (1 << (HORIZONTAL_SHIFT - 1))) >> HORIZONTAL_SHIFT);
+        }
+    }
+}
+
+static void resampleRow_C(const unsigned char* Input, short* Output, const int* Begin, const short* Weights, int Taps, int newWidth,
+                          int Channels, int X) {
+    switch (Channels) {
+        case 1: resampleRowOf(Input, Output, Begin, Weights, Taps, newWidth, 1, X); break;
+        case 2: resampleRowOf(Input, Output, Begin, Weights, Taps, newWidth, 2, X); break;
+        case 3: resampleRowOf(Input, Output, Begin, Weights, Taps, newWidth, 3, X); break;
+        default: resampleRowOf(Input, Output, Begin, Weights, Taps, newWidth, 4, X); break;
+    }
+}
+
+static void resampleColumns_C(const short* const* Rows, const short* Weights, int Taps, unsigned char* Output, int Count, int X) {
+    for (; X < Count; X++) {
+        int Sum = 1 << (RESAMPLE_SHIFT - 1);
+        for (int t = 0; t < Taps; t++) {
+            Sum += Weights[t] * Rows[t][X];
+        }
+        int Value = Sum >> RESAMPLE_SHIFT;
+        Output[X] = ClampToByte(Value);
+    }
+}
+
+#if OC_X86
+
+// Two weights packed for pmaddwd, which multiplies interleaved samples of two rows or pixels
+static inline int weightPair(const short* Weights, int t) {
+    return (int)(((unsigned int)(unsigned short)Weights[t + 1] << 16) | (unsigned short)Weights[t]);
+}
+
+// Loads two neighboring pixels, whose channels interleave after the shuffle. Reads 8 bytes.
+OC_TARGET("ssse3")
+static inline __m128i loadPixelPair_SSSE3(const unsigned char* Src, __m128i Interleave) {
+    return _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)Src), Interleave);
+}
+
+// 3 and 4 channel pixels, two taps at a time. Each pixel is stored as 4 words, so it stops one pixel short of the end of the
+// row, and where the 8 byte loads would read past the last pixel.
+OC_TARGET("ssse3")
+static int resampleRow_SSSE3(const unsigned char* Input, short* Output, const int* Begin, const short* Weights, int Taps, int Width,
+                             int newWidth, int Channels) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (HORIZONTAL_SHIFT - 1));
+    const __m128i interleave = Channels == 4 ? _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1)
+                                             : _mm_setr_epi8(0, 3, 1, 4, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i single = _mm_setr_epi8(0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3, -1, -1, -1);
+    int X = 0;
+    for (; X < newWidth - 1 && (Begin[X] + Taps) * Channels + 8 <= Width * Channels; X++) {
+        const unsigned char* pInput = Input + Begin[X] * Channels;
+        const short* pWeights = Weights + (size_t)X * Taps;
+        __m128i sum = round;
+        int t = 0;
+        for (; t + 2 <= Taps; t += 2, pInput += 2 * Channels) {
+            __m128i pair = _mm_unpacklo_epi8(loadPixelPair_SSSE3(pInput, interleave), zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, _mm_set1_epi32(weightPair(pWeights, t))));
+        }
+        if (t < Taps) {
+            __m128i pixel = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)pInput), single);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pixel, _mm_set1_epi32((unsigned short)pWeights[t])));
+        }
+        __m128i words = _mm_srai_epi32(sum, HORIZONTAL_SHIFT);
+        _mm_storel_epi64((__m128i*)(Output + X * Channels), _mm_packs_epi32(words, words));
+    }
+    return X;
+}
+
+OC_TARGET("ssse3")
+static int resampleColumns_SSSE3(const short* const* Rows, const short* Weights, int Taps, unsigned char* Output, int Count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (RESAMPLE_SHIFT - 1));
+    int X = 0;
+    for (; X + 8 <= Count; X += 8) {
+        __m128i lo = round, hi = round;
+        int t = 0;
+        for (; t + 2 <= Taps; t += 2) {
+            __m128i w = _mm_set1_epi32(weightPair(Weights, t));
+            __m128i a = _mm_loadu_si128((const __m128i*)(Rows[t] + X));
+            __m128i b = _mm_loadu_si128((const __m128i*)(Rows[t + 1] + X));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        if (t < Taps) {
+            __m128i w = _mm_set1_epi32((unsigned short)Weights[t]);
+            __m128i a = _mm_loadu_si128((const __m128i*)(Rows[t] + X));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), w));
+        }
+        __m128i words = _mm_packs_epi32(_mm_srai_epi32(lo, RESAMPLE_SHIFT), _mm_srai_epi32(hi, RESAMPLE_SHIFT));
+        _mm_storel_epi64((__m128i*)(Output + X), _mm_packus_epi16(words, words));
+    }
+    return X;
+}
+
+OC_TARGET("avx2")
+static int resampleColumns_AVX2(const short* const* Rows, const short* Weights, int Taps, unsigned char* Output, int Count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(1 << (RESAMPLE_SHIFT - 1));
+    int X = 0;
+    for (; X + 16 <= Count; X += 16) {
+        // The unpacks and packs work per 128-bit lane, so the samples come out in order
+        __m256i lo = round, hi = round;
+        int t = 0;
+        for (; t + 2 <= Taps; t += 2) {
+            __m256i w = _mm256_set1_epi32(weightPair(Weights, t));
+            __m256i a = _mm256_loadu_si256((const __m256i*)(Rows[t] + X));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(Rows[t + 1] + X));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        if (t < Taps) {
+            __m256i w = _mm256_set1_epi32((unsigned short)Weights[t]);
+            __m256i a = _mm256_loadu_si256((const __m256i*)(Rows[t] + X));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero), w));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero), w));
+        }
+        __m256i words = _mm256_packs_epi32(_mm256_srai_epi32(lo, RESAMPLE_SHIFT), _mm256_srai_epi32(hi, RESAMPLE_SHIFT));
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128((__m128i*)(Output + X), _mm256_castsi256_si128(bytes));
+    }
+    return X;
+}
+
+#endif /* OC_X86 */
+
+static void halveRow_C(const unsigned char* Row0, const unsigned char* Row1, unsigned char* Output, int Width, int Channels, int X) {
+    for (int i = X * Channels; i < Width * Channels; i++) {
+        int j = (i / Channels) * Channels + i;
+        Output[i] = (unsigned char)((Row0[j] + Row0[j + Channels] + Row1[j] + Row1[j + Channels] + 2) >> 2);
+    }
+}
+
+#if OC_X86
+
+// Sums horizontal pixel pairs of two rows as words: pshufb brings the channels of neighboring pixels together, pmaddubsw adds
+// them. 16 bytes are read from each row and 8 written, of which 2 pixels are valid for 3 channels.
+OC_TARGET("ssse3")
+static int halveRow_SSSE3(const unsigned char* Row0, const unsigned char* Row1, unsigned char* Output, int Width, int Channels) {
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i pairs;
+    if (Channels == 4)
+        pairs = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    else if (Channels == 3)
+        pairs = _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1);
+    else
+        pairs = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    int Step = Channels == 3 ? 2 : 8 / Channels;
+    int X = 0;
+    // The 8 byte stores stay within the output row, and so the 16 byte loads within the input rows
+    for (; X * Channels + 8 <= Width * Channels; X += Step) {
+        const unsigned char* p0 = Row0 + X * 2 * Channels;
+        const unsigned char* p1 = Row1 + X * 2 * Channels;
+        __m128i sum0 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p0), pairs), ones);
+        __m128i sum1 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p1), pairs), ones);
+        __m128i mean = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum0, sum1), two), 2);
+        _mm_storel_epi64((__m128i*)(Output + X * Channels), _mm_packus_epi16(mean, mean));
+    }
+    return X;
+}
+
+#endif /* OC_X86 */
+
+void simdHalveRow(const unsigned char* Row0, const unsigned char* Row1, unsigned char* Output, int Width, int Channels) {
+    int X = 0;
+#if OC_X86
+    if (Channels != 2 && ocularGetSimdLevel() >= OC_SIMD_SSSE3)
+        X = halveRow_SSSE3(Row0, Row1, Output, Width, Channels);
+#endif
+    halveRow_C(Row0, Row1, Output, Width, Channels, X);
+}
+
+void simdResampleRow(const unsigned char* Input, short* Output, const int* Begin, const short* Weights, int Taps, int Width, int newWidth,
+                     int Channels) {
+    int X = 0;
+#if OC_X86
+    if ((Channels == 3 || Channels == 4) && ocularGetSimdLevel() >= OC_SIMD_SSSE3)
+        X = resampleRow_SSSE3(Input, Output, Begin, Weights, Taps, Width, newWidth, Channels);
+#endif
+    resampleRow_C(Input, Output, Begin, Weights, Taps, newWidth, Channels, X);
+}
+
+void simdResampleColumns(const short* const* Rows, const short* Weights, int Taps, unsigned char* Output, int Count) {
+    int X = 0;
+#if OC_X86
+    OcSimdLevel level = ocularGetSimdLevel();
+    if (level >= OC_SIMD_AVX2)
+        X = resampleColumns_AVX2(Rows, Weights, Taps, Output, Count);
+    else if (level >= OC_SIMD_SSSE3)
+        X = resampleColumns_SSSE3(Rows, Weights, Taps, Output, Count);
+#endif
+    resampleColumns_C(Rows, Weights, Taps, Output, Count, X);
+}
+
+//--------------------------Bit packing--------------------------
+
+static void thresholdBitsRow_C(const unsigned char* Input, uint64_t* Output, int Width, int Threshold, int X) {
+    for (; X < Width; X += 64) {
+        int Count = min(64, Width - X);
+        uint64_t Bits = 0;
+        for (int i = 0; i < Count; i++) {
+            Bits |= (uint64_t)(Input[X + i] > Threshold) << i;
+        }
+        uint64_t Mask = Count == 64 ? ~(uint64_t)0 : ((uint64_t)1 << Count) - 1;
+        Output[X / 64] = (Output[X / 64] & ~Mask) | Bits;
+    }
+}
+
+#if OC_X86
+
+// There is no unsigned byte compare, so both sides are biased by 0x80 and compared signed
+OC_TARGET("ssse3")
+static int thresholdBitsRow_SSSE3(const unsigned char* Input, uint64_t* Output, int Width, int Threshold) {
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i limit = _mm_set1_epi8((char)(Threshold ^ 0x80));
+    int X = 0;
+    for (; X + 64 <= Width; X += 64) {
+        uint64_t Bits = 0;
+        for (int i = 0; i < 4; i++) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Input + X + i * 16)), bias);
+            Bits |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(v, limit)) << (i * 16);
+        }
+        Output[X / 64] = Bits;
+    }
+    return X;
+}
+
+OC_TARGET("avx2")
+static int thresholdBitsRow_AVX2(const unsigned char* Input, uint64_t* Output, int Width, int Threshold) {
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i limit = _mm256_set1_epi8((char)(Threshold ^ 0x80));
+    int X = 0;
+    for (; X + 64 <= Width; X += 64) {
+        __m256i lo = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(Input + X)), bias);
+        __m256i hi = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(Input + X + 32)), bias);
+        uint64_t Bits = (unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(lo, limit));
+        Bits |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(hi, limit)) << 32;
+        Output[X / 64] = Bits;
+    }
+    return X;
+}
+
+#endif /* OC_X86 */
+
+void simdThresholdBitsRow(const unsigned char* Input, uint64_t* Output, int Width, int Threshold) {
+    int X = 0;
+#if OC_X86
+    OcSimdLevel level = ocularGetSimdLevel();
+    if (level >= OC_SIMD_AVX2)
+        X = thresholdBitsRow_AVX2(Input, Output, Width, Threshold);
+    else if (level >= OC_SIMD_SSSE3)
+        X = thresholdBitsRow_SSSE3(Input, Output, Width, Threshold);
+#endif
+    thresholdBitsRow_C(Input, Output, Width, Threshold, X);
+}
+
+//--------------------------Layer blending--------------------------
+
+// The loops are plain C in 16-bit arithmetic, which the compiler vectorizes for whichever instruction set the enclosing
+// function targets; the division by 100 becomes a multiply-high.
+static inline void blendRowOf(unsigned char* Base, const unsigned char* Mix, int Count, int Alpha, OcBlendMode Mode) {
+    const unsigned short a = (unsigned short)Alpha, ia = (unsigned short)(100 - Alpha);
+    for (int i = 0; i < Count; i++) {
+        unsigned short b = Base[i];
+        unsigned short r = blendChannel(b, Mix[i], Mode);
+        Base[i] = (unsigned char)((unsigned short)(r * a + b * ia) / 100);
+    }
+}
+
+#define BLEND_ROW_CASE(Mode) \
+    case Mode: blendRowOf(Base, Mix, Count, Alpha, Mode); break;
+
+#define BLEND_ROW_SWITCH(Mode)                                                \
+    switch (Mode) {                                                           \
+        BLEND_ROW_CASE(OC_BLEND_DARKEN)                                       \
+        BLEND_ROW_CASE(OC_BLEND_MULTIPLY)                                     \
+        BLEND_ROW_CASE(OC_BLEND_LINEARBURN)                                   \
+        BLEND_ROW_CASE(OC_BLEND_LIGHTEN)                                      \
+        BLEND_ROW_CASE(OC_BLEND_SCREEN)                                       \
+        BLEND_ROW_CASE(OC_BLEND_LINEARDODGE)                                  \
+        BLEND_ROW_CASE(OC_BLEND_OVERLAY)                                      \
+        BLEND_ROW_CASE(OC_BLEND_HARDLIGHT)                                    \
+        BLEND_ROW_CASE(OC_BLEND_LINEARLIGHT)                                  \
+        BLEND_ROW_CASE(OC_BLEND_PINLIGHT)                                     \
+        BLEND_ROW_CASE(OC_BLEND_HARDMIX)                                      \
+        BLEND_ROW_CASE(OC_BLEND_DIFFERENCE)                                   \
+        BLEND_ROW_CASE(OC_BLEND_EXCLUSION)                                    \
+        BLEND_ROW_CASE(OC_BLEND_SUBTRACT)                                     \
+        default: blendRowOf(Base, Mix, Count, Alpha, OC_BLEND_NORMAL); break; \
+    }
+
+static void blendRow_C(unsigned char* Base, const unsigned char* Mix, int Count, OcBlendMode Mode, int Alpha) {
+    BLEND_ROW_SWITCH(Mode)
+}
+
+#if OC_X86
+
+OC_TARGET("avx2")
+static void blendRow_AVX2(unsigned char* Base, const unsigned char* Mix, int Count, OcBlendMode Mode, int Alpha) {
+    BLEND_ROW_SWITCH(Mode)
+}
+
+#endif /* OC_X86 */
+
+void simdBlendRow(unsigned char* Base, const unsigned char* Mix, int Count, OcBlendMode Mode, int Alpha) {
+#if OC_X86
+    if (ocularGetSimdLevel() >= OC_SIMD_AVX2) {
+        blendRow_AVX2(Base, Mix, Count, Mode, Alpha);
+        return;
+    }
+#endif
+    blendRow_C(Base, Mix, Count, Mode, Alpha);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file: simd.h
+ * @author Warren Galyen
+ * Created: 10-16-2026
+ * Last Updated: 10-16-2026
+ * Last update: initial implementation
+ *
+ * @brief Runtime CPU feature detection and the vectorized row kernels shared by the point-operation filters.
+ */
+
+#ifndef OCULAR_SIMD_H
+#define OCULAR_SIMD_H
+
+#include "core.h"
+#include "blend.h"
+#include <stdint.h>
+
+/**
+ * @enum OcSimdLevel
+ * @brief Instruction set extensions the row kernels can use. Each level implies the ones below it.
+ */
+typedef enum {
+    OC_SIMD_NONE = 0,   // portable C
+    OC_SIMD_SSSE3 = 1,  // SSE2 + pshufb deinterleave
+    OC_SIMD_AVX2 = 2,   // 256-bit integer kernels
+    OC_SIMD_AVX512 = 3, // AVX-512 BW + VBMI (byte permutes used for table lookups)
+} OcSimdLevel;
+
+/**
+ * @brief Gets the instruction set level the row kernels dispatch to.
+ * @ingroup group_ip_utility
+ * @return The detected level, lowered to the cap set with ocularSetSimdLevel().
+ */
+OcSimdLevel ocularGetSimdLevel(void);
+
+/**
+ * @brief Caps the instruction set level the row kernels may use, e.g. to compare kernels or work around a faulty CPU.
+ * The level actually used never exceeds what the CPU supports.
+ * @ingroup group_ip_utility
+ * @param Level The highest level to use; OC_SIMD_AVX512 removes the cap.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularSetSimdLevel(OcSimdLevel Level);
+
+// Converts one row of 3 or 4 channel pixels to luminance using the integer weights of ocularGrayscaleFilter.
+void simdGrayscaleRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels);
+
+// Maps one row through per-channel lookup tables (only TableR for single channel rows), copying alpha through.
+// Input and Output may point to the same row.
+void simdCurveRow(const unsigned char* Input, unsigned char* Output, int Width, int Channels, const unsigned char* TableR,
+                  const unsigned char* TableG, const unsigned char* TableB);
+
+// Computes the 3x3 Sobel gradient of row Cur for X in [1, Width - 1): the squared magnitude and an octant code that picks
+// the neighbors for non-maximum suppression. Bit 0 of the code is set when the gradient is more than 22.5 degrees off
+// horizontal, bit 1 when it is within 22.5 degrees of vertical and bit 2 when its components have opposite signs.
+// Entries 0 and Width - 1 are left untouched.
+void simdSobelRow(const unsigned char* Prev, const unsigned char* Cur, const unsigned char* Next, int* Magnitude, unsigned char* Octant,
+                  int Width);
+
+// Filters one row of 1 to 4 channel pixels horizontally into Q6 intermediates: output pixel X sums the Taps pixels from
+// Begin[X] weighted by the Q14 weights at Weights + X * Taps. Input holds Width pixels.
+void simdResampleRow(const unsigned char* Input, short* Output, const int* Begin, const short* Weights, int Taps, int Width, int newWidth,
+                     int Channels);
+
+// Averages the 2x2 blocks of two rows into Width pixels of 1 to 4 channels, rounding. The rows hold 2 * Width pixels.
+void simdHalveRow(const unsigned char* Row0, const unsigned char* Row1, unsigned char* Output, int Width, int Channels);
+
+// Sums Taps rows of Q6 intermediates weighted by Q14 weights into Count bytes, rounding and saturating. This is the
+// vertical pass of the resampler.
+void simdResampleColumns(const short* const* Rows, const short* Weights, int Taps, unsigned char* Output, int Count);
+
+// Packs one row of 8-bit pixels into bits, LSB first: bit X is set when Input[X] > Threshold, for Threshold in [0, 255].
+// Bits from Width on are left untouched.
+void simdThresholdBitsRow(const unsigned char* Input, uint64_t* Output, int Width, int Threshold);
+
+// Blends Count bytes of Mix into Base in one of the modes of blendChannel() (any other mode is taken as normal), mixing the
+// result with the base by Alpha percent like layerBlend(). The bytes may be the channels of any number of pixels.
+void simdBlendRow(unsigned char* Base, const unsigned char* Mix, int Count, OcBlendMode Mode, int Alpha);
+
+#endif /* OCULAR_SIMD_H */
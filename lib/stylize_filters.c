@@ -16,6 +16,7 @@
  #include "blend.h"
  #include "auxiliary.h"
  #include "noise.h"
+ #include "workspace.h"
  #include <math.h>
 
 OC_STATUS ocularOilPaintFilter(const unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int radius, int intensity) {
@@ -43,16 +44,16 @@ OC_STATUS ocularOilPaintFilter(const unsigned char* Input, unsigned char* Output
     const int CHUNK_SIZE = 32;
 
     // Allocate arrays on heap to prevent stack overflow
-    int* intensityCount = (int*)calloc(intensity, sizeof(int));
-    int* sumR = (int*)calloc(intensity, sizeof(int));
-    int* sumG = (int*)calloc(intensity, sizeof(int));
-    int* sumB = (int*)calloc(intensity, sizeof(int));
+    int* intensityCount = (int*)ScratchAlloc(intensity * sizeof(int), true);
+    int* sumR = (int*)ScratchAlloc(intensity * sizeof(int), true);
+    int* sumG = (int*)ScratchAlloc(intensity * sizeof(int), true);
+    int* sumB = (int*)ScratchAlloc(intensity * sizeof(int), true);
 
     if (!intensityCount || !sumR || !sumG || !sumB) {
-        free(intensityCount);
-        free(sumR);
-        free(sumG);
-        free(sumB);
+        ScratchFree(intensityCount);
+        ScratchFree(sumR);
+        ScratchFree(sumG);
+        ScratchFree(sumB);
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
@@ -141,14 +142,19 @@ OC_STATUS ocularOilPaintFilter(const unsigned char* Input, unsigned char* Output
     }
 
     // Clean up
-    free(intensityCount);
-    free(sumR);
-    free(sumG);
-    free(sumB);
+    ScratchFree(intensityCount);
+    ScratchFree(sumR);
+    ScratchFree(sumG);
+    ScratchFree(sumB);
 
     return OC_STATUS_OK;
 }
 
+size_t oilPaintScratchSize(void) {
+    // The histograms at the highest intensity
+    return 4 * ScratchBlockSize(100 * sizeof(int));
+}
+
 OC_STATUS ocularFrostedGlassEffect(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, int Radius, int Range) {
 
     if (Input == NULL || Output == NULL) {
@@ -214,7 +220,10 @@ OC_STATUS ocularFilmGrainEffect(unsigned char* input, unsigned char* output, int
     softness = clamp(softness, 0.0f, 25.0f);
 
     // Pre-calculate noise values for better performance
-    float* noiseValues = (float*)malloc(width * height * sizeof(float));
+    float* noiseValues = (float*)ScratchAlloc((size_t)width * height * sizeof(float), false);
+    if (noiseValues == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
     for (int i = 0; i < width * height; i++) {
         noiseValues[i] = (float)(rand() % 256) / 255.0f;
     }
@@ -257,11 +266,15 @@ OC_STATUS ocularFilmGrainEffect(unsigned char* input, unsigned char* output, int
         }
     }
 
-    free(noiseValues);
+    ScratchFree(noiseValues);
 
     return OC_STATUS_OK;
 }
 
+size_t filmGrainScratchSize(int Width, int Height) {
+    return ScratchBlockSize((size_t)Width * Height * sizeof(float));
+}
+
 OC_STATUS ocularReliefFilter(unsigned char* Input, unsigned char* Output, int Width, int Height, int Stride, float Angle, int Offset) {
     if (Input == NULL || Output == NULL)
         return OC_STATUS_ERR_NULLREFERENCE;
@@ -448,57 +461,37 @@ OC_STATUS ocularPortraitGlowFilter(const unsigned char* Input, unsigned char* Ou
             break;
     }
 
-    // Allocate temporary buffer for blurred image
-    size_t imageSize = (size_t)Height * Stride;
-    unsigned char* blurredImage = (unsigned char*)malloc(imageSize);
+    // Allocate temporary buffer for the unrounded blurred image
+    size_t rowFloats = (size_t)Width * Channels;
+    float* blurredImage = (float*)ScratchAlloc(rowFloats * Height * sizeof(float), false);
     if (blurredImage == NULL) {
         return OC_STATUS_ERR_OUTOFMEMORY;
     }
 
-    memcpy(blurredImage, Input, imageSize);
-
     // Apply Gaussian blur
     float sigma = (float)GlowRadius / 2.0f;
-    OC_STATUS blurStatus = ocularGaussianBlurFilter(blurredImage, blurredImage, Width, Height, Stride, sigma);
+    OC_STATUS blurStatus = gaussianBlurFloat(Input, blurredImage, Width, Height, Stride, sigma);
     if (blurStatus != OC_STATUS_OK) {
-        free(blurredImage);
+        ScratchFree(blurredImage);
         return blurStatus;
     }
 
-    // Apply exposure boost to blurred image
-    if (exposure != 0.0f) {
-        // Create exposure lookup table
-        unsigned char exposureMap[256] = { 0 };
-        for (int pixel = 0; pixel < 256; pixel++) {
-            exposureMap[pixel] = ClampToByte((float)pixel * pow(2.0, exposure));
-        }
-
-        // Apply exposure map to blurred image
-        for (int y = 0; y < Height; y++) {
-            unsigned char* pBlurred = blurredImage + (y * Stride);
-            for (int x = 0; x < Width; x++) {
-                pBlurred[0] = exposureMap[pBlurred[0]]; // R
-                pBlurred[1] = exposureMap[pBlurred[1]]; // G
-                pBlurred[2] = exposureMap[pBlurred[2]]; // B
-
-                pBlurred += Channels;
-            }
-        }
-    }
+    // Exposure boost is applied to the blurred image before it is rounded
+    float exposureGain = powf(2.0f, exposure);
 
     // Blend the blurred/exposed image with the original using the selected blend mode
     for (int y = 0; y < Height; y++) {
         const unsigned char* pInput = Input + (y * Stride);
-        const unsigned char* pBlurred = blurredImage + (y * Stride);
+        const float* pBlurred = blurredImage + y * rowFloats;
         unsigned char* pOutput = Output + (y * Stride);
 
         for (int x = 0; x < Width; x++) {
             int baseR = pInput[0];
             int baseG = pInput[1];
             int baseB = pInput[2];
-            int mixR = pBlurred[0];
-            int mixG = pBlurred[1];
-            int mixB = pBlurred[2];
+            int mixR = ClampToByte(pBlurred[0] * exposureGain + 0.5f);
+            int mixG = ClampToByte(pBlurred[1] * exposureGain + 0.5f);
+            int mixB = ClampToByte(pBlurred[2] * exposureGain + 0.5f);
 
             int resR, resG, resB;
             layerBlend(baseR, baseG, baseB, mixR, mixG, mixB, &resR, &resG, &resB, blendMode, Strength);
@@ -513,7 +506,7 @@ OC_STATUS ocularPortraitGlowFilter(const unsigned char* Input, unsigned char* Ou
         }
     }
 
-    free(blurredImage);
+    ScratchFree(blurredImage);
 
     return OC_STATUS_OK;
 }
@@ -2,7 +2,15 @@
 #include <math.h>
 #include <float.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "threshold.h"
+#include "parallel.h"
+#include "simd.h"
+#include "util.h"
+#include "workspace.h"
+
+// Minimum rows per band of the local thresholds; every band first sums the rows of its initial window
+#define LOCAL_THRESHOLD_GRAIN 32
 
 int GetMeanThreshold(int histogram[]) {
     int sum = 0, amount = 0;
@@ -552,3 +560,149 @@ bool isBimodal(int histogram[]) {
     else
         return false;
 }
+
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    OcImage* Bits;
+    int Width;
+    int Height;
+    int Stride;
+    LocalThresholdMethod Method;
+    int Radius;
+    float K;
+    unsigned char* Work;
+    size_t WorkSize;
+} LocalThresholdParams;
+
+// Thresholds a row given the prefix sums over its columns of the window sums and squared sums. invCount[X] is one over the
+// number of window pixels of X, the window being clipped to the image.
+static inline void localThresholdRowOf(const unsigned char* Input, unsigned char* Output, const uint64_t* Sum, const uint64_t* Squares,
+                                       const double* invCount, int Width, int Radius, float K, LocalThresholdMethod Method) {
+    for (int X = 0; X < Width; X++) {
+        int x0 = max(X - Radius, 0), x1 = min(X + Radius + 1, Width);
+        double mean = (double)(int64_t)(Sum[x1] - Sum[x0]) * invCount[X];
+        double threshold;
+        if (Method == LOCAL_THRESHOLD_BRADLEY) {
+            threshold = mean * (1.0 - K);
+        } else {
+            double variance = (double)(int64_t)(Squares[x1] - Squares[x0]) * invCount[X] - mean * mean;
+            double deviation = variance > 0.0 ? sqrt(variance) : 0.0;
+            if (Method == LOCAL_THRESHOLD_NIBLACK)
+                threshold = mean + K * deviation;
+            else
+                threshold = mean * (1.0 + K * (deviation / 128.0 - 1.0));
+        }
+        Output[X] = Input[X] > threshold ? 255 : 0;
+    }
+}
+
+static void localThresholdRows(void* Context, int Begin, int End, int Thread) {
+    const LocalThresholdParams* p = (const LocalThresholdParams*)Context;
+    int Width = p->Width, Radius = p->Radius;
+    uint64_t* Sum = (uint64_t*)(p->Work + Thread * p->WorkSize);
+    uint64_t* Squares = Sum + Width + 1;
+    uint64_t* columnSquares = Squares + Width + 1;
+    double* invCount = (double*)(columnSquares + Width);
+    unsigned int* columnSum = (unsigned int*)(invCount + Width);
+    unsigned char* Row = (unsigned char*)(columnSum + Width);
+
+    // Column sums of the rows [top, bottom) of the window, slid down one row at a time
+    int top = max(Begin - Radius, 0), bottom = top;
+    memset(columnSum, 0, Width * sizeof(unsigned int));
+    memset(columnSquares, 0, Width * sizeof(uint64_t));
+    Sum[0] = Squares[0] = 0;
+    int windowRows = 0;
+
+    for (int Y = Begin; Y < End; Y++) {
+        int y0 = max(Y - Radius, 0), y1 = min(Y + Radius + 1, p->Height);
+        // Once the window has reached its full height a row enters as one leaves, in a single pass
+        for (; bottom < y1 && top < y0; bottom++, top++) {
+            const unsigned char* pEnter = p->Input + (size_t)bottom * p->Stride;
+            const unsigned char* pLeave = p->Input + (size_t)top * p->Stride;
+            for (int X = 0; X < Width; X++) {
+                columnSum[X] += pEnter[X] - pLeave[X];
+                columnSquares[X] += pEnter[X] * pEnter[X] - pLeave[X] * pLeave[X];
+            }
+        }
+        for (; bottom < y1; bottom++) {
+            const unsigned char* pInput = p->Input + (size_t)bottom * p->Stride;
+            for (int X = 0; X < Width; X++) {
+                columnSum[X] += pInput[X];
+                columnSquares[X] += pInput[X] * pInput[X];
+            }
+        }
+        for (; top < y0; top++) {
+            const unsigned char* pInput = p->Input + (size_t)top * p->Stride;
+            for (int X = 0; X < Width; X++) {
+                columnSum[X] -= pInput[X];
+                columnSquares[X] -= pInput[X] * pInput[X];
+            }
+        }
+        for (int X = 0; X < Width; X++) {
+            Sum[X + 1] = Sum[X] + columnSum[X];
+            Squares[X + 1] = Squares[X] + columnSquares[X];
+        }
+        if (y1 - y0 != windowRows) {
+            windowRows = y1 - y0;
+            for (int X = 0; X < Width; X++) {
+                invCount[X] = 1.0 / ((double)(min(X + Radius + 1, Width) - max(X - Radius, 0)) * windowRows);
+            }
+        }
+
+        const unsigned char* pInput = p->Input + (size_t)Y * p->Stride;
+        unsigned char* pOutput = p->Output != NULL ? p->Output + (size_t)Y * p->Stride : Row;
+        switch (p->Method) {
+            case LOCAL_THRESHOLD_NIBLACK:
+                localThresholdRowOf(pInput, pOutput, Sum, Squares, invCount, Width, Radius, p->K, LOCAL_THRESHOLD_NIBLACK);
+                break;
+            case LOCAL_THRESHOLD_SAUVOLA:
+                localThresholdRowOf(pInput, pOutput, Sum, Squares, invCount, Width, Radius, p->K, LOCAL_THRESHOLD_SAUVOLA);
+                break;
+            default:
+                localThresholdRowOf(pInput, pOutput, Sum, Squares, invCount, Width, Radius, p->K, LOCAL_THRESHOLD_BRADLEY);
+                break;
+        }
+        if (p->Output == NULL)
+            simdThresholdBitsRow(Row, (uint64_t*)(p->Bits->Data + (size_t)Y * p->Bits->Stride), Width, 127);
+    }
+}
+
+OC_STATUS localThreshold(const unsigned char* Input, unsigned char* Output, OcImage* Bits, int Width, int Height, int Stride,
+                         LocalThresholdMethod Method, int Radius, float K) {
+    // Ensure filter specific parameters are within valid ranges
+    Radius = clamp(Radius, 1, max(Width, Height));
+
+    LocalThresholdParams params = { Input, Output, Bits, Width, Height, Stride, Method, Radius, K, NULL, 0 };
+    params.WorkSize =
+        ((size_t)(Width + 1) * 2 * sizeof(uint64_t) + (size_t)Width * (sizeof(uint64_t) + sizeof(double) + sizeof(unsigned int) + 1) + 31) &
+        ~(size_t)31;
+    params.Work = (unsigned char*)ScratchAlloc(params.WorkSize * ocularGetThreadCount(), false);
+    // Bands read the rows around them, so the input is kept apart when thresholding in place
+    unsigned char* Copy = NULL;
+    if (Input == Output) {
+        Copy = (unsigned char*)ScratchAlloc((size_t)Height * Stride, false);
+        if (Copy != NULL)
+            memcpy(Copy, Input, (size_t)Height * Stride);
+        params.Input = Copy;
+    }
+    if (params.Work == NULL || (Input == Output && Copy == NULL)) {
+        ScratchFree(params.Work);
+        ScratchFree(Copy);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+
+    ocularParallelFor(Height, max(LOCAL_THRESHOLD_GRAIN, 2 * Radius), localThresholdRows, &params);
+
+    ScratchFree(params.Work);
+    ScratchFree(Copy);
+    return OC_STATUS_OK;
+}
+
+size_t localThresholdScratchSize(int Width, int Height, int Stride) {
+    size_t workSize =
+        ((size_t)(Width + 1) * 2 * sizeof(uint64_t) + (size_t)Width * (sizeof(uint64_t) + sizeof(double) + sizeof(unsigned int) + 1) + 31) &
+        ~(size_t)31;
+    // Thresholding in place also copies the input
+    return ScratchBlockSize(workSize * ocularGetThreadCount()) + ScratchBlockSize((size_t)Height * Stride);
+}
@@ -12,6 +12,7 @@
 #ifndef OCULAR_THRESHOLD_H
 #define OCULAR_THRESHOLD_H
 
+#include "core.h"
 #include <stdbool.h>
 
 /**
@@ -163,5 +164,21 @@ float D(int histogram[], int index);
 // Check whether the histogram is bimodal
 bool isBimodal(int histogram[]);
 
+/**
+ * @enum LocalThresholdMethod
+ * @brief Locally adaptive thresholds, computed per pixel from the mean m and standard deviation s of its window.
+ */
+typedef enum {
+    LOCAL_THRESHOLD_NIBLACK = 0, // m + K * s
+    LOCAL_THRESHOLD_SAUVOLA = 1, // m * (1 + K * (s / 128 - 1))
+    LOCAL_THRESHOLD_BRADLEY = 2, // m * (1 - K)
+} LocalThresholdMethod;
+
+// Internal use: sets pixels above the threshold of their (2 * Radius + 1) square window, clipped to the image, to 255 and
+// the others to 0, or packs them into the OC_DEPTH_1U image Bits when Output is NULL. Window sums come from running column
+// sums and their row prefix sums, so the cost per pixel does not depend on the radius. Input may be Output.
+OC_STATUS localThreshold(const unsigned char* Input, unsigned char* Output, OcImage* Bits, int Width, int Height, int Stride,
+                         LocalThresholdMethod Method, int Radius, float K);
+
 
 #endif  /* OCULAR_THRESHOLD_H */
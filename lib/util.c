@@ -1,4 +1,7 @@
 #include "util.h"
+#include "parallel.h"
+#include "simd.h"
+#include "workspace.h"
 
 float vec2_distance(float vecX, float vecY, float otherX, float otherY) {
     float dx = vecX - otherX;
@@ -168,18 +171,78 @@ void CombineRGB(unsigned char* Blue, unsigned char* Green, unsigned char* Red, u
     }
 }
 
+typedef struct {
+    const unsigned char* Input;
+    unsigned char* Output;
+    int Width;
+    int Channels;
+    int Stride;
+    const unsigned char* TableR;
+    const unsigned char* TableG;
+    const unsigned char* TableB;
+} ApplyCurveParams;
+
+static void applyCurveRows(void* Context, int Begin, int End, int Thread) {
+    const ApplyCurveParams* p = (const ApplyCurveParams*)Context;
+    (void)Thread;
+    for (int y = Begin; y < End; y++) {
+        simdCurveRow(p->Input + y * p->Stride, p->Output + y * p->Stride, p->Width, p->Channels, p->TableR, p->TableG, p->TableB);
+    }
+}
+
 void applyCurve(unsigned char* input, unsigned char* output, int width, int height, int channels, int stride, unsigned char* TableR,
                 unsigned char* TableG, unsigned char* TableB) {
 
-    for (int y = 0; y < height; y++) {
-        unsigned char* scanIn = input + y * stride;
-        unsigned char* scanOut = output + y * stride;
-        for (int x = 0; x < width; x++) {
-            scanOut[0] = TableR[scanIn[0]];
-            scanOut[1] = TableG[scanIn[1]];
-            scanOut[2] = TableB[scanIn[2]];
-            scanIn += channels;
-            scanOut += channels;
+    ApplyCurveParams params = { input, output, width, channels, stride, TableR, TableG, TableB };
+    ocularParallelFor(height, 16, applyCurveRows, &params);
+}
+
+void unsharpMaskRow(const unsigned char* Input, const float* Blur, unsigned char* Output, int Width, int Channels, float intensity,
+                    float thresholdValue) {
+    for (int X = 0; X < Width; X++) {
+        // Calculate luminance delta for edge detection
+        float lumDelta = 0.0f;
+        if (Channels >= 3) {
+            // Calculate luminance for original and blurred using BT.709 coefficients
+            int idx = X * Channels;
+            float lumOrig = 0.2126f * Input[idx] + 0.7152f * Input[idx + 1] + 0.0722f * Input[idx + 2];
+            float lumBlur = 0.2126f * Blur[idx] + 0.7152f * Blur[idx + 1] + 0.0722f * Blur[idx + 2];
+            lumDelta = fabsf(lumOrig - lumBlur);
+        }
+
+        for (int c = 0; c < Channels; c++) {
+            int idx = X * Channels + c;
+
+            // Skip alpha channel if present
+            if (Channels == 4 && c == 3) {
+                Output[idx] = Input[idx];
+                continue;
+            }
+
+            // Calculate difference between original and blurred
+            float diff = Input[idx] - Blur[idx];
+
+            // For grayscale images, use direct difference as luminance delta
+            if (Channels == 1) {
+                lumDelta = fabsf(diff);
+            }
+
+            // Apply threshold with smooth transition based on luminance delta
+            if (lumDelta < thresholdValue) {
+                float thresholdFactor = lumDelta / thresholdValue;
+                diff *= thresholdFactor * thresholdFactor; // Smooth quadratic falloff
+            }
+
+            // Calculate sharpened value
+            int sharpened = Input[idx] + (int)(diff * intensity);
+            sharpened = clamp(sharpened, 0, 255);
+
+            // Calculate blend factor based on luminance delta
+            float blendFactor = lumDelta / 255.0f; // Normalize difference to 0-1 range
+            blendFactor = clamp(blendFactor * (intensity), 0.0f, 1.0f);
+
+            // Smooth blend between original and sharpened
+            Output[idx] = (unsigned char)(Input[idx] * (1.0f - blendFactor) + sharpened * blendFactor);
         }
     }
 }
@@ -350,36 +413,82 @@ int FindArrayMax(const unsigned int* Array, int numElements) {
     return N;
 }
 
-void FindMaxVote(unsigned int** VoteTable, int numAngles, int numDistances, int* M, int* N) {
-    unsigned int* maxVoteDiffAngles = (unsigned int*)malloc(numAngles * sizeof(unsigned int));
-
-    for (int i = 0; i < numAngles; i++) {
-        int j = FindArrayMax(VoteTable[i], numDistances);
-        maxVoteDiffAngles[i] = VoteTable[i][j];
+void FindMaxVote(const unsigned int* VoteTable, int numAngles, int numDistances, int* M, int* N) {
+    // The first maximum in angle-major order
+    size_t best = 0;
+    size_t count = (size_t)numAngles * numDistances;
+    for (size_t i = 1; i < count; i++) {
+        if (VoteTable[i] > VoteTable[best])
+            best = i;
+    }
+
+    *M = (int)(best / numDistances);
+    *N = (int)(best % numDistances);
+}
+
+typedef struct {
+    const int* pointX;
+    const int* pointY;
+    int numPoints;
+    float minAngle;
+    float angleInterval;
+    float minDistance;
+    float distanceInterval;
+    int numDistances;
+    unsigned int* voteTable;
+} HoughVoteParams;
+
+// Each band owns whole rows of the vote table, so the votes need no merging
+static void houghVoteRows(void* Context, int Begin, int End, int Thread) {
+    const HoughVoteParams* p = (const HoughVoteParams*)Context;
+    (void)Thread;
+    for (int i = Begin; i < End; i++) {
+        float angle = p->minAngle + p->angleInterval * ((float)i);
+        double cosAngle = cos(angle / 180 * M_PI);
+        double sinAngle = sin(angle / 180 * M_PI);
+        unsigned int* votes = p->voteTable + (size_t)i * p->numDistances;
+        for (int k = 0; k < p->numPoints; k++) {
+            float distance = p->pointX[k] * cosAngle + p->pointY[k] * sinAngle;
+            int j = (int)((distance - p->minDistance) / p->distanceInterval);
+            if (j >= 0 && j < p->numDistances) {
+                votes[j]++;
+            }
+        }
     }
-
-    *M = FindArrayMax(maxVoteDiffAngles, numAngles);
-    *N = FindArrayMax(VoteTable[*M], numDistances);
-
-    free(maxVoteDiffAngles);
 }
 
-void houghTransformLine(unsigned char* input, float minAngle, float angleInterval, int numAngles, float minDistance, float distanceInterval,
-                        int NumDistances, unsigned int** VoteTable, int width, int height) {
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            if (*(input + y * width + x) == 255) {
-                for (int i = 0; i < numAngles; i++) {
-                    float angle = minAngle + angleInterval * ((float)i);
-                    float distance = ((float)x) * cos(angle / 180 * M_PI) + ((float)y) * sin(angle / 180 * M_PI);
-                    int j = (int)((distance - minDistance) / distanceInterval);
-                    if (j < NumDistances) {
-                        VoteTable[i][j] = ((VoteTable[i][j]) + 1);
-                    }
-                }
+bool houghTransformLine(const unsigned char* input, float minAngle, float angleInterval, int numAngles, float minDistance, float distanceInterval,
+                        int NumDistances, unsigned int* VoteTable, int width, int height) {
+    // Gather the edge pixels in one pass, so the voting only visits them
+    int numPoints = 0;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        numPoints += (input[i] == 255);
+    }
+    int* pointX = (int*)ScratchAlloc(max(numPoints, 1) * sizeof(int), false);
+    int* pointY = (int*)ScratchAlloc(max(numPoints, 1) * sizeof(int), false);
+    if (pointX == NULL || pointY == NULL) {
+        ScratchFree(pointX);
+        ScratchFree(pointY);
+        return false;
+    }
+    int n = 0;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = input + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            if (row[x] == 255) {
+                pointX[n] = x;
+                pointY[n] = y;
+                n++;
             }
         }
     }
+
+    HoughVoteParams params = { pointX, pointY, numPoints, minAngle, angleInterval, minDistance, distanceInterval, NumDistances, VoteTable };
+    ocularParallelFor(numAngles, 1, houghVoteRows, &params);
+
+    ScratchFree(pointX);
+    ScratchFree(pointY);
+    return true;
 }
 
 void calculateNewSize(int Width, int Height, int* newWidth, int* newHeight, bool keepSize, float angle) {
@@ -576,19 +685,15 @@ void skinDenoise(unsigned char* input, unsigned char* output, int width, int hei
     if ((channels != 1) && (channels != 3))
         return;
     int windowSize = (2 * radius + 1) * (2 * radius + 1);
-    int* colPower = (int*)malloc(width * channels * sizeof(int));
-    int* colValue = (int*)malloc(width * channels * sizeof(int));
-    int* rowPos = (int*)malloc((width + radius + radius) * channels * sizeof(int));
-    int* colPos = (int*)malloc((height + radius + radius) * channels * sizeof(int));
+    int* colPower = (int*)ScratchAlloc((size_t)width * channels * sizeof(int), false);
+    int* colValue = (int*)ScratchAlloc((size_t)width * channels * sizeof(int), false);
+    int* rowPos = (int*)ScratchAlloc((size_t)(width + radius + radius) * channels * sizeof(int), false);
+    int* colPos = (int*)ScratchAlloc((size_t)(height + radius + radius) * channels * sizeof(int), false);
     if ((colPower == NULL) || (colValue == NULL) || (rowPos == NULL) || (colPos == NULL)) {
-        if (colPower)
-            free(colPower);
-        if (colValue)
-            free(colValue);
-        if (rowPos)
-            free(rowPos);
-        if (colPos)
-            free(colPos);
+        ScratchFree(colPower);
+        ScratchFree(colValue);
+        ScratchFree(rowPos);
+        ScratchFree(colPos);
         return;
     }
     int stride = width * channels;
@@ -669,14 +774,15 @@ void skinDenoise(unsigned char* input, unsigned char* output, int width, int hei
             scanOutLine += channels;
         }
     }
-    if (colPower)
-        free(colPower);
-    if (colValue)
-        free(colValue);
-    if (rowPos)
-        free(rowPos);
-    if (colPos)
-        free(colPos);
+    ScratchFree(colPower);
+    ScratchFree(colValue);
+    ScratchFree(rowPos);
+    ScratchFree(colPos);
+}
+
+size_t skinDenoiseScratchSize(int Width, int Height, int Channels, int Radius) {
+    return 2 * ScratchBlockSize((size_t)Width * Channels * sizeof(int)) + ScratchBlockSize((size_t)(Width + 2 * Radius) * Channels * sizeof(int)) +
+           ScratchBlockSize((size_t)(Height + 2 * Radius) * Channels * sizeof(int));
 }
 
 float calcWeight(const float weight, const float spatialContraDecay, const float diff) {
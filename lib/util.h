@@ -25,6 +25,12 @@
     #define DEPRECATED(msg)
 #endif
 
+#if defined(_MSC_VER)
+    #define OC_THREAD_LOCAL __declspec(thread)
+#else
+    #define OC_THREAD_LOCAL __thread
+#endif
+
 #ifndef clamp
     #define clamp(value, min, max) ((value) > (max) ? (max) : (value) < (min) ? (min) : (value))
 #endif
@@ -129,9 +135,15 @@ void SplitRGB(unsigned char* Src, unsigned char* Blue, unsigned char* Green, uns
 // Convert single-channel data to RGB data
 void CombineRGB(unsigned char* Blue, unsigned char* Green, unsigned char* Red, unsigned char* Dest, int Width, int Height, int Stride);
 
+// Map the first three channels through per-channel lookup tables (only TableR for single channel images),
+// copying alpha through. Rows are processed in parallel.
 void applyCurve(unsigned char* input, unsigned char* output, int width, int height, int channels, int stride, unsigned char* TableR,
                 unsigned char* TableG, unsigned char* TableB);
 
+// Blend one row of an unsharp mask from the original and its unrounded blurred copy. Output may alias Input.
+void unsharpMaskRow(const unsigned char* Input, const float* Blur, unsigned char* Output, int Width, int Channels, float intensity,
+                    float thresholdValue);
+
 void calculate_local_mean_deviation(const unsigned char* image, unsigned char* mean, int* deviation, int width, int height, int radius);
 
 void getLuminance(const unsigned char* input, unsigned char* output, int width, int height, int stride);
@@ -153,10 +165,12 @@ void zeroPadding(const unsigned char* input, unsigned char* output, int row, int
 
 int FindArrayMax(const unsigned int* Array, int numElements);
 
-void FindMaxVote(unsigned int** VoteTable, int numAngles, int numDistances, int* M, int* N);
+// Finds the cell of a flat numAngles x numDistances vote table with the most votes
+void FindMaxVote(const unsigned int* VoteTable, int numAngles, int numDistances, int* M, int* N);
 
-void houghTransformLine(unsigned char* input, float minAngle, float angleInterval, int numAngles, float minDistance, float distanceInterval,
-                        int NumDistances, unsigned int** VoteTable, int width, int height);
+// Adds the votes of every 255 pixel of a single channel image to a flat, angle-major vote table. Returns false when out of memory.
+bool houghTransformLine(const unsigned char* input, float minAngle, float angleInterval, int numAngles, float minDistance, float distanceInterval,
+                        int NumDistances, unsigned int* VoteTable, int width, int height);
 
 // calculates new image dimensions based on rotation angle
 void calculateNewSize(int Width, int Height, int* newWidth, int* newHeight, bool keepSize, float angle);
@@ -0,0 +1,329 @@
+/**
+ * @file: workspace.c
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Scratch arenas behind ScratchAlloc.
+ */
+
+#include "workspace.h"
+#include "util.h"
+#include <stdint.h>
+
+#define SCRATCH_ALIGN 32
+
+// Set on heap blocks, which are released to the heap rather than unwound from an arena
+#define SCRATCH_HEAP 1
+// Set on arena blocks released while blocks above them are still live
+#define SCRATCH_FREED 2
+
+// Precedes every block, padded so the block itself stays aligned
+typedef union {
+    struct {
+        OcWorkspace* Owner; // workspace charged for the block, NULL for heap blocks made without one
+        size_t Prev;        // arena offset of the block below
+        size_t Size;        // bytes taken, including this header
+        int Flags;
+    } Block;
+    unsigned char Align[SCRATCH_ALIGN];
+} ScratchHeader;
+
+struct OcWorkspace {
+    unsigned char* Buffer;
+    size_t Capacity;
+    size_t Top;             // offset past the highest live arena block
+    size_t Last;            // offset of the highest live arena block, valid while Top > 0
+    size_t Live;            // scratch bytes live, arena and heap
+    size_t Peak;            // largest Live seen
+    size_t HeapAllocations; // requests the arena could not hold
+};
+
+static OC_THREAD_LOCAL OcWorkspace* attachedWorkspace = NULL;
+
+size_t ScratchBlockSize(size_t Size) {
+    // Sizes too large to pad saturate instead of wrapping, and ScratchAlloc() refuses them
+    if (Size > SIZE_MAX - sizeof(ScratchHeader) - SCRATCH_ALIGN)
+        return SIZE_MAX;
+    return sizeof(ScratchHeader) + (Size + SCRATCH_ALIGN - 1) / SCRATCH_ALIGN * SCRATCH_ALIGN;
+}
+
+static bool resizeWorkspace(OcWorkspace* Workspace, size_t Capacity) {
+    FreeMemory(Workspace->Buffer);
+    Workspace->Buffer = (Capacity > 0) ? (unsigned char*)AllocMemory(Capacity, false) : NULL;
+    Workspace->Capacity = (Workspace->Buffer != NULL) ? Capacity : 0;
+    return Workspace->Buffer != NULL || Capacity == 0;
+}
+
+void* ScratchAlloc(size_t Size, bool ZeroMemory) {
+    OcWorkspace* ws = attachedWorkspace;
+    size_t blockSize = ScratchBlockSize(Size);
+    ScratchHeader* header = NULL;
+
+    if (blockSize == SIZE_MAX) {
+        return NULL;
+    }
+
+    if (ws != NULL) {
+        ws->Live += blockSize;
+        ws->Peak = max(ws->Peak, ws->Live);
+        // An empty arena grows to the largest demand seen so far, so the next run of the same filter fits entirely
+        if (ws->Top == 0 && ws->Capacity < ws->Peak) {
+            resizeWorkspace(ws, ws->Peak);
+        }
+        if (ws->Capacity - ws->Top >= blockSize) {
+            header = (ScratchHeader*)(ws->Buffer + ws->Top);
+            header->Block.Owner = ws;
+            header->Block.Prev = ws->Last;
+            header->Block.Size = blockSize;
+            header->Block.Flags = 0;
+            ws->Last = ws->Top;
+            ws->Top += blockSize;
+            if (ZeroMemory) {
+                memset(header + 1, 0, Size);
+            }
+            return header + 1;
+        }
+        ws->HeapAllocations++;
+    }
+
+    header = (ScratchHeader*)AllocMemory(blockSize, false);
+    if (header == NULL) {
+        if (ws != NULL)
+            ws->Live -= blockSize;
+        return NULL;
+    }
+    header->Block.Owner = ws;
+    header->Block.Prev = 0;
+    header->Block.Size = blockSize;
+    header->Block.Flags = SCRATCH_HEAP;
+    if (ZeroMemory) {
+        memset(header + 1, 0, Size);
+    }
+    return header + 1;
+}
+
+void ScratchFree(void* ptr) {
+    if (ptr == NULL)
+        return;
+
+    ScratchHeader* header = (ScratchHeader*)ptr - 1;
+    OcWorkspace* ws = header->Block.Owner;
+    if (ws != NULL)
+        ws->Live -= header->Block.Size;
+    if (header->Block.Flags & SCRATCH_HEAP) {
+        FreeMemory(header);
+        return;
+    }
+
+    header->Block.Flags |= SCRATCH_FREED;
+    // Unwind the top of the arena past every block that has been released
+    while (ws->Top > 0) {
+        ScratchHeader* top = (ScratchHeader*)(ws->Buffer + ws->Last);
+        if (!(top->Block.Flags & SCRATCH_FREED))
+            break;
+        ws->Top = ws->Last;
+        ws->Last = top->Block.Prev;
+    }
+}
+
+OC_STATUS ocularCreateWorkspace(size_t Capacity, OcWorkspace** Workspace) {
+    if (Workspace == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+
+    OcWorkspace* ws = (OcWorkspace*)calloc(1, sizeof(OcWorkspace));
+    if (ws == NULL) {
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    if (!resizeWorkspace(ws, Capacity)) {
+        free(ws);
+        return OC_STATUS_ERR_OUTOFMEMORY;
+    }
+    *Workspace = ws;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularFreeWorkspace(OcWorkspace** Workspace) {
+    if (Workspace == NULL || *Workspace == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+
+    OcWorkspace* ws = *Workspace;
+    if (ws->Live > 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+    if (attachedWorkspace == ws) {
+        attachedWorkspace = NULL;
+    }
+    FreeMemory(ws->Buffer);
+    free(ws);
+    *Workspace = NULL;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularAttachWorkspace(OcWorkspace* Workspace) {
+    attachedWorkspace = Workspace;
+    return OC_STATUS_OK;
+}
+
+OcWorkspace* ocularGetAttachedWorkspace(void) {
+    return attachedWorkspace;
+}
+
+OC_STATUS ocularGetWorkspaceUsage(const OcWorkspace* Workspace, size_t* Capacity, size_t* Peak, size_t* HeapAllocations) {
+    if (Workspace == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+
+    if (Capacity != NULL)
+        *Capacity = Workspace->Capacity;
+    if (Peak != NULL)
+        *Peak = Workspace->Peak;
+    if (HeapAllocations != NULL)
+        *HeapAllocations = Workspace->HeapAllocations;
+    return OC_STATUS_OK;
+}
+
+OC_STATUS ocularGetScratchSize(OcScratchFilter Filter, int Width, int Height, int Stride, int Radius, size_t* Size) {
+    if (Size == NULL) {
+        return OC_STATUS_ERR_NULLREFERENCE;
+    }
+    if (Width <= 0 || Height <= 0 || Stride <= 0) {
+        return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+
+    int Channels = Stride / Width;
+    // Filters clamp the radius to at least 1
+    Radius = max(Radius, 1);
+
+    switch (Filter) {
+        case OC_SCRATCH_MEDIAN_BLUR:
+            *Size = medianBlurScratchSize(Width, Height, Channels, Radius);
+            break;
+        case OC_SCRATCH_ERODE_DILATE:
+            *Size = rankRectangleScratchSize(Width, Height, Channels, Radius, Radius);
+            break;
+        case OC_SCRATCH_BILATERAL:
+            *Size = bilateralScratchSize(Width, Height, Channels);
+            break;
+        case OC_SCRATCH_MULTISCALE_RETINEX:
+            *Size = retinexScratchSize(Width, Height, Channels);
+            break;
+        case OC_SCRATCH_CONVOLUTION_2D:
+            *Size = convolution2DScratchSize(Width, Height, Channels, 2 * Radius + 1);
+            break;
+        case OC_SCRATCH_BOX_BLUR:
+            *Size = boxBlurScratchSize(Width, Height, Channels);
+            break;
+        case OC_SCRATCH_GAUSSIAN_BLUR:
+            *Size = gaussianBlurScratchSize(Width, Height, Channels);
+            break;
+        case OC_SCRATCH_EXPONENTIAL_BLUR:
+            *Size = exponentialBlurScratchSize(Width, Height, Channels, Radius);
+            break;
+        case OC_SCRATCH_SURFACE_BLUR:
+            *Size = surfaceBlurScratchSize(Width, Height, Channels, Radius);
+            break;
+        case OC_SCRATCH_ZOOM_BLUR:
+            *Size = zoomBlurScratchSize(Width, Height, Stride, Channels);
+            break;
+        case OC_SCRATCH_RADIAL_BLUR:
+            *Size = radialBlurScratchSize(Width, Height, Stride, Channels);
+            break;
+        case OC_SCRATCH_AVERAGE_BLUR:
+            *Size = averageBlurScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_MOTION_BLUR:
+            *Size = motionBlurScratchSize(Width, Height, Stride, Channels);
+            break;
+        case OC_SCRATCH_GUIDED_FILTER:
+            *Size = guidedFilterScratchSize(Width, Height, Radius);
+            break;
+        case OC_SCRATCH_DISTORTION:
+            *Size = distortionScratchSize(Height, Stride);
+            break;
+        case OC_SCRATCH_WAVE_DISTORTION:
+            *Size = waveDistortionScratchSize(Height, Stride);
+            break;
+        case OC_SCRATCH_LAPLACIAN_EDGE:
+            *Size = laplacianScratchSize(Width, Height, Radius);
+            break;
+        case OC_SCRATCH_CANNY_EDGE:
+            *Size = cannyScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_SOBEL_EDGE:
+            *Size = sobelScratchSize(Width);
+            break;
+        case OC_SCRATCH_GRADIENT_EDGE:
+            *Size = gradientScratchSize(Width, Channels);
+            break;
+        case OC_SCRATCH_ERODE_DILATE_SHAPE:
+            *Size = rankShapeScratchSize(Width, Height, Channels, Radius);
+            break;
+        case OC_SCRATCH_MIN_MAX:
+            *Size = rankDiskScratchSize(Width, Height, Stride, Channels, Radius);
+            break;
+        case OC_SCRATCH_SKELETONIZE:
+            *Size = skeletonizeScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_BINARY_MORPHOLOGY:
+            *Size = binaryRankScratchSize(Width, Height, Radius);
+            break;
+        case OC_SCRATCH_BINARY_SKELETONIZE:
+            *Size = binarySkeletonizeScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_FFT_FILTER:
+            *Size = fftFilterScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_FFT_VISUALIZE:
+            *Size = fftVisualizeScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_DESPECKLE:
+            *Size = despeckleScratchSize(Channels, Radius);
+            break;
+        case OC_SCRATCH_DOCUMENT_DESKEW:
+            *Size = documentDeskewScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_HOUGH_LINES:
+            *Size = houghLineScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_HAZE:
+            *Size = hazeFilterScratchSize(Height);
+            break;
+        case OC_SCRATCH_DARK_CHANNEL_PRIOR:
+            *Size = darkChannelPriorScratchSize(Width, Height, Radius);
+            break;
+        case OC_SCRATCH_AUTO_CONTRAST:
+            *Size = autoContrastScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_BACKLIGHT_REPAIR:
+            *Size = backlightRepairScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_BEEPS:
+            *Size = beepsScratchSize(Height, Stride);
+            break;
+        case OC_SCRATCH_POSTERIZE:
+            *Size = posterizeScratchSize(Width, Height, Channels);
+            break;
+        case OC_SCRATCH_ADAPTIVE_THRESHOLD:
+            *Size = localThresholdScratchSize(Width, Height, Stride);
+            break;
+        case OC_SCRATCH_OIL_PAINT:
+            *Size = oilPaintScratchSize();
+            break;
+        case OC_SCRATCH_FILM_GRAIN:
+            *Size = filmGrainScratchSize(Width, Height);
+            break;
+        case OC_SCRATCH_FRAGMENT:
+            *Size = fragmentScratchSize(Height, Stride);
+            break;
+        case OC_SCRATCH_CRYSTALLIZE:
+            *Size = crystallizeScratchSize(Width, Height, Radius);
+            break;
+        default:
+            return OC_STATUS_ERR_INVALIDPARAMETER;
+    }
+    return OC_STATUS_OK;
+}
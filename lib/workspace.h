@@ -0,0 +1,198 @@
+/**
+ * @file: workspace.h
+ * @author Warren Galyen
+ * Created: 10-17-2026
+ * Last Updated: 10-17-2026
+ * Last update: initial implementation
+ *
+ * @brief Reusable scratch arenas that let filters run without heap allocations in steady state.
+ *
+ * Filters take their temporary buffers from the workspace attached to the calling thread, falling back to the heap when
+ * none is attached. A workspace is a bump allocator: blocks are carved from one 32-byte aligned buffer and given back when
+ * the filter releases them. A request that does not fit is served from the heap and recorded, and the buffer grows to the
+ * recorded peak the next time it is empty, so after a warm-up call a stream of same-sized images allocates nothing.
+ */
+
+#ifndef OCULAR_WORKSPACE_H
+#define OCULAR_WORKSPACE_H
+
+#include <stddef.h>
+#include "core.h"
+
+/** @brief Opaque scratch arena, created with ocularCreateWorkspace(). */
+typedef struct OcWorkspace OcWorkspace;
+
+/**
+ * @enum OcScratchFilter
+ * @brief Filters whose scratch requirement ocularGetScratchSize() can report.
+ */
+typedef enum {
+    OC_SCRATCH_MEDIAN_BLUR = 0,          // ocularMedianBlur(), Radius as passed
+    OC_SCRATCH_ERODE_DILATE = 1,         // ocularErodeFilter() / ocularDilateFilter(), Radius as passed
+    OC_SCRATCH_BILATERAL = 2,            // ocularBilateralFilter(), Radius unused
+    OC_SCRATCH_MULTISCALE_RETINEX = 3,   // ocularMultiscaleRetinex(), Radius unused
+    OC_SCRATCH_CONVOLUTION_2D = 4,       // ocularConvolution2DFilter(), Radius is filterW / 2
+    OC_SCRATCH_BOX_BLUR = 5,             // ocularBoxBlurFilter(), Radius unused
+    OC_SCRATCH_GAUSSIAN_BLUR = 6,        // ocularGaussianBlurFilter(), ocularUnsharpMaskFilter(), ocularHighPassFilter(),
+                                         // ocularFrostedGlassEffect() and ocularPortraitGlowFilter(), Radius unused
+    OC_SCRATCH_EXPONENTIAL_BLUR = 7,     // ocularExponentialBlur(), Radius as passed
+    OC_SCRATCH_SURFACE_BLUR = 8,         // ocularSurfaceBlurFilter(), Radius as passed
+    OC_SCRATCH_ZOOM_BLUR = 9,            // ocularZoomBlur(), Radius unused
+    OC_SCRATCH_RADIAL_BLUR = 10,         // ocularRadialBlur(), Radius unused
+    OC_SCRATCH_AVERAGE_BLUR = 11,        // ocularAverageBlur(), Radius unused
+    OC_SCRATCH_MOTION_BLUR = 12,         // ocularMotionBlurFilter(), Radius unused
+    OC_SCRATCH_GUIDED_FILTER = 13,       // ocularGuidedFilter(), Radius as passed
+    OC_SCRATCH_DISTORTION = 14,          // ocularPinchDistortionFilter(), ocularTwirlDistortionFilter(), ocularRippleDistortionFilter(),
+                                         // ocularSpherizeDistortionFilter(), ocularPolarCoordinatesFilter() and ocularKaleidoscopeFilter(),
+                                         // Radius unused
+    OC_SCRATCH_WAVE_DISTORTION = 15,     // ocularWaveDistortionFilter(), Radius unused
+    OC_SCRATCH_LAPLACIAN_EDGE = 16,      // ocularLaplacianEdgeDetect(), Radius is the kernel radius, 3 * sigma rounded
+    OC_SCRATCH_CANNY_EDGE = 17,          // ocularCannyEdgeDetect(), Radius unused
+    OC_SCRATCH_SOBEL_EDGE = 18,          // ocularSobelEdgeDetect(), Radius unused
+    OC_SCRATCH_GRADIENT_EDGE = 19,       // ocularGradientEdgeDetect(), Radius unused
+    OC_SCRATCH_ERODE_DILATE_SHAPE = 20,  // ocularErodeShapeFilter() / ocularDilateShapeFilter(), Radius as passed, any element
+    OC_SCRATCH_MIN_MAX = 21,             // ocularMinFilter() / ocularMaxFilter(), Radius as passed
+    OC_SCRATCH_SKELETONIZE = 22,         // ocularSkeletonizeFilter(), Radius unused
+    OC_SCRATCH_BINARY_MORPHOLOGY = 23,   // ocularBinaryErode(), ocularBinaryDilate(), ocularBinaryOpen() and ocularBinaryClose(),
+                                         // Radius as passed; Stride is that of the OC_DEPTH_1U image
+    OC_SCRATCH_BINARY_SKELETONIZE = 24,  // ocularBinarySkeletonize(), Radius unused; Stride is that of the OC_DEPTH_1U image
+    OC_SCRATCH_FFT_FILTER = 25,          // ocularFFTFilter(), Radius unused
+    OC_SCRATCH_FFT_VISUALIZE = 26,       // ocularFFTVisualize(), Radius unused
+    OC_SCRATCH_DESPECKLE = 27,           // ocularDespeckle(), Radius is maxWindowSize
+    OC_SCRATCH_DOCUMENT_DESKEW = 28,     // ocularDocumentDeskew(), Radius unused
+    OC_SCRATCH_HOUGH_LINES = 29,         // ocularHoughLineDetection(), Radius unused
+    OC_SCRATCH_HAZE = 30,                // ocularHazeFilter(), Radius unused
+    OC_SCRATCH_DARK_CHANNEL_PRIOR = 31,  // ocularDarkChannelPriorHazeRemoval(), Radius as passed
+    OC_SCRATCH_AUTO_CONTRAST = 32,       // ocularAutoContrast(), Radius unused
+    OC_SCRATCH_BACKLIGHT_REPAIR = 33,    // ocularBacklightRepair(), Radius unused
+    OC_SCRATCH_BEEPS = 34,               // ocularBEEPSFilter(), Radius unused
+    OC_SCRATCH_POSTERIZE = 35,           // ocularPosterizeFilter(), Radius unused
+    OC_SCRATCH_ADAPTIVE_THRESHOLD = 36,  // ocularAdaptiveThreshold(), ocularAutoThreshold() and ocularAutoThresholdToBits(), Radius unused
+    OC_SCRATCH_OIL_PAINT = 37,           // ocularOilPaintFilter(), Radius unused
+    OC_SCRATCH_FILM_GRAIN = 38,          // ocularFilmGrainEffect(), Radius unused
+    OC_SCRATCH_FRAGMENT = 39,            // ocularFragmentFilter(), Radius unused
+    OC_SCRATCH_CRYSTALLIZE = 40,         // ocularCrystallizeFilter(), Radius is cellSize
+} OcScratchFilter;
+
+/**
+ * @brief Creates a workspace.
+ * @ingroup group_ip_utility
+ * @param Capacity The initial size of the arena in bytes; 0 lets it size itself on first use.
+ * @param[out] Workspace The returned workspace, released with ocularFreeWorkspace().
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularCreateWorkspace(size_t Capacity, OcWorkspace** Workspace);
+
+/**
+ * @brief Releases a workspace, detaching it from the calling thread if attached there. It must not hold any live blocks,
+ * i.e. no filter may be running with it.
+ * @ingroup group_ip_utility
+ * @param Workspace The workspace to release; set to NULL on return.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularFreeWorkspace(OcWorkspace** Workspace);
+
+/**
+ * @brief Attaches a workspace to the calling thread, so the filters it calls take their scratch buffers from it. A workspace
+ * must only be attached to one thread at a time. Worker threads of the pool never use it; filters size their per-thread
+ * buffers up front on the calling thread.
+ * @ingroup group_ip_utility
+ * @param Workspace The workspace to attach, or NULL to detach the current one.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularAttachWorkspace(OcWorkspace* Workspace);
+
+/**
+ * @brief Gets the workspace attached to the calling thread.
+ * @ingroup group_ip_utility
+ * @return The attached workspace, or NULL if none is attached.
+ */
+OcWorkspace* ocularGetAttachedWorkspace(void);
+
+/**
+ * @brief Reports how much a workspace has been used.
+ * @ingroup group_ip_utility
+ * @param Workspace The workspace to query.
+ * @param[out] Capacity The current size of the arena in bytes. May be NULL.
+ * @param[out] Peak The most scratch memory, in bytes, that was live at once, whether the arena or the heap held it. May be NULL.
+ * @param[out] HeapAllocations The number of requests that did not fit in the arena and went to the heap. May be NULL.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularGetWorkspaceUsage(const OcWorkspace* Workspace, size_t* Capacity, size_t* Peak, size_t* HeapAllocations);
+
+/**
+ * @brief Gets the peak scratch memory a filter takes from the attached workspace for an image of the given size, which is
+ * the capacity to create a workspace with for zero allocations from the first call. Where the buffers depend on the data
+ * or on other parameters, such as the kernel of ocularConvolution2DFilter(), the largest case is reported. FFT plans are
+ * not scratch: the transforms cache the last plan of each size internally. Filters whose buffers follow more than the
+ * image size and a radius are not covered; a workspace sizes itself for them after the first call. These are
+ * ocularResamplingFilter() and ocularResamplingThumbnails() (target sizes), pipelines (their stages),
+ * ocularSkinSmoothingFilter() (a window that follows the skin area found), ocularBinarySkewAngle() (the angle step),
+ * palette generation and quantization, and the low-level FFT functions.
+ * @ingroup group_ip_utility
+ * @param Filter The filter to query.
+ * @param Width The width of the image in pixels.
+ * @param Height The height of the image in pixels.
+ * @param Stride The number of bytes in one row of pixels; the channel count is taken as Stride / Width.
+ * @param Radius The filter radius, see OcScratchFilter.
+ * @param[out] Size The number of bytes required.
+ * @return OC_STATUS_OK if successful, otherwise an error code (see core.h)
+ */
+OC_STATUS ocularGetScratchSize(OcScratchFilter Filter, int Width, int Height, int Stride, int Radius, size_t* Size);
+
+// Allocates a 32-byte aligned temporary buffer from the workspace attached to the calling thread, or from the heap. Blocks
+// are released with ScratchFree() in any order; the arena space is reused once the blocks above it are released too.
+void* ScratchAlloc(size_t Size, bool ZeroMemory);
+
+// Releases a block from ScratchAlloc(). NULL is ignored.
+void ScratchFree(void* ptr);
+
+// Arena bytes a ScratchAlloc() of Size takes, for the size queries
+size_t ScratchBlockSize(size_t Size);
+
+// Scratch requirements of the individual filters, defined next to them
+size_t medianBlurScratchSize(int Width, int Height, int Channels, int Radius);
+size_t rankRectangleScratchSize(int Width, int Height, int Channels, int RadiusX, int RadiusY);
+size_t bilateralScratchSize(int Width, int Height, int Channels);
+size_t retinexScratchSize(int Width, int Height, int Channels);
+size_t convolution2DScratchSize(int Width, int Height, int Channels, int FilterW);
+size_t boxBlurScratchSize(int Width, int Height, int Channels);
+size_t gaussianBlurScratchSize(int Width, int Height, int Channels);
+size_t exponentialBlurScratchSize(int Width, int Height, int Channels, int Radius);
+size_t surfaceBlurScratchSize(int Width, int Height, int Channels, int Radius);
+size_t zoomBlurScratchSize(int Width, int Height, int Stride, int Channels);
+size_t radialBlurScratchSize(int Width, int Height, int Stride, int Channels);
+size_t averageBlurScratchSize(int Width, int Height);
+size_t motionBlurScratchSize(int Width, int Height, int Stride, int Channels);
+size_t guidedFilterScratchSize(int Width, int Height, int Radius);
+size_t distortionScratchSize(int Height, int Stride);
+size_t waveDistortionScratchSize(int Height, int Stride);
+size_t laplacianScratchSize(int Width, int Height, int Radius);
+size_t cannyScratchSize(int Width, int Height);
+size_t sobelScratchSize(int Width);
+size_t gradientScratchSize(int Width, int Channels);
+size_t rankShapeScratchSize(int Width, int Height, int Channels, int Radius);
+size_t rankDiskScratchSize(int Width, int Height, int Stride, int Channels, int Radius);
+size_t skeletonizeScratchSize(int Width, int Height);
+size_t binaryRankScratchSize(int Width, int Height, int Radius);
+size_t binarySkeletonizeScratchSize(int Width, int Height);
+size_t fftReal2DScratchSize(int Width, int Height);
+size_t fftFilterReal2DScratchSize(int Width, int Height);
+size_t fftFilterScratchSize(int Width, int Height);
+size_t fftVisualizeScratchSize(int Width, int Height);
+size_t despeckleScratchSize(int Channels, int maxWindowSize);
+size_t documentDeskewScratchSize(int Width, int Height);
+size_t houghLineScratchSize(int Width, int Height);
+size_t hazeFilterScratchSize(int Height);
+size_t darkChannelPriorScratchSize(int Width, int Height, int Radius);
+size_t autoContrastScratchSize(int Width, int Height);
+size_t backlightRepairScratchSize(int Width, int Height);
+size_t beepsScratchSize(int Height, int Stride);
+size_t posterizeScratchSize(int Width, int Height, int Channels);
+size_t localThresholdScratchSize(int Width, int Height, int Stride);
+size_t oilPaintScratchSize(void);
+size_t filmGrainScratchSize(int Width, int Height);
+size_t fragmentScratchSize(int Height, int Stride);
+size_t crystallizeScratchSize(int Width, int Height, int cellSize);
+
+#endif /* OCULAR_WORKSPACE_H */